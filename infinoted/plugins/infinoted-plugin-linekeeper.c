@@ -22,6 +22,7 @@
 
 #include <libinftext/inf-text-session.h>
 #include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-line-index.h>
 
 #include <libinfinity/common/inf-request-result.h>
 #include <libinfinity/inf-signals.h>
@@ -43,6 +44,7 @@ struct _InfinotedPluginLinekeeperSessionInfo {
   InfRequest* request;
   InfUser* user;
   InfTextBuffer* buffer;
+  InfTextLineIndex* line_index;
   InfIoDispatch* dispatch;
 };
 
@@ -80,7 +82,6 @@ infinoted_plugin_linekeeper_count_lines(InfTextBuffer* buffer)
    * buffer content is in UTF-8, which is currently hardcoded in infinoted. */
   InfTextBufferIter* iter;
   guint n_lines;
-  gboolean has_iter;
 
   guint length;
   gsize bytes;
@@ -130,10 +131,36 @@ static void
 infinoted_plugin_linekeeper_run(InfinotedPluginLinekeeperSessionInfo* info)
 {
   guint cur_lines;
+  guint length;
   guint n;
   gchar* text;
+  InfTextChunk* chunk;
+  gsize bytes;
+
+  /* Count the number of lines at the end of the document. The line index
+   * only knows about newline characters, but line separators (U+2028)
+   * count as line breaks as well. If the trailing newlines are preceded by
+   * one, then scan the end of the document for all of them. This is rare,
+   * so usually only the index needs to be queried. */
+  cur_lines = inf_text_line_index_get_trailing_newlines(info->line_index);
+  length = inf_text_buffer_get_length(info->buffer);
+
+  if(cur_lines < length)
+  {
+    chunk = inf_text_buffer_get_slice(
+      info->buffer,
+      length - cur_lines - 1,
+      1
+    );
 
-  cur_lines = infinoted_plugin_linekeeper_count_lines(info->buffer);
+    text = inf_text_chunk_get_text(chunk, &bytes);
+    inf_text_chunk_free(chunk);
+
+    if(g_unichar_type(g_utf8_get_char(text)) == G_UNICODE_LINE_SEPARATOR)
+      cur_lines = infinoted_plugin_linekeeper_count_lines(info->buffer);
+
+    g_free(text);
+  }
 
   if(cur_lines > info->plugin->n_lines)
   {
@@ -254,6 +281,9 @@ infinoted_plugin_linekeeper_remove_user(
     info
   );
 
+  g_object_unref(info->line_index);
+  info->line_index = NULL;
+
   g_object_unref(session);
 }
 
@@ -325,6 +355,10 @@ infinoted_plugin_linekeeper_user_join_cb(InfRequest* request,
     info->user = user;
     g_object_ref(info->user);
 
+    /* The buffer content is in UTF-8, which is currently hardcoded in
+     * infinoted, so that it can be indexed. */
+    info->line_index = inf_text_line_index_new(info->buffer);
+
     /* Initial run */
     infinoted_plugin_linekeeper_run(info);
 
@@ -443,6 +477,7 @@ infinoted_plugin_linekeeper_session_added(const InfBrowserIter* iter,
   info->proxy = proxy;
   info->request = NULL;
   info->user = NULL;
+  info->line_index = NULL;
   info->dispatch = NULL;
   g_object_ref(proxy);
 
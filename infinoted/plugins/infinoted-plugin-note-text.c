@@ -22,17 +22,40 @@
 
 #include <libinftext/inf-text-session.h>
 #include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-piece-buffer.h>
 #include <libinftext/inf-text-filesystem-format.h>
 
 #include <libinfinity/inf-i18n.h>
 
+#include <string.h>
+
+typedef enum _InfinotedPluginNoteTextFormat {
+  INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_XML,
+  INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_MAPPABLE,
+  INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_BINARY
+} InfinotedPluginNoteTextFormat;
+
 typedef struct _InfinotedPluginNoteText InfinotedPluginNoteText;
 struct _InfinotedPluginNoteText {
   InfinotedPluginManager* manager;
+  gboolean piece_buffer;
+  InfinotedPluginNoteTextFormat format;
+  gboolean checksum;
+
+  InfdNotePlugin note_plugin;
   const InfdNotePlugin* plugin;
 };
 
 /* Note plugin implementation */
+static InfTextBuffer*
+infinoted_plugin_note_text_create_buffer(InfinotedPluginNoteText* plugin)
+{
+  if(plugin->piece_buffer == TRUE)
+    return INF_TEXT_BUFFER(inf_text_piece_buffer_new());
+  else
+    return INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+}
+
 static InfSession*
 infinoted_plugin_note_text_session_new(InfIo* io,
                                        InfCommunicationManager* manager,
@@ -45,7 +68,9 @@ infinoted_plugin_note_text_session_new(InfIo* io,
   InfTextSession* session;
   InfTextBuffer* buffer;
 
-  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  buffer = infinoted_plugin_note_text_create_buffer(
+    (InfinotedPluginNoteText*)user_data
+  );
 
   session = inf_text_session_new(
     manager,
@@ -77,7 +102,9 @@ infinoted_plugin_note_text_session_read(InfdStorage* storage,
   g_assert(INFD_IS_FILESYSTEM_STORAGE(storage));
 
   user_table = inf_user_table_new();
-  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  buffer = infinoted_plugin_note_text_create_buffer(
+    (InfinotedPluginNoteText*)user_data
+  );
 
   result = inf_text_filesystem_format_read(
     INFD_FILESYSTEM_STORAGE(storage),
@@ -117,13 +144,40 @@ infinoted_plugin_note_text_session_write(InfdStorage* storage,
                                          gpointer user_data,
                                          GError** error)
 {
-  return inf_text_filesystem_format_write(
-    INFD_FILESYSTEM_STORAGE(storage),
-    path,
-    inf_session_get_user_table(session),
-    INF_TEXT_BUFFER(inf_session_get_buffer(session)),
-    error
-  );
+  InfinotedPluginNoteText* plugin;
+  plugin = (InfinotedPluginNoteText*)user_data;
+
+  switch(plugin->format)
+  {
+  case INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_XML:
+    return inf_text_filesystem_format_write(
+      INFD_FILESYSTEM_STORAGE(storage),
+      path,
+      inf_session_get_user_table(session),
+      INF_TEXT_BUFFER(inf_session_get_buffer(session)),
+      error
+    );
+  case INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_MAPPABLE:
+    return inf_text_filesystem_format_write_mappable(
+      INFD_FILESYSTEM_STORAGE(storage),
+      path,
+      inf_session_get_user_table(session),
+      INF_TEXT_BUFFER(inf_session_get_buffer(session)),
+      error
+    );
+  case INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_BINARY:
+    return inf_text_filesystem_format_write_binary(
+      INFD_FILESYSTEM_STORAGE(storage),
+      path,
+      inf_session_get_user_table(session),
+      INF_TEXT_BUFFER(inf_session_get_buffer(session)),
+      plugin->checksum,
+      error
+    );
+  default:
+    g_assert_not_reached();
+    return FALSE;
+  }
 }
 
 const InfdNotePlugin INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN = {
@@ -143,6 +197,9 @@ infinoted_plugin_note_text_info_initialize(gpointer plugin_info)
   plugin = (InfinotedPluginNoteText*)plugin_info;
 
   plugin->manager = NULL;
+  plugin->piece_buffer = FALSE;
+  plugin->format = INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_XML;
+  plugin->checksum = FALSE;
   plugin->plugin = NULL;
 }
 
@@ -158,9 +215,14 @@ infinoted_plugin_note_text_initialize(InfinotedPluginManager* manager,
 
   plugin->manager = manager;
 
+  /* Copy the note plugin so that the session callbacks can access the
+   * plugin options. */
+  plugin->note_plugin = INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN;
+  plugin->note_plugin.user_data = plugin;
+
   result = infd_directory_add_plugin(
     infinoted_plugin_manager_get_directory(manager),
-    &INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN
+    &plugin->note_plugin
   );
 
   if(result != TRUE)
@@ -176,7 +238,7 @@ infinoted_plugin_note_text_initialize(InfinotedPluginManager* manager,
     return FALSE;
   }
 
-  plugin->plugin = &INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN;
+  plugin->plugin = &plugin->note_plugin;
   return TRUE;
 }
 
@@ -202,8 +264,87 @@ infinoted_plugin_note_text_deinitialize(gpointer plugin_info)
   }
 }
 
+static gboolean
+infinoted_plugin_note_text_convert_format(gpointer out,
+                                          gpointer in,
+                                          GError** error)
+{
+  gchar** in_str;
+  InfinotedPluginNoteTextFormat* out_val;
+
+  in_str = (gchar**)in;
+  out_val = (InfinotedPluginNoteTextFormat*)out;
+
+  if(strcmp(*in_str, "xml") == 0)
+  {
+    *out_val = INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_XML;
+  }
+  else if(strcmp(*in_str, "mappable") == 0)
+  {
+    *out_val = INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_MAPPABLE;
+  }
+  else if(strcmp(*in_str, "binary") == 0)
+  {
+    *out_val = INFINOTED_PLUGIN_NOTE_TEXT_FORMAT_BINARY;
+  }
+  else
+  {
+    g_set_error(
+      error,
+      g_quark_from_static_string("INFINOTED_PLUGIN_NOTE_TEXT_ERROR"),
+      0,
+      _("\"%s\" is not a valid storage format. Allowed values are "
+        "\"xml\", \"mappable\" or \"binary\""),
+      *in_str
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static const InfinotedParameterInfo INFINOTED_PLUGIN_NOTE_TEXT_OPTIONS[] = {
   {
+    "piece-buffer",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedPluginNoteText, piece_buffer),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Whether to store the text of documents in a piece table instead of "
+       "the default text buffer. The piece table does not move text when "
+       "it is edited, which makes editing very large documents faster, at "
+       "the expense of keeping erased text in memory until the document "
+       "is unloaded. [Default: false]"),
+    NULL
+  }, {
+    "format",
+    INFINOTED_PARAMETER_STRING,
+    0,
+    offsetof(InfinotedPluginNoteText, format),
+    infinoted_plugin_note_text_convert_format,
+    0,
+    N_("The format in which documents are stored. \"xml\" stores the text "
+       "inside the XML. \"mappable\" stores it verbatim after the XML, and "
+       "\"binary\" stores the whole document in a compact binary format. "
+       "Documents in the latter two formats are mapped into memory when "
+       "they are opened, and together with the \"piece-buffer\" option "
+       "their text is only read from disk when it is accessed. Documents in "
+       "any format can be opened regardless of this setting. "
+       "[Default: xml]"),
+    N_("xml|mappable|binary")
+  }, {
+    "checksum",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedPluginNoteText, checksum),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Whether to append a checksum to documents stored in the binary "
+       "format, which is verified when they are opened. [Default: false]"),
+    NULL
+  }, {
     NULL,
     0,
     0,
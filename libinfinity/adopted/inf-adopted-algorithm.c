@@ -67,9 +67,30 @@
  * dynamically as O(active users^2). */
 
 #include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/adopted/inf-adopted-algorithm-private.h>
+#include <libinfinity/adopted/inf-adopted-request-log-private.h>
 #include <libinfinity/inf-signals.h>
 #include <libinfinity/inf-i18n.h>
 
+/* Each user in the algorithm is assigned a slot, which is its position in
+ * the users array. The array is sorted by user ID, so that the slot is also
+ * the position of the user's component in priv->current and in all state
+ * vectors with the same set of components. This allows state vector lookups
+ * in constant time via inf_adopted_state_vector_get_slot(). */
+typedef struct _InfAdoptedAlgorithmUser InfAdoptedAlgorithmUser;
+struct _InfAdoptedAlgorithmUser {
+  InfAdoptedUser* user;
+  guint id;
+  InfAdoptedRequestLog* log;
+
+  /* The user's vector as it is accounted for in priv->lcp, or NULL if the
+   * user is unavailable and does not take part in the lcp. */
+  InfAdoptedStateVector* vector;
+  /* Number of vectors taking part in the lcp whose component for this user
+   * equals the lcp's component, including priv->current. */
+  guint lcp_count;
+};
+
 typedef struct _InfAdoptedAlgorithmLocalUser InfAdoptedAlgorithmLocalUser;
 struct _InfAdoptedAlgorithmLocalUser {
   InfAdoptedUser* user;
@@ -82,18 +103,39 @@ struct _InfAdoptedAlgorithmPrivate {
   /* request log policy */
   guint max_total_log_size;
 
+  /* translation cache policy */
+  guint max_cache_size;
+  /* Total number of cached requests in all users' request logs, kept up to
+   * date by the logs themselves. */
+  guint n_cached_requests;
+
   InfAdoptedStateVector* current;
   InfAdoptedStateVector* buffer_modified_time;
 
+  /* Least common predecessor of the current state and the vectors of all
+   * available users. It is kept up to date whenever one of these changes,
+   * so that inf_adopted_algorithm_cleanup() does not need to recompute it,
+   * and cleanup only needs to look at the request logs if it has changed
+   * since the last cleanup. */
+  InfAdoptedStateVector* lcp;
+  gboolean lcp_changed;
+
   InfAdoptedRequest* execute_request;
 
+  /* Set while inf_adopted_algorithm_execute_requests() runs. Local user
+   * times, the buffer's modified flag and the can-undo and can-redo state
+   * are then only updated once at the end of the batch. batch_unmodified
+   * records whether the buffer should be reset to non-modified then. */
+  gboolean batch;
+  gboolean batch_unmodified;
+
   InfUserTable* user_table;
   InfBuffer* buffer;
 
   /* Users in user table. We need to iterate over them very often, so we
-   * keep them as array here. */
-  InfAdoptedUser** users_begin;
-  InfAdoptedUser** users_end;
+   * keep them as array here, sorted by user ID. */
+  InfAdoptedAlgorithmUser* users_begin;
+  InfAdoptedAlgorithmUser* users_end;
 
   GSList* local_users;
 };
@@ -105,6 +147,9 @@ enum {
   PROP_USER_TABLE,
   PROP_BUFFER,
   PROP_MAX_TOTAL_LOG_SIZE,
+
+  /* read/write */
+  PROP_MAX_CACHE_SIZE,
   
   /* read/only */
   PROP_CURRENT_STATE,
@@ -140,22 +185,22 @@ inf_adopted_algorithm_least_common_successor(InfAdoptedAlgorithm* algorithm,
                                              InfAdoptedStateVector* second)
 {
   InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedUser** user;
+  InfAdoptedAlgorithmUser* user;
   InfAdoptedStateVector* result;
-  guint id;
+  guint slot;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
   result = inf_adopted_state_vector_new();
 
   for(user = priv->users_begin; user != priv->users_end; ++ user)
   {
-    id = inf_user_get_id(INF_USER(*user));
+    slot = user - priv->users_begin;
     inf_adopted_state_vector_set(
       result,
-      id,
+      user->id,
       MAX(
-        inf_adopted_state_vector_get(first, id),
-        inf_adopted_state_vector_get(second, id)
+        inf_adopted_state_vector_get_slot(first, user->id, slot),
+        inf_adopted_state_vector_get_slot(second, user->id, slot)
       )
     );
   }
@@ -165,42 +210,6 @@ inf_adopted_algorithm_least_common_successor(InfAdoptedAlgorithm* algorithm,
   return result;
 }
 
-/* Returns a new state vector v so that v is both causally before first and
- * second and so that there is no other state vector with the same property
- * so that v is causally before that vector. */
-/* TODO: Move this to state vector, possibly with a faster O(n)
- * implementation (This is O(n log n), at best) */
-/* TODO: A version modifying first instead of returning a new result,
- * use in inf_adopted_algorithm_cleanup(). */
-static InfAdoptedStateVector*
-inf_adopted_algorithm_least_common_predecessor(InfAdoptedAlgorithm* algorithm,
-                                               InfAdoptedStateVector* first,
-                                               InfAdoptedStateVector* second)
-{
-  InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedUser** user;
-  InfAdoptedStateVector* result;
-  guint id;
-
-  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
-  result = inf_adopted_state_vector_new();
-
-  for(user = priv->users_begin; user != priv->users_end; ++ user)
-  {
-    id = inf_user_get_id(INF_USER(*user));
-    inf_adopted_state_vector_set(
-      result,
-      id,
-      MIN(
-        inf_adopted_state_vector_get(first, id),
-        inf_adopted_state_vector_get(second, id)
-      )
-    );
-  }
-
-  return result;
-}
-
 /* Checks whether the given request can be undone (or redone if it is an
  * undo request). In general, a user can perform an undo when
  * there is a request to undo in the request log. However, if there are too
@@ -339,31 +348,286 @@ inf_adopted_algorithm_local_user_free(InfAdoptedAlgorithm* algorithm,
   g_slice_free(InfAdoptedAlgorithmLocalUser, local);
 }
 
+/* Returns the position in the users array where a user with the given ID
+ * is, or would need to be inserted. */
+static InfAdoptedAlgorithmUser*
+inf_adopted_algorithm_find_user_pos(InfAdoptedAlgorithm* algorithm,
+                                    guint id)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedAlgorithmUser* begin;
+  InfAdoptedAlgorithmUser* end;
+  InfAdoptedAlgorithmUser* middle;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  begin = priv->users_begin;
+  end = priv->users_end;
+
+  while(begin != end)
+  {
+    middle = begin + (end - begin) / 2;
+    if(middle->id == id)
+      return middle;
+
+    if(middle->id < id)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+
+  return begin;
+}
+
+static InfAdoptedAlgorithmUser*
+inf_adopted_algorithm_find_user(InfAdoptedAlgorithm* algorithm,
+                                guint id)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedAlgorithmUser* user;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  user = inf_adopted_algorithm_find_user_pos(algorithm, id);
+
+  if(user == priv->users_end || user->id != id)
+    return NULL;
+
+  return user;
+}
+
+/* Recomputes the lcp component of comp from scratch, as the minimum of the
+ * component in the current state and in all available users' vectors. */
+static void
+inf_adopted_algorithm_lcp_recompute(InfAdoptedAlgorithm* algorithm,
+                                    InfAdoptedAlgorithmUser* comp)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedAlgorithmUser* user;
+  guint slot;
+  guint value;
+  guint n;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  slot = comp - priv->users_begin;
+
+  value = inf_adopted_state_vector_get_slot(priv->current, comp->id, slot);
+  comp->lcp_count = 1;
+
+  for(user = priv->users_begin; user != priv->users_end; ++ user)
+  {
+    if(user->vector != NULL)
+    {
+      n = inf_adopted_state_vector_get_slot(user->vector, comp->id, slot);
+      if(n < value)
+      {
+        value = n;
+        comp->lcp_count = 1;
+      }
+      else if(n == value)
+      {
+        ++ comp->lcp_count;
+      }
+    }
+  }
+
+  if(inf_adopted_state_vector_get_slot(priv->lcp, comp->id, slot) != value)
+  {
+    inf_adopted_state_vector_set(priv->lcp, comp->id, value);
+    priv->lcp_changed = TRUE;
+  }
+}
+
+/* Updates the lcp component of comp after one of the vectors taking part in
+ * the lcp changed its component from old_value to new_value. G_MAXUINT
+ * stands for a vector that does not (or no longer) take part in the lcp.
+ * The component only needs to be recomputed if the last vector holding the
+ * minimum advanced, so this is amortized constant time. */
+static void
+inf_adopted_algorithm_lcp_update(InfAdoptedAlgorithm* algorithm,
+                                 InfAdoptedAlgorithmUser* comp,
+                                 guint old_value,
+                                 guint new_value)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  guint slot;
+  guint value;
+
+  if(old_value == new_value)
+    return;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  slot = comp - priv->users_begin;
+  value = inf_adopted_state_vector_get_slot(priv->lcp, comp->id, slot);
+
+  if(new_value < value)
+  {
+    inf_adopted_state_vector_set(priv->lcp, comp->id, new_value);
+    comp->lcp_count = 1;
+    priv->lcp_changed = TRUE;
+  }
+  else if(new_value == value)
+  {
+    ++ comp->lcp_count;
+  }
+  else if(old_value == value)
+  {
+    g_assert(comp->lcp_count > 0);
+    if(-- comp->lcp_count == 0)
+      inf_adopted_algorithm_lcp_recompute(algorithm, comp);
+  }
+}
+
+/* Accounts for a change in the vector or availability of user in the lcp. */
+static void
+inf_adopted_algorithm_lcp_update_user(InfAdoptedAlgorithm* algorithm,
+                                      InfAdoptedAlgorithmUser* user)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedAlgorithmUser* comp;
+  InfAdoptedStateVector* old_vector;
+  guint slot;
+  guint old_value;
+  guint new_value;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  old_vector = user->vector;
+
+  if(inf_user_get_status(INF_USER(user->user)) != INF_USER_UNAVAILABLE)
+  {
+    user->vector = inf_adopted_state_vector_copy(
+      inf_adopted_user_get_vector(user->user)
+    );
+  }
+  else
+  {
+    user->vector = NULL;
+  }
+
+  if(old_vector == NULL && user->vector == NULL)
+    return;
+
+  for(comp = priv->users_begin; comp != priv->users_end; ++ comp)
+  {
+    slot = comp - priv->users_begin;
+
+    old_value = G_MAXUINT;
+    if(old_vector != NULL)
+    {
+      old_value = inf_adopted_state_vector_get_slot(
+        old_vector,
+        comp->id,
+        slot
+      );
+    }
+
+    new_value = G_MAXUINT;
+    if(user->vector != NULL)
+    {
+      new_value = inf_adopted_state_vector_get_slot(
+        user->vector,
+        comp->id,
+        slot
+      );
+    }
+
+    inf_adopted_algorithm_lcp_update(algorithm, comp, old_value, new_value);
+  }
+
+  if(old_vector != NULL)
+    inf_adopted_state_vector_free(old_vector);
+}
+
+static void
+inf_adopted_algorithm_user_notify_cb(GObject* object,
+                                     GParamSpec* pspec,
+                                     gpointer user_data)
+{
+  InfAdoptedAlgorithm* algorithm;
+  InfAdoptedAlgorithmUser* user;
+
+  algorithm = INF_ADOPTED_ALGORITHM(user_data);
+  user = inf_adopted_algorithm_find_user(
+    algorithm,
+    inf_user_get_id(INF_USER(object))
+  );
+
+  g_assert(user != NULL);
+  inf_adopted_algorithm_lcp_update_user(algorithm, user);
+}
+
 static void
 inf_adopted_algorithm_add_user(InfAdoptedAlgorithm* algorithm,
                                InfAdoptedUser* user)
 {
   InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedRequestLog* log;
   InfAdoptedStateVector* time;
+  InfAdoptedAlgorithmUser* pos;
+  guint user_id;
   guint user_count;
+  guint slot;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
-  log = inf_adopted_user_get_request_log(user);
+  user_id = inf_user_get_id(INF_USER(user));
   time = inf_adopted_user_get_vector(user);
 
   inf_adopted_state_vector_set(
     priv->current,
-    inf_user_get_id(INF_USER(user)),
-    inf_adopted_state_vector_get(time, inf_user_get_id(INF_USER(user)))
+    user_id,
+    inf_adopted_state_vector_get(time, user_id)
   );
 
+  /* Insert the user such that the array remains sorted by ID. This
+   * changes the slots of all users with higher IDs, but that happens only
+   * rarely, and slots are not kept across calls. */
+  pos = inf_adopted_algorithm_find_user_pos(algorithm, user_id);
+  g_assert(pos == priv->users_end || pos->id != user_id);
+
+  slot = pos - priv->users_begin;
   user_count = (priv->users_end - priv->users_begin) + 1;
-  priv->users_begin =
-    g_realloc(priv->users_begin, sizeof(InfAdoptedUser*) * user_count);
+  priv->users_begin = g_renew(
+    InfAdoptedAlgorithmUser,
+    priv->users_begin,
+    user_count
+  );
+
   priv->users_end = priv->users_begin + user_count;
-  priv->users_begin[user_count - 1] = user;
+
+  g_memmove(
+    priv->users_begin + slot + 1,
+    priv->users_begin + slot,
+    (user_count - slot - 1) * sizeof(InfAdoptedAlgorithmUser)
+  );
+
+  priv->users_begin[slot].user = user;
+  priv->users_begin[slot].id = user_id;
+  priv->users_begin[slot].log = inf_adopted_user_get_request_log(user);
+  priv->users_begin[slot].vector = NULL;
+
+  _inf_adopted_request_log_set_cache_counter(
+    priv->users_begin[slot].log,
+    &priv->n_cached_requests
+  );
+
+  /* The lcp gains a component for the new user, and the new user's vector
+   * takes part in the lcp while the user is available. There is a new
+   * request log to clean up, too. */
+  inf_adopted_algorithm_lcp_recompute(algorithm, priv->users_begin + slot);
+  inf_adopted_algorithm_lcp_update_user(algorithm, priv->users_begin + slot);
+  priv->lcp_changed = TRUE;
+
+  g_signal_connect(
+    G_OBJECT(user),
+    "notify::vector",
+    G_CALLBACK(inf_adopted_algorithm_user_notify_cb),
+    algorithm
+  );
+
+  g_signal_connect(
+    G_OBJECT(user),
+    "notify::status",
+    G_CALLBACK(inf_adopted_algorithm_user_notify_cb),
+    algorithm
+  );
 }
 
 static void
@@ -444,12 +708,12 @@ inf_adopted_algorithm_buffer_states_equivalent(InfAdoptedAlgorithm* algorithm,
                                                InfAdoptedStateVector* second)
 {
   InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedUser** user_it;
-  InfAdoptedUser* user;
+  InfAdoptedAlgorithmUser* user_it;
   InfAdoptedRequest* request;
   InfAdoptedRequestLog* log;
 
   guint user_id;
+  guint slot;
   guint first_n;
   guint second_n;
 
@@ -459,12 +723,12 @@ inf_adopted_algorithm_buffer_states_equivalent(InfAdoptedAlgorithm* algorithm,
 
   for(user_it = priv->users_begin; user_it != priv->users_end; ++ user_it)
   {
-    user = *user_it;
-    user_id = inf_user_get_id(INF_USER(user));
-    log = inf_adopted_user_get_request_log(user);
+    user_id = user_it->id;
+    slot = user_it - priv->users_begin;
+    log = user_it->log;
 
-    first_n = inf_adopted_state_vector_get(first, user_id);
-    second_n = inf_adopted_state_vector_get(second, user_id);
+    first_n = inf_adopted_state_vector_get_slot(first, user_id, slot);
+    second_n = inf_adopted_state_vector_get_slot(second, user_id, slot);
 
     /* TODO: This algorithm can probably be optimized by moving it into 
      * request log. */
@@ -485,10 +749,7 @@ inf_adopted_algorithm_buffer_states_equivalent(InfAdoptedAlgorithm* algorithm,
       {
         request = inf_adopted_request_log_prev_associated(log, request);
 
-        second_n = inf_adopted_state_vector_get(
-          inf_adopted_request_get_vector(request),
-          user_id
-        );
+        second_n = inf_adopted_request_get_index(request);
       }
     }
 
@@ -596,6 +857,51 @@ inf_adopted_algorithm_can_cache(InfAdoptedRequest* request)
   return flags == INF_ADOPTED_OPERATION_CACHABLE;
 }
 
+/* Evicts cached requests if the total number of cached requests in all
+ * request logs exceeds max-cache-size. Requests are evicted from the log
+ * with the largest cache, so that a single user's requests being translated
+ * very often does not flush the caches of everyone else. To not look for the
+ * largest log on every insertion once the cache is full, the cache is
+ * shrunk somewhat below max-cache-size. */
+static void
+inf_adopted_algorithm_limit_cache(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedAlgorithmUser* user;
+  InfAdoptedRequestLog* largest_log;
+  guint largest_size;
+  guint target_size;
+  guint size;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  if(priv->n_cached_requests <= priv->max_cache_size)
+    return;
+
+  target_size = priv->max_cache_size - priv->max_cache_size / 16;
+  while(priv->n_cached_requests > target_size)
+  {
+    largest_log = NULL;
+    largest_size = 0;
+
+    for(user = priv->users_begin; user != priv->users_end; ++user)
+    {
+      size = inf_adopted_request_log_get_n_cached_requests(user->log);
+      if(size > largest_size)
+      {
+        largest_log = user->log;
+        largest_size = size;
+      }
+    }
+
+    g_assert(largest_log != NULL);
+
+    inf_adopted_request_log_evict_cached_requests(
+      largest_log,
+      MIN(priv->n_cached_requests - target_size, largest_size)
+    );
+  }
+}
+
 /* Translates two requests to state at and then transforms them against each
  * other. The result needs to be unref()ed. */
 static InfAdoptedRequest*
@@ -703,10 +1009,11 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
                                                 InfAdoptedStateVector* to)
 {
   InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedUser** user_it;
-  InfAdoptedUser* user;
+  InfAdoptedAlgorithmUser* request_user;
+  InfAdoptedAlgorithmUser* user_it;
   InfAdoptedRequestLog* log;
   guint user_id;
+  guint slot;
 
   InfAdoptedRequest* cur_req;
   InfAdoptedRequest* next_req;
@@ -722,6 +1029,15 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
+  /* Transformations, folds and mirrors all keep the user of the request,
+   * so we only need to look it up once. */
+  request_user = inf_adopted_algorithm_find_user(
+    algorithm,
+    inf_adopted_request_get_user_id(request)
+  );
+
+  g_assert(request_user != NULL);
+
   cur_req = request;
   vector = inf_adopted_request_get_vector(cur_req);
   g_object_ref(cur_req);
@@ -733,18 +1049,18 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
     g_assert(inf_adopted_state_vector_causally_before(vector, to) == TRUE);
     for(user_it = priv->users_begin; user_it != priv->users_end; ++user_it)
     {
-      user = *user_it;
-      user_id = inf_user_get_id(INF_USER(user));
+      if(user_it == request_user) continue;
 
-      if(user_id == inf_adopted_request_get_user_id(cur_req)) continue;
+      user_id = user_it->id;
+      slot = user_it - priv->users_begin;
 
-      from_n = inf_adopted_state_vector_get(vector, user_id);
-      to_n = inf_adopted_state_vector_get(to, user_id);
+      from_n = inf_adopted_state_vector_get_slot(vector, user_id, slot);
+      to_n = inf_adopted_state_vector_get_slot(to, user_id, slot);
       g_assert(from_n <= to_n);
 
       if(from_n == to_n) continue;
 
-      log = inf_adopted_user_get_request_log(user);
+      log = user_it->log;
       g_assert(from_n >= inf_adopted_request_log_get_begin(log));
       g_assert(to_n <= inf_adopted_request_log_get_end(log));
 
@@ -790,14 +1106,12 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
     /* Late Mirror, only if no transformations or folds possible */
     if(next_req == NULL)
     {
-      user_id = inf_adopted_request_get_user_id(cur_req);
-      user = INF_ADOPTED_USER(
-        inf_user_table_lookup_user_by_id(priv->user_table, user_id)
-      );
+      user_id = request_user->id;
+      slot = request_user - priv->users_begin;
 
-      log = inf_adopted_user_get_request_log(user);
+      log = request_user->log;
       from_n = inf_adopted_request_get_index(cur_req);
-      to_n = inf_adopted_state_vector_get(to, user_id);
+      to_n = inf_adopted_state_vector_get_slot(to, user_id, slot);
       index = inf_adopted_request_log_get_request(log, from_n);
       associated = inf_adopted_request_log_next_associated(log, index);
 
@@ -873,8 +1187,17 @@ inf_adopted_algorithm_log_request(InfAdoptedAlgorithm* algorithm,
     inf_adopted_request_log_add_request(log, request);
     /* Update current document state */
     inf_adopted_state_vector_add(priv->current, user_id, 1);
-    /* Update local user times */
-    inf_adopted_algorithm_update_local_user_times(algorithm);
+    inf_adopted_algorithm_lcp_update(
+      algorithm,
+      inf_adopted_algorithm_find_user(algorithm, user_id),
+      inf_adopted_state_vector_get(priv->current, user_id) - 1,
+      inf_adopted_state_vector_get(priv->current, user_id)
+    );
+
+    /* Update local user times, unless we are executing a batch of requests
+     * in which case this is done once at the end of the batch. */
+    if(!priv->batch)
+      inf_adopted_algorithm_update_local_user_times(algorithm);
 
     /* Unset the modified flag of the buffer if the state is equivalent
      * (reachable only by folding, i.e. skipping undo/redo pairs) to the
@@ -889,7 +1212,11 @@ inf_adopted_algorithm_log_request(InfAdoptedAlgorithm* algorithm,
 
       if(equivalent == TRUE)
       {
-        inf_buffer_set_modified(priv->buffer, FALSE);
+        if(!priv->batch)
+          inf_buffer_set_modified(priv->buffer, FALSE);
+        else
+          priv->batch_unmodified = TRUE;
+
         inf_adopted_state_vector_free(priv->buffer_modified_time);
         priv->buffer_modified_time =
           inf_adopted_state_vector_copy(priv->current);
@@ -1034,10 +1361,16 @@ inf_adopted_algorithm_init(InfAdoptedAlgorithm* algorithm)
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
   priv->max_total_log_size = 2048;
+  priv->max_cache_size = 8192;
+  priv->n_cached_requests = 0;
   priv->execute_request = NULL;
+  priv->batch = FALSE;
+  priv->batch_unmodified = FALSE;
 
   priv->current = inf_adopted_state_vector_new();
   priv->buffer_modified_time = NULL;
+  priv->lcp = inf_adopted_state_vector_new();
+  priv->lcp_changed = TRUE;
   priv->user_table = NULL;
   priv->buffer = NULL;
 
@@ -1106,6 +1439,7 @@ inf_adopted_algorithm_dispose(GObject* object)
 {
   InfAdoptedAlgorithm* algorithm;
   InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedAlgorithmUser* user;
   GList* item;
 
   algorithm = INF_ADOPTED_ALGORITHM(object);
@@ -1114,7 +1448,25 @@ inf_adopted_algorithm_dispose(GObject* object)
   while(priv->local_users != NULL)
     inf_adopted_algorithm_local_user_free(algorithm, priv->local_users->data);
 
+  for(user = priv->users_begin; user != priv->users_end; ++ user)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(user->user),
+      G_CALLBACK(inf_adopted_algorithm_user_notify_cb),
+      algorithm
+    );
+
+    _inf_adopted_request_log_set_cache_counter(user->log, NULL);
+
+    if(user->vector != NULL)
+      inf_adopted_state_vector_free(user->vector);
+  }
+
+  g_assert(priv->n_cached_requests == 0);
+
   g_free(priv->users_begin);
+  priv->users_begin = NULL;
+  priv->users_end = NULL;
 
   if(priv->buffer != NULL)
   {
@@ -1168,6 +1520,7 @@ inf_adopted_algorithm_finalize(GObject* object)
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
   inf_adopted_state_vector_free(priv->current);
+  inf_adopted_state_vector_free(priv->lcp);
 
   G_OBJECT_CLASS(inf_adopted_algorithm_parent_class)->finalize(object);
 }
@@ -1229,6 +1582,10 @@ inf_adopted_algorithm_set_property(GObject* object,
   case PROP_MAX_TOTAL_LOG_SIZE:
     priv->max_total_log_size = g_value_get_uint(value);
     break;
+  case PROP_MAX_CACHE_SIZE:
+    priv->max_cache_size = g_value_get_uint(value);
+    inf_adopted_algorithm_limit_cache(algorithm);
+    break;
   case PROP_CURRENT_STATE:
   case PROP_BUFFER_MODIFIED_STATE:
     /* read/only */
@@ -1261,6 +1618,9 @@ inf_adopted_algorithm_get_property(GObject* object,
   case PROP_MAX_TOTAL_LOG_SIZE:
     g_value_set_uint(value, priv->max_total_log_size);
     break;
+  case PROP_MAX_CACHE_SIZE:
+    g_value_set_uint(value, priv->max_cache_size);
+    break;
   case PROP_CURRENT_STATE:
     g_value_set_boxed(value, priv->current);
     break;
@@ -1356,6 +1716,30 @@ inf_adopted_algorithm_class_init(InfAdoptedAlgorithmClass* algorithm_class)
     )
   );
 
+  /**
+   * InfAdoptedAlgorithm:max-cache-size:
+   *
+   * The maximum number of translated requests to keep in the translation
+   * caches of all user's request logs. When the caches grow larger, requests
+   * that have not been used recently are evicted, and need to be translated
+   * again if they are needed later. Set to %G_MAXUINT to disable the
+   * limitation, in which case the caches only shrink when requests are
+   * removed from the request logs.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_MAX_CACHE_SIZE,
+    g_param_spec_uint(
+      "max-cache-size",
+      "Maximum cache size",
+      "The maximum number of translated requests to cache in all user's logs",
+      0,
+      G_MAXUINT,
+      8192,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_CURRENT_STATE,
@@ -1704,9 +2088,7 @@ inf_adopted_algorithm_translate_request(InfAdoptedAlgorithm* algorithm,
                                         InfAdoptedStateVector* to)
 {
   InfAdoptedAlgorithmPrivate* priv;
-  guint user_id;
-  InfUser* plain_user;
-  InfAdoptedUser* user;
+  InfAdoptedAlgorithmUser* user;
   InfAdoptedRequestLog* log;
   InfAdoptedRequest* result;
 
@@ -1715,13 +2097,14 @@ inf_adopted_algorithm_translate_request(InfAdoptedAlgorithm* algorithm,
   g_return_val_if_fail(to != NULL, NULL);
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
-  user_id = inf_adopted_request_get_user_id(request);
-  plain_user = inf_user_table_lookup_user_by_id(priv->user_table, user_id);
+  user = inf_adopted_algorithm_find_user(
+    algorithm,
+    inf_adopted_request_get_user_id(request)
+  );
 
   /* Validity checks */
-  g_return_val_if_fail(INF_ADOPTED_IS_USER(plain_user), NULL);
-  user = INF_ADOPTED_USER(plain_user);
-  log = inf_adopted_user_get_request_log(user);
+  g_return_val_if_fail(user != NULL, NULL);
+  log = user->log;
 
   g_return_val_if_fail(
     inf_adopted_state_vector_causally_before(to, priv->current),
@@ -1765,61 +2148,52 @@ inf_adopted_algorithm_translate_request(InfAdoptedAlgorithm* algorithm,
   );
 
   if(inf_adopted_algorithm_can_cache(result))
+  {
     inf_adopted_request_log_add_cached_request(log, result);
+    inf_adopted_algorithm_limit_cache(algorithm);
+  }
+
   return result;
 }
 
-/**
- * inf_adopted_algorithm_execute_request:
- * @algorithm: A #InfAdoptedAlgorithm.
- * @request: The request to execute.
- * @apply: Whether to apply the request to the buffer.
- * @error: Location to store error information, if any.
- *
- * This function transforms the given request such that it can be applied to
- * the current document state and then applies it the buffer and adds it to
- * the request log of the algorithm, so that it is used for future
- * transformations of other requests.
- *
- * If @apply is %FALSE then the request is not applied to the buffer. In this
- * case, it is assumed that the buffer is already modified, and that the
- * request is made as a result from the buffer modification. This also means
- * that the request must be applicable to the current document state, without
- * requiring transformation.
- *
- * In addition, the function emits the
- * #InfAdoptedAlgorithm::begin-execute-request and
- * #InfAdoptedAlgorithm::end-execute-request signals, and makes
- * inf_adopted_algorithm_get_execute_request() return @request during that
- * period.
- *
- * This allows other code to hook in before and after request processing. This
- * does not cause any loss of generality because this function is not
- * re-entrant anyway: it cannot work when used concurrently by multiple
- * threads nor in a recursive manner, because only when one request has been
- * added to the log the next request can be translated, since it might need
- * the previous request for the translation path and it needs to be translated
- * to a state where the effect of the previous request is included so that it
- * can consistently applied to the buffer.
- *
- * There are also runtime errors that can occur if @request execution fails.
- * In this case the function returns %FALSE and @error is set. Possible
- * reasons for this include @request being an %INF_ADOPTED_REQUEST_UNDO or
- * %INF_ADOPTED_REQUEST_REDO request without there being an operation to
- * undo or redo, or if the translated operation cannot be applied to the
- * buffer. This usually means that the input @request was invalid. However,
- * this is not considered a programmer error because typically requests are
- * received from untrusted input sources such as network connections.
- * Note that there cannot be any runtime errors if @apply is set to %FALSE.
- * In that case it is safe to call the function with %NULL error.
- *
- * Returns: %TRUE on success or %FALSE on error.
- */
-gboolean
-inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
-                                      InfAdoptedRequest* request,
-                                      gboolean apply,
-                                      GError** error)
+/* Performs the state updates that are skipped while executing a batch of
+ * requests, so that the algorithm is in the same state as if the requests
+ * had been executed one by one. */
+static void
+inf_adopted_algorithm_end_batch(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  inf_adopted_algorithm_update_local_user_times(algorithm);
+
+  if(priv->batch_unmodified)
+  {
+    inf_signal_handlers_block_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
+
+    inf_buffer_set_modified(priv->buffer, FALSE);
+
+    inf_signal_handlers_unblock_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
+
+    priv->batch_unmodified = FALSE;
+  }
+
+  inf_adopted_algorithm_update_undo_redo(algorithm);
+}
+
+static gboolean
+inf_adopted_algorithm_execute_request_internal(InfAdoptedAlgorithm* algorithm,
+                                               InfAdoptedRequest* request,
+                                               gboolean apply,
+                                               GError** error)
 {
   InfAdoptedAlgorithmPrivate* priv;
   InfAdoptedUser* user;
@@ -1832,9 +2206,6 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
   GError* local_error;
   gchar* request_str;
 
-  g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), FALSE);
-  g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), FALSE);
-
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
   g_return_val_if_fail(
@@ -1869,6 +2240,11 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
   g_return_val_if_fail(priv->execute_request == NULL, FALSE);
   priv->execute_request = request;
 
+  /* Within a batch, the can-undo and can-redo state of local users is only
+   * updated at the end. Bring it up to date if we need it now. */
+  if(priv->batch && inf_adopted_algorithm_find_local_user(algorithm, user))
+    inf_adopted_algorithm_end_batch(algorithm);
+
   inf_adopted_request_set_execute_time(request, g_get_real_time());
 
   g_signal_emit(
@@ -1974,6 +2350,9 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
 
   if(apply == TRUE)
   {
+    /* Applying the request modifies the buffer */
+    priv->batch_unmodified = FALSE;
+
     log_request = inf_adopted_algorithm_apply_request(
       algorithm,
       user,
@@ -2025,7 +2404,8 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
     algorithm
   );
 
-  inf_adopted_algorithm_update_undo_redo(algorithm);
+  if(!priv->batch)
+    inf_adopted_algorithm_update_undo_redo(algorithm);
 
   g_signal_emit(
     G_OBJECT(algorithm),
@@ -2044,6 +2424,142 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
   return TRUE;
 }
 
+/**
+ * inf_adopted_algorithm_execute_request:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ * @request: The request to execute.
+ * @apply: Whether to apply the request to the buffer.
+ * @error: Location to store error information, if any.
+ *
+ * This function transforms the given request such that it can be applied to
+ * the current document state and then applies it the buffer and adds it to
+ * the request log of the algorithm, so that it is used for future
+ * transformations of other requests.
+ *
+ * If @apply is %FALSE then the request is not applied to the buffer. In this
+ * case, it is assumed that the buffer is already modified, and that the
+ * request is made as a result from the buffer modification. This also means
+ * that the request must be applicable to the current document state, without
+ * requiring transformation.
+ *
+ * In addition, the function emits the
+ * #InfAdoptedAlgorithm::begin-execute-request and
+ * #InfAdoptedAlgorithm::end-execute-request signals, and makes
+ * inf_adopted_algorithm_get_execute_request() return @request during that
+ * period.
+ *
+ * This allows other code to hook in before and after request processing. This
+ * does not cause any loss of generality because this function is not
+ * re-entrant anyway: it cannot work when used concurrently by multiple
+ * threads nor in a recursive manner, because only when one request has been
+ * added to the log the next request can be translated, since it might need
+ * the previous request for the translation path and it needs to be translated
+ * to a state where the effect of the previous request is included so that it
+ * can consistently applied to the buffer.
+ *
+ * There are also runtime errors that can occur if @request execution fails.
+ * In this case the function returns %FALSE and @error is set. Possible
+ * reasons for this include @request being an %INF_ADOPTED_REQUEST_UNDO or
+ * %INF_ADOPTED_REQUEST_REDO request without there being an operation to
+ * undo or redo, or if the translated operation cannot be applied to the
+ * buffer. This usually means that the input @request was invalid. However,
+ * this is not considered a programmer error because typically requests are
+ * received from untrusted input sources such as network connections.
+ * Note that there cannot be any runtime errors if @apply is set to %FALSE.
+ * In that case it is safe to call the function with %NULL error.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
+                                      InfAdoptedRequest* request,
+                                      gboolean apply,
+                                      GError** error)
+{
+  g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), FALSE);
+  g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), FALSE);
+
+  return inf_adopted_algorithm_execute_request_internal(
+    algorithm,
+    request,
+    apply,
+    error
+  );
+}
+
+/**
+ * inf_adopted_algorithm_execute_requests:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ * @requests: (array length=n_requests): The requests to execute.
+ * @n_requests: The number of requests in @requests.
+ * @apply: Whether to apply the requests to the buffer.
+ * @error: Location to store error information, if any.
+ *
+ * Executes the given requests in order, in the same way as if
+ * inf_adopted_algorithm_execute_request() was called for each of them.
+ * Each request must be causally before the current state at the time it is
+ * executed, i.e. after all previous requests in @requests have been executed.
+ *
+ * The #InfAdoptedAlgorithm::begin-execute-request and
+ * #InfAdoptedAlgorithm::end-execute-request signals are still emitted for
+ * every request. However, the state vectors of local users, the modified flag
+ * of the buffer, and the #InfAdoptedAlgorithm::can-undo-changed and
+ * #InfAdoptedAlgorithm::can-redo-changed signals are only updated once after
+ * the last request has been executed. Each request is still applied to the
+ * buffer on its own. Afterwards, inf_adopted_algorithm_cleanup() is called
+ * once. This makes executing many requests at once, for example when a
+ * burst of requests arrives from the network, cheaper than executing them
+ * one by one.
+ *
+ * If one of the requests fails to execute, then the function stops and
+ * @error is set. The requests before the failed one remain executed.
+ *
+ * Returns: The number of requests that have been executed successfully. If
+ * this is less than @n_requests then @error is set.
+ */
+guint
+inf_adopted_algorithm_execute_requests(InfAdoptedAlgorithm* algorithm,
+                                       InfAdoptedRequest** requests,
+                                       guint n_requests,
+                                       gboolean apply,
+                                       GError** error)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  gboolean result;
+  guint i;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), 0);
+  g_return_val_if_fail(requests != NULL || n_requests == 0, 0);
+  g_return_val_if_fail(error == NULL || *error == NULL, 0);
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  /* not re-entrant */
+  g_return_val_if_fail(priv->execute_request == NULL, 0);
+  g_return_val_if_fail(priv->batch == FALSE, 0);
+
+  for(i = 0; i < n_requests; ++i)
+    g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(requests[i]), 0);
+
+  _inf_adopted_algorithm_begin_batch(algorithm);
+
+  for(i = 0; i < n_requests; ++i)
+  {
+    result = inf_adopted_algorithm_execute_request_internal(
+      algorithm,
+      requests[i],
+      apply,
+      error
+    );
+
+    if(result == FALSE)
+      break;
+  }
+
+  _inf_adopted_algorithm_end_batch(algorithm, i > 0);
+  return i;
+}
+
 /**
  * inf_adopted_algorithm_cleanup:
  * @algorithm: A #InfAdoptedAlgorithm.
@@ -2061,9 +2577,8 @@ void
 inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
 {
   InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedStateVector* temp;
   InfAdoptedStateVector* lcp;
-  InfAdoptedUser** user;
+  InfAdoptedAlgorithmUser* user;
   InfAdoptedRequestLog* log;
   InfAdoptedRequest* req;
   InfAdoptedStateVector* req_vec;
@@ -2102,26 +2617,20 @@ inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
    * are additional conditions. However, in the current case, some requests
    * are just kept a bit longer than necessary, in favor of simplicity. */
 
-  lcp = inf_adopted_state_vector_copy(priv->current);
-  for(user = priv->users_begin; user != priv->users_end; ++ user)
-  {
-    if(inf_user_get_status(INF_USER(*user)) != INF_USER_UNAVAILABLE)
-    {
-      temp = inf_adopted_algorithm_least_common_predecessor(
-        algorithm,
-        lcp,
-        inf_adopted_user_get_vector(*user)
-      );
+  /* The lcp is maintained as the users' vectors change. If it did not
+   * change since the last cleanup, then no more requests can be removed
+   * than last time: Requests added to the logs since then are not older,
+   * and they can only make existing sets of related requests larger. */
+  if(!priv->lcp_changed)
+    return;
 
-      inf_adopted_state_vector_free(lcp);
-      lcp = temp;
-    }
-  }
+  priv->lcp_changed = FALSE;
+  lcp = priv->lcp;
 
   for(user = priv->users_begin; user != priv->users_end; ++ user)
   {
-    id = inf_user_get_id(INF_USER(*user));
-    log = inf_adopted_user_get_request_log(*user);
+    id = user->id;
+    log = user->log;
     n = inf_adopted_request_log_get_begin(log);
 
     /* Remove all sets of related requests whose upper related request has
@@ -2166,13 +2675,11 @@ inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
         break;
 
       /* Check next set of related requests */
-      n = inf_adopted_state_vector_get(req_vec, id) + 1;
+      n = inf_adopted_request_get_index(req) + 1;
     }
 
     inf_adopted_request_log_remove_requests(log, n);
   }
-
-  inf_adopted_state_vector_free(lcp);
 }
 
 /**
@@ -2257,4 +2764,44 @@ inf_adopted_algorithm_can_redo(InfAdoptedAlgorithm* algorithm,
   }
 }
 
+/* Starts a batch of requests, in the same way as
+ * inf_adopted_algorithm_execute_requests() does. Until
+ * _inf_adopted_algorithm_end_batch() is called, requests executed with
+ * inf_adopted_algorithm_execute_request() only update the state of local
+ * users once at the end of the batch. This allows the caller to run code,
+ * such as checking the next request, in between executing the requests of
+ * the batch. */
+void
+_inf_adopted_algorithm_begin_batch(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  g_assert(priv->execute_request == NULL);
+  g_assert(priv->batch == FALSE);
+
+  priv->batch = TRUE;
+  priv->batch_unmodified = FALSE;
+}
+
+/* Ends a batch started with _inf_adopted_algorithm_begin_batch(). If any
+ * request has been executed within the batch, as indicated by executed, then
+ * the skipped state updates are made, and the request logs are cleaned up. */
+void
+_inf_adopted_algorithm_end_batch(InfAdoptedAlgorithm* algorithm,
+                                 gboolean executed)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  g_assert(priv->batch == TRUE);
+  priv->batch = FALSE;
+
+  if(executed)
+  {
+    inf_adopted_algorithm_end_batch(algorithm);
+    inf_adopted_algorithm_cleanup(algorithm);
+  }
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -143,6 +143,13 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
                                       gboolean apply,
                                       GError** error);
 
+guint
+inf_adopted_algorithm_execute_requests(InfAdoptedAlgorithm* algorithm,
+                                       InfAdoptedRequest** requests,
+                                       guint n_requests,
+                                       gboolean apply,
+                                       GError** error);
+
 void
 inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm);
 
@@ -37,15 +37,21 @@
  */
 
 #include <libinfinity/adopted/inf-adopted-request-log.h>
+#include <libinfinity/adopted/inf-adopted-request-log-private.h>
 
 #include <string.h> /* For (g_)memmove */
 
-typedef struct _InfAdoptedRequestLogCleanupCacheData
-  InfAdoptedRequestLogCleanupCacheData;
-struct _InfAdoptedRequestLogCleanupCacheData {
-  guint user_id;
-  guint up_to;
-  GSList* requests_to_remove;
+typedef struct _InfAdoptedRequestLogCacheEntry InfAdoptedRequestLogCacheEntry;
+struct _InfAdoptedRequestLogCacheEntry {
+  InfAdoptedRequest* request;
+  guint hash;
+
+  /* Reference bit for CLOCK eviction */
+  gboolean referenced;
+
+  /* Cached translations of the same request */
+  InfAdoptedRequestLogCacheEntry* prev;
+  InfAdoptedRequestLogCacheEntry* next;
 };
 
 typedef struct _InfAdoptedRequestLogEntry InfAdoptedRequestLogEntry;
@@ -58,13 +64,34 @@ struct _InfAdoptedRequestLogEntry {
 
   InfAdoptedRequestLogEntry* lower_related;
   InfAdoptedRequestLogEntry* upper_related;
+
+  /* Cached translations of this request */
+  InfAdoptedRequestLogCacheEntry* cache;
 };
 
 typedef struct _InfAdoptedRequestLogPrivate InfAdoptedRequestLogPrivate;
 struct _InfAdoptedRequestLogPrivate {
   guint user_id;
   InfAdoptedRequestLogEntry* entries;
-  GTree* cache;
+
+  /* Open-addressing hash table of cached translations, keyed by the state
+   * vector of the translated request. Each cache entry is also linked into
+   * the list of the request it is a translation of, or into cache_end for
+   * translations of a request at the end of the log which has not yet been
+   * added. */
+  InfAdoptedRequestLogCacheEntry** cache;
+  gsize cache_alloc;
+  gsize cache_size;
+  gsize cache_hand;
+  InfAdoptedRequestLogCacheEntry* cache_end;
+
+  /* Shared with the other logs of an algorithm, so that it knows the total
+   * number of cached requests without asking every log. May be NULL. */
+  guint* cache_counter;
+
+  guint64 cache_hits;
+  guint64 cache_misses;
+  guint64 cache_evictions;
 
   InfAdoptedRequestLogEntry* next_undo;
   InfAdoptedRequestLogEntry* next_redo;
@@ -85,7 +112,11 @@ enum {
   PROP_END,
 
   PROP_NEXT_UNDO,
-  PROP_NEXT_REDO
+  PROP_NEXT_REDO,
+
+  PROP_CACHE_HITS,
+  PROP_CACHE_MISSES,
+  PROP_CACHE_EVICTIONS
 };
 
 enum {
@@ -98,6 +129,7 @@ enum {
 #define INF_ADOPTED_REQUEST_LOG_PRIVATE(obj)     ((InfAdoptedRequestLogPrivate*)(obj)->priv)
 
 static const guint INF_ADOPTED_REQUEST_LOG_INC = 0x80;
+static const gsize INF_ADOPTED_REQUEST_LOG_CACHE_MIN = 0x10;
 static guint request_log_signals[LAST_SIGNAL];
 
 G_DEFINE_TYPE_WITH_CODE(InfAdoptedRequestLog, inf_adopted_request_log, G_TYPE_OBJECT,
@@ -159,64 +191,152 @@ inf_adopted_request_log_verify_related(InfAdoptedRequestLog* log)
  * Transformation cache
  */
 
-static int
-inf_adopted_request_log_cache_key_cmp(gconstpointer a,
-                                      gconstpointer b,
-                                      gpointer user_data)
+static gsize
+inf_adopted_request_log_cache_find(InfAdoptedRequestLogPrivate* priv,
+                                   const InfAdoptedStateVector* vec,
+                                   guint hash)
 {
-  InfAdoptedRequestLog* log;
-  InfAdoptedRequestLogPrivate* priv;
-  const InfAdoptedStateVector* key_a;
-  const InfAdoptedStateVector* key_b;
-  guint n_a, n_b;
+  InfAdoptedRequestLogCacheEntry* entry;
+  gsize mask;
+  gsize i;
+
+  /* Returns the slot holding the entry for vec, or the empty slot at which
+   * such an entry would be inserted. */
+  mask = priv->cache_alloc - 1;
+  for(i = hash & mask; priv->cache[i] != NULL; i = (i + 1) & mask)
+  {
+    entry = priv->cache[i];
+    if(entry->hash == hash &&
+       inf_adopted_state_vector_compare(
+         inf_adopted_request_get_vector(entry->request),
+         vec
+       ) == 0)
+    {
+      break;
+    }
+  }
 
-  key_a = (const InfAdoptedStateVector*)a;
-  key_b = (const InfAdoptedStateVector*)b;
+  return i;
+}
 
-  log = (InfAdoptedRequestLog*)user_data;
-  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+static void
+inf_adopted_request_log_cache_resize(InfAdoptedRequestLogPrivate* priv,
+                                     gsize alloc)
+{
+  InfAdoptedRequestLogCacheEntry** old_cache;
+  gsize old_alloc;
+  gsize mask;
+  gsize i;
+  gsize j;
+
+  old_cache = priv->cache;
+  old_alloc = priv->cache_alloc;
+
+  priv->cache = g_malloc0(alloc * sizeof(InfAdoptedRequestLogCacheEntry*));
+  priv->cache_alloc = alloc;
+  mask = alloc - 1;
+
+  /* All entries are distinct, so we only need to find a free slot for each
+   * of them, without comparing any vectors. */
+  for(i = 0; i < old_alloc; ++i)
+  {
+    if(old_cache[i] != NULL)
+    {
+      for(j = old_cache[i]->hash & mask;
+          priv->cache[j] != NULL;
+          j = (j + 1) & mask);
 
-  /* Primary, order by component of user ID -- this makes cleanup very
-   * efficient. */
-  n_a = inf_adopted_state_vector_get(key_a, priv->user_id);
-  n_b = inf_adopted_state_vector_get(key_b, priv->user_id);
+      priv->cache[j] = old_cache[i];
+    }
+  }
 
-  if(n_a < n_b)
-    return -1;
-  if(n_a > n_b)
-    return 1;
+  g_free(old_cache);
+}
 
-  /* If user ID component is equal, go by other components. */
-  return inf_adopted_state_vector_compare(key_a, key_b);
+static void
+inf_adopted_request_log_cache_remove(InfAdoptedRequestLogPrivate* priv,
+                                     InfAdoptedRequestLogCacheEntry* entry)
+{
+  gsize mask;
+  gsize i;
+  gsize j;
+  gsize home;
+
+  mask = priv->cache_alloc - 1;
+  for(i = entry->hash & mask; priv->cache[i] != entry; i = (i + 1) & mask)
+    g_assert(priv->cache[i] != NULL);
+
+  /* Backward-shift deletion: move following entries of the probe sequence
+   * into the hole unless they would end up before their home slot, so that
+   * no tombstones are needed. */
+  for(j = (i + 1) & mask; priv->cache[j] != NULL; j = (j + 1) & mask)
+  {
+    home = priv->cache[j]->hash & mask;
+    if(((j - home) & mask) >= ((j - i) & mask))
+    {
+      priv->cache[i] = priv->cache[j];
+      i = j;
+    }
+  }
+
+  priv->cache[i] = NULL;
+  --priv->cache_size;
+  if(priv->cache_counter != NULL)
+    --*priv->cache_counter;
 }
 
-static gboolean
-inf_adopted_request_log_remove_requests_cache_foreach_func(gpointer key,
-                                                           gpointer value,
-                                                           gpointer user_data)
+static guint
+inf_adopted_request_log_cache_free_list(InfAdoptedRequestLogPrivate* priv,
+                                        InfAdoptedRequestLogCacheEntry* list)
 {
-  InfAdoptedStateVector* vector;
-  InfAdoptedRequestLogCleanupCacheData* data;
+  InfAdoptedRequestLogCacheEntry* next;
+  guint n_removed;
+
+  n_removed = 0;
+  while(list != NULL)
+  {
+    next = list->next;
 
-  vector = (InfAdoptedStateVector*)key;
-  data = (InfAdoptedRequestLogCleanupCacheData*)user_data;
+    inf_adopted_request_log_cache_remove(priv, list);
+    g_object_unref(list->request);
+    g_slice_free(InfAdoptedRequestLogCacheEntry, list);
 
-  /* Remove all requests which are a cached translation of one of the requests
-   * that have been removed, i.e. have a user component smaller than up_to. */
-  if(inf_adopted_state_vector_get(vector, data->user_id) < data->up_to)
+    ++n_removed;
+    list = next;
+  }
+
+  return n_removed;
+}
+
+static void
+inf_adopted_request_log_cache_unlink(InfAdoptedRequestLogPrivate* priv,
+                                     InfAdoptedRequestLogCacheEntry* entry)
+{
+  guint n;
+
+  if(entry->prev != NULL)
   {
-    data->requests_to_remove =
-      g_slist_prepend(data->requests_to_remove, vector);
-    return FALSE;
+    entry->prev->next = entry->next;
   }
   else
   {
-    /* Stop traversal. The tree is traversed in sorted order, and the primary
-     * sort criteria of the tree is the vector component of the user. So if
-     * we have reached this point, all other elements in the tree will have
-     * a higher user component and are not scheduled for removal. */
-    return TRUE;
+    n = inf_adopted_request_get_index(entry->request);
+
+    if(n == priv->end)
+    {
+      g_assert(priv->cache_end == entry);
+      priv->cache_end = entry->next;
+    }
+    else
+    {
+      g_assert(n >= priv->begin && n < priv->end);
+      g_assert(priv->entries[priv->offset + n - priv->begin].cache == entry);
+      priv->entries[priv->offset + n - priv->begin].cache = entry->next;
+    }
   }
+
+  if(entry->next != NULL)
+    entry->next->prev = entry->prev;
 }
 
 /*
@@ -297,6 +417,14 @@ inf_adopted_request_log_init(InfAdoptedRequestLog* log)
   priv->alloc = INF_ADOPTED_REQUEST_LOG_INC;
   priv->entries = g_malloc(priv->alloc * sizeof(InfAdoptedRequestLogEntry));
   priv->cache = NULL;
+  priv->cache_alloc = 0;
+  priv->cache_size = 0;
+  priv->cache_hand = 0;
+  priv->cache_end = NULL;
+  priv->cache_counter = NULL;
+  priv->cache_hits = 0;
+  priv->cache_misses = 0;
+  priv->cache_evictions = 0;
   priv->begin = 0;
   priv->end = 0;
   priv->offset = 0;
@@ -315,14 +443,19 @@ inf_adopted_request_log_dispose(GObject* object)
   log = INF_ADOPTED_REQUEST_LOG(object);
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
 
-  if(priv->cache != NULL)
+  for(i = priv->offset; i < priv->offset + (priv->end - priv->begin); ++ i)
   {
-    g_tree_destroy(priv->cache);
-    priv->cache = NULL;
+    inf_adopted_request_log_cache_free_list(priv, priv->entries[i].cache);
+    g_object_unref(G_OBJECT(priv->entries[i].request));
   }
 
-  for(i = priv->offset; i < priv->offset + (priv->end - priv->begin); ++ i)
-    g_object_unref(G_OBJECT(priv->entries[i].request));
+  inf_adopted_request_log_cache_free_list(priv, priv->cache_end);
+  priv->cache_end = NULL;
+
+  g_assert(priv->cache_size == 0);
+  g_free(priv->cache);
+  priv->cache = NULL;
+  priv->cache_alloc = 0;
 
   priv->begin = 0;
   priv->end = 0;
@@ -372,6 +505,9 @@ inf_adopted_request_log_set_property(GObject* object,
   case PROP_END:
   case PROP_NEXT_UNDO:
   case PROP_NEXT_REDO:
+  case PROP_CACHE_HITS:
+  case PROP_CACHE_MISSES:
+  case PROP_CACHE_EVICTIONS:
     /* These are read only; fallthrough */
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -415,6 +551,15 @@ inf_adopted_request_log_get_property(GObject* object,
     else
       g_value_set_object(value, NULL);
 
+    break;
+  case PROP_CACHE_HITS:
+    g_value_set_uint64(value, priv->cache_hits);
+    break;
+  case PROP_CACHE_MISSES:
+    g_value_set_uint64(value, priv->cache_misses);
+    break;
+  case PROP_CACHE_EVICTIONS:
+    g_value_set_uint64(value, priv->cache_evictions);
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -438,10 +583,7 @@ inf_adopted_request_log_add_request_handler(InfAdoptedRequestLog* log,
 
   g_assert(
     priv->begin == priv->end ||
-    inf_adopted_state_vector_get(
-      inf_adopted_request_get_vector(request),
-      priv->user_id
-    ) == priv->end
+    inf_adopted_request_get_index(request) == priv->end
   );
 
   if(priv->offset + (priv->end - priv->begin) == priv->alloc)
@@ -523,11 +665,18 @@ inf_adopted_request_log_add_request_handler(InfAdoptedRequestLog* log,
 
   if(priv->begin == priv->end)
   {
-    priv->begin = inf_adopted_state_vector_get(
-      inf_adopted_request_get_vector(request),
-      priv->user_id
-    );
+    i = inf_adopted_request_get_index(request);
 
+    /* Cached translations at the previous end of the log do not belong to
+     * this request if the log is moved to a different position. */
+    if(i != priv->begin)
+    {
+      priv->cache_evictions +=
+        inf_adopted_request_log_cache_free_list(priv, priv->cache_end);
+      priv->cache_end = NULL;
+    }
+
+    priv->begin = i;
     priv->end = priv->begin;
   }
 
@@ -539,6 +688,9 @@ inf_adopted_request_log_add_request_handler(InfAdoptedRequestLog* log,
   entry->request = request;
   g_object_ref(G_OBJECT(request));
 
+  entry->cache = priv->cache_end;
+  priv->cache_end = NULL;
+
   switch(inf_adopted_request_get_request_type(request))
   {
   case INF_ADOPTED_REQUEST_DO:
@@ -706,6 +858,70 @@ inf_adopted_request_log_class_init(
     )
   );
 
+  /**
+   * InfAdoptedRequestLog:cache-hits:
+   *
+   * The number of lookups in the translation cache which found a cached
+   * request, see inf_adopted_request_log_lookup_cached_request(). No
+   * notification is emitted when this property changes.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_CACHE_HITS,
+    g_param_spec_uint64(
+      "cache-hits",
+      "Cache hits",
+      "Number of successful lookups in the translation cache",
+      0,
+      G_MAXUINT64,
+      0,
+      G_PARAM_READABLE
+    )
+  );
+
+  /**
+   * InfAdoptedRequestLog:cache-misses:
+   *
+   * The number of lookups in the translation cache which did not find a
+   * cached request. No notification is emitted when this property changes.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_CACHE_MISSES,
+    g_param_spec_uint64(
+      "cache-misses",
+      "Cache misses",
+      "Number of unsuccessful lookups in the translation cache",
+      0,
+      G_MAXUINT64,
+      0,
+      G_PARAM_READABLE
+    )
+  );
+
+  /**
+   * InfAdoptedRequestLog:cache-evictions:
+   *
+   * The number of requests that have been removed from the translation
+   * cache, either because the request they are a translation of has been
+   * removed from the log, or by
+   * inf_adopted_request_log_evict_cached_requests(). No notification is
+   * emitted when this property changes.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_CACHE_EVICTIONS,
+    g_param_spec_uint64(
+      "cache-evictions",
+      "Cache evictions",
+      "Number of requests removed from the translation cache",
+      0,
+      G_MAXUINT64,
+      0,
+      G_PARAM_READABLE
+    )
+  );
+
   /**
    * InfAdoptedRequestLog::add-request:
    * @log: The #InfAdoptedRequestLog to which a new request is added.
@@ -861,6 +1077,10 @@ inf_adopted_request_log_set_begin(InfAdoptedRequestLog* log,
 
   if(priv->begin != n)
   {
+    priv->cache_evictions +=
+      inf_adopted_request_log_cache_free_list(priv, priv->cache_end);
+    priv->cache_end = NULL;
+
     priv->begin = n;
     priv->end = n;
 
@@ -919,10 +1139,7 @@ inf_adopted_request_log_add_request(InfAdoptedRequestLog* log,
 
   g_return_if_fail(
     priv->begin == priv->end ||
-    inf_adopted_state_vector_get(
-      inf_adopted_request_get_vector(request),
-      priv->user_id
-    ) == priv->end
+    inf_adopted_request_get_index(request) == priv->end
   );
 
   g_signal_emit(G_OBJECT(log), request_log_signals[ADD_REQUEST], 0, request);
@@ -943,9 +1160,7 @@ inf_adopted_request_log_remove_requests(InfAdoptedRequestLog* log,
                                         guint up_to)
 {
   InfAdoptedRequestLogPrivate* priv;
-  InfAdoptedRequestLogCleanupCacheData data;
   guint i;
-  GSList* item;
 
   g_return_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log));
 
@@ -959,8 +1174,17 @@ inf_adopted_request_log_remove_requests(InfAdoptedRequestLog* log,
     &priv->entries[priv->offset + up_to - priv->begin - 1]
   );
 
+  /* Cached translations are linked to the request they are a translation
+   * of, so we only need to visit the ones which are actually removed. */
   for(i = priv->offset; i < priv->offset + (up_to - priv->begin); ++i)
+  {
+    priv->cache_evictions += inf_adopted_request_log_cache_free_list(
+      priv,
+      priv->entries[i].cache
+    );
+
     g_object_unref(G_OBJECT(priv->entries[i].request));
+  }
 
   g_object_freeze_notify(G_OBJECT(log));
 
@@ -989,23 +1213,6 @@ inf_adopted_request_log_remove_requests(InfAdoptedRequestLog* log,
   priv->begin = up_to;
   g_object_notify(G_OBJECT(log), "begin");
 
-  if(priv->cache != NULL)
-  {
-    data.user_id = priv->user_id;
-    data.up_to = up_to;
-    data.requests_to_remove = NULL;
-
-    g_tree_foreach(
-      priv->cache,
-      inf_adopted_request_log_remove_requests_cache_foreach_func,
-      &data
-    );
-    
-    for(item = data.requests_to_remove; item != NULL; item = item->next)
-      g_tree_remove(priv->cache, (InfAdoptedStateVector*)item->data);
-    g_slist_free(data.requests_to_remove);
-  }
-
   inf_adopted_request_log_verify_related(log);
   g_object_thaw_notify(G_OBJECT(log));
 }
@@ -1028,7 +1235,6 @@ inf_adopted_request_log_next_associated(InfAdoptedRequestLog* log,
                                         InfAdoptedRequest* request)
 {
   InfAdoptedRequestLogPrivate* priv;
-  InfAdoptedStateVector* vector;
   guint user_id;
   guint n;
   InfAdoptedRequestLogEntry* entry;
@@ -1037,9 +1243,8 @@ inf_adopted_request_log_next_associated(InfAdoptedRequestLog* log,
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), NULL);
 
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
-  vector = inf_adopted_request_get_vector(request);
   user_id = inf_adopted_request_get_user_id(request);
-  n = inf_adopted_state_vector_get(vector, user_id);
+  n = inf_adopted_request_get_index(request);
 
   g_return_val_if_fail(priv->user_id == user_id, NULL);
   g_return_val_if_fail(n >= priv->begin && n < priv->end, NULL);
@@ -1071,7 +1276,6 @@ inf_adopted_request_log_prev_associated(InfAdoptedRequestLog* log,
                                         InfAdoptedRequest* request)
 {
   InfAdoptedRequestLogPrivate* priv;
-  InfAdoptedStateVector* vector;
   guint user_id;
   guint n;
   InfAdoptedRequestLogEntry* entry;
@@ -1080,9 +1284,8 @@ inf_adopted_request_log_prev_associated(InfAdoptedRequestLog* log,
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), NULL);
 
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
-  vector = inf_adopted_request_get_vector(request);
   user_id = inf_adopted_request_get_user_id(request);
-  n = inf_adopted_state_vector_get(vector, user_id);
+  n = inf_adopted_request_get_index(request);
 
   g_return_val_if_fail(priv->user_id == user_id, NULL);
   g_return_val_if_fail(n >= priv->begin && n <= priv->end, NULL);
@@ -1140,7 +1343,6 @@ inf_adopted_request_log_original_request(InfAdoptedRequestLog* log,
                                          InfAdoptedRequest* request)
 {
   InfAdoptedRequestLogPrivate* priv;
-  InfAdoptedStateVector* vector;
   guint user_id;
   guint n;
   InfAdoptedRequestLogEntry* entry;
@@ -1149,9 +1351,8 @@ inf_adopted_request_log_original_request(InfAdoptedRequestLog* log,
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), NULL);
 
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
-  vector = inf_adopted_request_get_vector(request);
   user_id = inf_adopted_request_get_user_id(request);
-  n = inf_adopted_state_vector_get(vector, user_id);
+  n = inf_adopted_request_get_index(request);
 
   g_return_val_if_fail(priv->user_id == user_id, NULL);
   g_return_val_if_fail(n >= priv->begin && n <= priv->end, NULL);
@@ -1322,15 +1523,19 @@ inf_adopted_request_log_lower_related(InfAdoptedRequestLog* log,
  * requests are removed from the log the cache is automatically updated
  * accordingly.
  *
- * The data structure of the cache is optimized for quick lookup of entries
- * by the state vector and cleaning up entries in an efficient manner also
- * when the cache has grown very big.
+ * The cache is a hash table keyed by the state vector of the cached request.
+ * Each cached request is additionally linked to the request in the log it is
+ * a translation of, so that removing requests from the log only needs to
+ * visit the cached translations of the removed requests.
  *
  * The request cache is mainly used by #InfAdoptedAlgorithm to efficiently
  * handle big transformations.
  *
  * This function adds a request to the cache of the request log.
- * @request must be a translated version of a request existing in @log.
+ * @request must be a translated version of a request existing in @log, or
+ * of a request whose vector time component of its own user is equivalent to
+ * inf_adopted_request_log_get_end(). No request with the same state vector
+ * may be cached yet.
  */
 void
 inf_adopted_request_log_add_cached_request(InfAdoptedRequestLog* log,
@@ -1338,6 +1543,11 @@ inf_adopted_request_log_add_cached_request(InfAdoptedRequestLog* log,
 {
   InfAdoptedRequestLogPrivate* priv;
   InfAdoptedStateVector* vector;
+  InfAdoptedRequestLogCacheEntry* entry;
+  InfAdoptedRequestLogCacheEntry** list;
+  guint hash;
+  guint n;
+  gsize i;
 
   g_return_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log));
   g_return_if_fail(INF_ADOPTED_IS_REQUEST(request));
@@ -1346,25 +1556,47 @@ inf_adopted_request_log_add_cached_request(InfAdoptedRequestLog* log,
   g_return_if_fail(inf_adopted_request_get_user_id(request) == priv->user_id);
 
   vector = inf_adopted_request_get_vector(request);
+  n = inf_adopted_request_get_index(request);
+  g_return_if_fail(n >= priv->begin && n <= priv->end);
 
   if(priv->cache == NULL)
   {
-    priv->cache = g_tree_new_full(
-      inf_adopted_request_log_cache_key_cmp,
-      log,
-      NULL,
-      g_object_unref
+    priv->cache_alloc = INF_ADOPTED_REQUEST_LOG_CACHE_MIN;
+    priv->cache = g_malloc0(
+      priv->cache_alloc * sizeof(InfAdoptedRequestLogCacheEntry*)
     );
   }
 
-  g_return_if_fail(g_tree_lookup(priv->cache, vector) == NULL);
+  hash = inf_adopted_state_vector_hash(vector);
+  i = inf_adopted_request_log_cache_find(priv, vector, hash);
+  g_return_if_fail(priv->cache[i] == NULL);
+
+  /* Keep the load factor at or below 1/2 */
+  if(2 * (priv->cache_size + 1) > priv->cache_alloc)
+  {
+    inf_adopted_request_log_cache_resize(priv, 2 * priv->cache_alloc);
+    i = inf_adopted_request_log_cache_find(priv, vector, hash);
+  }
+
+  if(n == priv->end)
+    list = &priv->cache_end;
+  else
+    list = &priv->entries[priv->offset + n - priv->begin].cache;
 
-  g_tree_insert(priv->cache, vector, request);
+  entry = g_slice_new(InfAdoptedRequestLogCacheEntry);
+  entry->request = request;
+  entry->hash = hash;
+  entry->referenced = TRUE;
+  entry->prev = NULL;
+  entry->next = *list;
+  if(*list != NULL) (*list)->prev = entry;
+  *list = entry;
   g_object_ref(request);
 
-  /* Implement lookup_cached_request */
-  /* Use this implementation in InfAdoptedAlgorithm */
-  /* Make the performance tests */
+  priv->cache[i] = entry;
+  ++priv->cache_size;
+  if(priv->cache_counter != NULL)
+    ++*priv->cache_counter;
 }
 
 /**
@@ -1386,14 +1618,128 @@ inf_adopted_request_log_lookup_cached_request(InfAdoptedRequestLog* log,
                                               InfAdoptedStateVector* vec)
 {
   InfAdoptedRequestLogPrivate* priv;
+  gsize i;
 
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log), NULL);
   g_return_val_if_fail(vec != NULL, NULL);
 
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
-  if(priv->cache == NULL) return NULL;
+  if(priv->cache_size == 0)
+  {
+    ++priv->cache_misses;
+    return NULL;
+  }
+
+  i = inf_adopted_request_log_cache_find(
+    priv,
+    vec,
+    inf_adopted_state_vector_hash(vec)
+  );
+
+  if(priv->cache[i] == NULL)
+  {
+    ++priv->cache_misses;
+    return NULL;
+  }
+
+  ++priv->cache_hits;
+  priv->cache[i]->referenced = TRUE;
+  return priv->cache[i]->request;
+}
+
+/**
+ * inf_adopted_request_log_get_n_cached_requests:
+ * @log: A #InfAdoptedRequestLog.
+ *
+ * Returns the number of requests in the cache of the request log. See
+ * inf_adopted_request_log_add_cached_request() for an explanation of the
+ * request cache.
+ *
+ * Returns: The number of cached requests in @log.
+ */
+guint
+inf_adopted_request_log_get_n_cached_requests(InfAdoptedRequestLog* log)
+{
+  g_return_val_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log), 0);
+  return INF_ADOPTED_REQUEST_LOG_PRIVATE(log)->cache_size;
+}
+
+/**
+ * inf_adopted_request_log_evict_cached_requests:
+ * @log: A #InfAdoptedRequestLog.
+ * @n: The number of requests to evict.
+ *
+ * Removes up to @n requests from the cache of the request log. Requests
+ * which have not been looked up recently are removed first, using the CLOCK
+ * approximation of a least-recently-used policy. Evicted requests can
+ * always be recomputed by translating the original request again, so this
+ * can be used to bound the memory used by the cache.
+ *
+ * Returns: The number of requests that have been evicted. This is less
+ * than @n only if the cache is empty afterwards.
+ */
+guint
+inf_adopted_request_log_evict_cached_requests(InfAdoptedRequestLog* log,
+                                              guint n)
+{
+  InfAdoptedRequestLogPrivate* priv;
+  InfAdoptedRequestLogCacheEntry* entry;
+  guint n_evicted;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log), 0);
+  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+
+  n_evicted = 0;
+  while(n_evicted < n && priv->cache_size > 0)
+  {
+    entry = priv->cache[priv->cache_hand];
+
+    if(entry == NULL)
+    {
+      priv->cache_hand = (priv->cache_hand + 1) & (priv->cache_alloc - 1);
+    }
+    else if(entry->referenced)
+    {
+      /* Give the entry a second chance */
+      entry->referenced = FALSE;
+      priv->cache_hand = (priv->cache_hand + 1) & (priv->cache_alloc - 1);
+    }
+    else
+    {
+      /* Do not advance the hand, since removal from the hash table can move
+       * another entry into the slot of the removed one. */
+      inf_adopted_request_log_cache_unlink(priv, entry);
+      inf_adopted_request_log_cache_remove(priv, entry);
+      g_object_unref(entry->request);
+      g_slice_free(InfAdoptedRequestLogCacheEntry, entry);
+
+      ++n_evicted;
+    }
+  }
+
+  priv->cache_evictions += n_evicted;
+  return n_evicted;
+}
+
+/* Makes the request log keep the guint pointed to by counter up to date with
+ * the number of requests it caches, so that several logs can share a
+ * counter for their total cache size. The current cache size is moved from
+ * the previous counter to the new one. counter can be NULL to detach the
+ * log from its counter. */
+void
+_inf_adopted_request_log_set_cache_counter(InfAdoptedRequestLog* log,
+                                           guint* counter)
+{
+  InfAdoptedRequestLogPrivate* priv;
+  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+
+  if(priv->cache_counter != NULL)
+    *priv->cache_counter -= priv->cache_size;
+
+  priv->cache_counter = counter;
 
-  return INF_ADOPTED_REQUEST(g_tree_lookup(priv->cache, vec));
+  if(priv->cache_counter != NULL)
+    *priv->cache_counter += priv->cache_size;
 }
 
 /* vim:set et sw=2 ts=2: */
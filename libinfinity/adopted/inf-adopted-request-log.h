@@ -133,6 +133,13 @@ InfAdoptedRequest*
 inf_adopted_request_log_lookup_cached_request(InfAdoptedRequestLog* log,
                                               InfAdoptedStateVector* vec);
 
+guint
+inf_adopted_request_log_get_n_cached_requests(InfAdoptedRequestLog* log);
+
+guint
+inf_adopted_request_log_evict_cached_requests(InfAdoptedRequestLog* log,
+                                              guint n);
+
 G_END_DECLS
 
 #endif /* __INF_ADOPTED_REQUEST_LOG_H__ */
@@ -63,15 +63,21 @@ struct _InfAdoptedRequestPrivate {
   InfAdoptedRequestType type;
   InfAdoptedStateVector* vector;
   guint user_id;
+  /* vector[user_id], cached since it is needed very often */
+  guint index;
   InfAdoptedOperation* operation;
   gint64 received;
   gint64 executed;
+  /* Whether construction is complete. The properties that are only set
+   * once are rejected afterwards, since requests must not change once they
+   * have been logged or cached. */
+  gboolean constructed;
 };
 
 enum {
   PROP_0,
 
-  /* construct only */
+  /* set once, usually by the constructor functions */
   PROP_TYPE,
   PROP_VECTOR,
   PROP_USER_ID,
@@ -99,10 +105,23 @@ inf_adopted_request_init(InfAdoptedRequest* request)
   priv->type = INF_ADOPTED_REQUEST_DO;
   priv->vector = NULL;
   priv->user_id = 0;
+  priv->index = 0;
   priv->operation = NULL;
 
   priv->received = 0;
   priv->executed = 0;
+  priv->constructed = FALSE;
+}
+
+static void
+inf_adopted_request_constructed(GObject* object)
+{
+  InfAdoptedRequestPrivate* priv;
+  priv = INF_ADOPTED_REQUEST_PRIVATE(INF_ADOPTED_REQUEST(object));
+
+  G_OBJECT_CLASS(inf_adopted_request_parent_class)->constructed(object);
+
+  priv->constructed = TRUE;
 }
 
 static void
@@ -150,26 +169,41 @@ inf_adopted_request_set_property(GObject* object,
   request = INF_ADOPTED_REQUEST(object);
   priv = INF_ADOPTED_REQUEST_PRIVATE(request);
 
+  if(priv->constructed && prop_id != PROP_EXECUTED)
+  {
+    g_warning(
+      "Property \"%s\" of %s can only be set at construction time",
+      pspec->name,
+      G_OBJECT_TYPE_NAME(object)
+    );
+
+    return;
+  }
+
   switch(prop_id)
   {
   case PROP_TYPE:
     priv->type = g_value_get_enum(value);
     break;
   case PROP_VECTOR:
-    g_assert(priv->vector == NULL); /* construct only */
+    g_assert(priv->vector == NULL); /* only set once */
     priv->vector = g_value_dup_boxed(value);
+    if(priv->user_id != 0)
+      priv->index = inf_adopted_state_vector_get(priv->vector, priv->user_id);
     break;
   case PROP_USER_ID:
-    g_assert(priv->user_id == 0); /* construct only */
+    g_assert(priv->user_id == 0); /* only set once */
     g_assert(g_value_get_uint(value) != 0); /* 0 is invalid ID */
     priv->user_id = g_value_get_uint(value);
+    if(priv->vector != NULL)
+      priv->index = inf_adopted_state_vector_get(priv->vector, priv->user_id);
     break;
   case PROP_OPERATION:
-    g_assert(priv->operation == NULL); /* construct only */
+    g_assert(priv->operation == NULL); /* only set once */
     priv->operation = INF_ADOPTED_OPERATION(g_value_dup_object(value));
     break;
   case PROP_RECEIVED:
-    g_assert(priv->received == 0); /* construct only */
+    g_assert(priv->received == 0); /* only set once */
     priv->received = g_value_get_int64(value);
     break;
   case PROP_EXECUTED:
@@ -225,6 +259,7 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
   GObjectClass* object_class;
   object_class = G_OBJECT_CLASS(request_class);
 
+  object_class->constructed = inf_adopted_request_constructed;
   object_class->dispose = inf_adopted_request_dispose;
   object_class->finalize = inf_adopted_request_finalize;
   object_class->set_property = inf_adopted_request_set_property;
@@ -239,7 +274,7 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
       "The type of the operation",
       INF_ADOPTED_TYPE_REQUEST_TYPE,
       INF_ADOPTED_REQUEST_DO,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -251,7 +286,7 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
       "Vector",
       "The vector time at which the request was made",
       INF_ADOPTED_TYPE_STATE_VECTOR,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -265,7 +300,7 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
       0,
       G_MAXUINT,
       0,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -277,7 +312,7 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
       "Operation",
       "The operation of the request",
       INF_ADOPTED_TYPE_OPERATION,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -291,7 +326,7 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
       G_MININT64,
       G_MAXINT64,
       0,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -310,6 +345,44 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
   );
 }
 
+/* Creates a new request without going through GObject property dispatch.
+ * Requests are created very often during transformation, so we set the
+ * members directly. None of the properties is a construct property, so
+ * g_object_new() does not dispatch their default values either. Ownership
+ * of vector is transferred to the new request, which avoids yet another
+ * copy of it. index must be vector[user_id]; the callers usually know it
+ * without looking it up in the vector. */
+static InfAdoptedRequest*
+inf_adopted_request_new_internal(InfAdoptedRequestType type,
+                                 InfAdoptedStateVector* vector,
+                                 guint user_id,
+                                 guint index,
+                                 InfAdoptedOperation* operation,
+                                 gint64 received,
+                                 gint64 executed)
+{
+  InfAdoptedRequest* request;
+  InfAdoptedRequestPrivate* priv;
+
+  request = INF_ADOPTED_REQUEST(g_object_new(INF_ADOPTED_TYPE_REQUEST, NULL));
+  priv = INF_ADOPTED_REQUEST_PRIVATE(request);
+
+  priv->type = type;
+  priv->vector = vector;
+  priv->user_id = user_id;
+  priv->index = index;
+  priv->received = received;
+  priv->executed = executed;
+
+  if(operation != NULL)
+  {
+    priv->operation = operation;
+    g_object_ref(operation);
+  }
+
+  return request;
+}
+
 /**
  * inf_adopted_request_new_do: (constructor)
  * @vector: The vector time at which the request was made.
@@ -327,23 +400,19 @@ inf_adopted_request_new_do(InfAdoptedStateVector* vector,
                            InfAdoptedOperation* operation,
                            gint64 received)
 {
-  GObject* object;
-
   g_return_val_if_fail(vector != NULL, NULL);
   g_return_val_if_fail(user_id != 0, NULL);
   g_return_val_if_fail(INF_ADOPTED_IS_OPERATION(operation), NULL);
 
-  object = g_object_new(
-    INF_ADOPTED_TYPE_REQUEST,
-    "type", INF_ADOPTED_REQUEST_DO,
-    "vector", vector,
-    "user-id", user_id,
-    "operation", operation,
-    "received", received,
-    NULL
+  return inf_adopted_request_new_internal(
+    INF_ADOPTED_REQUEST_DO,
+    inf_adopted_state_vector_copy(vector),
+    user_id,
+    inf_adopted_state_vector_get(vector, user_id),
+    operation,
+    received,
+    0
   );
-
-  return INF_ADOPTED_REQUEST(object);
 }
 
 /**
@@ -364,21 +433,18 @@ inf_adopted_request_new_undo(InfAdoptedStateVector* vector,
                              guint user_id,
                              gint64 received)
 {
-  GObject* object;
-
   g_return_val_if_fail(vector != NULL, NULL);
   g_return_val_if_fail(user_id != 0, NULL);
 
-  object = g_object_new(
-    INF_ADOPTED_TYPE_REQUEST,
-    "type", INF_ADOPTED_REQUEST_UNDO,
-    "vector", vector,
-    "user-id", user_id,
-    "received", received,
-    NULL
+  return inf_adopted_request_new_internal(
+    INF_ADOPTED_REQUEST_UNDO,
+    inf_adopted_state_vector_copy(vector),
+    user_id,
+    inf_adopted_state_vector_get(vector, user_id),
+    NULL,
+    received,
+    0
   );
-  
-  return INF_ADOPTED_REQUEST(object);
 }
 
 /**
@@ -399,21 +465,18 @@ inf_adopted_request_new_redo(InfAdoptedStateVector* vector,
                              guint user_id,
                              gint64 received)
 {
-  GObject* object;
-  
   g_return_val_if_fail(vector != NULL, NULL);
   g_return_val_if_fail(user_id != 0, NULL);
   
-  object = g_object_new(
-    INF_ADOPTED_TYPE_REQUEST,
-    "type", INF_ADOPTED_REQUEST_REDO,
-    "vector", vector,
-    "user-id", user_id,
-    "received", received,
-    NULL
+  return inf_adopted_request_new_internal(
+    INF_ADOPTED_REQUEST_REDO,
+    inf_adopted_state_vector_copy(vector),
+    user_id,
+    inf_adopted_state_vector_get(vector, user_id),
+    NULL,
+    received,
+    0
   );
-  
-  return INF_ADOPTED_REQUEST(object);
 }
 
 /**
@@ -428,39 +491,19 @@ InfAdoptedRequest*
 inf_adopted_request_copy(InfAdoptedRequest* request)
 {
   InfAdoptedRequestPrivate* priv;
-  InfAdoptedRequestPrivate* new_priv;
-  GObject* object;
-  
+
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), NULL);
   priv = INF_ADOPTED_REQUEST_PRIVATE(request);
 
-  if(priv->type == INF_ADOPTED_REQUEST_DO)
-  {
-    object = g_object_new(
-      INF_ADOPTED_TYPE_REQUEST,
-      "type", priv->type,
-      "vector", priv->vector,
-      "user-id", priv->user_id,
-      "operation", priv->operation,
-      "received", priv->received,
-      NULL
-    );
-  }
-  else
-  {
-    object = g_object_new(
-      INF_ADOPTED_TYPE_REQUEST,
-      "type", priv->type,
-      "vector", priv->vector,
-      "user-id", priv->user_id,
-      "received", priv->received,
-      NULL
-    );
-  }
-
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(INF_ADOPTED_REQUEST(object));
-  new_priv->executed = priv->executed;
-  return INF_ADOPTED_REQUEST(object);
+  return inf_adopted_request_new_internal(
+    priv->type,
+    inf_adopted_state_vector_copy(priv->vector),
+    priv->user_id,
+    priv->index,
+    priv->operation,
+    priv->received,
+    priv->executed
+  );
 }
 
 /**
@@ -548,12 +591,8 @@ inf_adopted_request_get_operation(InfAdoptedRequest* request)
 guint
 inf_adopted_request_get_index(InfAdoptedRequest* request)
 {
-  InfAdoptedRequestPrivate* priv;
-
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), 0);
-
-  priv = INF_ADOPTED_REQUEST_PRIVATE(request);
-  return inf_adopted_state_vector_get(priv->vector, priv->user_id);
+  return INF_ADOPTED_REQUEST_PRIVATE(request)->index;
 }
 
 /**
@@ -700,7 +739,6 @@ inf_adopted_request_transform(InfAdoptedRequest* request,
   InfAdoptedRequestPrivate* against_priv;
   InfAdoptedRequestPrivate* request_lcs_priv;
   InfAdoptedRequestPrivate* against_lcs_priv;
-  InfAdoptedRequestPrivate* new_priv;
   InfAdoptedOperation* new_operation;
   InfAdoptedStateVector* new_vector;
   InfAdoptedRequest* new_request;
@@ -794,18 +832,17 @@ inf_adopted_request_transform(InfAdoptedRequest* request,
   new_vector = inf_adopted_state_vector_copy(request_priv->vector);
   inf_adopted_state_vector_add(new_vector, against_priv->user_id, 1);
 
-  new_request = inf_adopted_request_new_do(
+  new_request = inf_adopted_request_new_internal(
+    INF_ADOPTED_REQUEST_DO,
     new_vector,
     request_priv->user_id,
+    request_priv->index,
     new_operation,
-    request_priv->received
+    request_priv->received,
+    request_priv->executed
   );
 
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(new_request);
-  new_priv->executed = request_priv->executed;
-
   g_object_unref(new_operation);
-  inf_adopted_state_vector_free(new_vector);
   return new_request;
 }
 
@@ -832,7 +869,6 @@ inf_adopted_request_mirror(InfAdoptedRequest* request,
                            guint by)
 {
   InfAdoptedRequestPrivate* priv;
-  InfAdoptedRequestPrivate* new_priv;
   InfAdoptedOperation* new_operation;
   InfAdoptedStateVector* new_vector;
   InfAdoptedRequest* new_request;
@@ -851,18 +887,17 @@ inf_adopted_request_mirror(InfAdoptedRequest* request,
   new_vector = inf_adopted_state_vector_copy(priv->vector);
   inf_adopted_state_vector_add(new_vector, priv->user_id, by);
 
-  new_request = inf_adopted_request_new_do(
+  new_request = inf_adopted_request_new_internal(
+    INF_ADOPTED_REQUEST_DO,
     new_vector,
     priv->user_id,
+    priv->index + by,
     new_operation,
-    priv->received
+    priv->received,
+    priv->executed
   );
 
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(new_request);
-  new_priv->executed = priv->executed;
-
   g_object_unref(new_operation);
-  inf_adopted_state_vector_free(new_vector);
   return new_request;
 }
 
@@ -889,9 +924,7 @@ inf_adopted_request_fold(InfAdoptedRequest* request,
                          guint by)
 {
   InfAdoptedRequestPrivate* priv;
-  InfAdoptedRequestPrivate* new_priv;
   InfAdoptedStateVector* new_vector;
-  InfAdoptedRequest* new_request;
 
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), NULL);
   g_return_val_if_fail(into != 0, NULL);
@@ -903,39 +936,15 @@ inf_adopted_request_fold(InfAdoptedRequest* request,
   new_vector = inf_adopted_state_vector_copy(priv->vector);
   inf_adopted_state_vector_add(new_vector, into, by);
 
-  if(priv->type == INF_ADOPTED_REQUEST_DO)
-  {
-    new_request = INF_ADOPTED_REQUEST(
-      g_object_new(
-        INF_ADOPTED_TYPE_REQUEST,
-        "type", priv->type,
-        "operation", priv->operation,
-        "vector", new_vector,
-        "user-id", priv->user_id,
-        "received", priv->received,
-        NULL
-      )
-    );
-  }
-  else
-  {
-    new_request = INF_ADOPTED_REQUEST(
-      g_object_new(
-        INF_ADOPTED_TYPE_REQUEST,
-        "type", priv->type,
-        "vector", new_vector,
-        "user-id", priv->user_id,
-        "received", priv->received,
-        NULL
-      )
-    );
-  }
-
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(new_request);
-  new_priv->executed = priv->executed;
-
-  inf_adopted_state_vector_free(new_vector);
-  return new_request;
+  return inf_adopted_request_new_internal(
+    priv->type,
+    new_vector,
+    priv->user_id,
+    priv->index,
+    priv->operation,
+    priv->received,
+    priv->executed
+  );
 }
 
 /**
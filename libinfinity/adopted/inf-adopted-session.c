@@ -38,6 +38,7 @@
 /* TODO: warning if no update from a particular non-local user for some time */
 
 #include <libinfinity/adopted/inf-adopted-session.h>
+#include <libinfinity/adopted/inf-adopted-algorithm-private.h>
 #include <libinfinity/adopted/inf-adopted-no-operation.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-error.h>
@@ -61,6 +62,15 @@ struct _InfAdoptedSessionLocalUser {
   time_t noop_time; /* TODO: should be monotonic time */
 };
 
+/* A buffered request whose vector has the component id set to n, while the
+ * current state's component is smaller than n, waits under this key until
+ * the request of user id with index n - 1 has been executed. */
+typedef struct _InfAdoptedSessionWaitKey InfAdoptedSessionWaitKey;
+struct _InfAdoptedSessionWaitKey {
+  guint id;
+  guint n;
+};
+
 typedef struct _InfAdoptedSessionPrivate InfAdoptedSessionPrivate;
 struct _InfAdoptedSessionPrivate {
   InfIo* io;
@@ -73,8 +83,15 @@ struct _InfAdoptedSessionPrivate {
   InfIoTimeout* noop_timeout;
   /* User to send the time for */
   InfAdoptedSessionLocalUser* next_noop_user;
-  /* Buffer for requests that are not ready to be executed yet */
-  GPtrArray* request_buffer;
+  /* Buffer for requests that are not ready to be executed yet. Each
+   * request waits for one of its components that the current state has not
+   * reached yet, mapping InfAdoptedSessionWaitKey to a list of requests.
+   * When that component is reached, the request is checked again and either
+   * waits for its next missing component or becomes ready. This way,
+   * executing a request only looks at the requests it unblocks. */
+  GHashTable* request_buffer;
+  /* Buffered requests that can be executed now */
+  GQueue ready_requests;
 };
 
 enum {
@@ -438,6 +455,258 @@ inf_adopted_session_broadcast_n_requests(InfAdoptedSession* session,
   inf_adopted_session_stop_noop_timer(session, local);
 }
 
+static guint
+inf_adopted_session_wait_key_hash(gconstpointer key)
+{
+  const InfAdoptedSessionWaitKey* wait_key;
+  wait_key = (const InfAdoptedSessionWaitKey*)key;
+
+  return wait_key->id * 0x9e3779b1u ^ wait_key->n;
+}
+
+static gboolean
+inf_adopted_session_wait_key_equal(gconstpointer first,
+                                   gconstpointer second)
+{
+  const InfAdoptedSessionWaitKey* first_key;
+  const InfAdoptedSessionWaitKey* second_key;
+
+  first_key = (const InfAdoptedSessionWaitKey*)first;
+  second_key = (const InfAdoptedSessionWaitKey*)second;
+
+  return first_key->id == second_key->id && first_key->n == second_key->n;
+}
+
+static void
+inf_adopted_session_wait_key_free(gpointer key)
+{
+  g_slice_free(InfAdoptedSessionWaitKey, key);
+}
+
+static void
+inf_adopted_session_wait_list_free(gpointer list)
+{
+  g_slist_free_full(list, g_object_unref);
+}
+
+typedef struct _InfAdoptedSessionFindMissingData
+  InfAdoptedSessionFindMissingData;
+struct _InfAdoptedSessionFindMissingData {
+  InfAdoptedStateVector* current;
+  gboolean found;
+  InfAdoptedSessionWaitKey key;
+};
+
+static void
+inf_adopted_session_find_missing_foreach_func(guint id,
+                                              guint value,
+                                              gpointer user_data)
+{
+  InfAdoptedSessionFindMissingData* data;
+  data = (InfAdoptedSessionFindMissingData*)user_data;
+
+  if(!data->found && value > inf_adopted_state_vector_get(data->current, id))
+  {
+    data->found = TRUE;
+    data->key.id = id;
+    data->key.n = value;
+  }
+}
+
+/* Puts a request into the request buffer. If it can be executed in the
+ * current state, then it is queued for execution by
+ * inf_adopted_session_process_buffered_requests(). Otherwise it waits for
+ * one of the components the current state is missing. This function takes
+ * ownership of request. */
+static void
+inf_adopted_session_buffer_request(InfAdoptedSession* session,
+                                   InfAdoptedRequest* request)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfAdoptedSessionFindMissingData data;
+  InfAdoptedSessionWaitKey* key;
+  gpointer orig_key;
+  GSList* list;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+
+  data.current = inf_adopted_algorithm_get_current(priv->algorithm);
+  data.found = FALSE;
+
+  inf_adopted_state_vector_foreach(
+    inf_adopted_request_get_vector(request),
+    inf_adopted_session_find_missing_foreach_func,
+    &data
+  );
+
+  if(data.found == FALSE)
+  {
+    g_queue_push_tail(&priv->ready_requests, request);
+  }
+  else
+  {
+    if(priv->request_buffer == NULL)
+    {
+      priv->request_buffer = g_hash_table_new_full(
+        inf_adopted_session_wait_key_hash,
+        inf_adopted_session_wait_key_equal,
+        inf_adopted_session_wait_key_free,
+        inf_adopted_session_wait_list_free
+      );
+    }
+
+    list = NULL;
+    if(g_hash_table_lookup_extended(priv->request_buffer, &data.key,
+                                    &orig_key, (gpointer*)&list))
+    {
+      g_hash_table_steal(priv->request_buffer, &data.key);
+      inf_adopted_session_wait_key_free(orig_key);
+    }
+
+    /* Note that the list is in reverse order of arrival */
+    key = g_slice_new(InfAdoptedSessionWaitKey);
+    *key = data.key;
+
+    list = g_slist_prepend(list, request);
+    g_hash_table_insert(priv->request_buffer, key, list);
+  }
+}
+
+/* Wakes up the requests that wait for the current state to reach n in the
+ * component id, after the corresponding request has been executed. */
+static void
+inf_adopted_session_wake_requests(InfAdoptedSession* session,
+                                  guint id,
+                                  guint n)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfAdoptedSessionWaitKey key;
+  gpointer orig_key;
+  GSList* list;
+  GSList* item;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  if(priv->request_buffer == NULL)
+    return;
+
+  key.id = id;
+  key.n = n;
+
+  if(!g_hash_table_lookup_extended(priv->request_buffer, &key,
+                                   &orig_key, (gpointer*)&list))
+  {
+    return;
+  }
+
+  g_hash_table_steal(priv->request_buffer, &key);
+  inf_adopted_session_wait_key_free(orig_key);
+
+  /* Re-buffer in order of arrival. The requests no longer wait for this
+   * component, so they either wait for another one now or are ready. */
+  list = g_slist_reverse(list);
+  for(item = list; item != NULL; item = g_slist_next(item))
+    inf_adopted_session_buffer_request(session, item->data);
+  g_slist_free(list);
+}
+
+/* Emits the check-request signal for a request that is about to be
+ * executed. Returns FALSE and sets error if the request was rejected. */
+static gboolean
+inf_adopted_session_emit_check_request(InfAdoptedSession* session,
+                                       InfAdoptedRequest* request,
+                                       InfAdoptedUser* user,
+                                       GError** error)
+{
+  gboolean reject_request;
+
+  g_signal_emit(
+    G_OBJECT(session),
+    session_signals[CHECK_REQUEST],
+    0,
+    request,
+    user,
+    &reject_request
+  );
+
+  if(reject_request)
+  {
+    g_set_error_literal(
+      error,
+      inf_adopted_session_error_quark,
+      INF_ADOPTED_SESSION_ERROR_INVALID_REQUEST,
+      _("The request was rejected via the API")
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Sends a message back to where a request came from, to let them know we
+ * couldn't handle it. Note that at the moment this is not explicitly
+ * handled, but it can aid in debugging. */
+static void
+inf_adopted_session_report_invalid_request(InfAdoptedSession* session,
+                                           InfAdoptedRequest* request,
+                                           InfAdoptedUser* user,
+                                           const GError* error)
+{
+  InfAdoptedSessionPrivate* priv;
+  xmlNodePtr reply_xml;
+  gchar* request_str;
+  gchar* current_str;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+
+  if(inf_user_get_connection(INF_USER(user)) != NULL)
+  {
+    request_str = inf_adopted_state_vector_to_string(
+      inf_adopted_request_get_vector(request)
+    );
+
+    current_str = inf_adopted_state_vector_to_string(
+      inf_adopted_algorithm_get_current(priv->algorithm)
+    );
+
+    reply_xml = xmlNewNode(NULL, (const xmlChar*)"invalid-request");
+
+    inf_xml_util_set_attribute(
+      reply_xml,
+      "request",
+      request_str
+    );
+
+    inf_xml_util_set_attribute(
+      reply_xml,
+      "state",
+      current_str
+    );
+
+    inf_xml_util_set_attribute_uint(
+      reply_xml,
+      "user",
+      inf_user_get_id(INF_USER(user))
+    );
+
+    xmlNewChild(
+      reply_xml,
+      NULL,
+      (const xmlChar*)"reason",
+      (const xmlChar*)error->message
+    );
+
+    g_free(request_str);
+    g_free(current_str);
+
+    inf_communication_group_send_message(
+      inf_session_get_subscription_group(INF_SESSION(session)),
+      inf_user_get_connection(INF_USER(user)),
+      reply_xml
+    );
+  }
+}
+
 static gboolean
 inf_adopted_session_process_request(InfAdoptedSession* session,
                                     InfAdoptedRequest* request,
@@ -447,43 +716,25 @@ inf_adopted_session_process_request(InfAdoptedSession* session,
   InfAdoptedSessionPrivate* priv;
   InfAdoptedStateVector* request_vector;
   InfAdoptedStateVector* current_vector;
-  gboolean reject_request;
   GError* local_error;
   gboolean execute_result;
 
-  xmlNodePtr reply_xml;
-  gchar* request_str;
-  gchar* current_str;
-
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
   request_vector = inf_adopted_request_get_vector(request);
   current_vector = inf_adopted_algorithm_get_current(priv->algorithm);
 
   if(inf_adopted_state_vector_causally_before(request_vector, current_vector))
   {
-    g_signal_emit(
-      G_OBJECT(session),
-      session_signals[CHECK_REQUEST],
-      0,
+    local_error = NULL;
+
+    execute_result = inf_adopted_session_emit_check_request(
+      session,
       request,
       user,
-      &reject_request
+      &local_error
     );
 
-    local_error = NULL;
-    
-    if(reject_request)
-    {
-      g_set_error_literal(
-        &local_error,
-        inf_adopted_session_error_quark,
-        INF_ADOPTED_SESSION_ERROR_INVALID_REQUEST,
-        _("The request was rejected via the API")
-      );
-
-      execute_result = FALSE;
-    }
-    else
+    if(execute_result == TRUE)
     {
       execute_result = inf_adopted_algorithm_execute_request(
         priv->algorithm,
@@ -495,52 +746,12 @@ inf_adopted_session_process_request(InfAdoptedSession* session,
 
     if(local_error != NULL)
     {
-      /* Send a message back to where the request came from, to let them
-       * know we couldn't handle this. Note that at the moment this is not
-       * explicitly handled, but it can aid in debugging. */
-      if(inf_user_get_connection(INF_USER(user)) != NULL)
-      {
-        /* Send a message back to where we got this request from, to inform
-         * them that the request cannot be handled. */
-        request_str = inf_adopted_state_vector_to_string(request_vector);
-        current_str = inf_adopted_state_vector_to_string(current_vector);
-
-        reply_xml = xmlNewNode(NULL, (const xmlChar*)"invalid-request");
-
-        inf_xml_util_set_attribute(
-          reply_xml,
-          "request",
-          request_str
-        );
-
-        inf_xml_util_set_attribute(
-          reply_xml,
-          "state",
-          current_str
-        );
-
-        inf_xml_util_set_attribute_uint(
-          reply_xml,
-          "user",
-          inf_user_get_id(INF_USER(user))
-        );
-
-        xmlNewChild(
-          reply_xml,
-          NULL,
-          (const xmlChar*)"reason",
-          (const xmlChar*)local_error->message
-        );
-
-        g_free(request_str);
-        g_free(current_str);
-
-        inf_communication_group_send_message(
-          inf_session_get_subscription_group(INF_SESSION(session)),
-          inf_user_get_connection(INF_USER(user)),
-          reply_xml
-        );
-      }
+      inf_adopted_session_report_invalid_request(
+        session,
+        request,
+        user,
+        local_error
+      );
 
       g_propagate_error(error, local_error);
     }
@@ -549,10 +760,8 @@ inf_adopted_session_process_request(InfAdoptedSession* session,
   }
   else
   {
-    if(priv->request_buffer == NULL)
-      priv->request_buffer = g_ptr_array_new();
-    g_ptr_array_add(priv->request_buffer, request);
     g_object_ref(request);
+    inf_adopted_session_buffer_request(session, request);
     return TRUE;
   }
 }
@@ -562,51 +771,80 @@ inf_adopted_session_process_buffered_requests(InfAdoptedSession* session)
 {
   InfAdoptedSessionPrivate* priv;
   InfUserTable* user_table;
-  InfAdoptedStateVector* current;
+  gboolean executed;
+  gboolean result;
 
-  guint i;
   InfAdoptedRequest* request;
-  InfAdoptedStateVector* vector;
+  GError* error;
 
   guint user_id;
   InfUser* user;
 
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  user_table = inf_session_get_user_table(INF_SESSION(session));
 
-  if(priv->request_buffer != NULL)
+  if(g_queue_is_empty(&priv->ready_requests))
+    return;
+
+  /* Execute all requests that are ready as a batch. Executing them can
+   * wake up more buffered requests, which are queued and executed in the
+   * same batch. Each request is checked right before it is executed, so
+   * that the check-request handlers see the state the request is actually
+   * executed in, including the effect of the previous requests.
+   *
+   * Note that there is no error handling here, since the buffered requests
+   * are not related to the request which has currently been received. In
+   * order to handle a failure here, the
+   * InfAdoptedAlgorithm::end-execute-request signal should be used. If a
+   * request fails, report it and go on with the rest of the batch. */
+  _inf_adopted_algorithm_begin_batch(priv->algorithm);
+  executed = FALSE;
+
+  while(!g_queue_is_empty(&priv->ready_requests))
   {
-    user_table = inf_session_get_user_table(INF_SESSION(session));
-    current = inf_adopted_algorithm_get_current(priv->algorithm);
-    for(i = 0; i < priv->request_buffer->len; ++i)
+    request = INF_ADOPTED_REQUEST(g_queue_pop_head(&priv->ready_requests));
+
+    user_id = inf_adopted_request_get_user_id(request);
+    user = inf_user_table_lookup_user_by_id(user_table, user_id);
+    g_assert(INF_ADOPTED_IS_USER(user));
+
+    error = NULL;
+    result = inf_adopted_session_emit_check_request(
+      session,
+      request,
+      INF_ADOPTED_USER(user),
+      &error
+    );
+
+    if(result)
     {
-      request =
-        INF_ADOPTED_REQUEST(g_ptr_array_index(priv->request_buffer, i));
-      vector = inf_adopted_request_get_vector(request);
+      result = inf_adopted_algorithm_execute_request(
+        priv->algorithm,
+        request,
+        TRUE,
+        &error
+      );
 
-      if(inf_adopted_state_vector_causally_before(vector, current))
-      {
-        g_ptr_array_remove_index_fast(priv->request_buffer, i);
-
-        user_id = inf_adopted_request_get_user_id(request);
-        user = inf_user_table_lookup_user_by_id(user_table, user_id);
-        g_assert(INF_ADOPTED_IS_USER(user));
-
-        /* Note that there is no error handling here, since the buffered
-         * requests are not related to the request which has currently been
-         * received. In order to handle a failure here, the
-         * InfAdoptedAlgorithm::end-execute-request signal should be used. */
-        inf_adopted_session_process_request(
-          session,
-          request,
-          INF_ADOPTED_USER(user),
-          NULL
-        );
+      if(result)
+        executed = TRUE;
+    }
 
-        g_object_unref(request);
-        return inf_adopted_session_process_buffered_requests(session);
-      }
+    if(result == FALSE && error != NULL)
+    {
+      inf_adopted_session_report_invalid_request(
+        session,
+        request,
+        INF_ADOPTED_USER(user),
+        error
+      );
+
+      g_error_free(error);
     }
+
+    g_object_unref(request);
   }
+
+  _inf_adopted_algorithm_end_batch(priv->algorithm, executed);
 }
 
 /*
@@ -721,6 +959,23 @@ inf_adopted_session_end_execute_request_cb(InfAdoptedAlgorithm* algorithm,
   session = INF_ADOPTED_SESSION(user_data);
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
 
+  /* If the request has been added to the log, then the current state has
+   * advanced in the component of the user who issued it, which can make
+   * buffered requests ready. */
+  if(error == NULL && inf_adopted_request_affects_buffer(request))
+  {
+    id = inf_adopted_request_get_user_id(request);
+
+    inf_adopted_session_wake_requests(
+      session,
+      id,
+      inf_adopted_state_vector_get(
+        inf_adopted_algorithm_get_current(algorithm),
+        id
+      )
+    );
+  }
+
   if(translated != NULL)
   {
     if(inf_adopted_request_affects_buffer(translated))
@@ -804,6 +1059,7 @@ inf_adopted_session_init(InfAdoptedSession* session)
   priv->noop_timeout = NULL;
   priv->next_noop_user = NULL;
   priv->request_buffer = NULL;
+  g_queue_init(&priv->ready_requests);
 }
 
 static void
@@ -872,7 +1128,6 @@ inf_adopted_session_dispose(GObject* object)
   InfAdoptedSession* session;
   InfAdoptedSessionPrivate* priv;
   InfUserTable* user_table;
-  guint i;
 
   session = INF_ADOPTED_SESSION(object);
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
@@ -905,12 +1160,13 @@ inf_adopted_session_dispose(GObject* object)
 
   if(priv->request_buffer != NULL)
   {
-    for(i = 0; i < priv->request_buffer->len; ++i)
-      g_object_unref(g_ptr_array_index(priv->request_buffer, i));
-    g_ptr_array_free(priv->request_buffer, TRUE);
+    g_hash_table_destroy(priv->request_buffer);
     priv->request_buffer = NULL;
   }
 
+  while(!g_queue_is_empty(&priv->ready_requests))
+    g_object_unref(g_queue_pop_head(&priv->ready_requests));
+
   if(priv->algorithm != NULL)
   {
     inf_signal_handlers_disconnect_by_func(
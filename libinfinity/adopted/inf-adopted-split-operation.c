@@ -52,6 +52,9 @@ typedef struct _InfAdoptedSplitOperationPrivate InfAdoptedSplitOperationPrivate;
 struct _InfAdoptedSplitOperationPrivate {
   InfAdoptedOperation* first;
   InfAdoptedOperation* second;
+  /* Properties can only be set during construction, since operations
+   * are shared between requests and must not change afterwards. */
+  gboolean constructed;
 };
 
 enum {
@@ -111,6 +114,38 @@ inf_adopted_split_operation_init(InfAdoptedSplitOperation* operation)
 
   priv->first = NULL;
   priv->second = NULL;
+  priv->constructed = FALSE;
+}
+
+static void
+inf_adopted_split_operation_constructed(GObject* object)
+{
+  InfAdoptedSplitOperationPrivate* priv;
+  priv = INF_ADOPTED_SPLIT_OPERATION_PRIVATE(object);
+
+  G_OBJECT_CLASS(inf_adopted_split_operation_parent_class)->constructed(object);
+
+  priv->constructed = TRUE;
+}
+
+/* Creates a split operation taking ownership of first and second. This is
+ * used for the intermediate split operations created during transformation,
+ * where property-based construction and the extra reference counting would
+ * only add overhead. */
+static InfAdoptedSplitOperation*
+inf_adopted_split_operation_new_take(InfAdoptedOperation* first,
+                                     InfAdoptedOperation* second)
+{
+  GObject* object;
+  InfAdoptedSplitOperationPrivate* priv;
+
+  object = g_object_new(INF_ADOPTED_TYPE_SPLIT_OPERATION, NULL);
+  priv = INF_ADOPTED_SPLIT_OPERATION_PRIVATE(object);
+
+  priv->first = first;
+  priv->second = second;
+
+  return INF_ADOPTED_SPLIT_OPERATION(object);
 }
 
 static void
@@ -149,6 +184,17 @@ inf_adopted_split_operation_set_property(GObject* object,
   operation = INF_ADOPTED_SPLIT_OPERATION(object);
   priv = INF_ADOPTED_SPLIT_OPERATION_PRIVATE(operation);
 
+  if(priv->constructed)
+  {
+    g_warning(
+      "Property \"%s\" of %s can only be set at construction time",
+      pspec->name,
+      G_OBJECT_TYPE_NAME(object)
+    );
+
+    return;
+  }
+
   switch(prop_id)
   {
   case PROP_FIRST:
@@ -200,6 +246,7 @@ inf_adopted_split_operation_class_init(
   GObjectClass* object_class;
   object_class = G_OBJECT_CLASS(split_operation_class);
 
+  object_class->constructed = inf_adopted_split_operation_constructed;
   object_class->dispose = inf_adopted_split_operation_dispose;
   object_class->set_property = inf_adopted_split_operation_set_property;
   object_class->get_property = inf_adopted_split_operation_get_property;
@@ -212,7 +259,7 @@ inf_adopted_split_operation_class_init(
       "First operation",
       "The first operation of the split operation",
       INF_ADOPTED_TYPE_OPERATION,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -224,7 +271,7 @@ inf_adopted_split_operation_class_init(
       "Second operation",
       "The second operation of the split operation",
       INF_ADOPTED_TYPE_OPERATION,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 }
@@ -352,12 +399,9 @@ inf_adopted_split_operation_transform(InfAdoptedOperation* operation,
    * fact that a split operation is never un-split during transformation. */
 
   result = INF_ADOPTED_OPERATION(
-    inf_adopted_split_operation_new(new_first, new_second)
+    inf_adopted_split_operation_new_take(new_first, new_second)
   );
 
-  g_object_unref(G_OBJECT(new_first));
-  g_object_unref(G_OBJECT(new_second));
-
   return result;
 }
 
@@ -371,7 +415,7 @@ inf_adopted_split_operation_copy(InfAdoptedOperation* operation)
   priv = INF_ADOPTED_SPLIT_OPERATION_PRIVATE(split);
 
   return INF_ADOPTED_OPERATION(
-    inf_adopted_split_operation_new(
+    inf_adopted_split_operation_new_take(
       inf_adopted_operation_copy(priv->first),
       inf_adopted_operation_copy(priv->second)
     )
@@ -489,14 +533,7 @@ inf_adopted_split_operation_apply_transformed(InfAdoptedOperation* operation,
   else
   {
     /* Otherwise create a new operation */
-    result = inf_adopted_split_operation_new(
-      ret_first,
-      ret_second
-    );
-
-    g_object_unref(ret_first);
-    g_object_unref(ret_second);
-
+    result = inf_adopted_split_operation_new_take(ret_first, ret_second);
     return INF_ADOPTED_OPERATION(result);
   }
 }
@@ -517,11 +554,7 @@ inf_adopted_split_operation_revert(InfAdoptedOperation* operation)
   revert_first = inf_adopted_operation_revert(priv->first);
   revert_second = inf_adopted_operation_revert(priv->second);
 
-  result = inf_adopted_split_operation_new(revert_second, revert_first);
-
-  g_object_unref(revert_first);
-  g_object_unref(revert_second);
-
+  result = inf_adopted_split_operation_new_take(revert_second, revert_first);
   return INF_ADOPTED_OPERATION(result);
 }
 
@@ -553,19 +586,12 @@ InfAdoptedSplitOperation*
 inf_adopted_split_operation_new(InfAdoptedOperation* first,
                                 InfAdoptedOperation* second)
 {
-  GObject* object;
-
   g_return_val_if_fail(INF_ADOPTED_IS_OPERATION(first), NULL);
   g_return_val_if_fail(INF_ADOPTED_IS_OPERATION(second), NULL);
 
-  object = g_object_new(
-    INF_ADOPTED_TYPE_SPLIT_OPERATION,
-    "first", first,
-    "second", second,
-    NULL
-  );
-
-  return INF_ADOPTED_SPLIT_OPERATION(object);
+  g_object_ref(first);
+  g_object_ref(second);
+  return inf_adopted_split_operation_new_take(first, second);
 }
 
 /**
@@ -37,17 +37,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
 G_DEFINE_BOXED_TYPE(InfAdoptedStateVector, inf_adopted_state_vector, inf_adopted_state_vector_copy, inf_adopted_state_vector_free)
 
 /* NOTE: What the state vector actually counts is the amount of operations
  * performed by each user. This number is called a timestamp, although it has
  * nothing to do with actual time. */
 
-typedef struct _InfAdoptedStateVectorComponent InfAdoptedStateVectorComponent;
-struct _InfAdoptedStateVectorComponent {
-  guint id;
-  guint n; /* timestamp */
-};
+/* Number of components that are stored inside the state vector itself,
+ * without requiring an extra allocation. Most sessions have only a handful
+ * of users, so this avoids a malloc for almost all state vectors. */
+#define INF_ADOPTED_STATE_VECTOR_INLINE_SIZE 8
 
 typedef struct _InfAdoptedStateVectorForeachData
   InfAdoptedStateVectorForeachData;
@@ -56,12 +59,59 @@ struct _InfAdoptedStateVectorForeachData {
   gpointer user_data;
 };
 
+/* The components are stored as two parallel arrays, one with the user IDs
+ * in ascending order and one with the corresponding timestamps. Keeping the
+ * timestamps contiguous allows the comparison functions below to process
+ * them in blocks when two vectors have the same set of IDs, which is the
+ * common case since all vectors within a session are derived from the
+ * algorithm's current state. */
 struct _InfAdoptedStateVector {
   gsize size;
   gsize max_size;
-  InfAdoptedStateVectorComponent* data;
+
+  guint* ids;
+  guint* ns; /* timestamps */
+
+  guint inline_ids[INF_ADOPTED_STATE_VECTOR_INLINE_SIZE];
+  guint inline_ns[INF_ADOPTED_STATE_VECTOR_INLINE_SIZE];
 };
 
+static void
+inf_adopted_state_vector_init(InfAdoptedStateVector* vec)
+{
+  vec->size = 0;
+  vec->max_size = INF_ADOPTED_STATE_VECTOR_INLINE_SIZE;
+  vec->ids = vec->inline_ids;
+  vec->ns = vec->inline_ns;
+}
+
+static void
+inf_adopted_state_vector_reserve(InfAdoptedStateVector* vec,
+                                 gsize size)
+{
+  gsize max_size;
+  guint* data;
+
+  if(size <= vec->max_size)
+    return;
+
+  max_size = vec->max_size;
+  while(max_size < size)
+    max_size *= 2;
+
+  /* IDs and timestamps share a single allocation */
+  data = g_malloc(2 * max_size * sizeof(guint));
+  memcpy(data, vec->ids, vec->size * sizeof(guint));
+  memcpy(data + max_size, vec->ns, vec->size * sizeof(guint));
+
+  if(vec->ids != vec->inline_ids)
+    g_free(vec->ids);
+
+  vec->ids = data;
+  vec->ns = data + max_size;
+  vec->max_size = max_size;
+}
+
 static gsize
 inf_adopted_state_vector_find_insert_pos(const InfAdoptedStateVector* vec,
                                          guint id)
@@ -69,9 +119,6 @@ inf_adopted_state_vector_find_insert_pos(const InfAdoptedStateVector* vec,
   gsize begin;
   gsize end;
   gsize middle;
-  InfAdoptedStateVectorComponent* comp;
-
-  if(vec->size == 0) return 0;
 
   begin = 0;
   end = vec->size;
@@ -80,68 +127,201 @@ inf_adopted_state_vector_find_insert_pos(const InfAdoptedStateVector* vec,
   while(begin != end)
   {
     middle = begin + (end - begin) / 2;
-    comp = vec->data + middle;
-    if (comp->id == id)
-    {
+    if(vec->ids[middle] == id)
       return middle;
-    }
 
-    if (comp->id < id)
-    {
+    if(vec->ids[middle] < id)
       begin = middle + 1;
-    }
     else
-    {
       end = middle;
-    }
   }
+
   return begin;
 }
 
-static InfAdoptedStateVectorComponent*
-inf_adopted_state_vector_lookup(const InfAdoptedStateVector* vec,
-                                guint id)
+static void
+inf_adopted_state_vector_insert(InfAdoptedStateVector* vec,
+                                guint id,
+                                guint value,
+                                gsize insert_pos)
 {
-  gsize pos;
+  gsize move_count;
 
-  pos = inf_adopted_state_vector_find_insert_pos(vec, id);
-  if(pos < vec->size && vec->data[pos].id == id)
-    return vec->data + pos;
-  return NULL;
+  inf_adopted_state_vector_reserve(vec, vec->size + 1);
+
+  if(insert_pos < vec->size)
+  {
+    g_assert(vec->ids[insert_pos] != id);
+
+    move_count = vec->size - insert_pos;
+    g_memmove(
+      vec->ids + insert_pos + 1,
+      vec->ids + insert_pos,
+      move_count * sizeof(guint)
+    );
+
+    g_memmove(
+      vec->ns + insert_pos + 1,
+      vec->ns + insert_pos,
+      move_count * sizeof(guint)
+    );
+  }
+
+  ++vec->size;
+  vec->ids[insert_pos] = id;
+  vec->ns[insert_pos] = value;
 }
 
-static InfAdoptedStateVectorComponent*
-inf_adopted_state_vector_insert(InfAdoptedStateVector* vec,
+/* Appends a component to the end of the vector. The caller needs to make
+ * sure that id is greater than all IDs already in the vector. */
+static void
+inf_adopted_state_vector_append(InfAdoptedStateVector* vec,
                                 guint id,
-                                guint value,
-                                gsize insert_pos)
+                                guint value)
+{
+  g_assert(vec->size == 0 || vec->ids[vec->size - 1] < id);
+
+  inf_adopted_state_vector_reserve(vec, vec->size + 1);
+  vec->ids[vec->size] = id;
+  vec->ns[vec->size] = value;
+  ++vec->size;
+}
+
+/* Returns TRUE if both vectors contain exactly the same set of IDs, in
+ * which case their timestamps can be compared component by component. */
+static gboolean
+inf_adopted_state_vector_same_layout(const InfAdoptedStateVector* first,
+                                     const InfAdoptedStateVector* second)
+{
+  if(first->size != second->size)
+    return FALSE;
+  if(first->ids == second->ids)
+    return TRUE;
+
+  return memcmp(first->ids, second->ids, first->size * sizeof(guint)) == 0;
+}
+
+/* Returns the position of the first component in which first and second
+ * differ, or size if they are equal. */
+static gsize
+inf_adopted_state_vector_mismatch(const guint* first,
+                                  const guint* second,
+                                  gsize size)
 {
-  InfAdoptedStateVectorComponent* comp;
+  gsize pos;
+#ifdef __SSE2__
+  __m128i first_block;
+  __m128i second_block;
+  gulong mask;
+#endif
+
+  pos = 0;
 
-  if(vec->max_size <= vec->size)
+#ifdef __SSE2__
+  for(; pos + 4 <= size; pos += 4)
   {
-    vec->max_size += 5;
-    vec->data = g_realloc(vec->data,
-                vec->max_size * sizeof(InfAdoptedStateVectorComponent));
+    first_block = _mm_loadu_si128((const __m128i*)(first + pos));
+    second_block = _mm_loadu_si128((const __m128i*)(second + pos));
+
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi32(first_block, second_block));
+    if(mask != 0xffff)
+      return pos + g_bit_nth_lsf(~mask & 0xffff, -1) / sizeof(guint);
   }
+#endif
 
-  comp = vec->data + insert_pos;
-  if(insert_pos < vec->size)
+  for(; pos < size; ++pos)
+    if(first[pos] != second[pos])
+      return pos;
+
+  return size;
+}
+
+/* Returns TRUE if first[i] <= second[i] for all i < size. */
+static gboolean
+inf_adopted_state_vector_less_equal(const guint* first,
+                                    const guint* second,
+                                    gsize size)
+{
+  gsize pos;
+  guint greater;
+#ifdef __SSE2__
+  __m128i bias;
+  __m128i first_block;
+  __m128i second_block;
+#endif
+
+  pos = 0;
+
+#ifdef __SSE2__
+  /* SSE2 only has a signed comparison, so move both operands into the
+   * signed range before comparing. */
+  bias = _mm_set1_epi32((gint)0x80000000u);
+  for(; pos + 4 <= size; pos += 4)
   {
-    gsize move_count;
+    first_block = _mm_xor_si128(
+      _mm_loadu_si128((const __m128i*)(first + pos)),
+      bias
+    );
+
+    second_block = _mm_xor_si128(
+      _mm_loadu_si128((const __m128i*)(second + pos)),
+      bias
+    );
+
+    if(_mm_movemask_epi8(_mm_cmpgt_epi32(first_block, second_block)) != 0)
+      return FALSE;
+  }
+#endif
+
+  greater = 0;
+  for(; pos < size; ++pos)
+    greater |= (first[pos] > second[pos]);
 
-    g_assert(comp->id != id);
+  return greater == 0;
+}
 
-    move_count = (vec->size - insert_pos);
-    g_memmove(comp + 1, comp,
-              move_count * sizeof(InfAdoptedStateVectorComponent));
+static guint
+inf_adopted_state_vector_sum(const InfAdoptedStateVector* vec)
+{
+  gsize pos;
+  guint sum;
+#ifdef __SSE2__
+  __m128i acc;
+  guint lanes[4];
+#endif
+
+  pos = 0;
+  sum = 0;
+
+#ifdef __SSE2__
+  acc = _mm_setzero_si128();
+  for(; pos + 4 <= vec->size; pos += 4)
+  {
+    acc = _mm_add_epi32(
+      acc,
+      _mm_loadu_si128((const __m128i*)(vec->ns + pos))
+    );
   }
 
-  ++vec->size;
-  comp->id = id;
-  comp->n = value;
+  _mm_storeu_si128((__m128i*)lanes, acc);
+  sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+  for(; pos < vec->size; ++pos)
+    sum += vec->ns[pos];
+
+  return sum;
+}
 
-  return comp;
+static gboolean
+inf_adopted_state_vector_has_nonzero(const guint* ns,
+                                     gsize size)
+{
+  gsize pos;
+  for(pos = 0; pos < size; ++pos)
+    if(ns[pos] > 0)
+      return TRUE;
+  return FALSE;
 }
 
 /**
@@ -170,9 +350,7 @@ inf_adopted_state_vector_new(void)
   InfAdoptedStateVector* vec;
 
   vec = g_slice_new(InfAdoptedStateVector);
-  vec->size = 0;
-  vec->max_size = 0;
-  vec->data = NULL;
+  inf_adopted_state_vector_init(vec);
 
   return vec;
 }
@@ -193,20 +371,12 @@ inf_adopted_state_vector_copy(InfAdoptedStateVector* vec)
   g_return_val_if_fail(vec != NULL, NULL);
 
   new_vec = g_slice_new(InfAdoptedStateVector);
-  new_vec->size = vec->size;
-  new_vec->max_size = vec->max_size;
+  inf_adopted_state_vector_init(new_vec);
+  inf_adopted_state_vector_reserve(new_vec, vec->size);
 
-  if(new_vec->max_size == 0)
-  {
-    new_vec->data = NULL;
-  }
-  else
-  {
-    new_vec->data =
-      g_malloc(new_vec->max_size * sizeof(InfAdoptedStateVectorComponent));
-    memcpy(new_vec->data, vec->data,
-           new_vec->size * sizeof(InfAdoptedStateVectorComponent));
-  }
+  memcpy(new_vec->ids, vec->ids, vec->size * sizeof(guint));
+  memcpy(new_vec->ns, vec->ns, vec->size * sizeof(guint));
+  new_vec->size = vec->size;
 
   return new_vec;
 }
@@ -223,7 +393,9 @@ inf_adopted_state_vector_free(InfAdoptedStateVector* vec)
 {
   g_return_if_fail(vec != NULL);
 
-  g_free(vec->data);
+  if(vec->ids != vec->inline_ids)
+    g_free(vec->ids);
+
   g_slice_free(InfAdoptedStateVector, vec);
 }
 
@@ -241,16 +413,43 @@ guint
 inf_adopted_state_vector_get(const InfAdoptedStateVector* vec,
                              guint id)
 {
-  InfAdoptedStateVectorComponent* comp;
+  gsize pos;
 
   g_return_val_if_fail(vec != NULL, 0);
 
-  comp = inf_adopted_state_vector_lookup(vec, id);
+  pos = inf_adopted_state_vector_find_insert_pos(vec, id);
+  if(pos < vec->size && vec->ids[pos] == id)
+    return vec->ns[pos];
+
+  return 0;
+}
+
+/**
+ * inf_adopted_state_vector_get_slot:
+ * @vec: A #InfAdoptedStateVector.
+ * @id: The component whose timestamp to look for.
+ * @slot: The expected position of @id within @vec.
+ *
+ * Returns the timestamp for the given component, like
+ * inf_adopted_state_vector_get(). @slot is the position of @id among the
+ * sorted IDs of a vector that contains the same set of components as @vec,
+ * such as the slot #InfAdoptedAlgorithm assigns to each of its users. If @id
+ * is found at that position then the lookup takes constant time, otherwise
+ * the function falls back to a binary search.
+ *
+ * Returns: The @component'th entry in the vector.
+ */
+guint
+inf_adopted_state_vector_get_slot(const InfAdoptedStateVector* vec,
+                                  guint id,
+                                  guint slot)
+{
+  g_return_val_if_fail(vec != NULL, 0);
 
-  if(comp == NULL)
-    return 0;
+  if(slot < vec->size && vec->ids[slot] == id)
+    return vec->ns[slot];
 
-  return comp->n;
+  return inf_adopted_state_vector_get(vec, id);
 }
 
 /**
@@ -271,8 +470,8 @@ inf_adopted_state_vector_set(InfAdoptedStateVector* vec,
   g_return_if_fail(vec != NULL);
 
   pos = inf_adopted_state_vector_find_insert_pos(vec, id);
-  if(pos < vec->size && vec->data[pos].id == id)
-    vec->data[pos].n = value;
+  if(pos < vec->size && vec->ids[pos] == id)
+    vec->ns[pos] = value;
   else
     inf_adopted_state_vector_insert(vec, id, value, pos);
 }
@@ -292,23 +491,21 @@ inf_adopted_state_vector_add(InfAdoptedStateVector* vec,
                              guint id,
                              gint value)
 {
-  InfAdoptedStateVectorComponent* comp;
   gsize pos;
 
   g_return_if_fail(vec != NULL);
 
   pos = inf_adopted_state_vector_find_insert_pos(vec, id);
-  comp = vec->data + pos;
-  if(pos == vec->size || comp->id != id)
+  if(pos == vec->size || vec->ids[pos] != id)
   {
     g_assert(value > 0);
-    comp = inf_adopted_state_vector_insert(vec, id, value, pos);
+    inf_adopted_state_vector_insert(vec, id, value, pos);
   }
   else
   {
-    g_assert(value > 0 || comp->n >= (guint)-value);
+    g_assert(value > 0 || vec->ns[pos] >= (guint)-value);
 
-    comp->n += value;
+    vec->ns[pos] += value;
   }
 }
 
@@ -333,7 +530,7 @@ inf_adopted_state_vector_foreach(const InfAdoptedStateVector* vec,
 
   for(pos = 0; pos < vec->size; ++pos)
   {
-    func(vec->data[pos].id, vec->data[pos].n, user_data);
+    func(vec->ids[pos], vec->ns[pos], user_data);
   }
 }
 
@@ -354,12 +551,45 @@ inf_adopted_state_vector_compare(const InfAdoptedStateVector* first,
 {
   gsize first_pos;
   gsize second_pos;
-  InfAdoptedStateVectorComponent* first_comp;
-  InfAdoptedStateVectorComponent* second_comp;
+  gsize pos;
 
   g_return_val_if_fail(first != NULL, 0);
   g_return_val_if_fail(second != NULL, 0);
 
+  if(inf_adopted_state_vector_same_layout(first, second))
+  {
+    pos = inf_adopted_state_vector_mismatch(first->ns, second->ns, first->size);
+    if(pos == first->size)
+      return 0;
+
+    if(first->ns[pos] > 0 && second->ns[pos] > 0)
+      return first->ns[pos] < second->ns[pos] ? -1 : 1;
+
+    /* One of the two is zero at pos. The general algorithm below skips
+     * zero components, so the result depends on whether the vector with
+     * the zero component has another non-zero component following. */
+    if(first->ns[pos] == 0)
+    {
+      if(inf_adopted_state_vector_has_nonzero(first->ns + pos + 1,
+                                              first->size - pos - 1))
+      {
+        return 1;
+      }
+
+      return -1;
+    }
+    else
+    {
+      if(inf_adopted_state_vector_has_nonzero(second->ns + pos + 1,
+                                              second->size - pos - 1))
+      {
+        return -1;
+      }
+
+      return 1;
+    }
+  }
+
   first_pos = 0;
   second_pos = 0;
 
@@ -371,45 +601,22 @@ inf_adopted_state_vector_compare(const InfAdoptedStateVector* first,
     /* Jump over components whose value is 0. This is necessary because
      * components that are not in the sequence are treated like having the
      * value zero and should be compared equal. */
-    while(first_pos < first->size)
-    {
-      first_comp = first->data + first_pos;
-      if(first_comp->n > 0)
-        break;
+    while(first_pos < first->size && first->ns[first_pos] == 0)
       ++first_pos;
-    }
-    
-    while(second_pos < second->size)
-    {
-      second_comp = second->data + second_pos;
-      if(second_comp->n > 0)
-        break;
+    while(second_pos < second->size && second->ns[second_pos] == 0)
       ++second_pos;
-    }
 
     if(first_pos == first->size || second_pos == second->size)
-    {
       break;
-    }
-
-    /* first_comp and second_comp are set here */
 
-    if(first_comp->id < second_comp->id)
-    {
+    if(first->ids[first_pos] < second->ids[second_pos])
       return -1;
-    }
-    else if(first_comp->id > second_comp->id)
-    {
+    else if(first->ids[first_pos] > second->ids[second_pos])
       return 1;
-    }
-    else if(first_comp->n < second_comp->n)
-    {
+    else if(first->ns[first_pos] < second->ns[second_pos])
       return -1;
-    }
-    else if(first_comp->n > second_comp->n)
-    {
+    else if(first->ns[first_pos] > second->ns[second_pos])
       return 1;
-    }
 
     /* Component matches, check next */
 
@@ -431,6 +638,39 @@ inf_adopted_state_vector_compare(const InfAdoptedStateVector* first,
   }
 }
 
+/**
+ * inf_adopted_state_vector_hash:
+ * @vec: A #InfAdoptedStateVector.
+ *
+ * Computes a hash value for @vec. Components with a value of zero do not
+ * contribute to the hash, so that two vectors for which
+ * inf_adopted_state_vector_compare() returns 0 always have the same hash
+ * value. This allows state vectors to be used as keys in hash tables.
+ *
+ * Returns: A hash value for @vec.
+ **/
+guint
+inf_adopted_state_vector_hash(const InfAdoptedStateVector* vec)
+{
+  guint32 hash;
+  gsize pos;
+
+  g_return_val_if_fail(vec != NULL, 0);
+
+  /* FNV-1a over the (id, n) pairs of all non-zero components */
+  hash = 2166136261u;
+  for(pos = 0; pos < vec->size; ++pos)
+  {
+    if(vec->ns[pos] != 0)
+    {
+      hash = (hash ^ vec->ids[pos]) * 16777619u;
+      hash = (hash ^ vec->ns[pos]) * 16777619u;
+    }
+  }
+
+  return hash;
+}
+
 /**
  * inf_adopted_state_vector_causally_before:
  * @first: A #InfAdoptedStateVector.
@@ -449,51 +689,42 @@ inf_adopted_state_vector_causally_before(const InfAdoptedStateVector* first,
 {
   gsize first_pos;
   gsize second_pos;
-  InfAdoptedStateVectorComponent* first_comp;
-  InfAdoptedStateVectorComponent* second_comp;
 
   g_return_val_if_fail(first != NULL, FALSE);
   g_return_val_if_fail(second != NULL, FALSE);
 
-  first_pos = 0;
+  if(inf_adopted_state_vector_same_layout(first, second))
+  {
+    return inf_adopted_state_vector_less_equal(
+      first->ns,
+      second->ns,
+      first->size
+    );
+  }
+
   second_pos = 0;
 
-  while(first_pos < first->size)
+  for(first_pos = 0; first_pos < first->size; ++first_pos)
   {
-    first_comp = first->data + first_pos++;
+    /* 0 is less or equal to anything */
+    if(first->ns[first_pos] == 0)
+      continue;
 
-    if(second_pos == second->size)
+    while(second_pos < second->size &&
+          second->ids[second_pos] < first->ids[first_pos])
     {
-      /* That component is not contained in second (thus 0) */
-      if(first_comp->n > 0)
-        return FALSE;
+      ++second_pos;
     }
-    else
-    {
-      second_comp = second->data + second_pos;
-      while(second_comp != NULL && first_comp->id > second_comp->id)
-      {
-        ++second_pos;
-        if(second_pos != second->size)
-          second_comp = second->data + second_pos;
-        else
-          second_comp = NULL;
-      }
-
-      if(second_comp == NULL || first_comp->id < second_comp->id)
-      {
-        /* That component is not contained in second (thus 0) */
-        if(first_comp->n > 0)
-          return FALSE;
-        else
-          /* 0 <= 0 */
-          continue;
-      }
 
-      g_assert(first_comp->id == second_comp->id);
-      if(first_comp->n > second_comp->n)
-        return FALSE;
+    /* That component is not contained in second (thus 0) */
+    if(second_pos == second->size ||
+       second->ids[second_pos] != first->ids[first_pos])
+    {
+      return FALSE;
     }
+
+    if(first->ns[first_pos] > second->ns[second_pos])
+      return FALSE;
   }
 
   return TRUE;
@@ -527,93 +758,62 @@ inf_adopted_state_vector_causally_before_inc(
 {
   gsize first_pos;
   gsize second_pos;
-  gboolean inc_comp_seen;
-
-  InfAdoptedStateVectorComponent* first_comp;
-  InfAdoptedStateVectorComponent* second_comp;
-  InfAdoptedStateVectorComponent inc_comp;
+  guint first_n;
 
   g_return_val_if_fail(first != NULL, FALSE);
   g_return_val_if_fail(second != NULL, FALSE);
 
-  first_pos = 0;
-  second_pos = 0;
-  inc_comp.id = inc_component;
-  inc_comp_seen = FALSE;
+  if(inf_adopted_state_vector_same_layout(first, second))
+  {
+    first_pos = inf_adopted_state_vector_find_insert_pos(first, inc_component);
+
+    /* If the component is in neither vector, then it is 1 in first after
+     * incrementing, and 0 in second. */
+    if(first_pos == first->size || first->ids[first_pos] != inc_component)
+      return FALSE;
+    if(first->ns[first_pos] >= second->ns[first_pos])
+      return FALSE;
+
+    return inf_adopted_state_vector_less_equal(
+      first->ns,
+      second->ns,
+      first->size
+    );
+  }
 
-  while(first_pos < first->size || !inc_comp_seen)
+  /* The incremented component is at least 1, so it needs to be in second
+   * and be greater than the non-incremented value in first. */
+  second_pos = inf_adopted_state_vector_find_insert_pos(second, inc_component);
+  if(second_pos == second->size || second->ids[second_pos] != inc_component)
+    return FALSE;
+  if(inf_adopted_state_vector_get(first, inc_component) >=
+     second->ns[second_pos])
   {
-    /* Set first_comp as if there was inc_component increased by one */
-    if(!inc_comp_seen)
-    {
-      if(first_pos < first->size)
-      {
-        first_comp = first->data + first_pos;
-        if(first_comp->id < inc_component)
-        {
-          ++ first_pos;
-        }
-        else if(first_comp->id == inc_component)
-        {
-          inc_comp.n = first_comp->n + 1;
-          first_comp = &inc_comp;
-          inc_comp_seen = TRUE;
-          ++ first_pos;
-        }
-        else
-        {
-          inc_comp.n = 1;
-          first_comp = &inc_comp;
-          inc_comp_seen = TRUE;
-        }
-      }
-      else
-      {
-        /* inc_comp is the only component of first */
-        inc_comp.n = 1;
-        first_comp = &inc_comp;
-        inc_comp_seen = TRUE;
-      }
-    }
-    else
+    return FALSE;
+  }
+
+  /* All other components must be causally before as usual */
+  second_pos = 0;
+  for(first_pos = 0; first_pos < first->size; ++first_pos)
+  {
+    first_n = first->ns[first_pos];
+    if(first_n == 0 || first->ids[first_pos] == inc_component)
+      continue;
+
+    while(second_pos < second->size &&
+          second->ids[second_pos] < first->ids[first_pos])
     {
-      /* inc_comp already handled, business as usual */
-      first_comp = first->data + first_pos;
-      ++ first_pos;
+      ++second_pos;
     }
 
-    if(second_pos == second->size)
+    if(second_pos == second->size ||
+       second->ids[second_pos] != first->ids[first_pos])
     {
-      /* That component is not contained in second (thus 0) */
-      if(first_comp->n > 0)
-        return FALSE;
+      return FALSE;
     }
-    else
-    {
-      second_comp = second->data + second_pos;
-      while(second_comp != NULL && first_comp->id > second_comp->id)
-      {
-        ++second_pos;
-        if(second_pos != second->size)
-          second_comp = second->data + second_pos;
-        else
-          second_comp = NULL;
-      }
-
-      if(second_comp == NULL || first_comp->id < second_comp->id)
-      {
-        /* That component is not contained in second (thus 0) */
-        if(first_comp->n > 0)
-          return FALSE;
-        else
-          /* 0 <= 0 */
-          continue;
-      }
 
-      g_assert(first_comp->id == second_comp->id);
-      if(first_comp->n > second_comp->n)
-        return FALSE;
-    }
+    if(first_n > second->ns[second_pos])
+      return FALSE;
   }
 
   return TRUE;
@@ -635,7 +835,6 @@ guint
 inf_adopted_state_vector_vdiff(const InfAdoptedStateVector* first,
                                const InfAdoptedStateVector* second)
 {
-  gsize n;
   guint first_sum;
   guint second_sum;
 
@@ -644,13 +843,8 @@ inf_adopted_state_vector_vdiff(const InfAdoptedStateVector* first,
     0
   );
 
-  first_sum = 0;
-  second_sum = 0;
-
-  for(n = 0; n < first->size; ++ n)
-    first_sum += first->data[n].n;
-  for(n = 0; n < second->size; ++ n)
-    second_sum += second->data[n].n;
+  first_sum = inf_adopted_state_vector_sum(first);
+  second_sum = inf_adopted_state_vector_sum(second);
 
   g_assert(second_sum >= first_sum);
   return second_sum - first_sum;
@@ -670,7 +864,6 @@ inf_adopted_state_vector_to_string(const InfAdoptedStateVector* vec)
 {
   GString* str;
   gsize pos;
-  InfAdoptedStateVectorComponent* component;
 
   g_return_val_if_fail(vec != NULL, NULL);
 
@@ -678,14 +871,12 @@ inf_adopted_state_vector_to_string(const InfAdoptedStateVector* vec)
 
   for(pos = 0; pos < vec->size; ++pos)
   {
-    component = vec->data + pos;
-
-    if(component->n > 0)
+    if(vec->ns[pos] > 0)
     {
       if(str->len > 0)
         g_string_append_c(str, ';');
 
-      g_string_append_printf(str, "%u:%u", component->id, component->n);
+      g_string_append_printf(str, "%u:%u", vec->ids[pos], vec->ns[pos]);
     }
   }
 
@@ -735,7 +926,7 @@ inf_adopted_state_vector_from_string(const gchar* str,
     }
 
     pos = inf_adopted_state_vector_find_insert_pos(vec, id);
-    if(pos < vec->size && vec->data[pos].id == id)
+    if(pos < vec->size && vec->ids[pos] == id)
     {
       g_set_error(
         error,
@@ -794,8 +985,7 @@ inf_adopted_state_vector_to_string_diff(const InfAdoptedStateVector* vec,
 {
   gsize vec_pos;
   gsize orig_pos;
-  InfAdoptedStateVectorComponent* vec_comp;
-  InfAdoptedStateVectorComponent* orig_comp;
+  guint orig_n;
   GString* str;
 
   g_return_val_if_fail(vec != NULL, NULL);
@@ -806,62 +996,38 @@ inf_adopted_state_vector_to_string_diff(const InfAdoptedStateVector* vec,
     NULL
   );
 
-  g_assert(vec->data != NULL || vec->size == 0);
-
   str = g_string_sized_new(vec->size * 12);
-  vec_pos = 0;
+  orig_pos = 0;
 
-  for(orig_pos = 0; orig_pos < orig->size; ++orig_pos)
+  for(vec_pos = 0; vec_pos < vec->size; ++vec_pos)
   {
-    orig_comp = orig->data + orig_pos;
-    if(orig_comp->n == 0) continue;
-
-    g_assert(vec_pos < vec->size);
-    vec_comp = vec->data + vec_pos;
-    while(vec_comp->id < orig_comp->id)
+    while(orig_pos < orig->size && orig->ids[orig_pos] < vec->ids[vec_pos])
     {
-      /* There does not seem to be a corresponding entry in orig_comp, so
-       * it is implicitely zero. */
-      if(str->len > 0) g_string_append_c(str, ';');
-      g_string_append_printf(str, "%u:%u", vec_comp->id, vec_comp->n);
-
-      ++vec_pos;
-
-      g_assert(vec_pos < vec->size);
-      vec_comp = vec->data + vec_pos;
+      /* Otherwise the inf_adopted_state_vector_causally_before test above
+       * should not have passed. */
+      g_assert(orig->ns[orig_pos] == 0);
+      ++orig_pos;
     }
 
-    /* Otherwise the inf_adopted_state_vector_causally_before test above
-     * should not have passed since orig_comp->n is not 0. */
-    g_assert(vec_comp->id == orig_comp->id);
-    g_assert(vec_comp->n >= orig_comp->n);
+    /* Components that have no counterpart in orig are implicitely zero
+     * there. */
+    if(orig_pos < orig->size && orig->ids[orig_pos] == vec->ids[vec_pos])
+      orig_n = orig->ns[orig_pos++];
+    else
+      orig_n = 0;
+
+    g_assert(vec->ns[vec_pos] >= orig_n);
 
-    if(vec_comp->n > orig_comp->n)
+    if(vec->ns[vec_pos] > orig_n)
     {
       if(str->len > 0) g_string_append_c(str, ';');
       g_string_append_printf(
         str,
         "%u:%u",
-        vec_comp->id,
-        vec_comp->n - orig_comp->n
+        vec->ids[vec_pos],
+        vec->ns[vec_pos] - orig_n
       );
     }
-
-    ++vec_pos;
-  }
-
-  /* All remaining components in vec have no counterpart in orig, meaning
-   * their values in orig are implicitely zero. */
-  while(vec_pos < vec->size)
-  {
-    vec_comp = vec->data + vec_pos;
-    if (vec_comp->n > 0)
-    {
-      if(str->len > 0) g_string_append_c(str, ';');
-      g_string_append_printf(str, "%u:%u", vec_comp->id, vec_comp->n);
-    }
-
-    ++vec_pos;
   }
 
   return g_string_free(str, FALSE);
@@ -885,67 +1051,64 @@ inf_adopted_state_vector_from_string_diff(const gchar* str,
                                           const InfAdoptedStateVector* orig,
                                           GError** error)
 {
+  InfAdoptedStateVector* diff;
   InfAdoptedStateVector* vec;
-  gsize vec_pos;
+  gsize diff_pos;
   gsize orig_pos;
-  InfAdoptedStateVectorComponent* vec_comp;
-  InfAdoptedStateVectorComponent* orig_comp;
 
   g_return_val_if_fail(str != NULL, NULL);
   g_return_val_if_fail(orig != NULL, NULL);
 
-  vec = inf_adopted_state_vector_from_string(str, error);
-  if(vec == NULL) return NULL;
+  diff = inf_adopted_state_vector_from_string(str, error);
+  if(diff == NULL) return NULL;
+
+  /* Merge diff and orig. Components of orig are kept even if they are
+   * zero, so that the result has the same layout as orig if the diff does
+   * not introduce new IDs, which allows fast comparisons between them. */
+  vec = inf_adopted_state_vector_new();
+  inf_adopted_state_vector_reserve(vec, diff->size + orig->size);
 
-  vec_pos = 0;
+  diff_pos = 0;
+  orig_pos = 0;
 
-  for(orig_pos = 0; orig_pos < orig->size; ++orig_pos)
+  while(diff_pos < diff->size || orig_pos < orig->size)
   {
-    orig_comp = orig->data + orig_pos;
-    if(orig_comp->n == 0) continue;
+    if(diff_pos == diff->size ||
+       (orig_pos < orig->size && orig->ids[orig_pos] < diff->ids[diff_pos]))
+    {
+      inf_adopted_state_vector_append(
+        vec,
+        orig->ids[orig_pos],
+        orig->ns[orig_pos]
+      );
 
-    if(vec_pos == vec->size)
+      ++orig_pos;
+    }
+    else if(orig_pos == orig->size ||
+            diff->ids[diff_pos] < orig->ids[orig_pos])
     {
-      inf_adopted_state_vector_insert(
+      inf_adopted_state_vector_append(
         vec,
-        orig_comp->id,
-        orig_comp->n,
-        vec_pos
+        diff->ids[diff_pos],
+        diff->ns[diff_pos]
       );
+
+      ++diff_pos;
     }
     else
     {
-      vec_comp = vec->data + vec_pos;
-      while(vec_comp->id < orig_comp->id)
-      {
-        ++vec_pos;
-        if(vec_pos < vec->size)
-        {
-          vec_comp = vec->data + vec_pos;
-        }
-        else
-        {
-          break;
-        }
-      }
+      inf_adopted_state_vector_append(
+        vec,
+        orig->ids[orig_pos],
+        orig->ns[orig_pos] + diff->ns[diff_pos]
+      );
 
-      if(vec_comp->id == orig_comp->id)
-      {
-        vec_comp->n += orig_comp->n;
-        ++vec_pos;
-      }
-      else
-      {
-        inf_adopted_state_vector_insert(
-          vec,
-          orig_comp->id,
-          orig_comp->n,
-          vec_pos
-        );
-      }
+      ++orig_pos;
+      ++diff_pos;
     }
   }
 
+  inf_adopted_state_vector_free(diff);
   return vec;
 }
 
@@ -82,6 +82,11 @@ guint
 inf_adopted_state_vector_get(const InfAdoptedStateVector* vec,
                              guint id);
 
+guint
+inf_adopted_state_vector_get_slot(const InfAdoptedStateVector* vec,
+                                  guint id,
+                                  guint slot);
+
 void
 inf_adopted_state_vector_set(InfAdoptedStateVector* vec,
                              guint id,
@@ -101,6 +106,9 @@ int
 inf_adopted_state_vector_compare(const InfAdoptedStateVector* first,
                                  const InfAdoptedStateVector* second);
 
+guint
+inf_adopted_state_vector_hash(const InfAdoptedStateVector* vec);
+
 gboolean
 inf_adopted_state_vector_causally_before(const InfAdoptedStateVector* first,
                                          const InfAdoptedStateVector* second);
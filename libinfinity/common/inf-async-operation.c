@@ -26,16 +26,19 @@
  *
  * #InfAsyncOperation is a simple mechanism to run some code in a separate
  * worker thread and then, once the result is computed, notify the main thread
- * about the result.
+ * about the result. The worker threads are shared with the rest of
+ * libinfinity, see #InfThreadPool.
  **/
 
 #include <libinfinity/common/inf-async-operation.h>
+#include <libinfinity/common/inf-thread-pool.h>
 #include <libinfinity/inf-i18n.h>
 
 struct _InfAsyncOperation {
   InfIo* io;
   InfIoDispatch* dispatch;
-  GThread* thread;
+  InfThreadPoolJob job;
+  gboolean started;
   GMutex mutex;
 
   InfAsyncOperationRunFunc run_func;
@@ -64,14 +67,14 @@ inf_async_operation_dispatch(gpointer data)
 
   op->run_data = NULL;
   op->run_notify = NULL;
-  op->thread = NULL;
+  op->started = FALSE;
   g_mutex_clear(&op->mutex);
 
   inf_async_operation_free(op);
 }
 
-static gpointer
-inf_async_operation_thread_start(gpointer data)
+static void
+inf_async_operation_job_func(gpointer data)
 {
   InfAsyncOperation* op;
   op = (InfAsyncOperation*)data;
@@ -99,11 +102,8 @@ inf_async_operation_thread_start(gpointer data)
 
     g_mutex_unlock(&op->mutex);
     g_mutex_clear(&op->mutex);
-    g_thread_unref(op->thread);
     g_slice_free(InfAsyncOperation, op);
   }
-
-  return NULL;
 }
 
 static void
@@ -169,7 +169,7 @@ inf_async_operation_new(InfIo* io,
 
   op->io = io;
   op->dispatch = NULL;
-  op->thread = NULL;
+  op->started = FALSE;
 
   op->run_func = run_func;
   op->done_func = done_func;
@@ -193,9 +193,11 @@ inf_async_operation_new(InfIo* io,
  * @error: Location to store error information, if any.
  *
  * Starts the operation given in @op. The operation must have been created
- * before with inf_async_operation_new(). If the operation cannot be started,
- * @error is set and %FALSE is returned. In that case, the operation must not
- * be used anymore since it will be automatically freed.
+ * before with inf_async_operation_new(). It is queued in the default
+ * #InfThreadPool and runs as soon as a worker thread is available. If the
+ * operation cannot be started, @error is set and %FALSE is returned. In that
+ * case, the operation must not be used anymore since it will be
+ * automatically freed.
  *
  * Returns: %TRUE on success or %FALSE if the operation could not be started.
  */
@@ -204,19 +206,20 @@ inf_async_operation_start(InfAsyncOperation* op,
                           GError** error)
 {
   g_return_val_if_fail(op != NULL, FALSE);
-  g_return_val_if_fail(op->thread == NULL, FALSE);
+  g_return_val_if_fail(op->started == FALSE, FALSE);
 
   g_mutex_init(&op->mutex);
   g_mutex_lock(&op->mutex);
 
-  op->thread = g_thread_try_new(
-    "InfAsyncOperation",
-    inf_async_operation_thread_start,
+  op->started = inf_thread_pool_push(
+    inf_thread_pool_get_default(),
+    &op->job,
+    inf_async_operation_job_func,
     op,
     error
   );
 
-  if(op->thread == NULL)
+  if(op->started == FALSE)
   {
     g_mutex_unlock(&op->mutex);
     g_mutex_clear(&op->mutex);
@@ -242,7 +245,16 @@ inf_async_operation_free(InfAsyncOperation* op)
 {
   g_return_if_fail(op != NULL);
 
-  if(op->thread == NULL)
+  if(op->started == TRUE &&
+     inf_thread_pool_cancel(inf_thread_pool_get_default(), &op->job))
+  {
+    /* The operation was still waiting for a worker thread, so it never
+     * ran. Treat it as if it had not been started. */
+    g_mutex_clear(&op->mutex);
+    op->started = FALSE;
+  }
+
+  if(op->started == FALSE)
   {
     /* The async operation has not started yet,
      * or it has finished (dispatched) already. */
@@ -287,7 +299,6 @@ inf_async_operation_free(InfAsyncOperation* op)
 
       g_mutex_unlock(&op->mutex);
       g_mutex_clear(&op->mutex);
-      g_thread_unref(op->thread);
       g_slice_free(InfAsyncOperation, op);
     }
   }
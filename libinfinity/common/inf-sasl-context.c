@@ -32,7 +32,12 @@
  * to give control back to a main loop while waiting for user input.
  *
  * This wrapper makes sure the callback is called in another thread so that it
- * can block without affecting the rest of the program.
+ * can block without affecting the rest of the program. Each call to
+ * inf_sasl_context_session_feed() is processed by a worker thread of the
+ * default #InfThreadPool. While the step waits for a property to be
+ * provided, its thread does not count towards the limit of the pool, so
+ * that sessions waiting for user input do not keep other work from running.
+ * Between steps, a session does not use any thread.
  * Use inf_sasl_context_session_feed() as a replacement for gsasl_step64().
  * Instead of returning the result data directly, the function calls a
  * callback once all properties requested have been provided.
@@ -45,6 +50,7 @@
 
 #include <libinfinity/common/inf-sasl-context.h>
 #include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-thread-pool.h>
 #include <libinfinity/common/inf-error.h>
 
 #include <string.h>
@@ -55,7 +61,6 @@ typedef enum _InfSaslContextMessageType {
   /* main -> session */
   INF_SASL_CONTEXT_MESSAGE_TERMINATE,
   INF_SASL_CONTEXT_MESSAGE_CONTINUE,
-  INF_SASL_CONTEXT_MESSAGE_STEP,
 
   /* session -> main */
   INF_SASL_CONTEXT_MESSAGE_QUERY, /* invoke callback to query a property */
@@ -80,13 +85,18 @@ struct _InfSaslContextSession {
    * need the mutex for this if InfIo would allow to set the
    * InfIoDispatch pointer before executing the dispatch. */
   InfIoDispatch* dispatch;
-  GThread* thread;
+  /* Whether a step is queued in the thread pool or running in one of its
+   * threads, protected by context mutex. The cond is signalled when the
+   * step has finished. */
+  InfThreadPoolJob job;
+  gboolean running;
+  GCond cond;
   /* This flag tells whether we are currently processing user data in the
    * helper thread. It is meant as a simple indicator in the main thread
    * whether more data can be given to the context or not. */
   gboolean stepping;
 
-  /* used in session thread only */
+  /* set when a step is queued, then used in the step's thread only */
   gchar* step64;
   InfSaslContextSessionFeedFunc feed_func;
   gpointer feed_user_data;
@@ -105,12 +115,6 @@ struct _InfSaslContextMessage {
       int retval;
     } cont;
 
-    struct {
-      gchar* data;
-      InfSaslContextSessionFeedFunc func;
-      gpointer user_data;
-    } step;
-
     struct {
       Gsasl_property prop;
     } query;
@@ -166,22 +170,6 @@ inf_sasl_context_message_continue(InfSaslContextSession* session,
   return message;
 }
 
-static InfSaslContextMessage*
-inf_sasl_context_message_step(InfSaslContextSession* session,
-                              const char* data,
-                              InfSaslContextSessionFeedFunc func,
-                              gpointer user_data)
-{
-  InfSaslContextMessage* message;
-  message = g_slice_new(InfSaslContextMessage);
-  message->type = INF_SASL_CONTEXT_MESSAGE_STEP;
-  message->session = session;
-  message->shared.step.data = data ? g_strdup(data) : NULL;
-  message->shared.step.func = func;
-  message->shared.step.user_data = user_data;
-  return message;
-}
-
 static InfSaslContextMessage*
 inf_sasl_context_message_query(InfSaslContextSession* session,
                                Gsasl_property prop)
@@ -224,9 +212,6 @@ inf_sasl_context_message_free(gpointer message_)
   case INF_SASL_CONTEXT_MESSAGE_CONTINUE:
     /* nothing to do */
     break;
-  case INF_SASL_CONTEXT_MESSAGE_STEP:
-    g_free(message->shared.step.data);
-    break;
   case INF_SASL_CONTEXT_MESSAGE_QUERY:
     /* nothing to do */
     break;
@@ -268,18 +253,6 @@ inf_sasl_context_session_message_func(gpointer user_data)
     g_assert(message->session->status == INF_SASL_CONTEXT_SESSION_INNER);
     message->session->retval = message->shared.cont.retval;
     break;
-  case INF_SASL_CONTEXT_MESSAGE_STEP:
-    /* session thread */
-    g_assert(message->session->status == INF_SASL_CONTEXT_SESSION_OUTER);
-    g_assert(message->shared.step.func != NULL);
-
-    message->session->step64 = message->shared.step.data;
-    message->session->feed_func = message->shared.step.func;
-    message->session->feed_user_data = message->shared.step.user_data;
-    message->shared.step.data = NULL; /* prevent deletion */
-
-    message->session->status = INF_SASL_CONTEXT_SESSION_INNER;
-    break;
   case INF_SASL_CONTEXT_MESSAGE_QUERY:
     /* main thread */
     g_mutex_lock(&message->session->context->mutex);
@@ -369,6 +342,12 @@ inf_sasl_context_gsasl_callback(Gsasl* gsasl,
 
   g_mutex_unlock(&session->context->mutex);
 
+  /* Providing the property might require user interaction, so do not block
+   * one of the limited threads of the pool in the meanwhile. The step
+   * cannot be suspended and queued again when the property arrives, since
+   * gsasl_step64() waits for us to return. */
+  inf_thread_pool_begin_wait(inf_thread_pool_get_default());
+
   session->retval = G_MAXINT;
   while(session->status == INF_SASL_CONTEXT_SESSION_INNER &&
         session->retval == G_MAXINT)
@@ -378,6 +357,8 @@ inf_sasl_context_gsasl_callback(Gsasl* gsasl,
     inf_sasl_context_message_free(message);
   }
 
+  inf_thread_pool_end_wait(inf_thread_pool_get_default());
+
   g_mutex_lock(&session->context->mutex);
 
   /* return on terminate */
@@ -388,94 +369,76 @@ inf_sasl_context_gsasl_callback(Gsasl* gsasl,
   return session->retval;
 }
 
-static void*
-inf_sasl_context_thread_func(gpointer data)
+static void
+inf_sasl_context_session_job_func(gpointer data)
 {
   InfSaslContextSession* session;
-  InfSaslContextMessage* message;
-
-  session = (InfSaslContextSession*)data;
+  InfSaslContext* context;
 
   int retval;
   char* output;
   InfSaslContextSessionFeedFunc feed_func;
   gpointer feed_user_data;
 
-  /* Wait for something to do */
-  while(session->status != INF_SASL_CONTEXT_SESSION_TERMINATE)
-  {
-    switch(session->status)
-    {
-    case INF_SASL_CONTEXT_SESSION_OUTER:
-      message = g_async_queue_pop(session->session_queue);
-      inf_sasl_context_session_message_func(message);
-      inf_sasl_context_message_free(message);
-      break;
-    case INF_SASL_CONTEXT_SESSION_INNER:
-      g_mutex_lock(&session->context->mutex);
+  session = (InfSaslContextSession*)data;
+  context = session->context;
 
-      g_assert(session->dispatch == NULL);
+  g_mutex_lock(&context->mutex);
 
-      /* This might call the gsasl callback once or more in which we wait
-       * for input from the main thread. */
-      retval = gsasl_step64(
-        session->session,
-        session->step64,
-        &output
-      );
+  g_assert(session->status == INF_SASL_CONTEXT_SESSION_OUTER);
+  g_assert(session->dispatch == NULL);
+  session->status = INF_SASL_CONTEXT_SESSION_INNER;
+
+  /* This might call the gsasl callback once or more in which we wait
+   * for input from the main thread. */
+  retval = gsasl_step64(
+    session->session,
+    session->step64,
+    &output
+  );
 
-      g_mutex_unlock(&session->context->mutex);
-
-      g_free(session->step64);
-      session->step64 = NULL;
-
-      if(retval != GSASL_OK && retval != GSASL_NEEDS_MORE)
-        output = NULL;
-
-      /* Only process the result when we were not requested to terminate
-       * within the gsasl callback. */
-      if(session->status != INF_SASL_CONTEXT_SESSION_TERMINATE)
-      {
-        feed_func = session->feed_func;
-        feed_user_data = session->feed_user_data;
-        session->feed_func = NULL; /* clear, so that feed can be called again */
-
-        session->status = INF_SASL_CONTEXT_SESSION_OUTER;
-
-        g_mutex_lock(&session->context->mutex);
-
-        g_assert(session->dispatch == NULL);
-
-        session->dispatch = inf_io_add_dispatch(
-          INF_IO(session->main_io),
-          inf_sasl_context_session_message_func,
-          inf_sasl_context_message_stepped(
-            session,
-            output,
-            retval,
-            feed_func,
-            feed_user_data
-          ),
-          inf_sasl_context_message_free
-        );
-
-        g_mutex_unlock(&session->context->mutex);
-      }
-      else
-      {
-        session->feed_func = NULL;
-        if(output) gsasl_free(output);
-      }
+  g_free(session->step64);
+  session->step64 = NULL;
 
-      break;
-    case INF_SASL_CONTEXT_SESSION_TERMINATE:
-    default:
-      g_assert_not_reached();
-      break;
-    }
+  if(retval != GSASL_OK && retval != GSASL_NEEDS_MORE)
+    output = NULL;
+
+  /* Only process the result when we were not requested to terminate
+   * within the gsasl callback. */
+  if(session->status != INF_SASL_CONTEXT_SESSION_TERMINATE)
+  {
+    feed_func = session->feed_func;
+    feed_user_data = session->feed_user_data;
+    session->feed_func = NULL; /* clear, so that feed can be called again */
+
+    session->status = INF_SASL_CONTEXT_SESSION_OUTER;
+
+    g_assert(session->dispatch == NULL);
+
+    session->dispatch = inf_io_add_dispatch(
+      INF_IO(session->main_io),
+      inf_sasl_context_session_message_func,
+      inf_sasl_context_message_stepped(
+        session,
+        output,
+        retval,
+        feed_func,
+        feed_user_data
+      ),
+      inf_sasl_context_message_free
+    );
+  }
+  else
+  {
+    session->feed_func = NULL;
+    if(output) gsasl_free(output);
   }
 
-  return NULL;
+  /* The session may be stopped as soon as we release the mutex, so it must
+   * not be accessed anymore afterwards. */
+  session->running = FALSE;
+  g_cond_broadcast(&session->cond);
+  g_mutex_unlock(&context->mutex);
 }
 
 /*
@@ -486,8 +449,7 @@ static InfSaslContextSession*
 inf_sasl_context_start_session(InfSaslContext* context,
                                InfIo* io,
                                Gsasl_session* gsasl_session,
-                               gpointer session_data,
-                               GError** error)
+                               gpointer session_data)
 {
   InfSaslContextSession* session;
   session = g_slice_new(InfSaslContextSession);
@@ -500,7 +462,8 @@ inf_sasl_context_start_session(InfSaslContext* context,
   session->session_queue =
     g_async_queue_new_full(inf_sasl_context_message_free);
   session->dispatch = NULL;
-  session->thread = NULL;
+  session->running = FALSE;
+  g_cond_init(&session->cond);
   session->stepping = FALSE;
 
   session->status = INF_SASL_CONTEXT_SESSION_OUTER;
@@ -512,22 +475,6 @@ inf_sasl_context_start_session(InfSaslContext* context,
   context->sessions = g_slist_prepend(context->sessions, session);
   gsasl_session_hook_set(gsasl_session, session);
 
-  session->thread = g_thread_try_new(
-    "InfSaslContext",
-    inf_sasl_context_thread_func,
-    session,
-    error
-  );
-
-  if(session->thread == NULL)
-  {
-    context->sessions = g_slist_remove(context->sessions, session);
-    g_async_queue_unref(session->session_queue);
-    g_object_unref(session->main_io);
-    g_slice_free(InfSaslContextSession, session);
-    return NULL;
-  }
-
   return session;
 }
 
@@ -720,17 +667,9 @@ inf_sasl_context_client_start_session(InfSaslContext* context,
     context,
     io,
     gsasl_session,
-    session_data,
-    error
+    session_data
   );
 
-  if(session == NULL)
-  {
-    gsasl_finish(gsasl_session);
-    g_mutex_unlock(&context->mutex);
-    return NULL;
-  }
-
   g_mutex_unlock(&context->mutex);
   return session;
 }
@@ -872,17 +811,9 @@ inf_sasl_context_server_start_session(InfSaslContext* context,
     context,
     io,
     gsasl_session,
-    session_data,
-    error
+    session_data
   );
 
-  if(session == NULL)
-  {
-    gsasl_finish(gsasl_session);
-    g_mutex_unlock(&context->mutex);
-    return NULL;
-  }
-
   g_mutex_unlock(&context->mutex);
   return session;
 }
@@ -973,17 +904,28 @@ inf_sasl_context_stop_session(InfSaslContext* context,
   g_mutex_lock(&context->mutex);
   g_return_if_fail(g_slist_find(context->sessions, session) != NULL);
   g_return_if_fail(session->context == context);
-  g_mutex_unlock(&context->mutex);
 
-  /* Tell client thread to terminate */
-  g_async_queue_push(
-    session->session_queue,
-    inf_sasl_context_message_terminate(session)
-  );
+  /* If the current step is still waiting for a worker thread, then we can
+   * simply drop it. */
+  if(session->running == TRUE &&
+     inf_thread_pool_cancel(inf_thread_pool_get_default(), &session->job))
+  {
+    session->running = FALSE;
+  }
 
-  g_thread_join(session->thread);
+  if(session->running == TRUE)
+  {
+    /* Tell the step to terminate, and wait until it has finished. This
+     * releases the mutex, so that the step can make progress. */
+    g_async_queue_push(
+      session->session_queue,
+      inf_sasl_context_message_terminate(session)
+    );
+
+    while(session->running == TRUE)
+      g_cond_wait(&session->cond, &context->mutex);
+  }
 
-  g_mutex_lock(&context->mutex);
   if(session->dispatch != NULL)
     inf_io_remove_dispatch(session->main_io, session->dispatch);
 
@@ -998,6 +940,7 @@ inf_sasl_context_stop_session(InfSaslContext* context,
 
   g_object_unref(session->main_io);
 
+  g_cond_clear(&session->cond);
   g_free(session->step64);
   g_slice_free(InfSaslContextSession, session);
 }
@@ -1090,6 +1033,9 @@ inf_sasl_context_session_continue(InfSaslContextSession* session,
  * finished, @func is called with output data to send to the remote side to
  * be fed to its session counterpart.
  *
+ * The data is processed in a worker thread of the default #InfThreadPool.
+ * If no thread can be started for it, @func is called with an error.
+ *
  * This function must not be called again before @func was called.
  */
 void
@@ -1098,6 +1044,8 @@ inf_sasl_context_session_feed(InfSaslContextSession* session,
                               InfSaslContextSessionFeedFunc func,
                               gpointer user_data)
 {
+  GError* error;
+
   g_return_if_fail(session != NULL);
   g_return_if_fail(func != NULL);
   g_return_if_fail(session->stepping == FALSE);
@@ -1105,10 +1053,45 @@ inf_sasl_context_session_feed(InfSaslContextSession* session,
 
   session->stepping = TRUE;
 
-  g_async_queue_push(
-    session->session_queue,
-    inf_sasl_context_message_step(session, data, func, user_data)
-  );
+  g_mutex_lock(&session->context->mutex);
+  g_assert(session->running == FALSE);
+  g_assert(session->dispatch == NULL);
+
+  session->step64 = g_strdup(data);
+  session->feed_func = func;
+  session->feed_user_data = user_data;
+  session->running = TRUE;
+
+  error = NULL;
+  if(!inf_thread_pool_push(inf_thread_pool_get_default(),
+                           &session->job,
+                           inf_sasl_context_session_job_func,
+                           session,
+                           &error))
+  {
+    /* Report the failure asynchronously, as if the step had failed */
+    g_error_free(error);
+
+    g_free(session->step64);
+    session->step64 = NULL;
+    session->feed_func = NULL;
+    session->running = FALSE;
+
+    session->dispatch = inf_io_add_dispatch(
+      INF_IO(session->main_io),
+      inf_sasl_context_session_message_func,
+      inf_sasl_context_message_stepped(
+        session,
+        NULL,
+        GSASL_MALLOC_ERROR,
+        func,
+        user_data
+      ),
+      inf_sasl_context_message_free
+    );
+  }
+
+  g_mutex_unlock(&session->context->mutex);
 }
 
 /**
@@ -37,12 +37,19 @@
  * instead which implements the #InfIo interface. For the GTK+ toolkit, there
  * is #InfGtkIo in the libinfgtk library, to integrate with the Glib main
  * loop.
+ *
+ * On Linux, #InfStandaloneIo waits for file descriptors with epoll, so that
+ * the cost of a wakeup only depends on the number of sockets that are ready,
+ * not on the number of sockets being watched. On other platforms, or if
+ * epoll is not available, poll() is used. Setting the environment variable
+ * <envar>LIBINFINITY_STANDALONE_IO_BACKEND</envar> to "poll" before an
+ * #InfStandaloneIo is created forces the use of poll().
  */
 
 #include <libinfinity/common/inf-standalone-io.h>
 #include <libinfinity/common/inf-io.h>
 
-/* TODO: Modularize the FD handling, then add epoll support */
+#include "config.h"
 
 #ifdef G_OS_WIN32
 # include <winsock2.h>
@@ -50,6 +57,9 @@
 # include <poll.h>
 # include <errno.h>
 # include <unistd.h>
+# ifdef HAVE_EPOLL
+#  include <sys/epoll.h>
+# endif
 #endif /* !G_OS_WIN32 */
 
 #include <string.h>
@@ -62,18 +72,30 @@ static const InfStandaloneIoPollResult INF_STANDALONE_IO_POLL_TIMEOUT =
   WSA_WAIT_TIMEOUT;
 static const InfStandaloneIoPollTimeout INF_STANDALONE_IO_POLL_INFINITE =
   WSA_INFINITE;
-#define inf_standalone_io_poll(events, num_events, timeout) \
-  ((num_events) == 0 ? \
+#define inf_standalone_io_poll(priv, timeout) \
+  ((priv)->fd_size == 0 ? \
     (Sleep(timeout), WSA_WAIT_TIMEOUT) : \
-    (WSAWaitForMultipleEvents(num_events, events, FALSE, timeout, TRUE)))
+    (WSAWaitForMultipleEvents( \
+      (priv)->fd_size, (priv)->events, FALSE, timeout, TRUE)))
 #else
 typedef struct pollfd InfStandaloneIoNativeEvent;
 typedef int InfStandaloneIoPollTimeout;
 typedef int InfStandaloneIoPollResult;
 static const InfStandaloneIoPollResult INF_STANDALONE_IO_POLL_TIMEOUT = 0;
 static const InfStandaloneIoPollTimeout INF_STANDALONE_IO_POLL_INFINITE = -1;
-#define inf_standalone_io_poll(events, num_events, timeout) \
-  (poll(events, (nfds_t)num_events, timeout))
+
+/* The pollfd array always holds the file descriptors and the events being
+ * watched. The backend decides how to wait for them: the poll backend
+ * passes the whole array to poll(), the epoll backend mirrors it into an
+ * epoll instance and only looks at the descriptors reported by the kernel. */
+typedef enum _InfStandaloneIoBackend {
+  INF_STANDALONE_IO_BACKEND_POLL,
+  INF_STANDALONE_IO_BACKEND_EPOLL
+} InfStandaloneIoBackend;
+
+/* Maximum number of events fetched with a single epoll_wait() call. Events
+ * not processed in one iteration are processed in the following ones. */
+#define INF_STANDALONE_IO_EPOLL_EVENTS 64
 #endif
 
 struct _InfIoWatch {
@@ -93,8 +115,12 @@ struct _InfIoWatch {
 };
 
 struct _InfIoTimeout {
-  GTimeVal begin;
-  guint msecs;
+  /* Time at which the timeout elapses, in microseconds on the monotonic
+   * clock, so that changes of the system time do not affect it. */
+  gint64 expiration;
+  /* Position in the timeouts heap */
+  guint index;
+
   InfIoTimeoutFunc func;
   gpointer user_data;
   GDestroyNotify notify;
@@ -117,11 +143,34 @@ struct _InfStandaloneIoPrivate {
   /* this array has fd_size-1 entries and fd_alloc-1 allocations: */
   InfIoWatch** watches;
 
-  GList* timeouts;
+  /* Binary min-heap ordered by expiration time, with n_timeouts entries
+   * and timeouts_alloc allocations. */
+  InfIoTimeout** timeouts;
+  guint n_timeouts;
+  guint timeouts_alloc;
+
   GList* dispatchs;
 
 #ifndef G_OS_WIN32
   int wakeup_pipe[2];
+  InfStandaloneIoBackend backend;
+#endif
+
+#ifdef HAVE_EPOLL
+  int epoll_fd;
+
+  /* Events reported by the last epoll_wait() call which have not yet been
+   * processed are at ready[ready_pos] to ready[n_ready - 1]. The data
+   * pointer is the watch, or NULL for the wakeup pipe. Entries whose watch
+   * has been removed in the meanwhile have their events set to 0. */
+  struct epoll_event ready[INF_STANDALONE_IO_EPOLL_EVENTS];
+  guint n_ready;
+  guint ready_pos;
+
+  /* Watches removed by another thread during epoll_wait(). The kernel might
+   * report events for them with a pointer to the watch, so they are only
+   * freed once epoll_wait() has returned. */
+  GSList* disposed_watches;
 #endif
 
   gboolean polling;
@@ -155,18 +204,387 @@ G_DEFINE_TYPE_WITH_CODE(InfStandaloneIo, inf_standalone_io, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfStandaloneIo)
   G_IMPLEMENT_INTERFACE(INF_TYPE_IO, inf_standalone_io_io_iface_init))
 
-static guint
-inf_standalone_io_timeval_diff(GTimeVal* first,
-                               GTimeVal* second)
+static void
+inf_standalone_io_timeouts_set(InfStandaloneIoPrivate* priv,
+                               guint index,
+                               InfIoTimeout* timeout)
+{
+  priv->timeouts[index] = timeout;
+  timeout->index = index;
+}
+
+static void
+inf_standalone_io_timeouts_sift_up(InfStandaloneIoPrivate* priv,
+                                   guint index)
+{
+  InfIoTimeout* timeout;
+  guint parent;
+
+  timeout = priv->timeouts[index];
+  while(index > 0)
+  {
+    parent = (index - 1) / 2;
+    if(priv->timeouts[parent]->expiration <= timeout->expiration)
+      break;
+
+    inf_standalone_io_timeouts_set(priv, index, priv->timeouts[parent]);
+    index = parent;
+  }
+
+  inf_standalone_io_timeouts_set(priv, index, timeout);
+}
+
+static void
+inf_standalone_io_timeouts_sift_down(InfStandaloneIoPrivate* priv,
+                                     guint index)
+{
+  InfIoTimeout* timeout;
+  guint child;
+
+  timeout = priv->timeouts[index];
+  for(;;)
+  {
+    child = 2 * index + 1;
+    if(child >= priv->n_timeouts)
+      break;
+
+    if(child + 1 < priv->n_timeouts &&
+       priv->timeouts[child + 1]->expiration <
+       priv->timeouts[child]->expiration)
+    {
+      ++child;
+    }
+
+    if(timeout->expiration <= priv->timeouts[child]->expiration)
+      break;
+
+    inf_standalone_io_timeouts_set(priv, index, priv->timeouts[child]);
+    index = child;
+  }
+
+  inf_standalone_io_timeouts_set(priv, index, timeout);
+}
+
+static void
+inf_standalone_io_timeouts_insert(InfStandaloneIoPrivate* priv,
+                                  InfIoTimeout* timeout)
+{
+  if(priv->n_timeouts == priv->timeouts_alloc)
+  {
+    priv->timeouts_alloc *= 2;
+
+    priv->timeouts = g_realloc(
+      priv->timeouts,
+      priv->timeouts_alloc * sizeof(InfIoTimeout*)
+    );
+  }
+
+  priv->timeouts[priv->n_timeouts] = timeout;
+  ++priv->n_timeouts;
+
+  inf_standalone_io_timeouts_sift_up(priv, priv->n_timeouts - 1);
+}
+
+static void
+inf_standalone_io_timeouts_remove(InfStandaloneIoPrivate* priv,
+                                  guint index)
+{
+  InfIoTimeout* last;
+
+  --priv->n_timeouts;
+  if(index != priv->n_timeouts)
+  {
+    /* Move the last timeout into the gap, and then restore the heap
+     * property, in whichever direction it is violated. */
+    last = priv->timeouts[priv->n_timeouts];
+    inf_standalone_io_timeouts_set(priv, index, last);
+
+    inf_standalone_io_timeouts_sift_down(priv, index);
+    inf_standalone_io_timeouts_sift_up(priv, last->index);
+  }
+}
+
+/* Runs the callback of a watch. Call this only with the mutex locked. */
+static void
+inf_standalone_io_run_watch(InfStandaloneIoPrivate* priv,
+                            InfIoWatch* watch,
+                            InfIoEvent events)
+{
+  /* protect from removing the watch object via
+   * inf_io_remove_watch() when running the callback. */
+  watch->executing = TRUE;
+  g_mutex_unlock(&priv->mutex);
+
+  watch->func(watch->socket, events, watch->user_data);
+
+  g_mutex_lock(&priv->mutex);
+  watch->executing = FALSE;
+  if(watch->disposed == TRUE)
+  {
+    g_mutex_unlock(&priv->mutex);
+    if(watch->notify) watch->notify(watch->user_data);
+    g_slice_free(InfIoWatch, watch);
+    g_mutex_lock(&priv->mutex);
+  }
+}
+
+#ifndef G_OS_WIN32
+#ifdef HAVE_EPOLL
+static gboolean
+inf_standalone_io_epoll_ctl(InfStandaloneIoPrivate* priv,
+                            int op,
+                            InfIoWatch* watch)
+{
+  struct epoll_event event;
+
+  /* EPOLLERR and EPOLLHUP are always reported, just as POLLERR and POLLHUP
+   * are with poll(). */
+  event.events = 0;
+  if(watch->event->events & POLLIN)
+    event.events |= EPOLLIN;
+  if(watch->event->events & POLLOUT)
+    event.events |= EPOLLOUT;
+  if(watch->event->events & POLLPRI)
+    event.events |= EPOLLPRI;
+
+  event.data.ptr = watch;
+  if(epoll_ctl(priv->epoll_fd, op, watch->event->fd, &event) == -1)
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+inf_standalone_io_epoll_remove(InfStandaloneIoPrivate* priv,
+                               InfIoWatch* watch)
+{
+  guint i;
+  int fd;
+
+  /* Drop events for the watch which have been fetched but not yet
+   * processed, the watch is going to be freed. */
+  for(i = priv->ready_pos; i < priv->n_ready; ++i)
+    if(priv->ready[i].data.ptr == watch)
+      priv->ready[i].events = 0;
+
+  /* If the socket has been closed already then the kernel has removed it
+   * from the epoll set by itself. In that case, the file descriptor number
+   * might have been reused for another watch already, so make sure not to
+   * remove that one instead. */
+  fd = watch->event->fd;
+  if(*watch->socket != fd)
+    return;
+
+  for(i = 1; i < priv->fd_size; ++i)
+    if(priv->watches[i-1] != watch && priv->events[i].fd == fd)
+      return;
+
+  if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1 &&
+     errno != EBADF && errno != ENOENT)
+  {
+    g_warning("epoll_ctl() failed: %s", strerror(errno));
+  }
+}
+
+/* Frees the watches which have been removed while epoll_wait() was running,
+ * after dropping the events it reported for them. Call this only with the
+ * mutex locked, after n_ready has been set. */
+static void
+inf_standalone_io_epoll_free_disposed(InfStandaloneIoPrivate* priv)
+{
+  GSList* disposed;
+  GSList* item;
+  InfIoWatch* watch;
+  guint i;
+
+  if(priv->disposed_watches == NULL)
+    return;
+
+  disposed = priv->disposed_watches;
+  priv->disposed_watches = NULL;
+
+  for(item = disposed; item != NULL; item = item->next)
+    for(i = priv->ready_pos; i < priv->n_ready; ++i)
+      if(priv->ready[i].data.ptr == item->data)
+        priv->ready[i].events = 0;
+
+  g_mutex_unlock(&priv->mutex);
+
+  for(item = disposed; item != NULL; item = item->next)
+  {
+    watch = (InfIoWatch*)item->data;
+    if(watch->notify) watch->notify(watch->user_data);
+    g_slice_free(InfIoWatch, watch);
+  }
+
+  g_slist_free(disposed);
+  g_mutex_lock(&priv->mutex);
+}
+#endif
+
+static InfStandaloneIoPollResult
+inf_standalone_io_poll(InfStandaloneIoPrivate* priv,
+                       InfStandaloneIoPollTimeout timeout)
+{
+#ifdef HAVE_EPOLL
+  if(priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL)
+  {
+    return epoll_wait(
+      priv->epoll_fd,
+      priv->ready,
+      INF_STANDALONE_IO_EPOLL_EVENTS,
+      timeout
+    );
+  }
+#endif
+
+  return poll(priv->events, (nfds_t)priv->fd_size, timeout);
+}
+
+/* Returns the next event reported by the last call to
+ * inf_standalone_io_poll(), or FALSE if there are no more. watch is set to
+ * NULL for the wakeup pipe. */
+static gboolean
+inf_standalone_io_next_event(InfStandaloneIoPrivate* priv,
+                             InfIoWatch** watch,
+                             InfIoEvent* events)
+{
+  guint i;
+#ifdef HAVE_EPOLL
+  struct epoll_event* event;
+
+  if(priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL)
+  {
+    while(priv->ready_pos < priv->n_ready)
+    {
+      event = &priv->ready[priv->ready_pos++];
+      if(event->events == 0)
+        continue;
+
+      *watch = event->data.ptr;
+      *events = 0;
+      if(event->events & EPOLLIN)
+        *events |= INF_IO_INCOMING;
+      if(event->events & EPOLLOUT)
+        *events |= INF_IO_OUTGOING;
+      if(event->events & (EPOLLERR | EPOLLPRI | EPOLLHUP))
+        *events |= INF_IO_ERROR;
+
+      /* The watch might have been updated by a callback which ran after
+       * the events had been fetched. */
+      if(*watch != NULL)
+      {
+        if(~(*watch)->event->events & POLLIN)
+          *events &= ~INF_IO_INCOMING;
+        if(~(*watch)->event->events & POLLOUT)
+          *events &= ~INF_IO_OUTGOING;
+      }
+
+      if(*events != 0)
+        return TRUE;
+    }
+
+    return FALSE;
+  }
+#endif
+
+  for(i = 0; i < priv->fd_size; ++ i)
+  {
+    if(priv->events[i].revents != 0)
+    {
+      *events = 0;
+      if(priv->events[i].revents & POLLIN)
+        *events |= INF_IO_INCOMING;
+      if(priv->events[i].revents & POLLOUT)
+        *events |= INF_IO_OUTGOING;
+      /* We treat POLLPRI as error because it should not occur in
+       * infinote. */
+      if(priv->events[i].revents & (POLLERR | POLLPRI | POLLHUP | POLLNVAL))
+        *events |= INF_IO_ERROR;
+
+      priv->events[i].revents = 0;
+
+      if(i == 0)
+        *watch = NULL;
+      else
+        *watch = priv->watches[i-1];
+
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+inf_standalone_io_read_wakeup(InfStandaloneIoPrivate* priv,
+                              InfIoEvent events)
+{
+  ssize_t ret;
+  char buf[1];
+
+  /* we were not polling for outgoing */
+  g_assert(~events & INF_IO_OUTGOING);
+  if(events & INF_IO_ERROR)
+  {
+    /* TODO: Read error from FD? */
+    g_warning("Error condition on wakeup pipe");
+    /* TODO: Is there anything we could do here?
+     * Try to re-establish pipe? */
+  }
+  else
+  {
+    ret = read(priv->wakeup_pipe[0], &buf, 1);
+    if(ret == -1)
+    {
+      g_warning(
+        "read() on wakeup pipe failed: %s",
+        strerror(errno)
+      );
+
+      /* TODO: Is there anything we could do here?
+       * Try to re-establish pipe? */
+    }
+    else if(ret == 0)
+    {
+      g_warning("Wakeup pipe received EOF");
+      /* TODO: Is there anything we could do here?
+       * Try to re-establish pipe? */
+    }
+    else
+    {
+      /* this is what we send as wakeup call */
+      g_assert(buf[0] == 'c');
+    }
+  }
+}
+
+/* Processes the events reported by the last call to
+ * inf_standalone_io_poll() until one watch has been run. Returns whether a
+ * watch was run. Call this only with the mutex locked. */
+static gboolean
+inf_standalone_io_process_events(InfStandaloneIoPrivate* priv)
 {
-  g_assert(first->tv_sec > second->tv_sec ||
-           (first->tv_sec == second->tv_sec &&
-            first->tv_usec >= second->tv_usec));
+  InfIoWatch* watch;
+  InfIoEvent events;
+
+  while(inf_standalone_io_next_event(priv, &watch, &events))
+  {
+    if(watch == NULL)
+    {
+      /* wakeup call */
+      inf_standalone_io_read_wakeup(priv, events);
+    }
+    else
+    {
+      inf_standalone_io_run_watch(priv, watch, events);
+      return TRUE;
+    }
+  }
 
-  /* Don't risk overflow, don't need to convert to signed int */
-  return (first->tv_sec - second->tv_sec) * 1000 +
-         (first->tv_usec+500)/1000 - (second->tv_usec+500)/1000;
+  return FALSE;
 }
+#endif
 
 /* Run one iteration of the main loop. Call this only with the mutex locked
  * and a local reference added to io. */
@@ -175,57 +593,66 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
                                  InfStandaloneIoPollTimeout timeout)
 {
   InfStandaloneIoPrivate* priv;
-  InfIoEvent events;
   InfStandaloneIoPollResult result;
-  guint i;
 
-  GList* item;
-  GTimeVal current;
-  InfIoWatch* watch;
+  gint64 current;
+  gint64 remaining;
   InfIoTimeout* cur_timeout;
   InfIoDispatch* dispatch;
-  guint elapsed;
 
 #ifdef G_OS_WIN32
+  InfIoEvent events;
+  InfIoWatch* watch;
+  guint i;
   gchar* error_message;
   WSANETWORKEVENTS wsa_events;
   const InfStandaloneIoEventTableEntry* entry;
-#else
-  ssize_t ret;
-  char buf[1];
 #endif
 
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
+#ifdef HAVE_EPOLL
+  /* If the previous epoll_wait() call reported more events than have been
+   * processed so far, then process the next one before asking the kernel
+   * again. */
+  if(priv->ready_pos < priv->n_ready)
+    if(inf_standalone_io_process_events(priv))
+      return;
+
+  priv->n_ready = 0;
+  priv->ready_pos = 0;
+#endif
+
   /* Find number of milliseconds to wait */
   if(priv->dispatchs != NULL)
   {
     /* TODO: Don't even poll */
     timeout = 0;
   }
-  else
+  else if(priv->n_timeouts > 0)
   {
-    g_get_current_time(&current);
-    for(item = priv->timeouts; item != NULL; item = g_list_next(item))
-    {
-      cur_timeout = (InfIoTimeout*)item->data;
-      elapsed = inf_standalone_io_timeval_diff(&current, &cur_timeout->begin);
+    /* The first timeout in the heap is the one to elapse next */
+    current = g_get_monotonic_time();
+    cur_timeout = priv->timeouts[0];
 
-      if(elapsed >= cur_timeout->msecs)
-      {
-        /* already elapsed */
-        /* TODO: Don't even poll */
-        timeout = 0;
-        /* no need to check other timeouts */
-        break;
-      }
-      else
+    if(cur_timeout->expiration <= current)
+    {
+      /* already elapsed */
+      /* TODO: Don't even poll */
+      timeout = 0;
+    }
+    else
+    {
+      /* Round up, so that we don't wake up just before the timeout
+       * elapses and then need to poll again. */
+      remaining = (cur_timeout->expiration - current + 999) / 1000;
+      if(remaining > G_MAXINT)
+        remaining = G_MAXINT;
+
+      if(timeout == INF_STANDALONE_IO_POLL_INFINITE ||
+         (guint)remaining < (guint)timeout)
       {
-        if(timeout == INF_STANDALONE_IO_POLL_INFINITE ||
-           cur_timeout->msecs - elapsed < (guint)timeout)
-        {
-          timeout = cur_timeout->msecs - elapsed;
-        }
+        timeout = remaining;
       }
     }
   }
@@ -233,11 +660,20 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
   priv->polling = TRUE;
   g_mutex_unlock(&priv->mutex);
 
-  result = inf_standalone_io_poll(priv->events, priv->fd_size, timeout);
+  result = inf_standalone_io_poll(priv, timeout);
 
   g_mutex_lock(&priv->mutex);
   priv->polling = FALSE;
 
+#ifdef HAVE_EPOLL
+  if(priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL)
+  {
+    if(result > 0)
+      priv->n_ready = result;
+    inf_standalone_io_epoll_free_disposed(priv);
+  }
+#endif
+
 #ifdef G_OS_WIN32
   switch(result)
   {
@@ -255,7 +691,14 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
   if(result == -1)
   {
     if(errno != EINTR)
-      g_warning("poll() failed: %s\n", strerror(errno));
+    {
+      g_warning(
+        "%s failed: %s\n",
+        priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL ?
+          "epoll_wait()" : "poll()",
+        strerror(errno)
+      );
+    }
 
     return;
   }
@@ -264,24 +707,20 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
   if(result == INF_STANDALONE_IO_POLL_TIMEOUT)
   {
     /* No file descriptor is active, so check whether a timeout elapsed */
-    g_get_current_time(&current);
-    for(item = priv->timeouts; item != NULL; item = g_list_next(item))
+    if(priv->n_timeouts > 0 &&
+       priv->timeouts[0]->expiration <= g_get_monotonic_time())
     {
-      cur_timeout = (InfIoTimeout*)item->data;
-      elapsed = inf_standalone_io_timeval_diff(&current, &cur_timeout->begin);
-      if(elapsed >= cur_timeout->msecs)
-      {
-        priv->timeouts = g_list_delete_link(priv->timeouts, item);
-        g_mutex_unlock(&priv->mutex);
+      cur_timeout = priv->timeouts[0];
+      inf_standalone_io_timeouts_remove(priv, 0);
+      g_mutex_unlock(&priv->mutex);
 
-        cur_timeout->func(cur_timeout->user_data);
-        if(cur_timeout->notify)
-          cur_timeout->notify(cur_timeout->user_data);
-        g_slice_free(InfIoTimeout, cur_timeout);
+      cur_timeout->func(cur_timeout->user_data);
+      if(cur_timeout->notify)
+        cur_timeout->notify(cur_timeout->user_data);
+      g_slice_free(InfIoTimeout, cur_timeout);
 
-        g_mutex_lock(&priv->mutex);
-        return;
-      }
+      g_mutex_lock(&priv->mutex);
+      return;
     }
   }
 #ifdef G_OS_WIN32
@@ -321,112 +760,15 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
         }
       }
 
-      /* protect from removing the watch object via
-       * inf_io_remove_watch() when running the callback. */
-      watch->executing = TRUE;
-      g_mutex_unlock(&priv->mutex);
-
-      watch->func(watch->socket, events, watch->user_data);
-
-      g_mutex_lock(&priv->mutex);
-      watch->executing = FALSE;
-      if(watch->disposed == TRUE)
-      {
-        g_mutex_unlock(&priv->mutex);
-        if(watch->notify) watch->notify(watch->user_data);
-        g_slice_free(InfIoWatch, watch);
-        g_mutex_lock(&priv->mutex);
-      }
-
+      inf_standalone_io_run_watch(priv, watch, events);
       return;
     }
   }
 #else
   else if(result > 0)
   {
-    while(result--)
-    {
-      for(i = 0; i < priv->fd_size; ++ i)
-      {
-        if(priv->events[i].revents != 0)
-        {
-          events = 0;
-          if(priv->events[i].revents & POLLIN)
-            events |= INF_IO_INCOMING;
-          if(priv->events[i].revents & POLLOUT)
-            events |= INF_IO_OUTGOING;
-          /* We treat POLLPRI as error because it should not occur in
-           * infinote. */
-          if(priv->events[i].revents & (POLLERR | POLLPRI | POLLHUP | POLLNVAL))
-            events |= INF_IO_ERROR;
-
-          priv->events[i].revents = 0;
-
-          if(i == 0)
-          {
-            /* wakeup call */
-
-            /* we were not polling for outgoing */
-            g_assert(~events & INF_IO_OUTGOING);
-            if(events & INF_IO_ERROR)
-            {
-              /* TODO: Read error from FD? */
-              g_warning("Error condition on wakeup pipe");
-              /* TODO: Is there anything we could do here?
-               * Try to re-establish pipe? */
-            }
-            else
-            {
-              ret = read(priv->events[0].fd, &buf, 1);
-              if(ret == -1)
-              {
-                g_warning(
-                  "read() on wakeup pipe failed: %s",
-                  strerror(errno)
-                );
-
-                /* TODO: Is there anything we could do here?
-                 * Try to re-establish pipe? */
-              }
-              else if(ret == 0)
-              {
-                g_warning("Wakeup pipe received EOF");
-                /* TODO: Is there anything we could do here?
-                 * Try to re-establish pipe? */
-              }
-              else
-              {
-                /* this is what we send as wakeup call */
-                g_assert(buf[0] == 'c');
-              }
-            }
-          }
-          else
-          {
-            watch = priv->watches[i-1];
-
-            /* protect from removing the watch object via
-             * inf_io_remove_watch() when running the callback. */
-            watch->executing = TRUE;
-            g_mutex_unlock(&priv->mutex);
-
-            watch->func(watch->socket, events, watch->user_data);
-
-            g_mutex_lock(&priv->mutex);
-            watch->executing = FALSE;
-            if(watch->disposed == TRUE)
-            {
-              g_mutex_unlock(&priv->mutex);
-              if(watch->notify) watch->notify(watch->user_data);
-              g_slice_free(InfIoWatch, watch);
-              g_mutex_lock(&priv->mutex);
-            }
-
-            return;
-          }
-        }
-      }
-    }
+    if(inf_standalone_io_process_events(priv))
+      return;
   }
 #endif
 
@@ -455,6 +797,11 @@ inf_standalone_io_init(InfStandaloneIo* io)
   gchar* error_message;
 #endif
 
+#ifdef HAVE_EPOLL
+  const gchar* backend;
+  struct epoll_event event;
+#endif
+
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   g_mutex_init(&priv->mutex);
@@ -489,10 +836,46 @@ inf_standalone_io_init(InfStandaloneIo* io)
     priv->events[0].revents = 0;
     ++priv->fd_size;
   }
+
+  priv->backend = INF_STANDALONE_IO_BACKEND_POLL;
+#endif
+
+#ifdef HAVE_EPOLL
+  priv->epoll_fd = -1;
+  priv->n_ready = 0;
+  priv->ready_pos = 0;
+  priv->disposed_watches = NULL;
+
+  backend = g_getenv("LIBINFINITY_STANDALONE_IO_BACKEND");
+  if(backend == NULL || strcmp(backend, "poll") != 0)
+  {
+    /* Fall back to poll() silently if epoll is not available, for example
+     * when running on an old kernel. */
+    priv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(priv->epoll_fd != -1)
+    {
+      event.events = EPOLLIN;
+      event.data.ptr = NULL;
+
+      if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_ADD, priv->wakeup_pipe[0],
+                   &event) == -1)
+      {
+        g_warning("epoll_ctl() failed: %s", strerror(errno));
+        close(priv->epoll_fd);
+        priv->epoll_fd = -1;
+      }
+      else
+      {
+        priv->backend = INF_STANDALONE_IO_BACKEND_EPOLL;
+      }
+    }
+  }
 #endif
 
   priv->watches = g_malloc(sizeof(InfIoWatch*) * (priv->fd_alloc - 1) );
-  priv->timeouts = NULL;
+  priv->n_timeouts = 0;
+  priv->timeouts_alloc = 16;
+  priv->timeouts = g_malloc(sizeof(InfIoTimeout*) * priv->timeouts_alloc);
   priv->dispatchs = NULL;
 
   priv->polling = FALSE;
@@ -541,9 +924,9 @@ inf_standalone_io_finalize(GObject* object)
     g_slice_free(InfIoWatch, watch);
   }
 
-  for(item = priv->timeouts; item != NULL; item = g_list_next(item))
+  for(i = 0; i < priv->n_timeouts; ++i)
   {
-    timeout = (InfIoTimeout*)item->data;
+    timeout = priv->timeouts[i];
     if(timeout->notify)
       timeout->notify(timeout->user_data);
     g_slice_free(InfIoTimeout, timeout);
@@ -571,7 +954,7 @@ inf_standalone_io_finalize(GObject* object)
 
   g_free(priv->events);
   g_free(priv->watches);
-  g_list_free(priv->timeouts);
+  g_free(priv->timeouts);
   g_list_free(priv->dispatchs);
 
 #ifndef G_OS_WIN32
@@ -592,6 +975,11 @@ inf_standalone_io_finalize(GObject* object)
   }
 #endif
 
+#ifdef HAVE_EPOLL
+  if(priv->epoll_fd != -1 && close(priv->epoll_fd) == -1)
+    g_warning("Failed to close epoll instance: %s", strerror(errno));
+#endif
+
   g_mutex_unlock(&priv->mutex);
   g_mutex_clear(&priv->mutex);
 
@@ -797,6 +1185,18 @@ inf_standalone_io_io_add_watch(InfIo* io,
   watch->executing = FALSE;
   watch->disposed = FALSE;
 
+#ifdef HAVE_EPOLL
+  if(priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL &&
+     !inf_standalone_io_epoll_ctl(priv, EPOLL_CTL_ADD, watch))
+  {
+    g_warning("epoll_ctl() failed: %s", strerror(errno));
+    g_slice_free(InfIoWatch, watch);
+
+    g_mutex_unlock(&priv->mutex);
+    return NULL;
+  }
+#endif
+
   priv->watches[priv->fd_size-1] = watch;
   ++priv->fd_size;
 
@@ -857,6 +1257,18 @@ inf_standalone_io_io_update_watch(InfIo* io,
     watch->event->events = pevents;
 #endif
 
+#ifdef HAVE_EPOLL
+    /* Leave the epoll set alone if the socket has been closed already,
+     * since the file descriptor might belong to another watch by now. */
+    if(priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL &&
+       *watch->socket == watch->event->fd &&
+       !inf_standalone_io_epoll_ctl(priv, EPOLL_CTL_MOD, watch) &&
+       errno != EBADF && errno != ENOENT)
+    {
+      g_warning("epoll_ctl() failed: %s", strerror(errno));
+    }
+#endif
+
     inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
   }
 
@@ -882,6 +1294,11 @@ inf_standalone_io_io_remove_watch(InfIo* io,
   watch_iter = inf_standalone_io_find_watch(INF_STANDALONE_IO(io), watch);
   if(watch_iter != NULL)
   {
+#ifdef HAVE_EPOLL
+    if(priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL)
+      inf_standalone_io_epoll_remove(priv, watch);
+#endif
+
 #ifdef G_OS_WIN32
     if(WSAEventSelect(*watch->socket, *watch->event, 0) == SOCKET_ERROR)
     {
@@ -908,6 +1325,17 @@ inf_standalone_io_io_remove_watch(InfIo* io,
        * user_data and the InfIoWatch struct. */
       watch->disposed = TRUE;
     }
+#ifdef HAVE_EPOLL
+    else if(priv->polling &&
+            priv->backend == INF_STANDALONE_IO_BACKEND_EPOLL)
+    {
+      /* The loop thread is waiting in epoll_wait(), which might return an
+       * event for this watch. Free it after epoll_wait() returned. */
+      watch->disposed = TRUE;
+      priv->disposed_watches =
+        g_slist_prepend(priv->disposed_watches, watch);
+    }
+#endif
     else
     {
       /* Free user_data */
@@ -956,14 +1384,13 @@ inf_standalone_io_io_add_timeout(InfIo* io,
   priv = INF_STANDALONE_IO_PRIVATE(io);
   timeout = g_slice_new(InfIoTimeout);
 
-  g_get_current_time(&timeout->begin);
-  timeout->msecs = msecs;
+  timeout->expiration = g_get_monotonic_time() + (gint64)msecs * 1000;
   timeout->func = func;
   timeout->user_data = user_data;
   timeout->notify = notify;
 
   g_mutex_lock(&priv->mutex);
-  priv->timeouts = g_list_prepend(priv->timeouts, timeout);
+  inf_standalone_io_timeouts_insert(priv, timeout);
   inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
   g_mutex_unlock(&priv->mutex);
 
@@ -975,16 +1402,17 @@ inf_standalone_io_io_remove_timeout(InfIo* io,
                                     InfIoTimeout* timeout)
 {
   InfStandaloneIoPrivate* priv;
-  GList* item;
 
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex);
 
-  item = g_list_find(priv->timeouts, timeout);
-  if(item != NULL)
+  /* The timeout knows its position in the heap, so there is no need to
+   * search for it. */
+  if(timeout->index < priv->n_timeouts &&
+     priv->timeouts[timeout->index] == timeout)
   {
-    priv->timeouts = g_list_delete_link(priv->timeouts, item);
+    inf_standalone_io_timeouts_remove(priv, timeout->index);
     g_mutex_unlock(&priv->mutex);
 
     if(timeout->notify)
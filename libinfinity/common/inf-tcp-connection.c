@@ -28,7 +28,13 @@
  * wrapper around a native socket object and integrates into the main loop
  * provided by #InfIo. An arbitrary amount of data can be sent with the
  * object, extra data will be buffered and automatically transmitted once
- * kernel space becomes available.
+ * kernel space becomes available. Buffered data is kept as a list of
+ * chunks which are handed to the kernel together with a single vectored
+ * send call. Data sent with inf_tcp_connection_send_bytes() is queued by
+ * reference instead of being copied. The
+ * #InfTcpConnection:send-queue-length and #InfTcpConnection:send-queue-size
+ * properties tell how much data is waiting to be sent, which can be used to
+ * stop producing more data for a slow remote host.
  *
  * The TCP connection properties should be set and then
  * inf_tcp_connection_open() be called to open a connection. If the
@@ -57,6 +63,7 @@
 #ifndef G_OS_WIN32
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/uio.h>
 # include <netinet/in.h>
 # include <net/if.h>
 # include <arpa/inet.h>
@@ -89,6 +96,28 @@ static const GEnumValue inf_tcp_connection_status_values[] = {
   }
 };
 
+/* Maximum number of chunks passed to a single send call */
+#define INF_TCP_CONNECTION_MAX_VECTOR 64
+
+/* Minimum allocation for chunks holding copied data. Small pieces of data
+ * are appended to the last chunk if it has room, so that we do not end up
+ * with many tiny chunks. */
+#define INF_TCP_CONNECTION_CHUNK_SIZE 4096
+
+/* Data passed to inf_tcp_connection_send_bytes() that is shorter than this
+ * is copied anyway, since that is cheaper than a chunk of its own. */
+#define INF_TCP_CONNECTION_COPY_LIMIT 1024
+
+typedef struct _InfTcpConnectionChunk InfTcpConnectionChunk;
+struct _InfTcpConnectionChunk {
+  /* If bytes is set, then data points into it. Otherwise data points to a
+   * buffer of alloc bytes owned by the chunk. */
+  GBytes* bytes;
+  const guint8* data;
+  gsize size;
+  gsize alloc;
+};
+
 typedef struct _InfTcpConnectionPrivate InfTcpConnectionPrivate;
 struct _InfTcpConnectionPrivate {
   InfIo* io;
@@ -106,10 +135,12 @@ struct _InfTcpConnectionPrivate {
   guint remote_port;
   unsigned int device_index;
 
-  guint8* queue;
-  gsize front_pos;
-  gsize back_pos;
-  gsize alloc;
+  /* Chunks waiting to be sent. The first send_offset bytes of the first
+   * chunk have been sent already. send_queue_size is the number of bytes
+   * that are not sent yet. */
+  GQueue send_queue;
+  gsize send_offset;
+  gsize send_queue_size;
 };
 
 enum {
@@ -127,7 +158,10 @@ enum {
   PROP_LOCAL_PORT,
 
   PROP_DEVICE_INDEX,
-  PROP_DEVICE_NAME
+  PROP_DEVICE_NAME,
+
+  PROP_SEND_QUEUE_LENGTH,
+  PROP_SEND_QUEUE_SIZE
 };
 
 enum {
@@ -269,6 +303,83 @@ inf_tcp_connection_system_error(InfTcpConnection* connection,
   g_error_free(error);
 }
 
+static void
+inf_tcp_connection_chunk_free(InfTcpConnectionChunk* chunk)
+{
+  if(chunk->bytes != NULL)
+    g_bytes_unref(chunk->bytes);
+  else
+    g_free((gpointer)chunk->data);
+
+  g_slice_free(InfTcpConnectionChunk, chunk);
+}
+
+static void
+inf_tcp_connection_clear_send_queue(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  while(!g_queue_is_empty(&priv->send_queue))
+    inf_tcp_connection_chunk_free(g_queue_pop_head(&priv->send_queue));
+
+  priv->send_offset = 0;
+  priv->send_queue_size = 0;
+}
+
+/* Queues data that could not be sent right away. If bytes is non-NULL then
+ * data points into it, and the queue keeps a reference on it instead of
+ * copying the data. */
+static void
+inf_tcp_connection_enqueue(InfTcpConnection* connection,
+                           gconstpointer data,
+                           gsize len,
+                           GBytes* bytes)
+{
+  InfTcpConnectionPrivate* priv;
+  InfTcpConnectionChunk* chunk;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  chunk = g_queue_peek_tail(&priv->send_queue);
+
+  if(bytes != NULL && len >= INF_TCP_CONNECTION_COPY_LIMIT)
+  {
+    chunk = g_slice_new(InfTcpConnectionChunk);
+    chunk->bytes = g_bytes_ref(bytes);
+    chunk->data = data;
+    chunk->size = len;
+    chunk->alloc = 0;
+
+    g_queue_push_tail(&priv->send_queue, chunk);
+  }
+  else if(chunk != NULL && chunk->bytes == NULL &&
+          chunk->alloc - chunk->size >= len)
+  {
+    /* Append to the last chunk */
+    memcpy((guint8*)chunk->data + chunk->size, data, len);
+    chunk->size += len;
+  }
+  else
+  {
+    chunk = g_slice_new(InfTcpConnectionChunk);
+    chunk->bytes = NULL;
+    chunk->alloc = MAX(len, INF_TCP_CONNECTION_CHUNK_SIZE);
+    chunk->data = g_malloc(chunk->alloc);
+    chunk->size = len;
+    memcpy((guint8*)chunk->data, data, len);
+
+    g_queue_push_tail(&priv->send_queue, chunk);
+  }
+
+  priv->send_queue_size += len;
+
+  if(~priv->events & INF_IO_OUTGOING)
+  {
+    priv->events |= INF_IO_OUTGOING;
+    inf_io_update_watch(priv->io, priv->watch, priv->events);
+  }
+}
+
 static void
 inf_tcp_connection_io(InfNativeSocket* socket,
                       InfIoEvent events,
@@ -282,8 +393,7 @@ inf_tcp_connection_connected(InfTcpConnection* connection)
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
 
   priv->status = INF_TCP_CONNECTION_CONNECTED;
-  priv->front_pos = 0;
-  priv->back_pos = 0;
+  inf_tcp_connection_clear_send_queue(connection);
 
   priv->events = INF_IO_INCOMING | INF_IO_ERROR;
 
@@ -634,6 +744,68 @@ inf_tcp_connection_send_real(InfTcpConnection* connection,
   return TRUE;
 }
 
+static void
+inf_tcp_connection_send_data(InfTcpConnection* connection,
+                             gconstpointer data,
+                             guint len,
+                             GBytes* bytes)
+{
+  InfTcpConnectionPrivate* priv;
+  gconstpointer sent_data;
+  guint sent_len;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  g_object_ref(connection);
+
+  /* Check whether we have data currently queued. If we have, then we need
+   * to wait until that data has been sent before sending the new data. */
+  if(g_queue_is_empty(&priv->send_queue))
+  {
+    /* Must not be set, because otherwise we would need something to send,
+     * but there is nothing in the queue. */
+    g_assert(~priv->events & INF_IO_OUTGOING);
+
+    /* Nothing in queue, send data directly. */
+    sent_len = len;
+    sent_data = data;
+
+    if(inf_tcp_connection_send_real(connection, data, &sent_len) == TRUE)
+    {
+      data = (const char*)data + sent_len;
+      len -= sent_len;
+    }
+    else
+    {
+      /* Sending failed. The error signal has been emitted. */
+      /* Set len to zero so that we don't enqueue data. */
+      len = 0;
+      sent_len = 0;
+    }
+  }
+  else
+  {
+    /* Nothing sent */
+    sent_len = 0;
+  }
+
+  /* If we couldn't send all the data... */
+  if(len > 0)
+    inf_tcp_connection_enqueue(connection, data, len, bytes);
+
+  if(sent_len > 0)
+  {
+    g_signal_emit(
+      G_OBJECT(connection),
+      tcp_connection_signals[SENT],
+      0,
+      sent_data,
+      sent_len
+    );
+  }
+
+  g_object_unref(connection);
+}
+
 static void
 inf_tcp_connection_io_incoming(InfTcpConnection* connection)
 {
@@ -676,6 +848,167 @@ inf_tcp_connection_io_incoming(InfTcpConnection* connection)
            (priv->status != INF_TCP_CONNECTION_CLOSED));
 }
 
+/* Sends as much of the send queue as the kernel accepts, passing up to
+ * INF_TCP_CONNECTION_MAX_VECTOR chunks to each send call. */
+static void
+inf_tcp_connection_send_queued(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+  InfTcpConnectionChunk* chunk;
+#ifdef G_OS_WIN32
+  WSABUF vector[INF_TCP_CONNECTION_MAX_VECTOR];
+  DWORD sent;
+#else
+  struct iovec vector[INF_TCP_CONNECTION_MAX_VECTOR];
+  struct msghdr msg;
+#endif
+  guint n_vector;
+  GQueue sent_chunks;
+  gsize first_offset;
+  gsize offset;
+  gsize remaining;
+  GList* item;
+  int errcode;
+  ssize_t result;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  g_assert(priv->status == INF_TCP_CONNECTION_CONNECTED);
+  g_assert(!g_queue_is_empty(&priv->send_queue));
+
+  /* Chunks that have been sent completely are moved here, and reported
+   * with the sent signal once we are done. */
+  g_queue_init(&sent_chunks);
+  first_offset = priv->send_offset;
+
+  do
+  {
+    n_vector = 0;
+    offset = priv->send_offset;
+
+    for(item = priv->send_queue.head;
+        item != NULL && n_vector < INF_TCP_CONNECTION_MAX_VECTOR;
+        item = item->next)
+    {
+      chunk = (InfTcpConnectionChunk*)item->data;
+#ifdef G_OS_WIN32
+      vector[n_vector].buf = (CHAR*)chunk->data + offset;
+      vector[n_vector].len = chunk->size - offset;
+#else
+      vector[n_vector].iov_base = (void*)(chunk->data + offset);
+      vector[n_vector].iov_len = chunk->size - offset;
+#endif
+      offset = 0;
+      ++n_vector;
+    }
+
+#ifdef G_OS_WIN32
+    if(WSASend(priv->socket, vector, n_vector, &sent, 0, NULL, NULL) == 0)
+      result = sent;
+    else
+      result = -1;
+#else
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = vector;
+    msg.msg_iovlen = n_vector;
+    result = sendmsg(priv->socket, &msg, INF_NATIVE_SOCKET_SENDRECV_FLAGS);
+#endif
+
+    /* Preserve error code so that it is not modified by future calls */
+    errcode = INF_NATIVE_SOCKET_LAST_ERROR;
+
+    if(result < 0 &&
+       errcode != INF_NATIVE_SOCKET_EINTR &&
+       errcode != INF_NATIVE_SOCKET_EAGAIN)
+    {
+      while(!g_queue_is_empty(&sent_chunks))
+        inf_tcp_connection_chunk_free(g_queue_pop_head(&sent_chunks));
+
+      inf_tcp_connection_system_error(connection, errcode);
+      return;
+    }
+    else if(result == 0)
+    {
+      while(!g_queue_is_empty(&sent_chunks))
+        inf_tcp_connection_chunk_free(g_queue_pop_head(&sent_chunks));
+
+      inf_tcp_connection_close(connection);
+      return;
+    }
+    else if(result > 0)
+    {
+      priv->send_queue_size -= result;
+
+      remaining = result;
+      while(remaining > 0)
+      {
+        chunk = (InfTcpConnectionChunk*)g_queue_peek_head(&priv->send_queue);
+        if(remaining < chunk->size - priv->send_offset)
+        {
+          priv->send_offset += remaining;
+          remaining = 0;
+        }
+        else
+        {
+          remaining -= chunk->size - priv->send_offset;
+          priv->send_offset = 0;
+
+          g_queue_push_tail(
+            &sent_chunks,
+            g_queue_pop_head(&priv->send_queue)
+          );
+        }
+      }
+    }
+  } while( !g_queue_is_empty(&priv->send_queue) &&
+           (result > 0 || errcode == INF_NATIVE_SOCKET_EINTR) );
+
+  if(g_queue_is_empty(&priv->send_queue))
+  {
+    /* sent everything */
+    priv->events &= ~INF_IO_OUTGOING;
+    inf_io_update_watch(priv->io, priv->watch, priv->events);
+  }
+
+  /* Report the sent data, unless a signal handler closes the connection
+   * in between. Note that the partially sent chunk stays in the queue, so
+   * it is only valid as long as the connection is open. */
+  offset = first_offset;
+  for(item = sent_chunks.head; item != NULL; item = item->next)
+  {
+    chunk = (InfTcpConnectionChunk*)item->data;
+
+    if(priv->status == INF_TCP_CONNECTION_CONNECTED)
+    {
+      g_signal_emit(
+        G_OBJECT(connection),
+        tcp_connection_signals[SENT],
+        0,
+        chunk->data + offset,
+        (guint)(chunk->size - offset)
+      );
+    }
+
+    offset = 0;
+  }
+
+  if(priv->status == INF_TCP_CONNECTION_CONNECTED &&
+     priv->send_offset > offset)
+  {
+    chunk = (InfTcpConnectionChunk*)g_queue_peek_head(&priv->send_queue);
+
+    g_signal_emit(
+      G_OBJECT(connection),
+      tcp_connection_signals[SENT],
+      0,
+      chunk->data + offset,
+      (guint)(priv->send_offset - offset)
+    );
+  }
+
+  while(!g_queue_is_empty(&sent_chunks))
+    inf_tcp_connection_chunk_free(g_queue_pop_head(&sent_chunks));
+}
+
 static void
 inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
 {
@@ -684,9 +1017,6 @@ inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
   socklen_t len;
   int errcode;
 
-  gconstpointer data;
-  guint data_len;
-
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
   switch(priv->status)
   {
@@ -709,35 +1039,8 @@ inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
 
     break;
   case INF_TCP_CONNECTION_CONNECTED:
-    g_assert(priv->back_pos < priv->front_pos);
     g_assert(priv->events & INF_IO_OUTGOING);
-
-    data = priv->queue + priv->back_pos;
-    data_len = priv->front_pos - priv->back_pos;
-    if(inf_tcp_connection_send_real(connection, data, &data_len) == TRUE)
-    {
-      priv->back_pos += data_len;
-
-      if(priv->front_pos == priv->back_pos)
-      {
-        /* sent everything */
-        priv->front_pos = 0;
-        priv->back_pos = 0;
-
-        priv->events &= ~INF_IO_OUTGOING;
-
-        inf_io_update_watch(priv->io, priv->watch, priv->events);
-      }
-
-      g_signal_emit(
-        G_OBJECT(connection),
-        tcp_connection_signals[SENT],
-        0,
-        data,
-        data_len
-      );
-    }
-
+    inf_tcp_connection_send_queued(connection);
     break;
   case INF_TCP_CONNECTION_CLOSED:
   default:
@@ -910,10 +1213,9 @@ inf_tcp_connection_init(InfTcpConnection* connection)
   priv->remote_port = 0;
   priv->device_index = 0;
 
-  priv->queue = g_malloc(1024);
-  priv->front_pos = 0;
-  priv->back_pos = 0;
-  priv->alloc = 1024;
+  g_queue_init(&priv->send_queue);
+  priv->send_offset = 0;
+  priv->send_queue_size = 0;
 }
 
 static void
@@ -954,7 +1256,7 @@ inf_tcp_connection_finalize(GObject* object)
   if(priv->socket != INVALID_SOCKET)
     closesocket(priv->socket);
 
-  g_free(priv->queue);
+  inf_tcp_connection_clear_send_queue(connection);
 
   G_OBJECT_CLASS(inf_tcp_connection_parent_class)->finalize(object);
 }
@@ -1158,6 +1460,12 @@ inf_tcp_connection_get_property(GObject* object,
     }
 #endif
     break;
+  case PROP_SEND_QUEUE_LENGTH:
+    g_value_set_uint(value, priv->send_queue.length);
+    break;
+  case PROP_SEND_QUEUE_SIZE:
+    g_value_set_uint64(value, priv->send_queue_size);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -1182,6 +1490,8 @@ inf_tcp_connection_error(InfTcpConnection* connection,
     priv->watch = NULL;
   }
 
+  inf_tcp_connection_clear_send_queue(connection);
+
   if(priv->status != INF_TCP_CONNECTION_CLOSED)
   {
     priv->status = INF_TCP_CONNECTION_CLOSED;
@@ -1331,6 +1641,48 @@ inf_tcp_connection_class_init(InfTcpConnectionClass* tcp_connection_class)
     )
   );
 
+  /**
+   * InfTcpConnection:send-queue-length:
+   *
+   * The number of buffers waiting to be sent. This property is not
+   * notified when it changes.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_SEND_QUEUE_LENGTH,
+    g_param_spec_uint(
+      "send-queue-length",
+      "Send queue length",
+      "The number of buffers waiting to be sent",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READABLE
+    )
+  );
+
+  /**
+   * InfTcpConnection:send-queue-size:
+   *
+   * The number of bytes that have been queued for sending but not yet been
+   * handed to the kernel. This property is not notified when it changes,
+   * but it only decreases when the #InfTcpConnection::sent signal is
+   * emitted.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_SEND_QUEUE_SIZE,
+    g_param_spec_uint64(
+      "send-queue-size",
+      "Send queue size",
+      "The number of bytes waiting to be sent",
+      0,
+      G_MAXUINT64,
+      0,
+      G_PARAM_READABLE
+    )
+  );
+
   /**
    * InfTcpConnection::sent:
    * @connection: The #InfTcpConnection through which the data has been sent.
@@ -1588,8 +1940,7 @@ inf_tcp_connection_close(InfTcpConnection* connection)
     priv->watch = NULL;
   }
 
-  priv->front_pos = 0;
-  priv->back_pos = 0;
+  inf_tcp_connection_clear_send_queue(connection);
 
   priv->status = INF_TCP_CONNECTION_CLOSED;
   g_object_notify(G_OBJECT(connection), "status");
@@ -1605,6 +1956,10 @@ inf_tcp_connection_close(InfTcpConnection* connection)
  * but enqueued to a buffer and will be sent as soon as kernel space
  * becomes available. The "sent" signal will be emitted when data has
  * really been sent.
+ *
+ * Data that cannot be sent right away is copied. Use
+ * inf_tcp_connection_send_bytes() to avoid the copy for large amounts of
+ * data.
  **/
 void
 inf_tcp_connection_send(InfTcpConnection* connection,
@@ -1612,8 +1967,6 @@ inf_tcp_connection_send(InfTcpConnection* connection,
                         guint len)
 {
   InfTcpConnectionPrivate* priv;
-  gconstpointer sent_data;
-  guint sent_len;
 
   g_return_if_fail(INF_IS_TCP_CONNECTION(connection));
   g_return_if_fail(len == 0 || data != NULL);
@@ -1621,91 +1974,72 @@ inf_tcp_connection_send(InfTcpConnection* connection,
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
   g_return_if_fail(priv->status == INF_TCP_CONNECTION_CONNECTED);
 
-  g_object_ref(connection);
-
-  /* Check whether we have data currently queued. If we have, then we need
-   * to wait until that data has been sent before sending the new data. */
-  if(priv->front_pos == priv->back_pos)
-  {
-    /* Must not be set, because otherwise we would need something to send,
-     * but there is nothing in the queue. */
-    g_assert(~priv->events & INF_IO_OUTGOING);
-
-    /* Nothing in queue, send data directly. */
-    sent_len = len;
-    sent_data = data;
-
-    if(inf_tcp_connection_send_real(connection, data, &sent_len) == TRUE)
-    {
-      data = (const char*)data + sent_len;
-      len -= sent_len;
-    }
-    else
-    {
-      /* Sending failed. The error signal has been emitted. */
-      /* Set len to zero so that we don't enqueue data. */
-      len = 0;
-      sent_len = 0;
-    }
-  }
-  else
-  {
-    /* Nothing sent */
-    sent_len = 0;
-  }
-
-  /* If we couldn't send all the data... */
-  if(len > 0)
-  {
-    /* If we have not enough space for the new data, move queue data back
-     * onto the beginning of the queue, if not already */
-    if(priv->alloc - priv->front_pos < len && priv->back_pos > 0)
-    {
-      memmove(
-        priv->queue,
-        priv->queue + priv->back_pos,
-        priv->front_pos - priv->back_pos
-      );
-
-      priv->front_pos -= priv->back_pos;
-      priv->back_pos = 0;
-    }
+  inf_tcp_connection_send_data(connection, data, len, NULL);
+}
 
-    /* Allocate more memory if there is still not enough space */
-    if(priv->alloc - priv->front_pos < len)
-    {
-      /* Make sure we allocate enough */
-      priv->alloc = priv->front_pos + len;
+/**
+ * inf_tcp_connection_send_bytes:
+ * @connection: A #InfTcpConnection with status %INF_TCP_CONNECTION_CONNECTED.
+ * @bytes: The data to send.
+ *
+ * Sends data through the TCP connection, like inf_tcp_connection_send().
+ * However, if the data cannot be sent immediately, then @connection keeps a
+ * reference on @bytes until it has been sent, instead of copying it. The
+ * content of @bytes must not be modified afterwards.
+ **/
+void
+inf_tcp_connection_send_bytes(InfTcpConnection* connection,
+                              GBytes* bytes)
+{
+  InfTcpConnectionPrivate* priv;
+  gconstpointer data;
+  gsize len;
 
-      /* Always allocate a multiple of 1024 */
-      if(priv->alloc % 1024 != 0)
-        priv->alloc = priv->alloc + (1024 - priv->alloc % 1024);
+  g_return_if_fail(INF_IS_TCP_CONNECTION(connection));
+  g_return_if_fail(bytes != NULL);
 
-      priv->queue = g_realloc(priv->queue, priv->alloc);
-    }
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  g_return_if_fail(priv->status == INF_TCP_CONNECTION_CONNECTED);
 
-    memcpy(priv->queue + priv->front_pos, data, len);
-    priv->front_pos += len;
+  data = g_bytes_get_data(bytes, &len);
+  g_return_if_fail(len <= G_MAXUINT);
 
-    if(~priv->events & INF_IO_OUTGOING)
-    {
-      priv->events |= INF_IO_OUTGOING;
-      inf_io_update_watch(priv->io, priv->watch, priv->events);
-    }
-  }
+  inf_tcp_connection_send_data(connection, data, len, bytes);
+}
 
-  if(sent_len > 0)
-  {
-    g_signal_emit(
-      G_OBJECT(connection),
-      tcp_connection_signals[SENT],
-      0,
-      sent_data,
-      sent_len
-    );
-  }
+/**
+ * inf_tcp_connection_get_send_queue_length:
+ * @connection: A #InfTcpConnection.
+ *
+ * Returns the number of buffers in the send queue of @connection, i.e. the
+ * number of separate pieces of memory waiting to be sent. Small pieces of
+ * data are merged into a single buffer when they are queued.
+ *
+ * Returns: The number of buffers waiting to be sent.
+ **/
+guint
+inf_tcp_connection_get_send_queue_length(InfTcpConnection* connection)
+{
+  g_return_val_if_fail(INF_IS_TCP_CONNECTION(connection), 0);
+  return INF_TCP_CONNECTION_PRIVATE(connection)->send_queue.length;
+}
 
-  g_object_unref(connection);
+/**
+ * inf_tcp_connection_get_send_queue_size:
+ * @connection: A #InfTcpConnection.
+ *
+ * Returns the number of bytes that have been passed to
+ * inf_tcp_connection_send() or inf_tcp_connection_send_bytes() but not yet
+ * to the kernel. This can be checked after the #InfTcpConnection::sent
+ * signal to decide whether to send more data.
+ *
+ * Returns: The number of bytes waiting to be sent.
+ **/
+guint64
+inf_tcp_connection_get_send_queue_size(InfTcpConnection* connection)
+{
+  g_return_val_if_fail(INF_IS_TCP_CONNECTION(connection), 0);
+  return INF_TCP_CONNECTION_PRIVATE(connection)->send_queue_size;
 }
 
 /**
@@ -131,6 +131,16 @@ inf_tcp_connection_send(InfTcpConnection* connection,
                         gconstpointer data,
                         guint len);
 
+void
+inf_tcp_connection_send_bytes(InfTcpConnection* connection,
+                              GBytes* bytes);
+
+guint
+inf_tcp_connection_get_send_queue_length(InfTcpConnection* connection);
+
+guint64
+inf_tcp_connection_get_send_queue_size(InfTcpConnection* connection);
+
 InfIpAddress*
 inf_tcp_connection_get_remote_address(InfTcpConnection* connection);
 
@@ -0,0 +1,507 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-thread-pool
+ * @title: InfThreadPool
+ * @short_description: Bounded pool of worker threads
+ * @include: libinfinity/common/inf-thread-pool.h
+ * @see_also: #InfAsyncOperation, #InfSaslContext
+ * @stability: Unstable
+ *
+ * #InfThreadPool runs functions in a limited number of worker threads.
+ * Functions are queued with inf_thread_pool_push() and run in the order
+ * they were queued. New threads are started as long as there are more
+ * queued functions than idle threads and the maximum number of threads has
+ * not been reached; threads that stay idle for a while exit again.
+ *
+ * #InfAsyncOperation and #InfSaslContext run their work in the default
+ * pool returned by inf_thread_pool_get_default(), instead of starting a new
+ * thread each time. A function that is still queued can be cancelled with
+ * inf_thread_pool_cancel().
+ *
+ * A function that needs to wait for something other than CPU or I/O, such
+ * as user input, should call inf_thread_pool_begin_wait() and
+ * inf_thread_pool_end_wait() around the wait, so that its thread does not
+ * keep other jobs from running in the meanwhile.
+ */
+
+#include <libinfinity/common/inf-thread-pool.h>
+
+/* Default for the maximum number of threads of the default pool. Most jobs
+ * are blocking DNS lookups and SASL steps, which spend their time waiting
+ * rather than computing, so this is not tied to the number of processors. */
+#define INF_THREAD_POOL_DEFAULT_MAX_THREADS 16
+
+/* Time after which an idle worker thread exits */
+#define INF_THREAD_POOL_IDLE_TIME (10 * G_TIME_SPAN_SECOND)
+
+struct _InfThreadPool {
+  /* protects all of the fields below and the jobs in the queue */
+  GMutex mutex;
+  GCond cond;
+
+  GQueue queue;
+  guint max_threads;
+  guint n_threads;
+  guint n_idle;
+  /* Threads between inf_thread_pool_begin_wait() and
+   * inf_thread_pool_end_wait(). They do not count towards max_threads. */
+  guint n_waiting;
+
+  guint peak_threads;
+  guint peak_queue_length;
+};
+
+static gpointer
+inf_thread_pool_worker_func(gpointer data)
+{
+  InfThreadPool* pool;
+  InfThreadPoolJob* job;
+  InfThreadPoolFunc func;
+  gpointer user_data;
+  gint64 end_time;
+  GList* link;
+
+  pool = (InfThreadPool*)data;
+
+  /* The thread was counted as idle when it was started */
+  g_mutex_lock(&pool->mutex);
+  for(;;)
+  {
+    end_time = g_get_monotonic_time() + INF_THREAD_POOL_IDLE_TIME;
+    while(g_queue_is_empty(&pool->queue) &&
+          pool->n_threads - pool->n_waiting <= pool->max_threads)
+    {
+      if(!g_cond_wait_until(&pool->cond, &pool->mutex, end_time))
+        break;
+    }
+
+    --pool->n_idle;
+
+    if(g_queue_is_empty(&pool->queue) ||
+       pool->n_threads - pool->n_waiting > pool->max_threads)
+    {
+      break;
+    }
+
+    link = g_queue_pop_head_link(&pool->queue);
+    job = (InfThreadPoolJob*)link->data;
+    link->data = NULL;
+
+    /* The job must not be accessed anymore once it runs, since it might be
+     * freed or queued again by the function itself. */
+    func = job->func;
+    user_data = job->user_data;
+
+    g_mutex_unlock(&pool->mutex);
+    func(user_data);
+    g_mutex_lock(&pool->mutex);
+
+    ++pool->n_idle;
+  }
+
+  --pool->n_threads;
+  g_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+/* Starts new threads until there is an idle one for each queued job or the
+ * maximum number of threads is reached. Threads that were started but did
+ * not yet pick up a job count as idle, and waiting threads are not counted
+ * at all. Requires the pool mutex to be held. */
+static gboolean
+inf_thread_pool_start_threads(InfThreadPool* pool,
+                              GError** error)
+{
+  GThread* thread;
+
+  while(pool->n_threads - pool->n_waiting < pool->max_threads &&
+        pool->queue.length > pool->n_idle)
+  {
+    thread = g_thread_try_new(
+      "InfThreadPool",
+      inf_thread_pool_worker_func,
+      pool,
+      error
+    );
+
+    if(thread == NULL)
+      return FALSE;
+
+    /* Worker threads are never joined */
+    g_thread_unref(thread);
+
+    ++pool->n_threads;
+    ++pool->n_idle;
+    if(pool->n_threads > pool->peak_threads)
+      pool->peak_threads = pool->n_threads;
+  }
+
+  return TRUE;
+}
+
+static gpointer
+inf_thread_pool_new_default(gpointer data)
+{
+  InfThreadPool* pool;
+  pool = g_slice_new(InfThreadPool);
+
+  g_mutex_init(&pool->mutex);
+  g_cond_init(&pool->cond);
+
+  g_queue_init(&pool->queue);
+  pool->max_threads = INF_THREAD_POOL_DEFAULT_MAX_THREADS;
+  pool->n_threads = 0;
+  pool->n_idle = 0;
+  pool->n_waiting = 0;
+
+  pool->peak_threads = 0;
+  pool->peak_queue_length = 0;
+
+  return pool;
+}
+
+/**
+ * inf_thread_pool_get_default:
+ *
+ * Returns the thread pool shared by all of libinfinity. It exists for the
+ * whole lifetime of the program.
+ *
+ * Returns: (transfer none): The default #InfThreadPool.
+ */
+InfThreadPool*
+inf_thread_pool_get_default(void)
+{
+  static GOnce once = G_ONCE_INIT;
+  g_once(&once, inf_thread_pool_new_default, NULL);
+  return (InfThreadPool*)once.retval;
+}
+
+/**
+ * inf_thread_pool_set_max_threads:
+ * @pool: A #InfThreadPool.
+ * @max_threads: The maximum number of worker threads, at least 1.
+ *
+ * Sets the maximum number of threads that @pool runs at the same time.
+ * Further jobs wait in the queue until a thread becomes available. If there
+ * are currently more threads running than @max_threads then the excess
+ * threads exit once they have finished their current job.
+ */
+void
+inf_thread_pool_set_max_threads(InfThreadPool* pool,
+                                guint max_threads)
+{
+  g_return_if_fail(pool != NULL);
+  g_return_if_fail(max_threads > 0);
+
+  g_mutex_lock(&pool->mutex);
+  pool->max_threads = max_threads;
+
+  /* If there are jobs waiting then we might be allowed to start more
+   * threads now. This only fails if a thread could not be created, in
+   * which case the existing threads process the queue. */
+  inf_thread_pool_start_threads(pool, NULL);
+
+  /* Wake up idle threads so that they exit if there are too many */
+  g_cond_broadcast(&pool->cond);
+  g_mutex_unlock(&pool->mutex);
+}
+
+/**
+ * inf_thread_pool_get_max_threads:
+ * @pool: A #InfThreadPool.
+ *
+ * Returns the maximum number of threads that @pool runs at the same time.
+ *
+ * Returns: The maximum number of worker threads.
+ */
+guint
+inf_thread_pool_get_max_threads(InfThreadPool* pool)
+{
+  guint max_threads;
+
+  g_return_val_if_fail(pool != NULL, 0);
+
+  g_mutex_lock(&pool->mutex);
+  max_threads = pool->max_threads;
+  g_mutex_unlock(&pool->mutex);
+
+  return max_threads;
+}
+
+/**
+ * inf_thread_pool_get_n_threads:
+ * @pool: A #InfThreadPool.
+ *
+ * Returns the number of worker threads of @pool that are currently running,
+ * including idle ones and ones between inf_thread_pool_begin_wait() and
+ * inf_thread_pool_end_wait().
+ *
+ * Returns: The current number of worker threads.
+ */
+guint
+inf_thread_pool_get_n_threads(InfThreadPool* pool)
+{
+  guint n_threads;
+
+  g_return_val_if_fail(pool != NULL, 0);
+
+  g_mutex_lock(&pool->mutex);
+  n_threads = pool->n_threads;
+  g_mutex_unlock(&pool->mutex);
+
+  return n_threads;
+}
+
+/**
+ * inf_thread_pool_get_peak_threads:
+ * @pool: A #InfThreadPool.
+ *
+ * Returns the highest number of worker threads that @pool was running at
+ * the same time since it was created. This can exceed the maximum number of
+ * threads if jobs called inf_thread_pool_begin_wait().
+ *
+ * Returns: The peak number of worker threads.
+ */
+guint
+inf_thread_pool_get_peak_threads(InfThreadPool* pool)
+{
+  guint peak_threads;
+
+  g_return_val_if_fail(pool != NULL, 0);
+
+  g_mutex_lock(&pool->mutex);
+  peak_threads = pool->peak_threads;
+  g_mutex_unlock(&pool->mutex);
+
+  return peak_threads;
+}
+
+/**
+ * inf_thread_pool_get_queue_length:
+ * @pool: A #InfThreadPool.
+ *
+ * Returns the number of jobs in @pool that are waiting for a thread to run
+ * them. Jobs that are currently running are not included.
+ *
+ * Returns: The number of queued jobs.
+ */
+guint
+inf_thread_pool_get_queue_length(InfThreadPool* pool)
+{
+  guint length;
+
+  g_return_val_if_fail(pool != NULL, 0);
+
+  g_mutex_lock(&pool->mutex);
+  length = pool->queue.length;
+  g_mutex_unlock(&pool->mutex);
+
+  return length;
+}
+
+/**
+ * inf_thread_pool_get_peak_queue_length:
+ * @pool: A #InfThreadPool.
+ *
+ * Returns the highest number of jobs that were waiting in the queue of
+ * @pool at the same time since it was created.
+ *
+ * Returns: The peak number of queued jobs.
+ */
+guint
+inf_thread_pool_get_peak_queue_length(InfThreadPool* pool)
+{
+  guint length;
+
+  g_return_val_if_fail(pool != NULL, 0);
+
+  g_mutex_lock(&pool->mutex);
+  length = pool->peak_queue_length;
+  g_mutex_unlock(&pool->mutex);
+
+  return length;
+}
+
+/**
+ * inf_thread_pool_push:
+ * @pool: A #InfThreadPool.
+ * @job: Uninitialized storage for the job, valid until @func runs or the
+ * job is cancelled.
+ * @func: (scope async): The function to run in a worker thread.
+ * @user_data: Additional data to pass to @func.
+ * @error: Location to store error information, if any.
+ *
+ * Queues @func to be run in one of the worker threads of @pool. If all
+ * threads are busy and no more threads can be started, then @func runs as
+ * soon as one of the threads has finished its current job.
+ *
+ * @job is used by @pool to keep track of the queued function. It can be
+ * passed to inf_thread_pool_cancel() to remove the function from the queue
+ * before it runs. @pool does not access @job anymore once @func has been
+ * called, so it can be pushed again from within @func.
+ *
+ * If no thread can be started to run @func, then @error is set and %FALSE is
+ * returned. In that case @func is not run.
+ *
+ * Returns: %TRUE on success or %FALSE if @func cannot be run.
+ */
+gboolean
+inf_thread_pool_push(InfThreadPool* pool,
+                     InfThreadPoolJob* job,
+                     InfThreadPoolFunc func,
+                     gpointer user_data,
+                     GError** error)
+{
+  GError* local_error;
+
+  g_return_val_if_fail(pool != NULL, FALSE);
+  g_return_val_if_fail(job != NULL, FALSE);
+  g_return_val_if_fail(func != NULL, FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  job->link.data = job;
+  job->link.prev = NULL;
+  job->link.next = NULL;
+  job->func = func;
+  job->user_data = user_data;
+
+  g_mutex_lock(&pool->mutex);
+
+  g_queue_push_tail_link(&pool->queue, &job->link);
+  if(pool->queue.length > pool->peak_queue_length)
+    pool->peak_queue_length = pool->queue.length;
+
+  local_error = NULL;
+  if(!inf_thread_pool_start_threads(pool, &local_error))
+  {
+    /* If there are other threads, then one of them will pick up the job
+     * eventually. Otherwise, nobody can run it. */
+    if(pool->n_threads == 0)
+    {
+      g_queue_unlink(&pool->queue, &job->link);
+      job->link.data = NULL;
+
+      g_mutex_unlock(&pool->mutex);
+      g_propagate_error(error, local_error);
+      return FALSE;
+    }
+
+    g_error_free(local_error);
+  }
+
+  if(pool->n_idle > 0)
+    g_cond_signal(&pool->cond);
+
+  g_mutex_unlock(&pool->mutex);
+  return TRUE;
+}
+
+/**
+ * inf_thread_pool_cancel:
+ * @pool: A #InfThreadPool.
+ * @job: A #InfThreadPoolJob pushed into @pool with inf_thread_pool_push().
+ *
+ * Removes @job from the queue of @pool if its function has not started
+ * running yet. If it returns %TRUE then the function will not be run, and
+ * @job is no longer used by @pool. If it returns %FALSE then the function
+ * is already running or has finished, and the caller needs to synchronize
+ * with it by other means.
+ *
+ * Returns: %TRUE if the job was cancelled, or %FALSE if it was not queued.
+ */
+gboolean
+inf_thread_pool_cancel(InfThreadPool* pool,
+                       InfThreadPoolJob* job)
+{
+  gboolean queued;
+
+  g_return_val_if_fail(pool != NULL, FALSE);
+  g_return_val_if_fail(job != NULL, FALSE);
+
+  g_mutex_lock(&pool->mutex);
+
+  queued = (job->link.data != NULL);
+  if(queued)
+  {
+    g_queue_unlink(&pool->queue, &job->link);
+    job->link.data = NULL;
+  }
+
+  g_mutex_unlock(&pool->mutex);
+  return queued;
+}
+
+/**
+ * inf_thread_pool_begin_wait:
+ * @pool: A #InfThreadPool.
+ *
+ * Tells @pool that the calling job is going to wait for an event which
+ * might take arbitrarily long, such as user input. Until the job calls
+ * inf_thread_pool_end_wait(), its thread does not count towards the maximum
+ * number of threads of @pool, so that a new thread can be started for
+ * queued jobs if necessary.
+ *
+ * This function must only be called from a function run by @pool, and
+ * every call must be followed by a call to inf_thread_pool_end_wait() from
+ * the same function.
+ */
+void
+inf_thread_pool_begin_wait(InfThreadPool* pool)
+{
+  g_return_if_fail(pool != NULL);
+
+  g_mutex_lock(&pool->mutex);
+  ++pool->n_waiting;
+
+  /* A thread is available for queued jobs now. If it cannot be started,
+   * then the queued jobs run once an existing thread is done. */
+  inf_thread_pool_start_threads(pool, NULL);
+
+  g_mutex_unlock(&pool->mutex);
+}
+
+/**
+ * inf_thread_pool_end_wait:
+ * @pool: A #InfThreadPool.
+ *
+ * Tells @pool that the calling job has finished waiting after a call to
+ * inf_thread_pool_begin_wait(). Its thread counts towards the maximum number
+ * of threads again. If this makes @pool exceed its maximum number of
+ * threads, then the job still finishes, but the thread exits afterwards.
+ */
+void
+inf_thread_pool_end_wait(InfThreadPool* pool)
+{
+  g_return_if_fail(pool != NULL);
+
+  g_mutex_lock(&pool->mutex);
+  g_assert(pool->n_waiting > 0);
+  --pool->n_waiting;
+
+  /* Wake up idle threads so that they exit if there are too many */
+  if(pool->n_threads - pool->n_waiting > pool->max_threads)
+    g_cond_broadcast(&pool->cond);
+
+  g_mutex_unlock(&pool->mutex);
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,102 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_THREAD_POOL_H__
+#define __INF_THREAD_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * InfThreadPoolFunc:
+ * @user_data: Data passed in inf_thread_pool_push().
+ *
+ * This function is run in one of the worker threads of a #InfThreadPool.
+ */
+typedef void(*InfThreadPoolFunc)(gpointer user_data);
+
+/**
+ * InfThreadPool: (foreign)
+ *
+ * #InfThreadPool is an opaque data type and should only be accessed via
+ * the public API functions.
+ */
+typedef struct _InfThreadPool InfThreadPool;
+
+/**
+ * InfThreadPoolJob:
+ *
+ * A #InfThreadPoolJob represents a function queued to run in a
+ * #InfThreadPool. It is allocated by the caller, typically as part of a
+ * larger structure, and is not accessed by the pool anymore once the
+ * function starts running. It has no public fields.
+ */
+typedef struct _InfThreadPoolJob InfThreadPoolJob;
+struct _InfThreadPoolJob {
+  /*< private >*/
+  GList link;
+  InfThreadPoolFunc func;
+  gpointer user_data;
+};
+
+InfThreadPool*
+inf_thread_pool_get_default(void);
+
+void
+inf_thread_pool_set_max_threads(InfThreadPool* pool,
+                                guint max_threads);
+
+guint
+inf_thread_pool_get_max_threads(InfThreadPool* pool);
+
+guint
+inf_thread_pool_get_n_threads(InfThreadPool* pool);
+
+guint
+inf_thread_pool_get_peak_threads(InfThreadPool* pool);
+
+guint
+inf_thread_pool_get_queue_length(InfThreadPool* pool);
+
+guint
+inf_thread_pool_get_peak_queue_length(InfThreadPool* pool);
+
+gboolean
+inf_thread_pool_push(InfThreadPool* pool,
+                     InfThreadPoolJob* job,
+                     InfThreadPoolFunc func,
+                     gpointer user_data,
+                     GError** error);
+
+gboolean
+inf_thread_pool_cancel(InfThreadPool* pool,
+                       InfThreadPoolJob* job);
+
+void
+inf_thread_pool_begin_wait(InfThreadPool* pool);
+
+void
+inf_thread_pool_end_wait(InfThreadPool* pool);
+
+G_END_DECLS
+
+#endif /* __INF_THREAD_POOL_H__ */
+
+/* vim:set et sw=2 ts=2: */
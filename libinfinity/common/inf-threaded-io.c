@@ -0,0 +1,639 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-threaded-io
+ * @title: InfThreadedIo
+ * @short_description: Event loops running in a pool of threads
+ * @include: libinfinity/common/inf-threaded-io.h
+ * @see_also: #InfIo, #InfStandaloneIo
+ * @stability: Unstable
+ *
+ * #InfThreadedIo runs a number of #InfStandaloneIo event loops, each of
+ * them in its own thread, so that independent work can make use of several
+ * CPU cores.
+ *
+ * libinfinity objects are not thread-safe themselves. Instead, each object
+ * is pinned to one of the loops: it is created with that loop as its #InfIo,
+ * and it is only ever accessed from the thread running the loop, i.e. from
+ * within watch, timeout and dispatch callbacks of that loop. Objects which
+ * use each other need to be pinned to the same loop. For example, a
+ * connection, the #InfCommunicationManager and browser using it, and all
+ * the sessions synchronized over it belong to one loop.
+ * inf_threaded_io_acquire_loop() chooses the loop with the fewest objects
+ * pinned to it for a new set of such objects.
+ *
+ * Work is handed over from one loop to another one with inf_io_add_dispatch()
+ * on the target loop, which is safe to call from any thread. The dispatch
+ * function then runs in the thread of the target loop.
+ *
+ * #InfThreadedIo implements the #InfIo interface itself by forwarding all
+ * calls to its first loop, so objects that are not pinned explicitly run in
+ * the thread of that loop.
+ */
+
+#include <libinfinity/common/inf-threaded-io.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-io.h>
+
+typedef struct _InfThreadedIoLoop InfThreadedIoLoop;
+struct _InfThreadedIoLoop {
+  InfStandaloneIo* io;
+  GThread* thread;
+
+  /* Number of objects pinned to this loop via
+   * inf_threaded_io_acquire_loop() */
+  guint n_pinned;
+};
+
+typedef struct _InfThreadedIoPrivate InfThreadedIoPrivate;
+struct _InfThreadedIoPrivate {
+  /* Protects the pin counts of the loops */
+  GMutex mutex;
+  /* Serializes starting and stopping the threads. This is a separate lock
+   * so that the loop threads can still pin objects while being joined. */
+  GMutex state_mutex;
+
+  InfThreadedIoLoop* loops;
+  guint n_loops;
+
+  gboolean running;
+};
+
+enum {
+  PROP_0,
+
+  PROP_N_LOOPS
+};
+
+#define INF_THREADED_IO_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_THREADED_IO, InfThreadedIoPrivate))
+
+static void inf_threaded_io_io_iface_init(InfIoInterface* iface);
+G_DEFINE_TYPE_WITH_CODE(InfThreadedIo, inf_threaded_io, G_TYPE_OBJECT,
+  G_ADD_PRIVATE(InfThreadedIo)
+  G_IMPLEMENT_INTERFACE(INF_TYPE_IO, inf_threaded_io_io_iface_init))
+
+static gpointer
+inf_threaded_io_thread_func(gpointer data)
+{
+  InfStandaloneIo* io;
+  io = INF_STANDALONE_IO(data);
+
+  inf_standalone_io_loop(io);
+  return NULL;
+}
+
+static void
+inf_threaded_io_quit_func(gpointer user_data)
+{
+  /* This runs inside the loop, so the loop is guaranteed to be running
+   * at this point, even if the thread has only just been started. */
+  inf_standalone_io_loop_quit(INF_STANDALONE_IO(user_data));
+}
+
+/* Quits and joins the threads of the first n_loops loops. Call this with
+ * the state mutex locked. */
+static void
+inf_threaded_io_stop_loops(InfThreadedIo* io,
+                           guint n_loops)
+{
+  InfThreadedIoPrivate* priv;
+  guint i;
+
+  priv = INF_THREADED_IO_PRIVATE(io);
+
+  for(i = 0; i < n_loops; ++i)
+  {
+    inf_io_add_dispatch(
+      INF_IO(priv->loops[i].io),
+      inf_threaded_io_quit_func,
+      priv->loops[i].io,
+      NULL
+    );
+  }
+
+  for(i = 0; i < n_loops; ++i)
+  {
+    g_thread_join(priv->loops[i].thread);
+    priv->loops[i].thread = NULL;
+  }
+}
+
+static void
+inf_threaded_io_init(InfThreadedIo* io)
+{
+  InfThreadedIoPrivate* priv;
+  priv = INF_THREADED_IO_PRIVATE(io);
+
+  g_mutex_init(&priv->mutex);
+  g_mutex_init(&priv->state_mutex);
+
+  priv->loops = NULL;
+  priv->n_loops = 0;
+  priv->running = FALSE;
+}
+
+static void
+inf_threaded_io_constructed(GObject* object)
+{
+  InfThreadedIoPrivate* priv;
+  guint i;
+
+  priv = INF_THREADED_IO_PRIVATE(object);
+
+  G_OBJECT_CLASS(inf_threaded_io_parent_class)->constructed(object);
+
+  if(priv->n_loops == 0)
+    priv->n_loops = g_get_num_processors();
+
+  priv->loops = g_new(InfThreadedIoLoop, priv->n_loops);
+  for(i = 0; i < priv->n_loops; ++i)
+  {
+    priv->loops[i].io = inf_standalone_io_new();
+    priv->loops[i].thread = NULL;
+    priv->loops[i].n_pinned = 0;
+  }
+}
+
+static void
+inf_threaded_io_dispose(GObject* object)
+{
+  InfThreadedIo* io;
+  InfThreadedIoPrivate* priv;
+  guint i;
+
+  io = INF_THREADED_IO(object);
+  priv = INF_THREADED_IO_PRIVATE(io);
+
+  if(inf_threaded_io_get_running(io))
+    inf_threaded_io_stop(io);
+
+  for(i = 0; i < priv->n_loops; ++i)
+  {
+    if(priv->loops[i].io != NULL)
+    {
+      g_object_unref(priv->loops[i].io);
+      priv->loops[i].io = NULL;
+    }
+  }
+
+  G_OBJECT_CLASS(inf_threaded_io_parent_class)->dispose(object);
+}
+
+static void
+inf_threaded_io_finalize(GObject* object)
+{
+  InfThreadedIoPrivate* priv;
+  priv = INF_THREADED_IO_PRIVATE(object);
+
+  g_free(priv->loops);
+  g_mutex_clear(&priv->mutex);
+  g_mutex_clear(&priv->state_mutex);
+
+  G_OBJECT_CLASS(inf_threaded_io_parent_class)->finalize(object);
+}
+
+static void
+inf_threaded_io_set_property(GObject* object,
+                             guint prop_id,
+                             const GValue* value,
+                             GParamSpec* pspec)
+{
+  InfThreadedIoPrivate* priv;
+  priv = INF_THREADED_IO_PRIVATE(object);
+
+  switch(prop_id)
+  {
+  case PROP_N_LOOPS:
+    priv->n_loops = g_value_get_uint(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_threaded_io_get_property(GObject* object,
+                             guint prop_id,
+                             GValue* value,
+                             GParamSpec* pspec)
+{
+  InfThreadedIoPrivate* priv;
+  priv = INF_THREADED_IO_PRIVATE(object);
+
+  switch(prop_id)
+  {
+  case PROP_N_LOOPS:
+    g_value_set_uint(value, priv->n_loops);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static InfIoWatch*
+inf_threaded_io_io_add_watch(InfIo* io,
+                             InfNativeSocket* socket,
+                             InfIoEvent events,
+                             InfIoWatchFunc func,
+                             gpointer user_data,
+                             GDestroyNotify notify)
+{
+  return inf_io_add_watch(
+    INF_IO(INF_THREADED_IO_PRIVATE(io)->loops[0].io),
+    socket,
+    events,
+    func,
+    user_data,
+    notify
+  );
+}
+
+static void
+inf_threaded_io_io_update_watch(InfIo* io,
+                                InfIoWatch* watch,
+                                InfIoEvent events)
+{
+  inf_io_update_watch(
+    INF_IO(INF_THREADED_IO_PRIVATE(io)->loops[0].io),
+    watch,
+    events
+  );
+}
+
+static void
+inf_threaded_io_io_remove_watch(InfIo* io,
+                                InfIoWatch* watch)
+{
+  inf_io_remove_watch(
+    INF_IO(INF_THREADED_IO_PRIVATE(io)->loops[0].io),
+    watch
+  );
+}
+
+static InfIoTimeout*
+inf_threaded_io_io_add_timeout(InfIo* io,
+                               guint msecs,
+                               InfIoTimeoutFunc func,
+                               gpointer user_data,
+                               GDestroyNotify notify)
+{
+  return inf_io_add_timeout(
+    INF_IO(INF_THREADED_IO_PRIVATE(io)->loops[0].io),
+    msecs,
+    func,
+    user_data,
+    notify
+  );
+}
+
+static void
+inf_threaded_io_io_remove_timeout(InfIo* io,
+                                  InfIoTimeout* timeout)
+{
+  inf_io_remove_timeout(
+    INF_IO(INF_THREADED_IO_PRIVATE(io)->loops[0].io),
+    timeout
+  );
+}
+
+static InfIoDispatch*
+inf_threaded_io_io_add_dispatch(InfIo* io,
+                                InfIoDispatchFunc func,
+                                gpointer user_data,
+                                GDestroyNotify notify)
+{
+  return inf_io_add_dispatch(
+    INF_IO(INF_THREADED_IO_PRIVATE(io)->loops[0].io),
+    func,
+    user_data,
+    notify
+  );
+}
+
+static void
+inf_threaded_io_io_remove_dispatch(InfIo* io,
+                                   InfIoDispatch* dispatch)
+{
+  inf_io_remove_dispatch(
+    INF_IO(INF_THREADED_IO_PRIVATE(io)->loops[0].io),
+    dispatch
+  );
+}
+
+static void
+inf_threaded_io_class_init(InfThreadedIoClass* io_class)
+{
+  GObjectClass* object_class;
+  object_class = G_OBJECT_CLASS(io_class);
+
+  object_class->constructed = inf_threaded_io_constructed;
+  object_class->dispose = inf_threaded_io_dispose;
+  object_class->finalize = inf_threaded_io_finalize;
+  object_class->set_property = inf_threaded_io_set_property;
+  object_class->get_property = inf_threaded_io_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_N_LOOPS,
+    g_param_spec_uint(
+      "n-loops",
+      "Number of loops",
+      "The number of event loops, each running in its own thread, or 0 to "
+      "use one loop per processor",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+    )
+  );
+}
+
+static void
+inf_threaded_io_io_iface_init(InfIoInterface* iface)
+{
+  iface->add_watch = inf_threaded_io_io_add_watch;
+  iface->update_watch = inf_threaded_io_io_update_watch;
+  iface->remove_watch = inf_threaded_io_io_remove_watch;
+  iface->add_timeout = inf_threaded_io_io_add_timeout;
+  iface->remove_timeout = inf_threaded_io_io_remove_timeout;
+  iface->add_dispatch = inf_threaded_io_io_add_dispatch;
+  iface->remove_dispatch = inf_threaded_io_io_remove_dispatch;
+}
+
+/**
+ * inf_threaded_io_new: (constructor)
+ * @n_loops: The number of event loops to run, or 0.
+ *
+ * Creates a new #InfThreadedIo with @n_loops event loops. If @n_loops is 0,
+ * one loop is created for each processor of the machine. The threads
+ * running the loops are only started by inf_threaded_io_start().
+ *
+ * Returns: (transfer full): A new #InfThreadedIo. Free with
+ * g_object_unref() when no longer needed.
+ **/
+InfThreadedIo*
+inf_threaded_io_new(guint n_loops)
+{
+  GObject* object;
+  object = g_object_new(INF_TYPE_THREADED_IO, "n-loops", n_loops, NULL);
+  return INF_THREADED_IO(object);
+}
+
+/**
+ * inf_threaded_io_get_n_loops:
+ * @io: A #InfThreadedIo.
+ *
+ * Returns the number of event loops in @io.
+ *
+ * Returns: The number of loops in @io.
+ **/
+guint
+inf_threaded_io_get_n_loops(InfThreadedIo* io)
+{
+  g_return_val_if_fail(INF_IS_THREADED_IO(io), 0);
+  return INF_THREADED_IO_PRIVATE(io)->n_loops;
+}
+
+/**
+ * inf_threaded_io_get_loop:
+ * @io: A #InfThreadedIo.
+ * @index: The index of the loop, smaller than the number of loops.
+ *
+ * Returns the event loop with the given index. It is a #InfStandaloneIo
+ * which is run by a thread of @io. It must not be run by other means,
+ * such as inf_standalone_io_loop().
+ *
+ * Returns: (transfer none): The loop with index @index.
+ **/
+InfIo*
+inf_threaded_io_get_loop(InfThreadedIo* io,
+                         guint index)
+{
+  InfThreadedIoPrivate* priv;
+
+  g_return_val_if_fail(INF_IS_THREADED_IO(io), NULL);
+
+  priv = INF_THREADED_IO_PRIVATE(io);
+  g_return_val_if_fail(index < priv->n_loops, NULL);
+
+  return INF_IO(priv->loops[index].io);
+}
+
+/**
+ * inf_threaded_io_acquire_loop:
+ * @io: A #InfThreadedIo.
+ *
+ * Chooses the event loop to which the least number of objects are pinned,
+ * and pins one more object to it. The object should then be created with
+ * the returned loop as its #InfIo, and it must only be accessed from the
+ * thread running that loop. When the object is no longer needed, call
+ * inf_threaded_io_release_loop().
+ *
+ * This function is thread-safe.
+ *
+ * Returns: (transfer none): The loop to pin a new object to.
+ **/
+InfIo*
+inf_threaded_io_acquire_loop(InfThreadedIo* io)
+{
+  InfThreadedIoPrivate* priv;
+  InfThreadedIoLoop* loop;
+  guint i;
+
+  g_return_val_if_fail(INF_IS_THREADED_IO(io), NULL);
+  priv = INF_THREADED_IO_PRIVATE(io);
+
+  g_mutex_lock(&priv->mutex);
+
+  loop = &priv->loops[0];
+  for(i = 1; i < priv->n_loops; ++i)
+    if(priv->loops[i].n_pinned < loop->n_pinned)
+      loop = &priv->loops[i];
+
+  ++loop->n_pinned;
+  g_mutex_unlock(&priv->mutex);
+
+  return INF_IO(loop->io);
+}
+
+/**
+ * inf_threaded_io_release_loop:
+ * @io: A #InfThreadedIo.
+ * @loop: A loop obtained with inf_threaded_io_acquire_loop().
+ *
+ * Unpins an object from @loop, after it is no longer in use. This makes
+ * it more likely for new objects to be pinned to @loop.
+ *
+ * This function is thread-safe.
+ **/
+void
+inf_threaded_io_release_loop(InfThreadedIo* io,
+                             InfIo* loop)
+{
+  InfThreadedIoPrivate* priv;
+  guint i;
+
+  g_return_if_fail(INF_IS_THREADED_IO(io));
+  g_return_if_fail(INF_IS_STANDALONE_IO(loop));
+
+  priv = INF_THREADED_IO_PRIVATE(io);
+  g_mutex_lock(&priv->mutex);
+
+  for(i = 0; i < priv->n_loops; ++i)
+    if(INF_IO(priv->loops[i].io) == loop)
+      break;
+
+  /* loop must have been acquired with inf_threaded_io_acquire_loop() */
+  if(i == priv->n_loops || priv->loops[i].n_pinned == 0)
+  {
+    g_mutex_unlock(&priv->mutex);
+    g_return_if_reached();
+  }
+
+  --priv->loops[i].n_pinned;
+  g_mutex_unlock(&priv->mutex);
+}
+
+/**
+ * inf_threaded_io_start:
+ * @io: A #InfThreadedIo.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Starts one thread for each loop of @io, which runs the loop until
+ * inf_threaded_io_stop() is called. If a thread cannot be created, the
+ * threads started so far are stopped again, and the function returns
+ * %FALSE with @error set.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ **/
+gboolean
+inf_threaded_io_start(InfThreadedIo* io,
+                      GError** error)
+{
+  InfThreadedIoPrivate* priv;
+  guint i;
+
+  g_return_val_if_fail(INF_IS_THREADED_IO(io), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  priv = INF_THREADED_IO_PRIVATE(io);
+  g_mutex_lock(&priv->state_mutex);
+
+  /* not running yet */
+  if(priv->running == TRUE)
+  {
+    g_mutex_unlock(&priv->state_mutex);
+    g_return_val_if_reached(FALSE);
+  }
+
+  for(i = 0; i < priv->n_loops; ++i)
+  {
+    priv->loops[i].thread = g_thread_try_new(
+      "InfThreadedIo",
+      inf_threaded_io_thread_func,
+      priv->loops[i].io,
+      error
+    );
+
+    if(priv->loops[i].thread == NULL)
+    {
+      inf_threaded_io_stop_loops(io, i);
+      g_mutex_unlock(&priv->state_mutex);
+      return FALSE;
+    }
+  }
+
+  priv->running = TRUE;
+  g_mutex_unlock(&priv->state_mutex);
+
+  return TRUE;
+}
+
+/**
+ * inf_threaded_io_stop:
+ * @io: A #InfThreadedIo.
+ *
+ * Makes all loops of @io quit, and waits for their threads to finish. This
+ * function must not be called from one of the threads of @io. Watches,
+ * timeouts and dispatches of the loops are kept, and are processed again
+ * when the loops are restarted with inf_threaded_io_start().
+ **/
+void
+inf_threaded_io_stop(InfThreadedIo* io)
+{
+  InfThreadedIoPrivate* priv;
+  guint i;
+
+  g_return_if_fail(INF_IS_THREADED_IO(io));
+
+  priv = INF_THREADED_IO_PRIVATE(io);
+  g_mutex_lock(&priv->state_mutex);
+
+  /* running */
+  if(priv->running == FALSE)
+  {
+    g_mutex_unlock(&priv->state_mutex);
+    g_return_if_reached();
+  }
+
+  /* Joining our own thread would deadlock */
+  for(i = 0; i < priv->n_loops; ++i)
+  {
+    if(priv->loops[i].thread == g_thread_self())
+    {
+      g_mutex_unlock(&priv->state_mutex);
+      g_return_if_reached();
+    }
+  }
+
+  inf_threaded_io_stop_loops(io, priv->n_loops);
+  priv->running = FALSE;
+
+  g_mutex_unlock(&priv->state_mutex);
+}
+
+/**
+ * inf_threaded_io_get_running:
+ * @io: A #InfThreadedIo.
+ *
+ * Returns whether the threads of @io have been started with
+ * inf_threaded_io_start() and not been stopped since.
+ *
+ * Returns: Whether the loops of @io are running.
+ **/
+gboolean
+inf_threaded_io_get_running(InfThreadedIo* io)
+{
+  InfThreadedIoPrivate* priv;
+  gboolean running;
+
+  g_return_val_if_fail(INF_IS_THREADED_IO(io), FALSE);
+  priv = INF_THREADED_IO_PRIVATE(io);
+
+  g_mutex_lock(&priv->state_mutex);
+  running = priv->running;
+  g_mutex_unlock(&priv->state_mutex);
+
+  return running;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,94 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_THREADED_IO_H__
+#define __INF_THREADED_IO_H__
+
+#include <libinfinity/common/inf-io.h>
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INF_TYPE_THREADED_IO                 (inf_threaded_io_get_type())
+#define INF_THREADED_IO(obj)                 (G_TYPE_CHECK_INSTANCE_CAST((obj), INF_TYPE_THREADED_IO, InfThreadedIo))
+#define INF_THREADED_IO_CLASS(klass)         (G_TYPE_CHECK_CLASS_CAST((klass), INF_TYPE_THREADED_IO, InfThreadedIoClass))
+#define INF_IS_THREADED_IO(obj)              (G_TYPE_CHECK_INSTANCE_TYPE((obj), INF_TYPE_THREADED_IO))
+#define INF_IS_THREADED_IO_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE((klass), INF_TYPE_THREADED_IO))
+#define INF_THREADED_IO_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS((obj), INF_TYPE_THREADED_IO, InfThreadedIoClass))
+
+typedef struct _InfThreadedIo InfThreadedIo;
+typedef struct _InfThreadedIoClass InfThreadedIoClass;
+
+/**
+ * InfThreadedIoClass:
+ *
+ * This structure does not contain any public fields.
+ */
+struct _InfThreadedIoClass {
+  /*< private >*/
+  GObjectClass parent_class;
+};
+
+/**
+ * InfThreadedIo:
+ *
+ * #InfThreadedIo is an opaque data type. You should only access it via the
+ * public API functions.
+ */
+struct _InfThreadedIo {
+  /*< private >*/
+  GObject parent;
+};
+
+GType
+inf_threaded_io_get_type(void) G_GNUC_CONST;
+
+InfThreadedIo*
+inf_threaded_io_new(guint n_loops);
+
+guint
+inf_threaded_io_get_n_loops(InfThreadedIo* io);
+
+InfIo*
+inf_threaded_io_get_loop(InfThreadedIo* io,
+                         guint index);
+
+InfIo*
+inf_threaded_io_acquire_loop(InfThreadedIo* io);
+
+void
+inf_threaded_io_release_loop(InfThreadedIo* io,
+                             InfIo* loop);
+
+gboolean
+inf_threaded_io_start(InfThreadedIo* io,
+                      GError** error);
+
+void
+inf_threaded_io_stop(InfThreadedIo* io);
+
+gboolean
+inf_threaded_io_get_running(InfThreadedIo* io);
+
+G_END_DECLS
+
+#endif /* __INF_THREADED_IO_H__ */
+
+/* vim:set et sw=2 ts=2: */
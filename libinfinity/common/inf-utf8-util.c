@@ -0,0 +1,288 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-utf8-util
+ * @title: UTF-8 utility functions
+ * @short_description: Fast character counting in UTF-8 text
+ * @include: libinfinity/common/inf-utf8-util.h
+ * @stability: Unstable
+ *
+ * These functions count and locate characters in UTF-8 encoded text. Unlike
+ * g_utf8_strlen() and g_utf8_offset_to_pointer() they look at many bytes at
+ * once, which makes a difference for long texts such as large documents or
+ * big pastes. Except for inf_utf8_util_validate(), the text is not
+ * validated, it is assumed to be valid UTF-8.
+ **/
+
+#include <libinfinity/common/inf-utf8-util.h>
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Number of bytes that are looked at at once */
+#define INF_UTF8_UTIL_BLOCK_SIZE 16
+
+/* A byte starts a character unless it is a continuation byte, i.e. of the
+ * form 10xxxxxx. */
+static gsize
+inf_utf8_util_count_scalar(const guchar* text,
+                           gsize bytes)
+{
+  gsize count;
+  gsize i;
+
+  count = 0;
+  for(i = 0; i < bytes; ++i)
+    if((text[i] & 0xc0) != 0x80)
+      ++count;
+
+  return count;
+}
+
+#ifdef __SSE2__
+/* Returns a vector with 1 in each byte that starts a character, and 0 in
+ * each continuation byte. */
+static __m128i
+inf_utf8_util_starts_sse2(const guchar* text)
+{
+  __m128i block;
+
+  /* As signed bytes, continuation bytes are -128 to -65 */
+  block = _mm_loadu_si128((const __m128i*)text);
+  return _mm_and_si128(
+    _mm_cmpgt_epi8(block, _mm_set1_epi8(-65)),
+    _mm_set1_epi8(1)
+  );
+}
+
+static gsize
+inf_utf8_util_sum_sse2(__m128i counts)
+{
+  __m128i sum;
+
+  sum = _mm_sad_epu8(counts, _mm_setzero_si128());
+  return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+}
+#else
+/* Counts the continuation bytes in eight bytes of text at once */
+static gsize
+inf_utf8_util_count_continuation_swar(const guchar* text)
+{
+  guint64 word;
+  guint64 mask;
+
+  memcpy(&word, text, sizeof(word));
+
+  /* Highest bit of each byte is set if it is 10xxxxxx */
+  mask = word & ~(word << 1) & G_GUINT64_CONSTANT(0x8080808080808080);
+  return ((mask >> 7) * G_GUINT64_CONSTANT(0x0101010101010101)) >> 56;
+}
+#endif
+
+/* Checks whether INF_UTF8_UTIL_BLOCK_SIZE bytes are all ASCII */
+static gboolean
+inf_utf8_util_is_ascii_block(const guchar* text)
+{
+#ifdef __SSE2__
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)text)) == 0;
+#else
+  guint64 words[2];
+
+  memcpy(words, text, sizeof(words));
+  return ((words[0] | words[1]) & G_GUINT64_CONSTANT(0x8080808080808080)) == 0;
+#endif
+}
+
+/* Counts the characters starting in INF_UTF8_UTIL_BLOCK_SIZE bytes */
+static gsize
+inf_utf8_util_count_block(const guchar* text)
+{
+#ifdef __SSE2__
+  return inf_utf8_util_sum_sse2(inf_utf8_util_starts_sse2(text));
+#else
+  return INF_UTF8_UTIL_BLOCK_SIZE -
+    inf_utf8_util_count_continuation_swar(text) -
+    inf_utf8_util_count_continuation_swar(text + 8);
+#endif
+}
+
+/**
+ * inf_utf8_util_strlen:
+ * @text: (array length=bytes): UTF-8 encoded text.
+ * @bytes: Number of bytes in @text.
+ *
+ * Returns the number of characters in the first @bytes bytes of @text. The
+ * text does not need to be zero-terminated, and zero bytes are counted as
+ * characters.
+ *
+ * Returns: The number of characters in @text.
+ */
+gsize
+inf_utf8_util_strlen(const gchar* text,
+                     gsize bytes)
+{
+  const guchar* pos;
+  gsize count;
+#ifdef __SSE2__
+  __m128i counts;
+  guint n;
+  guint i;
+#endif
+
+  pos = (const guchar*)text;
+  count = 0;
+
+#ifdef __SSE2__
+  while(bytes >= INF_UTF8_UTIL_BLOCK_SIZE)
+  {
+    /* Sum up at most 255 blocks bytewise before the counters overflow */
+    n = MIN(bytes / INF_UTF8_UTIL_BLOCK_SIZE, 255);
+    counts = _mm_setzero_si128();
+
+    for(i = 0; i < n; ++i)
+    {
+      counts = _mm_add_epi8(counts, inf_utf8_util_starts_sse2(pos));
+      pos += INF_UTF8_UTIL_BLOCK_SIZE;
+    }
+
+    count += inf_utf8_util_sum_sse2(counts);
+    bytes -= n * INF_UTF8_UTIL_BLOCK_SIZE;
+  }
+#else
+  while(bytes >= INF_UTF8_UTIL_BLOCK_SIZE)
+  {
+    count += inf_utf8_util_count_block(pos);
+    pos += INF_UTF8_UTIL_BLOCK_SIZE;
+    bytes -= INF_UTF8_UTIL_BLOCK_SIZE;
+  }
+#endif
+
+  return count + inf_utf8_util_count_scalar(pos, bytes);
+}
+
+/**
+ * inf_utf8_util_offset_to_index:
+ * @text: (array length=bytes): UTF-8 encoded text.
+ * @bytes: Number of bytes in @text.
+ * @offset: A character offset into @text.
+ *
+ * Returns the byte index at which the character with offset @offset starts
+ * in @text. If @offset is the number of characters in @text, @bytes is
+ * returned. If @text starts in the middle of a character, the continuation
+ * bytes at its beginning are skipped, i.e. offset 0 refers to the first
+ * character that starts within @text.
+ *
+ * Returns: The byte index of the character at @offset.
+ */
+gsize
+inf_utf8_util_offset_to_index(const gchar* text,
+                              gsize bytes,
+                              gsize offset)
+{
+  const guchar* pos;
+  gsize index;
+  gsize count;
+
+  pos = (const guchar*)text;
+  index = 0;
+
+  /* Skip whole blocks as long as the character is not within them */
+  while(bytes - index >= INF_UTF8_UTIL_BLOCK_SIZE)
+  {
+    count = inf_utf8_util_count_block(pos + index);
+    if(count > offset)
+      break;
+
+    offset -= count;
+    index += INF_UTF8_UTIL_BLOCK_SIZE;
+  }
+
+  for(; index < bytes; ++index)
+  {
+    if((pos[index] & 0xc0) != 0x80)
+    {
+      if(offset == 0)
+        return index;
+      --offset;
+    }
+  }
+
+  g_assert(offset == 0);
+  return bytes;
+}
+
+/**
+ * inf_utf8_util_validate:
+ * @text: (array length=bytes): Text to validate.
+ * @bytes: Number of bytes in @text.
+ *
+ * Checks whether the first @bytes bytes of @text are valid UTF-8, in the
+ * same way as g_utf8_validate(), except that zero bytes are allowed. Runs
+ * of ASCII characters are skipped many bytes at a time, and only the other
+ * characters are decoded one by one.
+ *
+ * Returns: %TRUE if @text is valid UTF-8, or %FALSE otherwise.
+ */
+gboolean
+inf_utf8_util_validate(const gchar* text,
+                       gsize bytes)
+{
+  const guchar* pos;
+  const guchar* end;
+  const guchar* block_end;
+  gunichar c;
+
+  pos = (const guchar*)text;
+  end = pos + bytes;
+
+  while(pos < end)
+  {
+    while(end - pos >= INF_UTF8_UTIL_BLOCK_SIZE &&
+          inf_utf8_util_is_ascii_block(pos))
+    {
+      pos += INF_UTF8_UTIL_BLOCK_SIZE;
+    }
+
+    /* Decode the block with non-ASCII characters, or the rest of the text */
+    block_end = pos + MIN(end - pos, INF_UTF8_UTIL_BLOCK_SIZE);
+    while(pos < block_end)
+    {
+      if(*pos < 0x80)
+      {
+        ++pos;
+      }
+      else
+      {
+        c = g_utf8_get_char_validated((const gchar*)pos, end - pos);
+        if(c == (gunichar)-1 || c == (gunichar)-2)
+          return FALSE;
+
+        pos = (const guchar*)g_utf8_next_char(pos);
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+/* vim:set et sw=2 ts=2: */
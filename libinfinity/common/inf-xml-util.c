@@ -32,6 +32,7 @@
 
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-error.h>
+#include <libinfinity/common/inf-utf8-util.h>
 #include <libinfinity/inf-i18n.h>
 
 #include <string.h>
@@ -39,6 +40,10 @@
 #include <math.h> /* HUGE_VAL */
 #include <errno.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 static gboolean
 inf_xml_util_string_to_long(const gchar* attribute,
                             const xmlChar* value,
@@ -290,6 +295,80 @@ inf_xml_util_valid_xml_char(gunichar codepoint)
  */
 #define inf_utf8_next_char(p) ((p) + g_utf8_skip[*(const guchar *)(p)])
 
+/* Number of bytes that inf_xml_util_skip_valid_blocks() looks at at once */
+#define INF_XML_UTIL_BLOCK_SIZE 16
+
+/* In valid UTF-8, the only characters which are not valid in XML text are
+ * the C0 control characters other than tab, newline and carriage return,
+ * and U+FFFE and U+FFFF, which are encoded starting with 0xef. This returns
+ * the number of bytes at the beginning of text which make up whole blocks
+ * without any such byte, and which are therefore valid XML text. The
+ * returned position can be in the middle of a character. */
+static gsize
+inf_xml_util_skip_valid_blocks(const guchar* text,
+                               gsize bytes)
+{
+  gsize skipped;
+#ifdef __SSE2__
+  __m128i block;
+  __m128i control;
+  __m128i allowed;
+  __m128i special;
+#else
+  guint64 words[2];
+  guint64 special;
+  guint i;
+#endif
+
+  skipped = 0;
+  while(bytes - skipped >= INF_XML_UTIL_BLOCK_SIZE)
+  {
+#ifdef __SSE2__
+    block = _mm_loadu_si128((const __m128i*)(text + skipped));
+    control = _mm_cmpeq_epi8(_mm_min_epu8(block, _mm_set1_epi8(0x1f)), block);
+
+    allowed = _mm_or_si128(
+      _mm_or_si128(
+        _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')),
+        _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'))
+      ),
+      _mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))
+    );
+
+    special = _mm_or_si128(
+      _mm_andnot_si128(allowed, control),
+      _mm_cmpeq_epi8(block, _mm_set1_epi8((gchar)0xef))
+    );
+
+    if(_mm_movemask_epi8(special) != 0)
+      break;
+#else
+    /* This also stops at tab, newline and carriage return, and the bytes
+     * following a special byte, which is safe, only slower. */
+    memcpy(words, text + skipped, sizeof(words));
+
+    special = 0;
+    for(i = 0; i < 2; ++i)
+    {
+      /* Bytes less than 0x20 */
+      special |= (words[i] - G_GUINT64_CONSTANT(0x2020202020202020)) &
+        ~words[i];
+      /* Bytes equal to 0xef */
+      words[i] ^= G_GUINT64_CONSTANT(0xefefefefefefefef);
+      special |= (words[i] - G_GUINT64_CONSTANT(0x0101010101010101)) &
+        ~words[i];
+    }
+
+    if((special & G_GUINT64_CONSTANT(0x8080808080808080)) != 0)
+      break;
+#endif
+
+    skipped += INF_XML_UTIL_BLOCK_SIZE;
+  }
+
+  return skipped;
+}
+
 /**
  * inf_xml_util_add_child_text:
  * @xml: A #xmlNodePtr.
@@ -311,12 +390,27 @@ inf_xml_util_add_child_text(xmlNodePtr xml,
 {
   const gchar* p;
   const gchar* next;
+  const gchar* end;
   gchar* node_value;
   xmlNodePtr child_node;
   gunichar ch;
-  gsize i;
-  for(i = 0, p = text; i < bytes; i += next - p, p = next)
+  gsize skipped;
+
+  end = text + bytes;
+  for(p = text; p < end; p = next)
   {
+    skipped = inf_xml_util_skip_valid_blocks((const guchar*)p, end - p);
+    if(skipped > 0)
+    {
+      p += skipped;
+      if(p == end)
+        break;
+
+      /* Go back to the beginning of the character we stopped in */
+      while((*(const guchar*)p & 0xc0) == 0x80)
+        --p;
+    }
+
     next = inf_utf8_next_char(p);
     ch = g_utf8_get_char(p);
     if(!inf_xml_util_valid_xml_char(ch))
@@ -366,13 +460,15 @@ inf_xml_util_get_child_text(xmlNodePtr xml,
   GString* result = g_string_sized_new(16);
   guint num_codepoint;
   gsize char_count = 0;
+  gsize len;
   for(child = xml->children; child; child = child->next)
   {
     switch(child->type)
     {
     case XML_TEXT_NODE:
-      g_string_append(result, (const gchar*)child->content);
-      char_count += g_utf8_strlen((const gchar*)child->content, -1);
+      len = strlen((const char*)child->content);
+      g_string_append_len(result, (const gchar*)child->content, len);
+      char_count += inf_utf8_util_strlen((const gchar*)child->content, len);
       break;
     case XML_ELEMENT_NODE:
       if(strcmp((const char*) child->name, "uchar") != 0) {
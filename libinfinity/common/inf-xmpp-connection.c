@@ -224,6 +224,10 @@ enum {
   PROP_REMOTE_CERTIFICATE
 };
 
+/* Serialized messages of at least this size are handed over to the TCP
+ * connection without copying them, if TLS is not used. */
+#define INF_XMPP_CONNECTION_DETACH_SIZE 16384
+
 #define INF_XMPP_CONNECTION_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_XMPP_CONNECTION, InfXmppConnectionPrivate))
 
 static GQuark inf_xmpp_connection_stream_error_quark;
@@ -696,10 +700,13 @@ inf_xmpp_connection_clear(InfXmppConnection* xmpp)
   g_object_thaw_notify(G_OBJECT(xmpp));
 }
 
+/* If bytes is non-NULL, then data points into it, and it can be passed on
+ * to the TCP connection as-is when TLS is not used. */
 static void
-inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
-                               gconstpointer data,
-                               guint len)
+inf_xmpp_connection_send_data(InfXmppConnection* xmpp,
+                              gconstpointer data,
+                              guint len,
+                              GBytes* bytes)
 {
   InfXmppConnectionPrivate* priv;
   ssize_t cur_bytes;
@@ -755,7 +762,11 @@ inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
   else
   {
     priv->position += len;
-    inf_tcp_connection_send(priv->tcp, data, len);
+
+    if(bytes != NULL)
+      inf_tcp_connection_send_bytes(priv->tcp, bytes);
+    else
+      inf_tcp_connection_send(priv->tcp, data, len);
   }
 
   g_assert(priv->parsing > 0);
@@ -773,11 +784,23 @@ inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
   }
 }
 
+static void
+inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
+                               gconstpointer data,
+                               guint len)
+{
+  inf_xmpp_connection_send_data(xmpp, data, len, NULL);
+}
+
 static void
 inf_xmpp_connection_send_xml(InfXmppConnection* xmpp,
                              xmlNodePtr xml)
 {
   InfXmppConnectionPrivate* priv;
+  xmlChar* content;
+  guint len;
+  GBytes* bytes;
+
   priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
 
   g_return_if_fail(priv->doc != NULL);
@@ -792,11 +815,29 @@ inf_xmpp_connection_send_xml(InfXmppConnection* xmpp,
    * the buffer variable afterwards. */
   g_object_ref(xmpp);
 
-  inf_xmpp_connection_send_chars(
-    xmpp,
-    xmlBufferContent(priv->buf),
-    xmlBufferLength(priv->buf)
-  );
+  len = xmlBufferLength(priv->buf);
+  if(priv->session == NULL && len >= INF_XMPP_CONNECTION_DETACH_SIZE)
+  {
+    /* Without TLS, the serialized message goes to the TCP connection
+     * unchanged. Pass on ownership of the buffer content so that it does
+     * not need to be copied if it cannot be sent right away, and use a
+     * fresh buffer for the next message. */
+    content = xmlBufferDetach(priv->buf);
+    xmlBufferFree(priv->buf);
+    priv->buf = xmlBufferCreate();
+
+    bytes = g_bytes_new_with_free_func(content, len, xmlFree, content);
+    inf_xmpp_connection_send_data(xmpp, content, len, bytes);
+    g_bytes_unref(bytes);
+  }
+  else
+  {
+    inf_xmpp_connection_send_chars(
+      xmpp,
+      xmlBufferContent(priv->buf),
+      len
+    );
+  }
 
   /* The connection might be closed & cleared as a result from
    * inf_xmpp_connection_send_chars(), so make sure the buffer still
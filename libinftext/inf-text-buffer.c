@@ -256,6 +256,143 @@ inf_text_buffer_erase_text(InfTextBuffer* buffer,
   iface->erase_text(buffer, pos, len, user);
 }
 
+/* Returns whether anybody is interested in the given signal being emitted,
+ * so that the chunk for it does not need to be built otherwise. */
+static gboolean
+inf_text_buffer_signal_is_observed(InfTextBuffer* buffer,
+                                   guint signal_id,
+                                   gboolean has_class_handler)
+{
+  if(has_class_handler)
+    return TRUE;
+
+  return g_signal_has_handler_pending(buffer, signal_id, 0, FALSE);
+}
+
+/**
+ * inf_text_buffer_append_text:
+ * @buffer: A #InfTextBuffer.
+ * @text (type=guint8*) (array length=bytes) (transfer none): A pointer to
+ * the text to append.
+ * @bytes: The length (in bytes) of @text.
+ * @len: The length (in characters) of @text.
+ * @user: (allow-none): A #InfUser that has written the new text, or %NULL.
+ *
+ * Appends @text to the end of @buffer as written by @user. This is
+ * equivalent to calling inf_text_buffer_insert_text() with the length of
+ * @buffer as position, but it allows the buffer to skip looking up the
+ * insertion position. Also, the #InfTextBuffer::text-inserted signal is only
+ * emitted, and the #InfTextChunk passed to it only created, if a handler is
+ * connected to it. This makes it the preferred way to fill a buffer when
+ * loading a document.
+ **/
+void
+inf_text_buffer_append_text(InfTextBuffer* buffer,
+                            gconstpointer text,
+                            gsize bytes,
+                            guint len,
+                            InfUser* user)
+{
+  InfTextBufferInterface* iface;
+  InfTextChunk* chunk;
+  guint pos;
+
+  g_return_if_fail(INF_TEXT_IS_BUFFER(buffer));
+  g_return_if_fail(text != NULL);
+  g_return_if_fail(user == NULL || INF_IS_USER(user));
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+
+  if(iface->append_text == NULL)
+  {
+    inf_text_buffer_insert_text(
+      buffer,
+      inf_text_buffer_get_length(buffer),
+      text,
+      bytes,
+      len,
+      user
+    );
+
+    return;
+  }
+
+  if(len == 0)
+    return;
+
+  pos = inf_text_buffer_get_length(buffer);
+  iface->append_text(buffer, text, bytes, len, user);
+
+  if(inf_text_buffer_signal_is_observed(
+       buffer,
+       text_buffer_signals[TEXT_INSERTED],
+       iface->text_inserted != NULL))
+  {
+    chunk = inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
+
+    inf_text_chunk_insert_text(
+      chunk,
+      0,
+      text,
+      bytes,
+      len,
+      user == NULL ? 0 : inf_user_get_id(user)
+    );
+
+    inf_text_buffer_text_inserted(buffer, pos, chunk, user);
+    inf_text_chunk_free(chunk);
+  }
+}
+
+/**
+ * inf_text_buffer_clear:
+ * @buffer: A #InfTextBuffer.
+ *
+ * Removes all text from @buffer. This is equivalent to erasing the whole
+ * buffer with inf_text_buffer_erase_text() without a user, but the buffer
+ * can release its content at once, and the erased text is only extracted
+ * for the #InfTextBuffer::text-erased signal if a handler is connected to
+ * it.
+ **/
+void
+inf_text_buffer_clear(InfTextBuffer* buffer)
+{
+  InfTextBufferInterface* iface;
+  InfTextChunk* chunk;
+  guint len;
+
+  g_return_if_fail(INF_TEXT_IS_BUFFER(buffer));
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+  len = inf_text_buffer_get_length(buffer);
+
+  if(len == 0)
+    return;
+
+  if(iface->clear == NULL)
+  {
+    inf_text_buffer_erase_text(buffer, 0, len, NULL);
+    return;
+  }
+
+  chunk = NULL;
+  if(inf_text_buffer_signal_is_observed(
+       buffer,
+       text_buffer_signals[TEXT_ERASED],
+       iface->text_erased != NULL))
+  {
+    chunk = inf_text_buffer_get_slice(buffer, 0, len);
+  }
+
+  iface->clear(buffer);
+
+  if(chunk != NULL)
+  {
+    inf_text_buffer_text_erased(buffer, 0, chunk, NULL);
+    inf_text_chunk_free(chunk);
+  }
+}
+
 /**
  * inf_text_buffer_create_begin_iter:
  * @buffer: A #InfTextBuffer.
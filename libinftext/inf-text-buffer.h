@@ -83,6 +83,12 @@ typedef struct _InfTextBufferIter InfTextBufferIter;
  * signal.
  * @text_erased: Default signal handler of the #InfTextBuffer::text-erased
  * signal.
+ * @append_text: Virtual function to append text to the end of the buffer
+ * without emitting the #InfTextBuffer::text-inserted signal. If not
+ * implemented, @insert_text is used instead.
+ * @clear: Virtual function to remove all text from the buffer without
+ * emitting the #InfTextBuffer::text-erased signal. If not implemented,
+ * @erase_text is used instead.
  *
  * This structure contains virtual functions and signal handlers of the
  * #InfTextBuffer interface.
@@ -150,6 +156,17 @@ struct _InfTextBufferInterface {
                      guint pos,
                      InfTextChunk* chunk,
                      InfUser* user);
+
+  /* Virtual table, continued. These come last so that the layout of the
+   * structure stays compatible with implementations built before they were
+   * added. */
+  void(*append_text)(InfTextBuffer* buffer,
+                     gconstpointer text,
+                     gsize bytes,
+                     guint len,
+                     InfUser* user);
+
+  void(*clear)(InfTextBuffer* buffer);
 };
 
 GType
@@ -186,6 +203,16 @@ inf_text_buffer_erase_text(InfTextBuffer* buffer,
                            guint len,
                            InfUser* user);
 
+void
+inf_text_buffer_append_text(InfTextBuffer* buffer,
+                            gconstpointer text,
+                            gsize bytes,
+                            guint len,
+                            InfUser* user);
+
+void
+inf_text_buffer_clear(InfTextBuffer* buffer);
+
 InfTextBufferIter*
 inf_text_buffer_create_begin_iter(InfTextBuffer* buffer);
 
@@ -47,6 +47,7 @@
 
 #include <libinftext/inf-text-chunk.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-utf8-util.h>
 
 #include <string.h>
 
@@ -62,25 +63,86 @@ struct _InfTextChunkPath {
                           gchar* text,
                           gsize bytes,
                           guint offset);
+
+  /* Counts the characters in text. Only encodings that provide this
+   * support a character index for large segments. */
+  guint (*get_length)(InfTextChunk* chunk,
+                      gchar* text,
+                      gsize bytes);
 };
 
-struct _InfTextChunk {
-  GSequence* segments;
-  guint length; /* in characters */
-  GQuark encoding;
+/* Segments with more bytes than this get a character index, so that
+ * finding a character offset within them does not need to look at all the
+ * text in front of it. */
+#define INF_TEXT_CHUNK_INDEX_THRESHOLD 16384
+/* Distance in bytes between two checkpoints of the index */
+#define INF_TEXT_CHUNK_INDEX_INTERVAL 4096
+
+/* Sparse character index of a segment. chars[i] is the number of characters
+ * starting in the first i * INF_TEXT_CHUNK_INDEX_INTERVAL bytes of the
+ * segment's text. The index is built lazily, up to the position that was
+ * looked up, and an edit only invalidates the checkpoints behind it. */
+typedef struct _InfTextChunkIndex InfTextChunkIndex;
+struct _InfTextChunkIndex {
+  guint* chars;
+  guint n_valid; /* number of valid checkpoints, at least one */
+  guint n_allocated;
+};
 
-  const InfTextChunkPath* path;
+/* The text of segments is kept in reference-counted storage that can be
+ * shared between segments, also of different chunks. Copying a chunk or
+ * taking a substring only takes a reference on the storage of the segments
+ * involved, with the new segments referring to a range of it. The storage
+ * is copied only when a segment that does not own it exclusively is
+ * modified. The text follows the structure in the same allocation. */
+typedef struct _InfTextChunkStorage InfTextChunkStorage;
+struct _InfTextChunkStorage {
+  volatile gint ref_count;
+  gsize size; /* allocated bytes behind the structure */
 };
 
+#define INF_TEXT_CHUNK_STORAGE_DATA(storage) ((gchar*)((storage) + 1))
+
+/* The segments of a chunk are stored in a treap, i.e. a binary search tree
+ * ordered by position in the chunk which is kept balanced by assigning a
+ * random priority to each node and maintaining heap order on the
+ * priorities. Each node caches the number of characters in its subtree.
+ * Segments do not store their offset, it is derived from the subtree sums
+ * when needed. Inserting or erasing text therefore only needs to update the
+ * nodes on the path to the root instead of all following segments, and
+ * finding the segment at a given position takes logarithmic time. */
 typedef struct _InfTextChunkSegment InfTextChunkSegment;
 struct _InfTextChunkSegment {
+  InfTextChunkSegment* parent;
+  InfTextChunkSegment* left;
+  InfTextChunkSegment* right;
+  guint32 priority;
+  guint sum; /* characters in the subtree rooted at this segment */
+
   guint author;
+  InfTextChunkStorage* storage;
   /* This is gchar so that we can do pointer arithmetic. It does not
    * necessarily store a full character in each byte. This depends on the
-   * encoding specified in the InfTextChunk. */
+   * encoding specified in the InfTextChunk. Points into storage. */
   gchar* text;
   gsize length; /* in bytes */
-  guint offset; /* absolute to chunk begin in characters, sort criteria */
+  guint chars; /* in characters */
+
+  InfTextChunkIndex* index; /* NULL for small segments */
+};
+
+struct _InfTextChunk {
+  InfTextChunkSegment* root;
+  /* Sentinel without text that is always the last node of the tree. It
+   * marks the end of the segment sequence, and text inserted at the end of
+   * the chunk is inserted before it. */
+  InfTextChunkSegment end;
+  guint32 seed; /* generates segment priorities */
+
+  guint length; /* in characters */
+  GQuark encoding;
+
+  const InfTextChunkPath* path;
 };
 
 /*
@@ -93,10 +155,17 @@ gsize inf_text_chunk_get_byte_index_utf8(InfTextChunk* self,
                                          guint offset)
 {
 #ifdef CHUNK_CHECK_INTEGRITY
-  g_assert(offset <= g_utf8_strlen(text, bytes));
+  g_assert(offset <= inf_utf8_util_strlen(text, bytes));
 #endif
 
-  return g_utf8_offset_to_pointer(text, offset) - text;
+  return inf_utf8_util_offset_to_index(text, bytes, offset);
+}
+
+guint inf_text_chunk_get_length_utf8(InfTextChunk* self,
+                                     gchar* text,
+                                     gsize bytes)
+{
+  return inf_utf8_util_strlen(text, bytes);
 }
 
 gsize inf_text_chunk_get_byte_index_iconv(InfTextChunk* self,
@@ -104,8 +173,9 @@ gsize inf_text_chunk_get_byte_index_iconv(InfTextChunk* self,
                                           gsize bytes,
                                           guint offset)
 {
-  /* We convert the segment's text into UCS-4, character by character.
-   * This assumes every UCS-4 character is 4 bytes in length */
+  /* We convert the segment's text into UCS-4, one batch of characters at a
+   * time, and check how much input has been consumed. This assumes every
+   * UCS-4 character is 4 bytes in length */
 
   /* This is quite inefficient, but a general-purpose solution. It looks like
    * libicu has a function, UCharIteratorMove, which would allow us to move
@@ -114,14 +184,13 @@ gsize inf_text_chunk_get_byte_index_iconv(InfTextChunk* self,
    * maybe with an option to fall back to iconv at configure time */
 
   GIConv cd;
-  gchar buffer[4];
+  gchar buffer[4 * 256];
 
   gchar* inbuf;
   gchar* outbuf;
   gsize inlen;
   gsize outlen;
   guint count;
-  gsize result;
 
   cd = g_iconv_open("UCS-4", g_quark_to_string(self->encoding));
   g_assert(cd != (GIConv)-1);
@@ -129,15 +198,20 @@ gsize inf_text_chunk_get_byte_index_iconv(InfTextChunk* self,
   inbuf = text;
   inlen = bytes;
 
-  for(count = 0; count < offset; ++count)
+  while(offset > 0)
   {
     g_assert(inlen > 0);
 
+    count = MIN(offset, sizeof(buffer) / 4);
     outbuf = buffer;
-    outlen = 4;
+    outlen = 4 * count;
+
+    /* Stops with E2BIG as soon as count characters have been converted,
+     * unless the input ends exactly there. */
+    g_iconv(cd, &inbuf, &inlen, &outbuf, &outlen);
+    g_assert(outlen == 0);
 
-    result = g_iconv(cd, &inbuf, &inlen, &outbuf, &outlen);
-    g_assert(result == (size_t)(-1)); /* errno == E2BIG */
+    offset -= count;
   }
 
   g_iconv_close(cd);
@@ -145,182 +219,653 @@ gsize inf_text_chunk_get_byte_index_iconv(InfTextChunk* self,
 }
 
 const InfTextChunkPath INF_TEXT_CHUNK_PATH_UTF8 = {
-  inf_text_chunk_get_byte_index_utf8
+  inf_text_chunk_get_byte_index_utf8,
+  inf_text_chunk_get_length_utf8
 };
 
 const InfTextChunkPath INF_TEXT_CHUNK_PATH_ICONV = {
-  inf_text_chunk_get_byte_index_iconv
+  inf_text_chunk_get_byte_index_iconv,
+  NULL
 };
 
 /*
  * Helper functions
  */
 
+static guint32
+inf_text_chunk_next_priority(InfTextChunk* self)
+{
+  /* xorshift32, good enough to keep the tree balanced, and deterministic
+   * so that the shape of the tree does not depend on global state. */
+  self->seed ^= self->seed << 13;
+  self->seed ^= self->seed >> 17;
+  self->seed ^= self->seed << 5;
+  return self->seed;
+}
+
+static void
+inf_text_chunk_init_segments(InfTextChunk* self)
+{
+  self->seed = 0x9e3779b9;
+
+  self->end.parent = NULL;
+  self->end.left = NULL;
+  self->end.right = NULL;
+  self->end.priority = inf_text_chunk_next_priority(self);
+  self->end.sum = 0;
+  self->end.author = 0;
+  self->end.storage = NULL;
+  self->end.text = NULL;
+  self->end.length = 0;
+  self->end.chars = 0;
+  self->end.index = NULL;
+
+  self->root = &self->end;
+}
+
+/* Creates new storage with room for size bytes, and copies bytes bytes
+ * of text into it. */
+static InfTextChunkStorage*
+inf_text_chunk_storage_new(gconstpointer text,
+                           gsize bytes,
+                           gsize size)
+{
+  InfTextChunkStorage* storage;
+
+  g_assert(bytes <= size);
+
+  storage = g_malloc(sizeof(InfTextChunkStorage) + size);
+  storage->ref_count = 1;
+  storage->size = size;
+  memcpy(INF_TEXT_CHUNK_STORAGE_DATA(storage), text, bytes);
+
+  return storage;
+}
+
+static void
+inf_text_chunk_storage_unref(InfTextChunkStorage* storage)
+{
+  if(g_atomic_int_dec_and_test(&storage->ref_count))
+    g_free(storage);
+}
+
+/* Creates a new segment with its own copy of text */
+static InfTextChunkSegment*
+inf_text_chunk_segment_new(InfTextChunk* self,
+                           guint author,
+                           gconstpointer text,
+                           gsize bytes,
+                           guint chars)
+{
+  InfTextChunkSegment* segment;
+
+  segment = g_slice_new(InfTextChunkSegment);
+  segment->parent = NULL;
+  segment->left = NULL;
+  segment->right = NULL;
+  segment->priority = inf_text_chunk_next_priority(self);
+  segment->sum = chars;
+
+  segment->author = author;
+  segment->storage = inf_text_chunk_storage_new(text, bytes, bytes);
+  segment->text = INF_TEXT_CHUNK_STORAGE_DATA(segment->storage);
+  segment->length = bytes;
+  segment->chars = chars;
+  segment->index = NULL;
+
+  return segment;
+}
+
+/* Creates a new segment for self which shares the text of source, starting
+ * at byte index begin. */
+static InfTextChunkSegment*
+inf_text_chunk_segment_new_shared(InfTextChunk* self,
+                                  InfTextChunkSegment* source,
+                                  gsize begin,
+                                  gsize bytes,
+                                  guint chars)
+{
+  InfTextChunkSegment* segment;
+
+  g_assert(begin + bytes <= source->length);
+
+  segment = g_slice_new(InfTextChunkSegment);
+  segment->parent = NULL;
+  segment->left = NULL;
+  segment->right = NULL;
+  segment->priority = inf_text_chunk_next_priority(self);
+  segment->sum = chars;
+
+  segment->author = source->author;
+  segment->storage = source->storage;
+  segment->text = source->text + begin;
+  segment->length = bytes;
+  segment->chars = chars;
+  segment->index = NULL;
+
+  g_atomic_int_inc(&segment->storage->ref_count);
+  return segment;
+}
+
 static void
 inf_text_chunk_segment_free(InfTextChunkSegment* segment)
 {
-  g_free(segment->text);
+  if(segment->index != NULL)
+  {
+    g_free(segment->index->chars);
+    g_slice_free(InfTextChunkIndex, segment->index);
+  }
+
+  inf_text_chunk_storage_unref(segment->storage);
   g_slice_free(InfTextChunkSegment, segment);
 }
 
-static int
-inf_text_chunk_segment_cmp(gconstpointer first,
-                           gconstpointer second,
-                           gpointer userdata)
+/* Makes sure that segment owns its storage exclusively, that its text
+ * starts at the beginning of the storage, and that there is room for size
+ * bytes, so that the text can be modified in place. */
+static void
+inf_text_chunk_segment_make_writable(InfTextChunkSegment* segment,
+                                     gsize size)
 {
-  const InfTextChunkSegment* first_segment;
-  const InfTextChunkSegment* second_segment;
- 
-  first_segment  = (const InfTextChunkSegment*)first;
-  second_segment = (const InfTextChunkSegment*)second;
+  InfTextChunkStorage* storage;
 
-  g_return_val_if_fail(second != NULL && first != NULL, 0);
+  storage = segment->storage;
 
-  if (first_segment->offset < second_segment->offset)
-    return -1;
-  else if (first_segment->offset == second_segment->offset)
-    return 0;
+  if(g_atomic_int_get(&storage->ref_count) == 1 &&
+     segment->text == INF_TEXT_CHUNK_STORAGE_DATA(storage))
+  {
+    if(storage->size < size)
+    {
+      /* Grow by a factor, so that typing into a segment does not need to
+       * reallocate on every keypress. */
+      size = MAX(size, storage->size + storage->size / 2);
+      storage = g_realloc(storage, sizeof(InfTextChunkStorage) + size);
+      storage->size = size;
+    }
+  }
   else
-    return 1;
+  {
+    storage = inf_text_chunk_storage_new(
+      segment->text,
+      segment->length,
+      MAX(size, segment->length)
+    );
+
+    inf_text_chunk_storage_unref(segment->storage);
+  }
+
+  segment->storage = storage;
+  segment->text = INF_TEXT_CHUNK_STORAGE_DATA(storage);
 }
 
-/* This is a special comparison function which is only used
- * in inf_text_chunk_get_segment. It makes sure that when two segments
- * have the same offset, the second one gets sorted behind. This ensures
- * that the first segment in the sequence is never returned, since it
- * always has offset 0, which is a precondition for the algorithm
- * in inf_text_chunk_get_segment. See also libinfinity github issue #10. */
-static int
-inf_text_chunk_segment_cmp_for_get_segment(gconstpointer first,
-                                           gconstpointer second,
-                                           gpointer userdata)
+/* Needs to be called when the text of segment changes behind the byte
+ * position pos. */
+static void
+inf_text_chunk_segment_invalidate(InfTextChunkSegment* segment,
+                                  gsize pos)
 {
-  const InfTextChunkSegment* first_segment;
-  const InfTextChunkSegment* second_segment;
+  if(segment->index != NULL)
+  {
+    segment->index->n_valid = MIN(
+      segment->index->n_valid,
+      pos / INF_TEXT_CHUNK_INDEX_INTERVAL + 1
+    );
+  }
+}
 
-  first_segment  = (const InfTextChunkSegment*)first;
-  second_segment = (const InfTextChunkSegment*)second;
+/* Returns the byte index of the character at offset within segment */
+static gsize
+inf_text_chunk_segment_get_byte_index(InfTextChunk* self,
+                                      InfTextChunkSegment* segment,
+                                      guint offset)
+{
+  InfTextChunkIndex* index;
+  guint n_checkpoints;
+  guint begin;
+  guint end;
+  guint mid;
+  gsize pos;
+
+  if(segment->index == NULL)
+  {
+    if(segment->length <= INF_TEXT_CHUNK_INDEX_THRESHOLD ||
+       self->path->get_length == NULL)
+    {
+      return self->path->get_byte_index(
+        self,
+        segment->text,
+        segment->length,
+        offset
+      );
+    }
 
-  g_return_val_if_fail(second != NULL && first != NULL, 0);
+    segment->index = g_slice_new(InfTextChunkIndex);
+    segment->index->chars = g_malloc(sizeof(guint));
+    segment->index->chars[0] = 0;
+    segment->index->n_valid = 1;
+    segment->index->n_allocated = 1;
+  }
 
-  if (first_segment->offset < second_segment->offset)
-    return -1;
-  else if (first_segment->offset == second_segment->offset)
-    return -1;
-  else
-    return 1;
+  index = segment->index;
+  n_checkpoints = segment->length / INF_TEXT_CHUNK_INDEX_INTERVAL + 1;
+
+  if(index->n_allocated < n_checkpoints)
+  {
+    index->chars = g_realloc(index->chars, n_checkpoints * sizeof(guint));
+    index->n_allocated = n_checkpoints;
+  }
+
+  /* Build the index up to the first checkpoint behind offset */
+  while(index->n_valid < n_checkpoints &&
+        index->chars[index->n_valid - 1] <= offset)
+  {
+    pos = (index->n_valid - 1) * INF_TEXT_CHUNK_INDEX_INTERVAL;
+
+    index->chars[index->n_valid] = index->chars[index->n_valid - 1] +
+      self->path->get_length(
+        self,
+        segment->text + pos,
+        INF_TEXT_CHUNK_INDEX_INTERVAL
+      );
+
+    ++index->n_valid;
+  }
+
+  /* Find the last checkpoint in front of offset */
+  begin = 0;
+  end = index->n_valid;
+  while(end - begin > 1)
+  {
+    mid = (begin + end) / 2;
+    if(index->chars[mid] <= offset)
+      begin = mid;
+    else
+      end = mid;
+  }
+
+  /* The checkpoint may be in the middle of a character, but
+   * get_byte_index skips the rest of it. */
+  pos = begin * INF_TEXT_CHUNK_INDEX_INTERVAL;
+  return pos + self->path->get_byte_index(
+    self,
+    segment->text + pos,
+    segment->length - pos,
+    offset - index->chars[begin]
+  );
 }
 
-static guint
-inf_text_chunk_next_offset(InfTextChunk* self,
-                           GSequenceIter* iter)
+static void
+inf_text_chunk_segment_free_tree(InfTextChunk* self,
+                                 InfTextChunkSegment* segment)
 {
-  GSequenceIter* next_iter;
+  if(segment->left != NULL)
+    inf_text_chunk_segment_free_tree(self, segment->left);
+  if(segment->right != NULL)
+    inf_text_chunk_segment_free_tree(self, segment->right);
 
-  g_assert(iter != g_sequence_get_end_iter(self->segments));
-  
-  next_iter = g_sequence_iter_next(iter);
-  if(next_iter == g_sequence_get_end_iter(self->segments))
-    return self->length;
-  else
-    return ((InfTextChunkSegment*)g_sequence_get(next_iter))->offset;
+  if(segment != &self->end)
+    inf_text_chunk_segment_free(segment);
 }
 
-#ifdef CHUNK_CHECK_INTEGRITY
-static gboolean
-inf_text_chunk_check_integrity(InfTextChunk* self)
+static guint
+inf_text_chunk_segment_sum(InfTextChunkSegment* segment)
+{
+  if(segment == NULL)
+    return 0;
+  return segment->sum;
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_segment_first(InfTextChunk* self)
 {
-  GSequenceIter* iter;
   InfTextChunkSegment* segment;
+
+  segment = self->root;
+  while(segment->left != NULL)
+    segment = segment->left;
+
+  return segment;
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_segment_next(InfTextChunkSegment* segment)
+{
+  if(segment->right != NULL)
+  {
+    segment = segment->right;
+    while(segment->left != NULL)
+      segment = segment->left;
+    return segment;
+  }
+
+  while(segment->parent != NULL && segment->parent->right == segment)
+    segment = segment->parent;
+
+  return segment->parent;
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_segment_prev(InfTextChunkSegment* segment)
+{
+  if(segment->left != NULL)
+  {
+    segment = segment->left;
+    while(segment->right != NULL)
+      segment = segment->right;
+    return segment;
+  }
+
+  while(segment->parent != NULL && segment->parent->left == segment)
+    segment = segment->parent;
+
+  return segment->parent;
+}
+
+/* Returns the character offset of segment from the beginning of the chunk */
+static guint
+inf_text_chunk_segment_offset(InfTextChunkSegment* segment)
+{
   guint offset;
-  guint new_offset;
 
-  offset = 0;
+  offset = inf_text_chunk_segment_sum(segment->left);
+  for(; segment->parent != NULL; segment = segment->parent)
+  {
+    if(segment->parent->right == segment)
+    {
+      offset += inf_text_chunk_segment_sum(segment->parent->left) +
+        segment->parent->chars;
+    }
+  }
+
+  return offset;
+}
 
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
+/* Changes the number of characters in segment, and updates the subtree
+ * sums of its ancestors accordingly. */
+static void
+inf_text_chunk_segment_set_chars(InfTextChunkSegment* segment,
+                                 guint chars)
+{
+  InfTextChunkSegment* node;
+  guint old_chars;
+
+  old_chars = segment->chars;
+  segment->chars = chars;
+
+  for(node = segment; node != NULL; node = node->parent)
+    node->sum = node->sum - old_chars + chars;
+}
+
+/* Rotates segment above its parent, keeping the in-order sequence */
+static void
+inf_text_chunk_segment_rotate_up(InfTextChunk* self,
+                                 InfTextChunkSegment* segment)
+{
+  InfTextChunkSegment* parent;
+  InfTextChunkSegment* grandparent;
+
+  parent = segment->parent;
+  grandparent = parent->parent;
+
+  if(parent->left == segment)
+  {
+    parent->left = segment->right;
+    if(parent->left != NULL)
+      parent->left->parent = parent;
+    segment->right = parent;
+  }
+  else
   {
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
-    if(offset != segment->offset)
+    parent->right = segment->left;
+    if(parent->right != NULL)
+      parent->right->parent = parent;
+    segment->left = parent;
+  }
+
+  parent->parent = segment;
+  segment->parent = grandparent;
+
+  if(grandparent == NULL)
+    self->root = segment;
+  else if(grandparent->left == parent)
+    grandparent->left = segment;
+  else
+    grandparent->right = segment;
+
+  /* segment now spans the same range as parent did before */
+  segment->sum = parent->sum;
+  parent->sum = inf_text_chunk_segment_sum(parent->left) +
+    inf_text_chunk_segment_sum(parent->right) + parent->chars;
+}
+
+/* Inserts segment into the tree, in front of position */
+static void
+inf_text_chunk_segment_insert_before(InfTextChunk* self,
+                                     InfTextChunkSegment* position,
+                                     InfTextChunkSegment* segment)
+{
+  InfTextChunkSegment* node;
+
+  g_assert(segment->parent == NULL);
+  g_assert(segment->left == NULL && segment->right == NULL);
+
+  if(position->left == NULL)
+  {
+    position->left = segment;
+    segment->parent = position;
+  }
+  else
+  {
+    node = position->left;
+    while(node->right != NULL)
+      node = node->right;
+
+    node->right = segment;
+    segment->parent = node;
+  }
+
+  for(node = segment->parent; node != NULL; node = node->parent)
+    node->sum += segment->chars;
+
+  while(segment->parent != NULL &&
+        segment->parent->priority < segment->priority)
+  {
+    inf_text_chunk_segment_rotate_up(self, segment);
+  }
+}
+
+static void
+inf_text_chunk_segment_append(InfTextChunk* self,
+                              InfTextChunkSegment* segment)
+{
+  inf_text_chunk_segment_insert_before(self, &self->end, segment);
+}
+
+/* Removes segment from the tree, without freeing it */
+static void
+inf_text_chunk_segment_remove(InfTextChunk* self,
+                              InfTextChunkSegment* segment)
+{
+  InfTextChunkSegment* child;
+  InfTextChunkSegment* node;
+
+  g_assert(segment != &self->end);
+
+  /* Move the segment down until it is a leaf */
+  while(segment->left != NULL || segment->right != NULL)
+  {
+    if(segment->left == NULL)
+      child = segment->right;
+    else if(segment->right == NULL)
+      child = segment->left;
+    else if(segment->left->priority > segment->right->priority)
+      child = segment->left;
+    else
+      child = segment->right;
+
+    inf_text_chunk_segment_rotate_up(self, child);
+  }
+
+  /* The sentinel is always in the tree, so segment is not the root */
+  g_assert(segment->parent != NULL);
+
+  for(node = segment->parent; node != NULL; node = node->parent)
+    node->sum -= segment->chars;
+
+  if(segment->parent->left == segment)
+    segment->parent->left = NULL;
+  else
+    segment->parent->right = NULL;
+
+  segment->parent = NULL;
+}
+
+#ifdef CHUNK_CHECK_INTEGRITY
+static gboolean
+inf_text_chunk_check_subtree(InfTextChunk* self,
+                             InfTextChunkSegment* segment)
+{
+  if(segment->left != NULL)
+  {
+    if(segment->left->parent != segment)
+      return FALSE;
+    if(segment->left->priority > segment->priority)
       return FALSE;
+    if(!inf_text_chunk_check_subtree(self, segment->left))
+      return FALSE;
+  }
 
-    new_offset = inf_text_chunk_next_offset(self, iter);
-    if(new_offset <= offset)
+  if(segment->right != NULL)
+  {
+    if(segment->right->parent != segment)
       return FALSE;
+    if(segment->right->priority > segment->priority)
+      return FALSE;
+    if(!inf_text_chunk_check_subtree(self, segment->right))
+      return FALSE;
+  }
 
-    if(new_offset - offset > segment->length)
+  if(segment != &self->end)
+  {
+    if(segment->chars == 0 || segment->chars > segment->length)
+      return FALSE;
+    if(segment->text < INF_TEXT_CHUNK_STORAGE_DATA(segment->storage))
+      return FALSE;
+    if(segment->text + segment->length >
+       INF_TEXT_CHUNK_STORAGE_DATA(segment->storage) + segment->storage->size)
+    {
       return FALSE;
+    }
+  }
 
-    offset = new_offset;
+  if(segment->sum != inf_text_chunk_segment_sum(segment->left) +
+                     inf_text_chunk_segment_sum(segment->right) +
+                     segment->chars)
+  {
+    return FALSE;
   }
 
   return TRUE;
 }
+
+static gboolean
+inf_text_chunk_check_integrity(InfTextChunk* self)
+{
+  if(self->root->parent != NULL)
+    return FALSE;
+  if(self->root->sum != self->length)
+    return FALSE;
+  if(self->end.right != NULL || self->end.chars != 0)
+    return FALSE;
+  if(inf_text_chunk_segment_next(&self->end) != NULL)
+    return FALSE;
+
+  return inf_text_chunk_check_subtree(self, self->root);
+}
 #endif
 
-static GSequenceIter*
+/* Returns the segment containing the character at pos. If pos is at the
+ * boundary of two segments, the latter one is returned, except at the end
+ * of the chunk, where the last segment is returned. index is set to the
+ * byte index of pos within the segment, and offset to the character
+ * offset of the segment within the chunk. If the chunk is empty, the end
+ * sentinel is returned. */
+static InfTextChunkSegment*
 inf_text_chunk_get_segment(InfTextChunk* self,
                            guint pos,
-                           gsize* index)
+                           gsize* index,
+                           guint* offset)
 {
   InfTextChunkSegment* found;
-  InfTextChunkSegment key;
-  GSequenceIter* iter;
+  guint begin;
+  guint left;
 
   g_assert(pos <= self->length);
 
-  /* only offset is relevant for lookup */
-  key.offset = pos;
-
-  /* TODO: Verify this does binary search */
-  iter = g_sequence_search(
-    self->segments,
-    &key,
-    inf_text_chunk_segment_cmp_for_get_segment,
-    NULL
-  );
+  if(self->length == 0)
+  {
+    if(index != NULL) *index = 0;
+    if(offset != NULL) *offset = 0;
+    return &self->end;
+  }
 
-  if(self->length > 0)
+  if(pos == self->length)
   {
-    g_assert(iter != g_sequence_get_begin_iter(self->segments));
+    found = inf_text_chunk_segment_prev(&self->end);
+    g_assert(found != NULL);
 
-    iter = g_sequence_iter_prev(iter);
-    found = g_sequence_get(iter);
+    if(index != NULL) *index = found->length;
+    if(offset != NULL) *offset = self->length - found->chars;
+    return found;
+  }
 
-    g_assert(pos >= found->offset);
+  found = self->root;
+  begin = 0;
 
-    /* This is not "<=" because it should rather find position 0 on the
-     * next segment in that case. */
-    g_assert(pos <= inf_text_chunk_next_offset(self, iter));
+  for(;;)
+  {
+    left = inf_text_chunk_segment_sum(found->left);
 
-    /* Find byte index in the segment where the specified character starts.
-     * This is rather ugly, I wish iconv or glib or someone had some nice(r)
-     * API for this. */
-    if(index != NULL)
+    if(pos < begin + left)
     {
-      if(pos == inf_text_chunk_next_offset(self, iter))
-      {
-        *index = found->length;
-      }
-      else
-      {
-        *index = self->path->get_byte_index(
-          self,
-          found->text,
-          found->length,
-          pos - found->offset
-        );
-      }
+      found = found->left;
+    }
+    else if(pos < begin + left + found->chars)
+    {
+      begin += left;
+      break;
+    }
+    else
+    {
+      begin += left + found->chars;
+      found = found->right;
     }
+
+    /* Cannot run off the tree since pos < self->length */
+    g_assert(found != NULL);
   }
-  else
+
+  /* Find byte index in the segment where the specified character starts.
+   * This is rather ugly, I wish iconv or glib or someone had some nice(r)
+   * API for this. */
+  if(index != NULL)
   {
-    if(index != NULL)
+    if(pos == begin)
+    {
       *index = 0;
+    }
+    else
+    {
+      *index = inf_text_chunk_segment_get_byte_index(
+        self,
+        found,
+        pos - begin
+      );
+    }
   }
-  
-  return iter;
+
+  if(offset != NULL) *offset = begin;
+  return found;
 }
 
 /*
@@ -373,10 +918,7 @@ InfTextChunk*
 inf_text_chunk_new(const gchar* encoding)
 {
   InfTextChunk* chunk = g_slice_new(InfTextChunk);
-  
-  chunk->segments = g_sequence_new(
-    (GDestroyNotify)inf_text_chunk_segment_free
-  );
+  inf_text_chunk_init_segments(chunk);
 
   chunk->length = 0;
   chunk->encoding = g_quark_from_string(encoding);
@@ -401,26 +943,27 @@ InfTextChunk*
 inf_text_chunk_copy(InfTextChunk* self)
 {
   InfTextChunk* new_chunk;
-  GSequenceIter* iter;
+  InfTextChunkSegment* segment;
+  InfTextChunkSegment* new_segment;
 
   g_return_val_if_fail(self != NULL, NULL);
 
   new_chunk = g_slice_new(InfTextChunk);
-  new_chunk->segments = g_sequence_new(
-    (GDestroyNotify)inf_text_chunk_segment_free
-  );
-  
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
+  inf_text_chunk_init_segments(new_chunk);
+
+  for(segment = inf_text_chunk_segment_first(self);
+      segment != &self->end;
+      segment = inf_text_chunk_segment_next(segment))
   {
-    InfTextChunkSegment* segment = g_sequence_get(iter);
-    InfTextChunkSegment* new_segment = g_slice_new(InfTextChunkSegment);
-    new_segment->author = segment->author;
-    new_segment->text = g_memdup(segment->text, segment->length);
-    new_segment->length = segment->length;
-    new_segment->offset = segment->offset;
-    g_sequence_append(new_chunk->segments, new_segment);
+    new_segment = inf_text_chunk_segment_new_shared(
+      new_chunk,
+      segment,
+      0,
+      segment->length,
+      segment->chars
+    );
+
+    inf_text_chunk_segment_append(new_chunk, new_segment);
   }
 
   new_chunk->length = self->length;
@@ -441,7 +984,7 @@ void
 inf_text_chunk_free(InfTextChunk* self)
 {
   g_return_if_fail(self != NULL);
-  g_sequence_free(self->segments);
+  inf_text_chunk_segment_free_tree(self, self->root);
   g_slice_free(InfTextChunk, self);
 }
 
@@ -491,79 +1034,81 @@ inf_text_chunk_substring(InfTextChunk* self,
                          guint begin,
                          guint length)
 {
-  GSequenceIter* begin_iter;
-  GSequenceIter* end_iter;
+  InfTextChunkSegment* segment;
+  InfTextChunkSegment* end_segment;
   gsize begin_index;
   gsize end_index;
+  guint segment_offset;
 
   InfTextChunk* result;
-  InfTextChunkSegment* segment;
   InfTextChunkSegment* new_segment;
-  guint current_length;
+  guint remaining;
+  guint chars;
 
   g_return_val_if_fail(self != NULL, NULL);
   g_return_val_if_fail(begin + length <= self->length, NULL);
 
   if(self->length > 0 && length > 0)
   {
-    begin_iter = inf_text_chunk_get_segment(self, begin, &begin_index);
-    end_iter = inf_text_chunk_get_segment(self, begin + length, &end_index);
+    segment = inf_text_chunk_get_segment(
+      self,
+      begin,
+      &begin_index,
+      &segment_offset
+    );
+
+    end_segment = inf_text_chunk_get_segment(
+      self,
+      begin + length,
+      &end_index,
+      NULL
+    );
 
     if(end_index == 0)
     {
-      g_assert(end_iter != g_sequence_get_end_iter(self->segments));
-      end_iter = g_sequence_iter_prev(end_iter);
-      end_index = ((InfTextChunkSegment*)g_sequence_get(end_iter))->length;
+      end_segment = inf_text_chunk_segment_prev(end_segment);
+      g_assert(end_segment != NULL);
+      end_index = end_segment->length;
     }
 
     result = inf_text_chunk_new(g_quark_to_string(self->encoding));
 
-    current_length = 0;
-    segment = g_sequence_get(begin_iter);
+    /* Characters of the first segment behind begin */
+    chars = segment->chars - (begin - segment_offset);
+    remaining = length;
 
-    while(begin_iter != end_iter)
+    while(segment != end_segment)
     {
-      new_segment = g_slice_new(InfTextChunkSegment);
-      new_segment->author = segment->author;
-
-      new_segment->text = g_memdup(
-        segment->text + begin_index,
-        segment->length - begin_index
+      new_segment = inf_text_chunk_segment_new_shared(
+        result,
+        segment,
+        begin_index,
+        segment->length - begin_index,
+        chars
       );
-      
-      new_segment->length = segment->length - begin_index;
-      new_segment->offset = current_length;
 
-      begin_iter = g_sequence_iter_next(begin_iter);
-      segment = g_sequence_get(begin_iter);
+      inf_text_chunk_segment_append(result, new_segment);
+      remaining -= chars;
 
-      /* Add (remaining) length of this segment to current length */
-      current_length = segment->offset - begin;
+      segment = inf_text_chunk_segment_next(segment);
+      chars = segment->chars;
 
       /* So we get the next segment from the beginning. This may only be
        * non-zero during the first iteration. */
       begin_index = 0;
-    /*  begin = new_segment->offset;*/
-      
-      g_sequence_append(result->segments, new_segment);
     }
 
     /* Don't forget last segment */
-    new_segment = g_slice_new(InfTextChunkSegment);
-    new_segment->author = segment->author;
-    new_segment->text = g_memdup(
-      segment->text + begin_index,
-      end_index - begin_index
+    new_segment = inf_text_chunk_segment_new_shared(
+      result,
+      segment,
+      begin_index,
+      end_index - begin_index,
+      remaining
     );
-    
-    new_segment->length = end_index - begin_index;
-    new_segment->offset = current_length;
-    
-    g_sequence_append(result->segments, new_segment);
 
+    inf_text_chunk_segment_append(result, new_segment);
     result->length = length;
-    result->encoding = self->encoding;
-    result->path = self->path;
   }
   else
   {
@@ -580,49 +1125,45 @@ inf_text_chunk_substring(InfTextChunk* self,
   return result;
 }
 
-/**
- * inf_text_chunk_insert_text:
- * @self: A #InfTextChunk.
- * @offset: Character offset at which to insert text
- * @text (type const guint8*) (array length=bytes) (transfer none): Text
- * to insert.
- * @length: Number of characters contained in @text.
- * @bytes: Number of bytes of @text.
- * @author: User that wrote @text.
- *
- * Inserts text written by @author into @self. @text is expected to be in
- * the chunk's encoding.
- **/
-void
-inf_text_chunk_insert_text(InfTextChunk* self,
-                           guint offset,
-                           gconstpointer text,
-                           gsize bytes,
-                           guint length,
-                           guint author)
+/* Inserts text into self. If source is non-NULL, text is the text of
+ * source, and a new segment for it shares its storage. */
+static void
+inf_text_chunk_insert_text_internal(InfTextChunk* self,
+                                    guint offset,
+                                    gconstpointer text,
+                                    gsize bytes,
+                                    guint length,
+                                    guint author,
+                                    InfTextChunkSegment* source)
 {
-  GSequenceIter* iter;
-  gsize offset_index;
   InfTextChunkSegment* segment;
+  InfTextChunkSegment* position;
   InfTextChunkSegment* new_segment;
+  gsize offset_index;
+  guint segment_offset;
 
-  g_return_if_fail(self != NULL);
-  g_return_if_fail(offset <= self->length);
+  /* Segments are never empty */
+  if(length == 0)
+    return;
 
   if(self->length > 0)
   {
-    iter = inf_text_chunk_get_segment(self, offset, &offset_index);
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
+    segment = inf_text_chunk_get_segment(
+      self,
+      offset,
+      &offset_index,
+      &segment_offset
+    );
 
     /* Have to split segment, unless it is between two segments in which
      * case we can perhaps append to the previous. */
     if(segment->author != author && offset > 0 && offset_index == 0)
     {
-      g_assert(iter != g_sequence_get_begin_iter(self->segments));
+      segment = inf_text_chunk_segment_prev(segment);
+      g_assert(segment != NULL);
 
-      iter = g_sequence_iter_prev(iter);
-      segment = (InfTextChunkSegment*)g_sequence_get(iter);
       offset_index = segment->length;
+      segment_offset = offset - segment->chars;
     }
 
     if(segment->author != author)
@@ -630,40 +1171,54 @@ inf_text_chunk_insert_text(InfTextChunk* self,
       /* No luck, split if necessary */
       if(offset_index > 0 && offset_index < segment->length)
       {
-        new_segment = g_slice_new(InfTextChunkSegment);
-        new_segment->author = segment->author;
-        new_segment->text = g_memdup(
-          segment->text + offset_index,
-          segment->length - offset_index
+        new_segment = inf_text_chunk_segment_new_shared(
+          self,
+          segment,
+          offset_index,
+          segment->length - offset_index,
+          segment->chars - (offset - segment_offset)
         );
 
-        new_segment->length = segment->length - offset_index;
-        new_segment->offset = offset;
-
-        iter = g_sequence_iter_next(iter);
-        iter = g_sequence_insert_before(iter, new_segment);
+        inf_text_chunk_segment_insert_before(
+          self,
+          inf_text_chunk_segment_next(segment),
+          new_segment
+        );
 
-        /* Don't realloc to make smaller */
+        /* The text behind offset_index is still referenced by the new
+         * segment, so just shorten this one. */
         segment->length = offset_index;
-        /* Note that we did not invalidate offsets so far */
+        inf_text_chunk_segment_invalidate(segment, offset_index);
+        inf_text_chunk_segment_set_chars(segment, offset - segment_offset);
+
+        position = new_segment;
       }
       else if(offset_index == segment->length)
       {
         /* Insert behind segment */
-        iter = g_sequence_iter_next(iter);
+        position = inf_text_chunk_segment_next(segment);
+      }
+      else
+      {
+        position = segment;
+      }
+
+      if(source != NULL)
+      {
+        new_segment =
+          inf_text_chunk_segment_new_shared(self, source, 0, bytes, length);
+      }
+      else
+      {
+        new_segment =
+          inf_text_chunk_segment_new(self, author, text, bytes, length);
       }
 
-      new_segment = g_slice_new(InfTextChunkSegment);
-      new_segment->author = author;
-      new_segment->text = g_memdup(text, bytes);
-      new_segment->length = bytes;
-      new_segment->offset = offset;
-      g_sequence_insert_before(iter, new_segment);
+      inf_text_chunk_segment_insert_before(self, position, new_segment);
     }
     else
     {
-      /* TODO: g_malloc + g_free + 2*memcpy? */
-      segment->text = g_realloc(segment->text, segment->length + bytes);
+      inf_text_chunk_segment_make_writable(segment, segment->length + bytes);
       if(offset_index < segment->length)
       {
         g_memmove(
@@ -672,31 +1227,29 @@ inf_text_chunk_insert_text(InfTextChunk* self,
           segment->length - offset_index
         );
       }
-      
+
       memcpy(segment->text + offset_index, text, bytes);
+      inf_text_chunk_segment_invalidate(segment, offset_index);
       segment->length += bytes;
-      iter = g_sequence_iter_next(iter);
-    }
-
-    /* Adjust offsets */
-    while(iter != g_sequence_get_end_iter(self->segments))
-    {
-      segment = (InfTextChunkSegment*)g_sequence_get(iter);
-      segment->offset += length;
-      iter = g_sequence_iter_next(iter);
+      inf_text_chunk_segment_set_chars(segment, segment->chars + length);
     }
 
     self->length += length;
   }
   else
   {
-    new_segment = g_slice_new(InfTextChunkSegment);
-    new_segment->author = author;
-    new_segment->text = g_memdup(text, bytes);
-    new_segment->length = bytes;
-    new_segment->offset = 0;
+    if(source != NULL)
+    {
+      new_segment =
+        inf_text_chunk_segment_new_shared(self, source, 0, bytes, length);
+    }
+    else
+    {
+      new_segment =
+        inf_text_chunk_segment_new(self, author, text, bytes, length);
+    }
 
-    g_sequence_append(self->segments, new_segment);
+    inf_text_chunk_segment_append(self, new_segment);
     self->length = length;
   }
 
@@ -705,6 +1258,41 @@ inf_text_chunk_insert_text(InfTextChunk* self,
 #endif
 }
 
+/**
+ * inf_text_chunk_insert_text:
+ * @self: A #InfTextChunk.
+ * @offset: Character offset at which to insert text
+ * @text (type const guint8*) (array length=bytes) (transfer none): Text
+ * to insert.
+ * @length: Number of characters contained in @text.
+ * @bytes: Number of bytes of @text.
+ * @author: User that wrote @text.
+ *
+ * Inserts text written by @author into @self. @text is expected to be in
+ * the chunk's encoding.
+ **/
+void
+inf_text_chunk_insert_text(InfTextChunk* self,
+                           guint offset,
+                           gconstpointer text,
+                           gsize bytes,
+                           guint length,
+                           guint author)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(offset <= self->length);
+
+  inf_text_chunk_insert_text_internal(
+    self,
+    offset,
+    text,
+    bytes,
+    length,
+    author,
+    NULL
+  );
+}
+
 /**
  * inf_text_chunk_insert_chunk:
  * @self: A #InfTextChunk.
@@ -719,20 +1307,17 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
                             guint offset,
                             InfTextChunk* text)
 {
-  GSequenceIter* iter;
-  GSequenceIter* text_iter;
-  gsize offset_index;
   InfTextChunkSegment* segment;
   InfTextChunkSegment* new_segment;
+  gsize offset_index;
+  guint segment_offset;
 
-  GSequenceIter* first_iter;
-  GSequenceIter* last_iter;
   InfTextChunkSegment* first;
   InfTextChunkSegment* last;
+  InfTextChunkSegment* stop;
 
-  InfTextChunkSegment* first_merge;
-  InfTextChunkSegment* last_merge;
-  GSequenceIter* beyond;
+  InfTextChunkSegment* before;
+  InfTextChunkSegment* after;
 
   g_return_if_fail(self != NULL);
   g_return_if_fail(offset <= self->length);
@@ -741,217 +1326,131 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
 
   if(self->length > 0 && text->length > 0)
   {
-    if(g_sequence_get_length(text->segments) == 1)
-    {
-      segment = g_sequence_get(g_sequence_get_begin_iter(text->segments));
+    first = inf_text_chunk_segment_first(text);
+    last = inf_text_chunk_segment_prev(&text->end);
 
-      inf_text_chunk_insert_text(
+    if(first == last)
+    {
+      inf_text_chunk_insert_text_internal(
         self,
         offset,
-        segment->text,
-        segment->length,
+        first->text,
+        first->length,
         text->length,
-        segment->author
+        first->author,
+        first
       );
     }
     else
     {
-      iter = inf_text_chunk_get_segment(self, offset, &offset_index);
-      segment = (InfTextChunkSegment*)g_sequence_get(iter);
-
-      /* First, we insert the first and last segment of text into self,
-       * possibly merging with adjacent segments. Then, the rest is
-       * copied. */
-      first_iter = g_sequence_get_begin_iter(text->segments);
-      last_iter = g_sequence_iter_prev(
-        g_sequence_get_end_iter(text->segments)
+      segment = inf_text_chunk_get_segment(
+        self,
+        offset,
+        &offset_index,
+        &segment_offset
       );
 
-      first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-      last = (InfTextChunkSegment*)g_sequence_get(last_iter);
+      /* Find the segments between which text is inserted, splitting the
+       * segment at offset if offset lies within it. before is NULL when
+       * inserting at the beginning, and after is the end sentinel when
+       * inserting at the end. */
+      if(offset == 0)
+      {
+        before = NULL;
+        after = segment;
+      }
+      else if(offset_index == 0)
+      {
+        before = inf_text_chunk_segment_prev(segment);
+        after = segment;
+      }
+      else if(offset_index == segment->length)
+      {
+        before = segment;
+        after = inf_text_chunk_segment_next(segment);
+      }
+      else
+      {
+        after = inf_text_chunk_segment_new_shared(
+          self,
+          segment,
+          offset_index,
+          segment->length - offset_index,
+          segment->chars - (offset - segment_offset)
+        );
+
+        inf_text_chunk_segment_insert_before(
+          self,
+          inf_text_chunk_segment_next(segment),
+          after
+        );
 
-      /* 0 and 1 segment special cases have been handled above */
-      g_assert(first != last);
+        /* The text behind offset_index is still referenced by the new
+         * segment, so just shorten this one. */
+        segment->length = offset_index;
+        inf_text_chunk_segment_invalidate(segment, offset_index);
+        inf_text_chunk_segment_set_chars(segment, offset - segment_offset);
 
-      last_merge = segment;
-      first_merge = segment;
+        before = segment;
+      }
 
-      /* beyond points to the first segment that needs offset adjustment
-       * after insertion */
-      beyond = iter;
+      /* Segments of text in [first, stop) still need to be copied */
+      stop = &text->end;
 
-      /* Try merge with end of previous segment if inserting inbetween two
-       * segments. */
-      if(offset_index == 0 && offset > 0)
+      if(before != NULL && before->author == first->author)
       {
-        g_assert(iter != g_sequence_get_begin_iter(self->segments));
+        /* Can merge first segment */
+        inf_text_chunk_segment_make_writable(
+          before,
+          before->length + first->length
+        );
 
-        iter = g_sequence_iter_prev(iter);
-        first_merge = (InfTextChunkSegment*)g_sequence_get(iter);
-        offset_index = first_merge->length;
-      }
+        inf_text_chunk_segment_invalidate(before, before->length);
+        memcpy(before->text + before->length, first->text, first->length);
+        before->length += first->length;
 
-      if(offset == 0 || offset == self->length || first_merge != last_merge)
-      {
-        /* Insert between two segments, or at beginning/end */
-        if(first_merge->author == first->author && offset > 0)
-        {
-          /* Can merge first segment */
-          first_merge->length += first->length;
-
-          first_merge->text = g_realloc(
-            first_merge->text,
-            first_merge->length
-          );
-
-          memcpy(
-            first_merge->text + first_merge->length - first->length,
-            first->text,
-            first->length
-          );
-
-          /* Already inserted */
-          first_iter = g_sequence_iter_next(first_iter);
-        }
-
-        if(last_merge->author == last->author && offset < self->length)
-        {
-          /* Can merge last segment */
-          last_merge->length += last->length;
-          last_merge->text = g_realloc(last_merge->text, last_merge->length);
-
-          g_memmove(
-            last_merge->text + last->length,
-            last_merge->text,
-            last_merge->length - last->length
-          );
-
-          memcpy(last_merge->text, last->text, last->length);
-          last_merge->offset = offset + last->offset;
-
-          /* Merged with last, so don't need to adjust last_merge->offset
-           * anymore, continue behind with offset adjustment. */
-          beyond = g_sequence_iter_next(beyond);
-        }
-        else
-        {
-          /* Could not merge last segment, so we have to insert it. Therefore,
-           * make last_iter point to the end of the sequence. */
-          last_iter = g_sequence_iter_next(last_iter);
-
-          if(offset_index > 0) /* Note: This is only false for offset == 0 */
-            beyond = g_sequence_iter_next(iter);
-        }
-
-        if(offset_index > 0) /* Note: This is only false for offset == 0 */
-        {
-          /* Pointing to the position before which to insert
-           * the rest of text. */
-          iter = g_sequence_iter_next(iter);
-        }
+        inf_text_chunk_segment_set_chars(
+          before,
+          before->chars + first->chars
+        );
+
+        first = inf_text_chunk_segment_next(first);
       }
-      else
+
+      if(after != &self->end && after->author == last->author)
       {
-        /* Insert within a segment, split segment */
-
-        new_segment = g_slice_new(InfTextChunkSegment);
-        new_segment->author = last_merge->author;
-
-        if(last_merge->author == last->author)
-        {
-          /* Merge last part into new segment */
-          new_segment->length = last_merge->length - offset_index +
-            last->length;
-
-          new_segment->text = g_malloc(new_segment->length);
-          memcpy(new_segment->text, last->text, last->length);
-
-          memcpy(
-            new_segment->text + last->length,
-            last_merge->text + offset_index,
-            last_merge->length - offset_index
-          );
-
-          new_segment->offset = offset + last->offset;
-        }
-        else
-        {
-          /* Split up last part */
-          new_segment->length = last_merge->length - offset_index;
-          new_segment->text = g_malloc(new_segment->length);
-
-          memcpy(
-            new_segment->text,
-            last_merge->text + offset_index,
-            new_segment->length
-          );
-
-          new_segment->offset = offset + text->length;
-
-          /* We still have to insert last segment since we could not merge */
-          last_iter = g_sequence_iter_next(last_iter);
-        }
-
-        iter = g_sequence_iter_next(iter);
-        iter = g_sequence_insert_before(iter, new_segment);
-
-        /* The segment just inserted is the last one being inserted, so
-         * we need to adjust beyond that */
-        beyond = g_sequence_iter_next(iter);
-
-        /* Note first_merge == last_merge */
-        if(first_merge->author == first->author)
-        {
-          /* Merge into first */
-          if(first_merge->length < offset_index + first->length)
-          {
-            first_merge->text = g_realloc(
-              first_merge->text,
-              offset_index + first->length
-            );
-          }
-
-          first_merge->length = offset_index + first->length;
-
-          memcpy(
-            first_merge->text + offset_index,
-            first->text,
-            first->length
-          );
-
-          /* Already inserted */
-          first_iter = g_sequence_iter_next(first_iter);
-        }
-        else
-        {
-          /* Cannot merge, just cut */
-          first_merge->length = offset_index;
-        }
-      }
+        /* Can merge last segment */
+        inf_text_chunk_segment_make_writable(
+          after,
+          after->length + last->length
+        );
 
-      /* iter now points to the segment before which the rest of text has to
-       * be inserted */
+        inf_text_chunk_segment_invalidate(after, 0);
+        g_memmove(after->text + last->length, after->text, after->length);
+        memcpy(after->text, last->text, last->length);
+        after->length += last->length;
 
-      for(text_iter = first_iter;
-          text_iter != last_iter;
-          text_iter = g_sequence_iter_next(text_iter))
-      {
-        segment = g_sequence_get(text_iter);
-        new_segment = g_slice_new(InfTextChunkSegment);
-
-        new_segment->author = segment->author;
-        new_segment->text = g_memdup(segment->text, segment->length);
-        new_segment->length = segment->length;
-        new_segment->offset = offset + segment->offset;
-        g_sequence_insert_before(iter, new_segment);
+        inf_text_chunk_segment_set_chars(
+          after,
+          after->chars + last->chars
+        );
+
+        stop = last;
       }
 
-      for(iter = beyond;
-          iter != g_sequence_get_end_iter(self->segments);
-          iter = g_sequence_iter_next(iter))
+      for(segment = first;
+          segment != stop;
+          segment = inf_text_chunk_segment_next(segment))
       {
-        segment = g_sequence_get(iter);
-        segment->offset += inf_text_chunk_get_length(text);
+        new_segment = inf_text_chunk_segment_new_shared(
+          self,
+          segment,
+          0,
+          segment->length,
+          segment->chars
+        );
+
+        inf_text_chunk_segment_insert_before(self, after, new_segment);
       }
 
       self->length += text->length;
@@ -959,19 +1458,19 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
   }
   else
   {
-    for(text_iter = g_sequence_get_begin_iter(text->segments);
-        text_iter != g_sequence_get_end_iter(text->segments);
-        text_iter = g_sequence_iter_next(text_iter))
+    for(segment = inf_text_chunk_segment_first(text);
+        segment != &text->end;
+        segment = inf_text_chunk_segment_next(segment))
     {
-      segment = (InfTextChunkSegment*)g_sequence_get(text_iter);
-      new_segment = g_slice_new(InfTextChunkSegment);
-
-      new_segment->author = segment->author;
-      new_segment->text = g_memdup(segment->text, segment->length);
-      new_segment->length = segment->length;
-      new_segment->offset = segment->offset;
+      new_segment = inf_text_chunk_segment_new_shared(
+        self,
+        segment,
+        0,
+        segment->length,
+        segment->chars
+      );
 
-      g_sequence_append(self->segments, new_segment);
+      inf_text_chunk_segment_append(self, new_segment);
     }
 
     self->length += text->length;
@@ -995,173 +1494,126 @@ inf_text_chunk_erase(InfTextChunk* self,
                      guint begin,
                      guint length)
 {
-  GSequenceIter* first_iter;
-  GSequenceIter* last_iter;
-  GSequenceIter* beyond;
-  gsize first_index;
-  gsize last_index;
   InfTextChunkSegment* first;
   InfTextChunkSegment* last;
+  InfTextChunkSegment* before;
+  InfTextChunkSegment* next;
+  gsize first_index;
+  gsize last_index;
+  guint first_offset;
+  guint last_offset;
+  guint chars;
 
   g_return_if_fail(self != NULL);
   g_return_if_fail(begin + length <= self->length);
 
   if(self->length > 0 && length > 0)
   {
-    first_iter = inf_text_chunk_get_segment(self, begin, &first_index);
-    last_iter = inf_text_chunk_get_segment(self, begin + length, &last_index);
+    first = inf_text_chunk_get_segment(
+      self,
+      begin,
+      &first_index,
+      &first_offset
+    );
 
-    first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-    last = (InfTextChunkSegment*)g_sequence_get(last_iter);
+    last = inf_text_chunk_get_segment(
+      self,
+      begin + length,
+      &last_index,
+      &last_offset
+    );
 
-    if(begin > 0 && begin + length < self->length)
+    if(first == last)
     {
-      if(first_index == 0)
-      {
-        g_assert(first_iter != g_sequence_get_end_iter(self->segments));
-        first_iter = g_sequence_iter_prev(first_iter);
-        first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-        first_index = first->length;
-      }
+      /* Remove within a segment */
+      inf_text_chunk_segment_make_writable(first, first->length);
+
+      g_memmove(
+        first->text + first_index,
+        first->text + last_index,
+        first->length - last_index
+      );
+
+      first->length -= (last_index - first_index);
+      inf_text_chunk_segment_invalidate(first, first_index);
 
-      if(first->author == last->author)
+      /* This can only remove the segment completely if it is the last
+       * one, in which case there is nothing to merge afterwards. */
+      if(first->chars > length)
       {
-        /* Can merge */
-        if(first == last)
-        {
-          /* Remove within a segment */
-          g_memmove(
-            first->text + first_index,
-            first->text + last_index,
-            first->length - last_index
-          );
-
-          first->length -= (last_index - first_index);
-          beyond = g_sequence_iter_next(last_iter);
-        }
-        else
-        {
-          if(first->length < first_index + last->length - last_index)
-          {
-            first->text = g_realloc(
-              first->text,
-              first_index + last->length - last_index
-            );
-          }
-
-          first->length = first_index + last->length - last_index;
-
-          memcpy(
-            first->text + first_index,
-            last->text + last_index,
-            last->length - last_index
-          );
-
-          last_iter = g_sequence_iter_next(last_iter);
-          beyond = last_iter;
-        }
+        inf_text_chunk_segment_set_chars(first, first->chars - length);
       }
       else
       {
-        /* This could only happen if these are the first or last segment,
-         * of the whole chunk, respectively, which they are not
-         * (as checked above). */
-        g_assert(first_index > 0);
-        g_assert(last_index < last->length);
-        
-        /* Erase from border segments */
-        first->length = first_index;
-
-        if(last_index > 0)
-        {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
-        }
-
-        last->length -= last_index;
-        last->offset = begin;
-
-        /* We already adjusted offset of last, so only adjust behind */
-        beyond = g_sequence_iter_next(last_iter);
+        inf_text_chunk_segment_remove(self, first);
+        inf_text_chunk_segment_free(first);
       }
-
-      /* Keep first alive, we merged stuff into it */
-      first_iter = g_sequence_iter_next(first_iter);
     }
     else
     {
-      if(begin == 0 && length == self->length)
+      if(first_index > 0)
       {
-        /* Erase everything */
-        last_iter = g_sequence_iter_next(last_iter);
-        g_assert(last_iter == g_sequence_get_end_iter(self->segments));
+        /* Keep the beginning of the first segment */
+        first->length = first_index;
+        inf_text_chunk_segment_invalidate(first, first_index);
+        inf_text_chunk_segment_set_chars(first, begin - first_offset);
 
-        beyond = last_iter;
-      }
-      else if(begin == 0)
-      {
-        g_assert(last_index < last->length);
-
-        /* Erase from beginning */
-        if(last_index > 0)
-        {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
-
-          last->length -= last_index;
-          last->offset = 0;
-
-          beyond = g_sequence_iter_next(last_iter);
-        }
-        else
-        {
-          /* First segments are completely removed */
-          beyond = last_iter;
-        }
+        before = first;
+        first = inf_text_chunk_segment_next(first);
       }
       else
       {
-        /* Erase until end */
-
-        /* This could only be possible in the last segment, but then we
-         * would erase 0-length, which is a special case we would have
-         * catched elsewhere. */
-        g_assert(first_index < first->length);
+        before = inf_text_chunk_segment_prev(first);
+      }
 
+      if(last_index == last->length)
+      {
+        /* Erase until end, last segment goes away completely */
+        g_assert(begin + length == self->length);
+        last = inf_text_chunk_segment_next(last);
+      }
+      else if(last_index > 0)
+      {
+        /* Keep the end of the last segment. The storage can stay as it
+         * is, the segment just refers to less of it. */
+        last->text += last_index;
+        last->length -= last_index;
+        inf_text_chunk_segment_invalidate(last, 0);
 
-        if(first_index > 0)
-        {
-          /* Cannot erase whole first chunk */
-          first->length = first_index;
-          first_iter = g_sequence_iter_next(first_iter);
-        }
-        
-        last_iter = g_sequence_iter_next(last_iter);
-        g_assert(last_iter == g_sequence_get_end_iter(self->segments));
+        inf_text_chunk_segment_set_chars(
+          last,
+          last->chars - (begin + length - last_offset)
+        );
+      }
 
-        beyond = last_iter;
+      /* Remove [first, last) */
+      while(first != last)
+      {
+        next = inf_text_chunk_segment_next(first);
+        inf_text_chunk_segment_remove(self, first);
+        inf_text_chunk_segment_free(first);
+        first = next;
       }
-    }
 
-    /* first_iter and last_iter have been adjusted so that we have to
-     * remove [first_iter, last_iter). */
+      if(before != NULL && last != &self->end &&
+         before->author == last->author)
+      {
+        /* Segments around the erased text can be merged */
+        inf_text_chunk_segment_make_writable(
+          before,
+          before->length + last->length
+        );
+
+        inf_text_chunk_segment_invalidate(before, before->length);
+        memcpy(before->text + before->length, last->text, last->length);
+        before->length += last->length;
+        chars = last->chars;
 
-    /* segments are freed through the sequence's destroy function */
-    g_sequence_remove_range(first_iter, last_iter);
+        inf_text_chunk_segment_remove(self, last);
+        inf_text_chunk_segment_free(last);
 
-    /* adjust offsets */
-    for(first_iter = beyond;
-        first_iter != g_sequence_get_end_iter(self->segments);
-        first_iter = g_sequence_iter_next(first_iter))
-    {
-      first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-      first->offset -= length;
+        inf_text_chunk_segment_set_chars(before, before->chars + chars);
+      }
     }
   }
 
@@ -1188,21 +1640,19 @@ gpointer
 inf_text_chunk_get_text(InfTextChunk* self,
                         gsize* length)
 {
-  GSequenceIter* iter;
   InfTextChunkSegment* segment;
   gsize bytes;
   gsize cur;
   gchar* result;
-  
+
   g_return_val_if_fail(self != NULL, NULL);
   bytes = 0;
 
   /* First pass, determine size */
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
+  for(segment = inf_text_chunk_segment_first(self);
+      segment != &self->end;
+      segment = inf_text_chunk_segment_next(segment))
   {
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
     bytes += segment->length;
   }
 
@@ -1210,11 +1660,10 @@ inf_text_chunk_get_text(InfTextChunk* self,
   result = g_malloc(bytes);
   cur = 0;
 
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
+  for(segment = inf_text_chunk_segment_first(self);
+      segment != &self->end;
+      segment = inf_text_chunk_segment_next(segment))
   {
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
     memcpy(result + cur, segment->text, segment->length);
     cur += segment->length;
   }
@@ -1237,8 +1686,6 @@ gboolean
 inf_text_chunk_equal(InfTextChunk* self,
                      InfTextChunk* other)
 {
-  GSequenceIter* iter1;
-  GSequenceIter* iter2;
   InfTextChunkSegment* segment1;
   InfTextChunkSegment* segment2;
 
@@ -1246,30 +1693,23 @@ inf_text_chunk_equal(InfTextChunk* self,
   g_return_val_if_fail(other != NULL, FALSE);
   g_return_val_if_fail(self->encoding == other->encoding, FALSE);
 
-  iter1 = g_sequence_get_begin_iter(self->segments);
-  iter2 = g_sequence_get_begin_iter(other->segments);
+  segment1 = inf_text_chunk_segment_first(self);
+  segment2 = inf_text_chunk_segment_first(other);
 
-  while(iter1 != g_sequence_get_end_iter(self->segments) &&
-        iter2 != g_sequence_get_end_iter(other->segments))
+  while(segment1 != &self->end && segment2 != &other->end)
   {
-    segment1 = (InfTextChunkSegment*)g_sequence_get(iter1);
-    segment2 = (InfTextChunkSegment*)g_sequence_get(iter2);
-
     if(segment1->length != segment2->length)
       return FALSE;
 
     if(memcmp(segment1->text, segment2->text, segment1->length) != 0)
       return FALSE;
 
-    iter1 = g_sequence_iter_next(iter1);
-    iter2 = g_sequence_iter_next(iter2);
+    segment1 = inf_text_chunk_segment_next(segment1);
+    segment2 = inf_text_chunk_segment_next(segment2);
   }
 
-  if(iter1 != g_sequence_get_end_iter(self->segments) ||
-     iter2 != g_sequence_get_end_iter(other->segments))
-  {
+  if(segment1 != &self->end || segment2 != &other->end)
     return FALSE;
-  }
 
   return TRUE;
 }
@@ -1295,8 +1735,8 @@ inf_text_chunk_iter_init_begin(InfTextChunk* self,
   if(self->length > 0)
   {
     iter->chunk = self;
-    iter->first = g_sequence_get_begin_iter(self->segments);
-    iter->second = g_sequence_iter_next(iter->first);
+    iter->first = inf_text_chunk_segment_first(self);
+    iter->second = inf_text_chunk_segment_next(iter->first);
     return TRUE;
   }
   else
@@ -1326,8 +1766,8 @@ inf_text_chunk_iter_init_end(InfTextChunk* self,
   if(self->length > 0)
   {
     iter->chunk = self;
-    iter->second = g_sequence_get_end_iter(self->segments);
-    iter->first = g_sequence_iter_prev(iter->second);
+    iter->second = &self->end;
+    iter->first = inf_text_chunk_segment_prev(&self->end);
     return TRUE;
   }
   else
@@ -1350,10 +1790,10 @@ inf_text_chunk_iter_next(InfTextChunkIter* iter)
 {
   g_return_val_if_fail(iter != NULL, FALSE);
 
-  if(g_sequence_iter_is_end(iter->second) == FALSE)
+  if(iter->second != &iter->chunk->end)
   {
     iter->first = iter->second;
-    iter->second = g_sequence_iter_next(iter->first);
+    iter->second = inf_text_chunk_segment_next(iter->first);
     return TRUE;
   }
   else
@@ -1374,12 +1814,15 @@ inf_text_chunk_iter_next(InfTextChunkIter* iter)
 gboolean
 inf_text_chunk_iter_prev(InfTextChunkIter* iter)
 {
+  InfTextChunkSegment* prev;
+
   g_return_val_if_fail(iter != NULL, FALSE);
 
-  if(g_sequence_iter_is_begin(iter->first) == FALSE)
+  prev = inf_text_chunk_segment_prev(iter->first);
+  if(prev != NULL)
   {
     iter->second = iter->first;
-    iter->first = g_sequence_iter_prev(iter->first);
+    iter->first = prev;
     return TRUE;
   }
   else
@@ -1401,7 +1844,7 @@ gconstpointer
 inf_text_chunk_iter_get_text(InfTextChunkIter* iter)
 {
   g_return_val_if_fail(iter != NULL, NULL);
-  return ((InfTextChunkSegment*)g_sequence_get(iter->first))->text;
+  return ((InfTextChunkSegment*)iter->first)->text;
 }
 
 /**
@@ -1416,12 +1859,8 @@ inf_text_chunk_iter_get_text(InfTextChunkIter* iter)
 guint
 inf_text_chunk_iter_get_offset(InfTextChunkIter* iter)
 {
-  InfTextChunkSegment* first;
-
   g_return_val_if_fail(iter != NULL, 0);
-
-  first = (InfTextChunkSegment*)g_sequence_get(iter->first);
-  return first->offset;
+  return inf_text_chunk_segment_offset(iter->first);
 }
 
 /**
@@ -1435,22 +1874,8 @@ inf_text_chunk_iter_get_offset(InfTextChunkIter* iter)
 guint
 inf_text_chunk_iter_get_length(InfTextChunkIter* iter)
 {
-  InfTextChunkSegment* first;
-  InfTextChunkSegment* second;
-
   g_return_val_if_fail(iter != NULL, 0);
-
-  if(g_sequence_iter_is_end(iter->second) == TRUE)
-  {
-    first = (InfTextChunkSegment*)g_sequence_get(iter->first);
-    return iter->chunk->length - first->offset;
-  }
-  else
-  {
-    first = (InfTextChunkSegment*)g_sequence_get(iter->first);
-    second = (InfTextChunkSegment*)g_sequence_get(iter->second);
-    return second->offset - first->offset;
-  }
+  return ((InfTextChunkSegment*)iter->first)->chars;
 }
 
 /**
@@ -1465,7 +1890,7 @@ gsize
 inf_text_chunk_iter_get_bytes(InfTextChunkIter* iter)
 {
   g_return_val_if_fail(iter != NULL, 0);
-  return ((InfTextChunkSegment*)g_sequence_get(iter->first))->length;
+  return ((InfTextChunkSegment*)iter->first)->length;
 }
 
 /**
@@ -1480,7 +1905,7 @@ guint
 inf_text_chunk_iter_get_author(InfTextChunkIter* iter)
 {
   g_return_val_if_fail(iter != NULL, 0);
-  return ((InfTextChunkSegment*)g_sequence_get(iter->first))->author;
+  return ((InfTextChunkSegment*)iter->first)->author;
 }
 
 /* vim:set et sw=2 ts=2: */
@@ -52,8 +52,8 @@ typedef struct _InfTextChunkIter InfTextChunkIter;
 struct _InfTextChunkIter {
   /*< private >*/
   InfTextChunk* chunk;
-  GSequenceIter* first;
-  GSequenceIter* second;
+  gpointer first;
+  gpointer second;
 };
 
 GType
@@ -225,6 +225,50 @@ inf_text_default_buffer_buffer_erase_text(InfTextBuffer* buffer,
   }
 }
 
+static void
+inf_text_default_buffer_buffer_append_text(InfTextBuffer* buffer,
+                                           gconstpointer text,
+                                           gsize bytes,
+                                           guint len,
+                                           InfUser* user)
+{
+  InfTextDefaultBufferPrivate* priv;
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+
+  /* Other than insert_text, this copies the text only once, directly into
+   * the buffer's chunk. */
+  inf_text_chunk_insert_text(
+    priv->chunk,
+    inf_text_chunk_get_length(priv->chunk),
+    text,
+    bytes,
+    len,
+    user == NULL ? 0 : inf_user_get_id(user)
+  );
+
+  if(priv->modified == FALSE)
+  {
+    priv->modified = TRUE;
+    g_object_notify(G_OBJECT(buffer), "modified");
+  }
+}
+
+static void
+inf_text_default_buffer_buffer_clear(InfTextBuffer* buffer)
+{
+  InfTextDefaultBufferPrivate* priv;
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+
+  inf_text_chunk_free(priv->chunk);
+  priv->chunk = inf_text_chunk_new(priv->encoding);
+
+  if(priv->modified == FALSE)
+  {
+    priv->modified = TRUE;
+    g_object_notify(G_OBJECT(buffer), "modified");
+  }
+}
+
 static InfTextBufferIter*
 inf_text_default_buffer_buffer_create_begin_iter(InfTextBuffer* buffer)
 {
@@ -375,6 +419,8 @@ inf_text_default_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_default_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_default_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_default_buffer_buffer_iter_get_author;
+  iface->append_text = inf_text_default_buffer_buffer_append_text;
+  iface->clear = inf_text_default_buffer_buffer_clear;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
@@ -37,6 +37,9 @@ typedef struct _InfTextDefaultDeleteOperationPrivate InfTextDefaultDeleteOperati
 struct _InfTextDefaultDeleteOperationPrivate {
   guint position;
   InfTextChunk* chunk;
+  /* Properties can only be set during construction, since operations
+   * are shared between requests and must not change afterwards. */
+  gboolean constructed;
 };
 
 enum {
@@ -104,6 +107,36 @@ inf_text_default_delete_operation_init(
 
   priv->position = 0;
   priv->chunk = NULL;
+  priv->constructed = FALSE;
+}
+
+static void
+inf_text_default_delete_operation_constructed(GObject* object)
+{
+  InfTextDefaultDeleteOperationPrivate* priv;
+  priv = INF_TEXT_DEFAULT_DELETE_OPERATION_PRIVATE(object);
+
+  G_OBJECT_CLASS(inf_text_default_delete_operation_parent_class)->constructed(object);
+
+  priv->constructed = TRUE;
+}
+
+/* Sets the members directly instead of via properties, which is
+ * considerably faster. The new operation owns chunk. */
+static InfTextDefaultDeleteOperation*
+inf_text_default_delete_operation_new_internal(guint position,
+                                               InfTextChunk* chunk)
+{
+  GObject* object;
+  InfTextDefaultDeleteOperationPrivate* priv;
+
+  object = g_object_new(INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION, NULL);
+  priv = INF_TEXT_DEFAULT_DELETE_OPERATION_PRIVATE(object);
+
+  priv->position = position;
+  priv->chunk = chunk;
+
+  return INF_TEXT_DEFAULT_DELETE_OPERATION(object);
 }
 
 static void
@@ -132,13 +165,24 @@ inf_text_default_delete_operation_set_property(GObject* object,
   operation = INF_TEXT_DEFAULT_DELETE_OPERATION(object);
   priv = INF_TEXT_DEFAULT_DELETE_OPERATION_PRIVATE(operation);
 
+  if(priv->constructed)
+  {
+    g_warning(
+      "Property \"%s\" of %s can only be set at construction time",
+      pspec->name,
+      G_OBJECT_TYPE_NAME(object)
+    );
+
+    return;
+  }
+
   switch(prop_id)
   {
   case PROP_POSITION:
     priv->position = g_value_get_uint(value);
     break;
   case PROP_CHUNK:
-    g_assert(priv->chunk == NULL); /* construct only */
+    g_assert(priv->chunk == NULL); /* only set once */
     priv->chunk = (InfTextChunk*)g_value_dup_boxed(value);
     break;
   default:
@@ -223,11 +267,9 @@ inf_text_default_delete_operation_copy(InfAdoptedOperation* operation)
   priv = INF_TEXT_DEFAULT_DELETE_OPERATION_PRIVATE(operation);
 
   return INF_ADOPTED_OPERATION(
-    g_object_new(
-      INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION,
-      "position", priv->position,
-      "chunk", priv->chunk,
-      NULL
+    inf_text_default_delete_operation_new_internal(
+      priv->position,
+      inf_text_chunk_copy(priv->chunk)
     )
   );
 }
@@ -325,11 +367,9 @@ inf_text_default_delete_operation_transform_position(
   priv = INF_TEXT_DEFAULT_DELETE_OPERATION_PRIVATE(operation);
 
   return INF_TEXT_DELETE_OPERATION(
-    g_object_new(
-      INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION,
-      "position", position,
-      "chunk", priv->chunk,
-      NULL
+    inf_text_default_delete_operation_new_internal(
+      position,
+      inf_text_chunk_copy(priv->chunk)
     )
   );
 }
@@ -345,21 +385,14 @@ inf_text_default_delete_operation_transform_overlap(
 {
   InfTextDefaultDeleteOperationPrivate* priv;
   InfTextChunk* chunk;
-  GObject* result;
 
   priv = INF_TEXT_DEFAULT_DELETE_OPERATION_PRIVATE(operation);
   chunk = inf_text_chunk_copy(priv->chunk);
   inf_text_chunk_erase(chunk, begin, length);
 
-  result = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION,
-    "position", position,
-    "chunk", chunk,
-    NULL
+  return INF_TEXT_DELETE_OPERATION(
+    inf_text_default_delete_operation_new_internal(position, chunk)
   );
-
-  inf_text_chunk_free(chunk);
-  return INF_TEXT_DELETE_OPERATION(result);
 }
 
 static InfAdoptedSplitOperation*
@@ -369,38 +402,26 @@ inf_text_default_delete_operation_transform_split(
   guint split_len)
 {
   InfTextDefaultDeleteOperationPrivate* priv;
-  InfTextChunk* first_chunk;
-  InfTextChunk* second_chunk;
-  GObject* first;
-  GObject* second;
+  InfTextDefaultDeleteOperation* first;
+  InfTextDefaultDeleteOperation* second;
   InfAdoptedSplitOperation* result;
 
   priv = INF_TEXT_DEFAULT_DELETE_OPERATION_PRIVATE(operation);
 
-  first_chunk = inf_text_chunk_substring(priv->chunk, 0, split_pos);
-  second_chunk = inf_text_chunk_substring(
-    priv->chunk,
-    split_pos,
-    inf_text_chunk_get_length(priv->chunk) - split_pos
-  );
-
-  first = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION,
-    "position", priv->position,
-    "chunk", first_chunk,
-    NULL
+  first = inf_text_default_delete_operation_new_internal(
+    priv->position,
+    inf_text_chunk_substring(priv->chunk, 0, split_pos)
   );
 
-  second = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION,
-    "position", priv->position + split_len,
-    "chunk", second_chunk,
-    NULL
+  second = inf_text_default_delete_operation_new_internal(
+    priv->position + split_len,
+    inf_text_chunk_substring(
+      priv->chunk,
+      split_pos,
+      inf_text_chunk_get_length(priv->chunk) - split_pos
+    )
   );
 
-  inf_text_chunk_free(first_chunk);
-  inf_text_chunk_free(second_chunk);
-
   result = inf_adopted_split_operation_new(
     INF_ADOPTED_OPERATION(first),
     INF_ADOPTED_OPERATION(second)
@@ -418,6 +439,7 @@ inf_text_default_delete_operation_class_init(
   GObjectClass* object_class;
   object_class = G_OBJECT_CLASS(default_delete_operation_class);
 
+  object_class->constructed = inf_text_default_delete_operation_constructed;
   object_class->finalize = inf_text_default_delete_operation_finalize;
   object_class->set_property = inf_text_default_delete_operation_set_property;
   object_class->get_property = inf_text_default_delete_operation_get_property;
@@ -432,7 +454,7 @@ inf_text_default_delete_operation_class_init(
       0,
       G_MAXUINT,
       0,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -444,7 +466,7 @@ inf_text_default_delete_operation_class_init(
       "Chunk",
       "The deleted text",
       INF_TEXT_TYPE_CHUNK,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 }
@@ -492,18 +514,12 @@ InfTextDefaultDeleteOperation*
 inf_text_default_delete_operation_new(guint position,
                                       InfTextChunk* chunk)
 {
-  GObject* object;
-
   g_return_val_if_fail(chunk != NULL, NULL);
 
-  object = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION,
-    "position", position,
-    "chunk", chunk,
-    NULL
+  return inf_text_default_delete_operation_new_internal(
+    position,
+    inf_text_chunk_copy(chunk)
   );
-
-  return INF_TEXT_DEFAULT_DELETE_OPERATION(object);
 }
 
 /**
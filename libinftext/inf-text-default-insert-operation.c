@@ -31,6 +31,9 @@ typedef struct _InfTextDefaultInsertOperationPrivate
 struct _InfTextDefaultInsertOperationPrivate {
   guint position;
   InfTextChunk* chunk;
+  /* Properties can only be set during construction, since operations
+   * are shared between requests and must not change afterwards. */
+  gboolean constructed;
 };
 
 enum {
@@ -58,6 +61,36 @@ inf_text_default_insert_operation_init(
 
   priv->position = 0;
   priv->chunk = NULL;
+  priv->constructed = FALSE;
+}
+
+static void
+inf_text_default_insert_operation_constructed(GObject* object)
+{
+  InfTextDefaultInsertOperationPrivate* priv;
+  priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(object);
+
+  G_OBJECT_CLASS(inf_text_default_insert_operation_parent_class)->constructed(object);
+
+  priv->constructed = TRUE;
+}
+
+/* Operations are created in large numbers during transformation, so avoid
+ * the overhead of property-based construction. Takes ownership of chunk. */
+static InfTextDefaultInsertOperation*
+inf_text_default_insert_operation_new_internal(guint position,
+                                               InfTextChunk* chunk)
+{
+  GObject* object;
+  InfTextDefaultInsertOperationPrivate* priv;
+
+  object = g_object_new(INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION, NULL);
+  priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(object);
+
+  priv->position = position;
+  priv->chunk = chunk;
+
+  return INF_TEXT_DEFAULT_INSERT_OPERATION(object);
 }
 
 static void
@@ -86,13 +119,24 @@ inf_text_default_insert_operation_set_property(GObject* object,
   operation = INF_TEXT_DEFAULT_INSERT_OPERATION(object);
   priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(operation);
 
+  if(priv->constructed)
+  {
+    g_warning(
+      "Property \"%s\" of %s can only be set at construction time",
+      pspec->name,
+      G_OBJECT_TYPE_NAME(object)
+    );
+
+    return;
+  }
+
   switch(prop_id)
   {
   case PROP_POSITION:
     priv->position = g_value_get_uint(value);
     break;
   case PROP_CHUNK:
-    g_assert(priv->chunk == NULL); /* construct only */
+    g_assert(priv->chunk == NULL); /* only set once */
     priv->chunk = (InfTextChunk*)g_value_dup_boxed(value);
     break;
   default:
@@ -185,11 +229,9 @@ inf_text_default_insert_operation_copy(InfAdoptedOperation* operation)
   priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(operation);
 
   return INF_ADOPTED_OPERATION(
-    g_object_new(
-      INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION,
-      "position", priv->position,
-      "chunk", priv->chunk,
-      NULL
+    inf_text_default_insert_operation_new_internal(
+      priv->position,
+      inf_text_chunk_copy(priv->chunk)
     )
   );
 }
@@ -270,18 +312,14 @@ inf_text_default_insert_operation_transform_position(
   guint position)
 {
   InfTextDefaultInsertOperationPrivate* priv;
-  GObject* result;
-
   priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(operation);
 
-  result = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION,
-    "position", position,
-    "chunk", priv->chunk,
-    NULL
+  return INF_TEXT_INSERT_OPERATION(
+    inf_text_default_insert_operation_new_internal(
+      position,
+      inf_text_chunk_copy(priv->chunk)
+    )
   );
-
-  return INF_TEXT_INSERT_OPERATION(result);
 }
 
 static void
@@ -291,6 +329,7 @@ inf_text_default_insert_operation_class_init(
   GObjectClass* object_class;
   object_class = G_OBJECT_CLASS(default_insert_operation_class);
 
+  object_class->constructed = inf_text_default_insert_operation_constructed;
   object_class->finalize = inf_text_default_insert_operation_finalize;
   object_class->set_property =
     inf_text_default_insert_operation_set_property;
@@ -307,7 +346,7 @@ inf_text_default_insert_operation_class_init(
       0,
       G_MAXUINT,
       0,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -319,7 +358,7 @@ inf_text_default_insert_operation_class_init(
       "Chunk",
       "The text to insert",
       INF_TEXT_TYPE_CHUNK,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 }
@@ -362,18 +401,12 @@ InfTextDefaultInsertOperation*
 inf_text_default_insert_operation_new(guint pos,
                                       InfTextChunk* chunk)
 {
-  GObject* object;
-
   g_return_val_if_fail(chunk != NULL, NULL);
 
-  object = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION,
-    "position", pos,
-    "chunk", chunk,
-    NULL
+  return inf_text_default_insert_operation_new_internal(
+    pos,
+    inf_text_chunk_copy(chunk)
   );
-
-  return INF_TEXT_DEFAULT_INSERT_OPERATION(object);
 }
 
 /**
@@ -33,16 +33,56 @@
  */
 
 #include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-piece-buffer.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-utf8-util.h>
 #include <libinfinity/inf-i18n.h>
 
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
+
+#include <glib/gstdio.h>
+
+#include <sys/stat.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
+/* First bytes of a file written by
+ * inf_text_filesystem_format_write_mappable(), followed by the size of the
+ * XML part of the file and a newline. */
+#define INF_TEXT_FILESYSTEM_FORMAT_MAPPABLE_MAGIC "INF-TEXT-MAPPABLE 1 "
+
+/* First bytes of a file written by
+ * inf_text_filesystem_format_write_binary(). */
+#define INF_TEXT_FILESYSTEM_FORMAT_BINARY_MAGIC "INF-TEXT-BINARY 1\n"
+
+/* Flag in the header of a binary file that indicates that the file ends
+ * with a checksum of all data before it. */
+#define INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM (1 << 0)
+#define INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM_TYPE G_CHECKSUM_SHA256
+
+/* Maximum number of bytes of text passed to libxml2 at once when writing */
+#define INF_TEXT_FILESYSTEM_FORMAT_RUN_SIZE 4096
 
 typedef struct _InfTextFilesystemFormatWriteData {
-  xmlNodePtr root;
+  xmlTextWriterPtr writer;
   GHashTable* encountered_authors;
+  GSList* users;
+  int result;
 } InfTextFilesystemFormatWriteData;
 
+/* Position in the content of a binary file while reading it */
+typedef struct _InfTextFilesystemFormatCursor {
+  const gchar* data;
+  gsize size;
+  gsize offset;
+} InfTextFilesystemFormatCursor;
+
 static GQuark
 inf_text_filesystem_format_error_quark()
 {
@@ -69,6 +109,56 @@ inf_text_filesystem_format_read_close_func(void* context)
   return infd_filesystem_storage_stream_close((FILE*)context);
 }
 
+static gboolean
+inf_text_filesystem_format_add_user(InfUserTable* user_table,
+                                    guint id,
+                                    const gchar* name,
+                                    gdouble hue,
+                                    GError** error)
+{
+  InfUser* user;
+
+  if(inf_user_table_lookup_user_by_id(user_table, id) != NULL)
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
+      _("User with ID %u exists already"),
+      id
+    );
+
+    return FALSE;
+  }
+
+  if(inf_user_table_lookup_user_by_name(user_table, name))
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
+      _("User with name \"%s\" exists already"),
+      name
+    );
+
+    return FALSE;
+  }
+
+  user = INF_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", id,
+      "name", name,
+      "hue", hue,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, user);
+  g_object_unref(user);
+  return TRUE;
+}
+
 static gboolean
 inf_text_filesystem_format_read_user(InfUserTable* user_table,
                                      xmlNodePtr node,
@@ -78,7 +168,6 @@ inf_text_filesystem_format_read_user(InfUserTable* user_table,
   gdouble hue;
   xmlChar* name;
   gboolean result;
-  InfUser* user;
 
   if(!inf_xml_util_get_attribute_uint_required(node, "id", &id, error))
     return FALSE;
@@ -90,381 +179,1906 @@ inf_text_filesystem_format_read_user(InfUserTable* user_table,
   if(name == NULL)
     return FALSE;
 
-  if(inf_user_table_lookup_user_by_id(user_table, id) != NULL)
+  result = inf_text_filesystem_format_add_user(
+    user_table,
+    id,
+    (const gchar*)name,
+    hue,
+    error
+  );
+
+  xmlFree(name);
+  return result;
+}
+
+static gboolean
+inf_text_filesystem_format_lookup_author(InfUserTable* user_table,
+                                         guint author,
+                                         InfUser** user,
+                                         GError** error)
+{
+  if(author == 0)
+  {
+    *user = NULL;
+    return TRUE;
+  }
+
+  *user = inf_user_table_lookup_user_by_id(user_table, author);
+  if(*user == NULL)
   {
     g_set_error(
+      error,
+      g_quark_from_static_string("INF_NOTE_PLUGIN_TEXT_ERROR"),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER,
+      _("User with ID \"%u\" does not exist"),
+      author
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Checks that text taken from the payload of a file, which is not parsed
+ * by libxml2, is valid UTF-8 and has as many characters as the file claims.
+ * Otherwise, the character and byte counts of the buffer would disagree. */
+static gboolean
+inf_text_filesystem_format_validate_text(const gchar* text,
+                                         gsize bytes,
+                                         guint chars,
+                                         GError** error)
+{
+  if(!inf_utf8_util_validate(text, bytes))
+  {
+    g_set_error_literal(
       error,
       inf_text_filesystem_format_error_quark(),
-      INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
-      _("User with ID %u exists already"),
-      id
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+      _("The text of the document is not valid UTF-8")
     );
 
-    result = FALSE;
+    return FALSE;
+  }
+
+  if(inf_utf8_util_strlen(text, bytes) != chars)
+  {
+    g_set_error_literal(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+      _("The length of the text of the document does not match its size")
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Inserts a segment read from storage at the end of buffer. content is
+ * UTF-8 encoded. */
+static gboolean
+inf_text_filesystem_format_read_insert(InfTextBuffer* buffer,
+                                       const gchar* content,
+                                       gsize bytes,
+                                       guint chars,
+                                       InfUser* user,
+                                       GError** error)
+{
+  gchar* converted;
+  gsize converted_bytes;
+
+  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") == 0)
+  {
+    inf_text_buffer_append_text(
+      buffer,
+      content,
+      bytes,
+      chars,
+      user
+    );
   }
   else
   {
-    if(inf_user_table_lookup_user_by_name(user_table, (const gchar*)name))
-    {
-      g_set_error(
-        error,
-        inf_text_filesystem_format_error_quark(),
-        INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
-        _("User with name \"%s\" exists already"),
-        (const gchar*)name
-      );
+    /* Convert from UTF-8 to buffer encoding */
+    converted = g_convert(
+      content,
+      bytes,
+      inf_text_buffer_get_encoding(buffer),
+      "UTF-8",
+      NULL,
+      &converted_bytes, error
+    );
 
-      result = FALSE;
-    }
-    else
-    {
-      user = INF_USER(
-        g_object_new(
-          INF_TEXT_TYPE_USER,
-          "id", id,
-          "name", name,
-          "hue", hue,
-          NULL
-        )
-      );
+    if(converted == NULL)
+      return FALSE;
 
-      inf_user_table_add_user(user_table, user);
-      g_object_unref(user);
-      result = TRUE;
-    }
+    inf_text_buffer_append_text(
+      buffer,
+      converted,
+      converted_bytes,
+      chars,
+      user
+    );
+
+    g_free(converted);
   }
 
-  xmlFree(name);
-  return result;
+  return TRUE;
 }
 
+/* Inserts text from a file that has been mapped into memory at the end of
+ * buffer. An InfTextPieceBuffer refers to the mapping directly, so that the
+ * text is not copied. The text needs to be validated by the caller. */
 static gboolean
-inf_text_filesystem_format_read_buffer(InfTextBuffer* buffer,
-                                       InfUserTable* user_table,
-                                       xmlNodePtr node,
-                                       GError** error)
+inf_text_filesystem_format_read_original(InfTextBuffer* buffer,
+                                         GBytes* original,
+                                         gsize offset,
+                                         gsize bytes,
+                                         guint chars,
+                                         InfUser* user,
+                                         GError** error)
+{
+  const gchar* data;
+
+  if(bytes == 0)
+    return TRUE;
+
+  if(INF_TEXT_IS_PIECE_BUFFER(buffer))
+  {
+    inf_text_piece_buffer_insert_original(
+      INF_TEXT_PIECE_BUFFER(buffer),
+      inf_text_buffer_get_length(buffer),
+      original,
+      offset,
+      bytes,
+      chars,
+      user
+    );
+
+    return TRUE;
+  }
+
+  data = g_bytes_get_data(original, NULL);
+
+  return inf_text_filesystem_format_read_insert(
+    buffer,
+    data + offset,
+    bytes,
+    chars,
+    user,
+    error
+  );
+}
+
+/* Reads the text of a segment from the payload of a mappable file */
+static gboolean
+inf_text_filesystem_format_read_payload(InfTextBuffer* buffer,
+                                        xmlNodePtr node,
+                                        InfUser* user,
+                                        GBytes* payload,
+                                        gsize* offset,
+                                        GError** error)
+{
+  gulong bytes;
+  guint chars;
+  gsize size;
+  const gchar* data;
+
+  if(!inf_xml_util_get_attribute_ulong_required(node, "bytes", &bytes, error))
+    return FALSE;
+  if(!inf_xml_util_get_attribute_uint_required(node, "chars", &chars, error))
+    return FALSE;
+
+  size = g_bytes_get_size(payload);
+  if(bytes > size - *offset)
+  {
+    g_set_error_literal(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+      _("The text of the document is truncated")
+    );
+
+    return FALSE;
+  }
+
+  data = g_bytes_get_data(payload, NULL);
+  if(!inf_text_filesystem_format_validate_text(data + *offset, bytes,
+                                               chars, error))
+  {
+    return FALSE;
+  }
+
+  if(!inf_text_filesystem_format_read_original(buffer, payload, *offset,
+                                               bytes, chars, user, error))
+  {
+    return FALSE;
+  }
+
+  *offset += bytes;
+  return TRUE;
+}
+
+/* Reads a segment of the buffer and appends it to buffer. If payload is
+ * NULL, the text of the segment is contained in the XML, otherwise it is
+ * taken from payload at offset. */
+static gboolean
+inf_text_filesystem_format_read_segment(InfTextBuffer* buffer,
+                                        InfUserTable* user_table,
+                                        xmlNodePtr node,
+                                        GBytes* payload,
+                                        gsize* offset,
+                                        GError** error)
 {
-  xmlNodePtr child;
   guint author;
   gchar* content;
-  gboolean result;
   gboolean res;
   InfUser* user;
   gsize bytes;
   guint chars;
 
-  gboolean is_utf8;
-  gchar* converted;
-  gsize converted_bytes;
+  res = inf_xml_util_get_attribute_uint_required(
+    node,
+    "author",
+    &author,
+    error
+  );
 
-  g_assert(inf_text_buffer_get_length(buffer) == 0);
+  if(res == FALSE)
+    return FALSE;
 
-  is_utf8 = TRUE;
-  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") != 0)
-    is_utf8 = FALSE;
+  if(!inf_text_filesystem_format_lookup_author(user_table, author,
+                                               &user, error))
+  {
+    return FALSE;
+  }
 
-  for(child = node->children; child != NULL; child = child->next)
+  if(payload != NULL)
   {
-    if(child->type != XML_ELEMENT_NODE)
-      continue;
+    return inf_text_filesystem_format_read_payload(
+      buffer,
+      node,
+      user,
+      payload,
+      offset,
+      error
+    );
+  }
 
-    if(strcmp((const gchar*)child->name, "segment") == 0)
-    {
-      res = inf_xml_util_get_attribute_uint_required(
-        child,
-        "author",
-        &author,
-        error
-      );
+  content = inf_xml_util_get_child_text(node, &bytes, &chars, error);
+  if(!content) return FALSE;
 
-      if(res == FALSE)
-        return FALSE;
+  res = TRUE;
+  if(*content != '\0')
+  {
+    res = inf_text_filesystem_format_read_insert(
+      buffer,
+      content,
+      bytes,
+      chars,
+      user,
+      error
+    );
+  }
 
-      if(author != 0)
-      {
-        user = inf_user_table_lookup_user_by_id(user_table, author);
+  g_free(content);
+  return res;
+}
 
-        if(user == NULL)
-        {
-          g_set_error(
-            error,
-            g_quark_from_static_string("INF_NOTE_PLUGIN_TEXT_ERROR"),
-            INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER,
-            _("User with ID \"%u\" does not exist"),
-            author
-          );
+static void
+inf_text_filesystem_format_set_parser_error(const gchar* path,
+                                            GError** error)
+{
+  xmlErrorPtr xmlerror;
+  xmlerror = xmlGetLastError();
 
-          return FALSE;
-        }
-      }
-      else
-      {
-        user = NULL;
-      }
+  g_set_error(
+    error,
+    g_quark_from_static_string("LIBXML2_PARSER_ERROR"),
+    xmlerror->code,
+    _("Error parsing XML in file \"%s\": [%d]: %s"),
+    path,
+    xmlerror->line,
+    xmlerror->message
+  );
+}
 
-      content = inf_xml_util_get_child_text(child, &bytes, &chars, error);
-      if(!content) return FALSE;
+/* Reads users and buffer of a stored session from reader. Only a single
+ * user or segment element is expanded into a tree at a time, and the
+ * reader releases it when it advances to the next one, so that the memory
+ * needed does not grow with the size of the document. */
+static gboolean
+inf_text_filesystem_format_read_session(InfUserTable* user_table,
+                                        InfTextBuffer* buffer,
+                                        xmlTextReaderPtr reader,
+                                        GBytes* payload,
+                                        const gchar* path,
+                                        GError** error)
+{
+  const gchar* name;
+  xmlNodePtr node;
+  gboolean in_buffer;
+  gboolean result;
+  gsize offset;
+  int depth;
+  int ret;
 
-      if(*content != '\0')
-      {
-        if(is_utf8)
-        {
-          inf_text_buffer_insert_text(
-            buffer,
-            inf_text_buffer_get_length(buffer),
-            content,
-            bytes,
-            chars,
-            user
-          );
+  do
+  {
+    ret = xmlTextReaderRead(reader);
+  } while(ret == 1 &&
+          xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT);
 
-          g_free(content);
-        }
-        else
-        {
-          /* Convert from UTF-8 to buffer encoding */
-          converted = g_convert(
-            content,
-            bytes,
-            inf_text_buffer_get_encoding(buffer),
-            "UTF-8",
-            NULL,
-            &converted_bytes, error
-          );
+  if(ret == -1)
+  {
+    inf_text_filesystem_format_set_parser_error(path, error);
+    return FALSE;
+  }
+
+  if(ret == 0 ||
+     strcmp((const char*)xmlTextReaderConstName(reader),
+            "inf-text-session") != 0)
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_NOT_A_TEXT_SESSION,
+      _("Error processing file \"%s\": %s"),
+      path,
+      _("The document is not a text session")
+    );
 
-          g_free(content);
+    return FALSE;
+  }
 
-          if(converted == NULL)
-            return FALSE;
+  in_buffer = FALSE;
+  offset = 0;
+  ret = xmlTextReaderRead(reader);
 
-          inf_text_buffer_insert_text(
-            buffer,
-            inf_text_buffer_get_length(buffer),
-            converted,
-            converted_bytes,
-            chars,
-            user
-          );
+  while(ret == 1)
+  {
+    if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+    {
+      ret = xmlTextReaderRead(reader);
+      continue;
+    }
 
-          g_free(converted);
-        }
+    depth = xmlTextReaderDepth(reader);
+    name = (const gchar*)xmlTextReaderConstName(reader);
+
+    if(depth == 1)
+      in_buffer = (strcmp(name, "buffer") == 0);
+
+    if((depth == 1 && strcmp(name, "user") == 0) ||
+       (depth == 2 && in_buffer && strcmp(name, "segment") == 0))
+    {
+      node = xmlTextReaderExpand(reader);
+      if(node == NULL)
+      {
+        inf_text_filesystem_format_set_parser_error(path, error);
+        return FALSE;
+      }
+
+      if(depth == 1)
+      {
+        result = inf_text_filesystem_format_read_user(
+          user_table,
+          node,
+          error
+        );
+      }
+      else
+      {
+        result = inf_text_filesystem_format_read_segment(
+          buffer,
+          user_table,
+          node,
+          payload,
+          &offset,
+          error
+        );
+      }
+
+      if(result == FALSE)
+      {
+        g_prefix_error(error, _("Error processing file \"%s\": "), path);
+        return FALSE;
       }
+
+      ret = xmlTextReaderNext(reader);
+    }
+    else if(depth > 1)
+    {
+      /* Skip unknown elements including their children */
+      ret = xmlTextReaderNext(reader);
+    }
+    else
+    {
+      ret = xmlTextReaderRead(reader);
     }
   }
 
+  if(ret == -1)
+  {
+    inf_text_filesystem_format_set_parser_error(path, error);
+    return FALSE;
+  }
+
   return TRUE;
 }
 
-static void
-inf_text_filesystem_format_write_foreach_user_func(InfUser* user,
-                                                   gpointer user_data)
+/* Reads a file written by inf_text_filesystem_format_write_mappable(). The
+ * file starts with a header line giving the size of the XML part, which is
+ * followed by the text of all segments. */
+static gboolean
+inf_text_filesystem_format_read_mappable(GMappedFile* mapped,
+                                         const gchar* path,
+                                         InfUserTable* user_table,
+                                         InfTextBuffer* buffer,
+                                         GError** error)
+{
+  const gchar* contents;
+  gsize size;
+  const gchar* header_end;
+  gchar* number_end;
+  guint64 xml_size;
+  gsize xml_offset;
+  GBytes* bytes;
+  GBytes* payload;
+  xmlTextReaderPtr reader;
+  gboolean result;
+
+  contents = g_mapped_file_get_contents(mapped);
+  size = g_mapped_file_get_length(mapped);
+
+  number_end = NULL;
+  xml_size = 0;
+  xml_offset = 0;
+
+  header_end = memchr(contents, '\n', size);
+  if(header_end != NULL)
+  {
+    xml_size = g_ascii_strtoull(
+      contents + strlen(INF_TEXT_FILESYSTEM_FORMAT_MAPPABLE_MAGIC),
+      &number_end,
+      10
+    );
+
+    xml_offset = header_end + 1 - contents;
+  }
+
+  if(header_end == NULL || number_end != header_end ||
+     xml_size > size - xml_offset || xml_size > G_MAXINT)
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+      _("Error processing file \"%s\": %s"),
+      path,
+      _("The file header is invalid")
+    );
+
+    return FALSE;
+  }
+
+  reader = xmlReaderForMemory(
+    contents + xml_offset,
+    (int)xml_size,
+    NULL,
+    "UTF-8",
+    XML_PARSE_NOWARNING | XML_PARSE_NOERROR
+  );
+
+  if(reader == NULL)
+  {
+    inf_text_filesystem_format_set_parser_error(path, error);
+    return FALSE;
+  }
+
+  bytes = g_mapped_file_get_bytes(mapped);
+  payload = g_bytes_new_from_bytes(
+    bytes,
+    xml_offset + xml_size,
+    size - xml_offset - xml_size
+  );
+
+  g_bytes_unref(bytes);
+
+  result = inf_text_filesystem_format_read_session(
+    user_table,
+    buffer,
+    reader,
+    payload,
+    path,
+    error
+  );
+
+  g_bytes_unref(payload);
+  xmlFreeTextReader(reader);
+  return result;
+}
+
+static gboolean
+inf_text_filesystem_format_cursor_read(InfTextFilesystemFormatCursor* cursor,
+                                       gsize len,
+                                       const gchar** data)
+{
+  if(len > cursor->size - cursor->offset)
+    return FALSE;
+
+  *data = cursor->data + cursor->offset;
+  cursor->offset += len;
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_format_cursor_read_uint32(
+  InfTextFilesystemFormatCursor* cursor,
+  guint32* value)
+{
+  const gchar* data;
+  if(!inf_text_filesystem_format_cursor_read(cursor, 4, &data))
+    return FALSE;
+
+  memcpy(value, data, 4);
+  *value = GUINT32_FROM_LE(*value);
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_format_cursor_read_uint64(
+  InfTextFilesystemFormatCursor* cursor,
+  guint64* value)
+{
+  const gchar* data;
+  if(!inf_text_filesystem_format_cursor_read(cursor, 8, &data))
+    return FALSE;
+
+  memcpy(value, data, 8);
+  *value = GUINT64_FROM_LE(*value);
+  return TRUE;
+}
+
+/* Verifies the checksum at the end of a binary file, and removes it from
+ * the part of the file that cursor reads. */
+static gboolean
+inf_text_filesystem_format_verify_checksum(
+  InfTextFilesystemFormatCursor* cursor,
+  const gchar* contents,
+  GError** error)
+{
+  GChecksum* checksum;
+  guint8 digest[64];
+  gsize digest_len;
+  gboolean result;
+
+  digest_len = g_checksum_type_get_length(
+    INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM_TYPE
+  );
+
+  g_assert(digest_len <= sizeof(digest));
+
+  if(cursor->size - cursor->offset < digest_len)
+  {
+    g_set_error_literal(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+      _("The file is truncated")
+    );
+
+    return FALSE;
+  }
+
+  cursor->size -= digest_len;
+
+  checksum = g_checksum_new(INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM_TYPE);
+  g_checksum_update(
+    checksum,
+    (const guchar*)contents,
+    cursor->data + cursor->size - contents
+  );
+
+  g_checksum_get_digest(checksum, digest, &digest_len);
+  g_checksum_free(checksum);
+
+  result = memcmp(digest, cursor->data + cursor->size, digest_len) == 0;
+  if(result == FALSE)
+  {
+    g_set_error_literal(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_CHECKSUM_MISMATCH,
+      _("The checksum of the file does not match its content")
+    );
+  }
+
+  return result;
+}
+
+/* Reads a file written by inf_text_filesystem_format_write_binary(). See
+ * there for the layout of the file. The text is inserted directly from the
+ * mapped file, without parsing or escaping. */
+static gboolean
+inf_text_filesystem_format_read_binary(GMappedFile* mapped,
+                                       InfUserTable* user_table,
+                                       InfTextBuffer* buffer,
+                                       GError** error)
+{
+  InfTextFilesystemFormatCursor cursor;
+  const gchar* contents;
+  GBytes* original;
+  gboolean result;
+  const gchar* data;
+  gchar* name;
+  guint32 flags;
+  guint32 n_users;
+  guint32 n_runs;
+  guint32 id;
+  guint64 hue;
+  gdouble hue_value;
+  guint32 name_len;
+  guint32 author;
+  guint32 chars;
+  guint64 bytes;
+  InfUser* user;
+  guint32 i;
+
+  contents = g_mapped_file_get_contents(mapped);
+  cursor.data = contents;
+  cursor.size = g_mapped_file_get_length(mapped);
+  cursor.offset = strlen(INF_TEXT_FILESYSTEM_FORMAT_BINARY_MAGIC);
+
+  if(!inf_text_filesystem_format_cursor_read_uint32(&cursor, &flags))
+    goto truncated;
+
+  if((flags & ~INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM) != 0)
+  {
+    g_set_error_literal(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+      _("The file uses unsupported features")
+    );
+
+    return FALSE;
+  }
+
+  /* Verify the checksum before adding anything to the buffer */
+  if((flags & INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM) != 0 &&
+     !inf_text_filesystem_format_verify_checksum(&cursor, contents, error))
+  {
+    return FALSE;
+  }
+
+  if(!inf_text_filesystem_format_cursor_read_uint32(&cursor, &n_users))
+    goto truncated;
+
+  for(i = 0; i < n_users; ++i)
+  {
+    if(!inf_text_filesystem_format_cursor_read_uint32(&cursor, &id) ||
+       !inf_text_filesystem_format_cursor_read_uint64(&cursor, &hue) ||
+       !inf_text_filesystem_format_cursor_read_uint32(&cursor, &name_len) ||
+       !inf_text_filesystem_format_cursor_read(&cursor, name_len, &data))
+    {
+      goto truncated;
+    }
+
+    if(!g_utf8_validate(data, name_len, NULL))
+    {
+      g_set_error_literal(
+        error,
+        inf_text_filesystem_format_error_quark(),
+        INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+        _("The name of a user is not valid UTF-8")
+      );
+
+      return FALSE;
+    }
+
+    memcpy(&hue_value, &hue, sizeof(hue_value));
+    name = g_strndup(data, name_len);
+
+    result = inf_text_filesystem_format_add_user(
+      user_table,
+      id,
+      name,
+      hue_value,
+      error
+    );
+
+    g_free(name);
+    if(result == FALSE)
+      return FALSE;
+  }
+
+  if(!inf_text_filesystem_format_cursor_read_uint32(&cursor, &n_runs))
+    goto truncated;
+
+  original = g_mapped_file_get_bytes(mapped);
+  result = TRUE;
+
+  for(i = 0; i < n_runs && result == TRUE; ++i)
+  {
+    if(!inf_text_filesystem_format_cursor_read_uint32(&cursor, &author) ||
+       !inf_text_filesystem_format_cursor_read_uint32(&cursor, &chars) ||
+       !inf_text_filesystem_format_cursor_read_uint64(&cursor, &bytes) ||
+       bytes > cursor.size - cursor.offset)
+    {
+      g_bytes_unref(original);
+      goto truncated;
+    }
+
+    result = inf_text_filesystem_format_lookup_author(
+      user_table,
+      author,
+      &user,
+      error
+    );
+
+    /* The checksum is optional, and even a matching one does not mean
+     * that the file was written by us. */
+    if(result == TRUE)
+    {
+      result = inf_text_filesystem_format_validate_text(
+        cursor.data + cursor.offset,
+        bytes,
+        chars,
+        error
+      );
+    }
+
+    if(result == TRUE)
+    {
+      result = inf_text_filesystem_format_read_original(
+        buffer,
+        original,
+        cursor.offset,
+        bytes,
+        chars,
+        user,
+        error
+      );
+    }
+
+    cursor.offset += bytes;
+  }
+
+  g_bytes_unref(original);
+  return result;
+
+truncated:
+  g_set_error_literal(
+    error,
+    inf_text_filesystem_format_error_quark(),
+    INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+    _("The file is truncated")
+  );
+
+  return FALSE;
+}
+
+/* Does the actual work for inf_text_filesystem_format_read(), which leaves
+ * buffer empty if this fails. */
+static gboolean
+inf_text_filesystem_format_read_file(InfdFilesystemStorage* storage,
+                                     const gchar* path,
+                                     InfUserTable* user_table,
+                                     InfTextBuffer* buffer,
+                                     GError** error)
+{
+  FILE* stream;
+  gchar* full_path;
+  gchar* uri;
+  GMappedFile* mapped;
+
+  xmlTextReaderPtr reader;
+  gboolean result;
+
+  full_path = NULL;
+  stream = infd_filesystem_storage_open(
+    INFD_FILESYSTEM_STORAGE(storage),
+    "InfText",
+    path,
+    "r",
+    &full_path,
+    error
+  );
+
+  if(stream == NULL)
+  {
+    g_free(full_path);
+    return FALSE;
+  }
+
+  /* If the file cannot be mapped, it is parsed as XML, which works for all
+   * files except mappable ones. */
+  mapped = g_mapped_file_new_from_fd(fileno(stream), FALSE, NULL);
+  if(mapped != NULL)
+  {
+    if(g_mapped_file_get_length(mapped) >=
+         strlen(INF_TEXT_FILESYSTEM_FORMAT_MAPPABLE_MAGIC) &&
+       memcmp(g_mapped_file_get_contents(mapped),
+              INF_TEXT_FILESYSTEM_FORMAT_MAPPABLE_MAGIC,
+              strlen(INF_TEXT_FILESYSTEM_FORMAT_MAPPABLE_MAGIC)) == 0)
+    {
+      /* The mapping stays valid after the file has been closed */
+      infd_filesystem_storage_stream_close(stream);
+      g_free(full_path);
+
+      result = inf_text_filesystem_format_read_mappable(
+        mapped,
+        path,
+        user_table,
+        buffer,
+        error
+      );
+
+      g_mapped_file_unref(mapped);
+      return result;
+    }
+
+    if(g_mapped_file_get_length(mapped) >=
+         strlen(INF_TEXT_FILESYSTEM_FORMAT_BINARY_MAGIC) &&
+       memcmp(g_mapped_file_get_contents(mapped),
+              INF_TEXT_FILESYSTEM_FORMAT_BINARY_MAGIC,
+              strlen(INF_TEXT_FILESYSTEM_FORMAT_BINARY_MAGIC)) == 0)
+    {
+      infd_filesystem_storage_stream_close(stream);
+      g_free(full_path);
+
+      result = inf_text_filesystem_format_read_binary(
+        mapped,
+        user_table,
+        buffer,
+        error
+      );
+
+      if(result == FALSE)
+        g_prefix_error(error, _("Error processing file \"%s\": "), path);
+
+      g_mapped_file_unref(mapped);
+      return result;
+    }
+
+    g_mapped_file_unref(mapped);
+  }
+
+  uri = g_filename_to_uri(full_path, NULL, error);
+  g_free(full_path);
+
+  if(uri == NULL)
+  {
+    infd_filesystem_storage_stream_close(stream);
+    return FALSE;
+  }
+
+  /* This closes the stream if it fails */
+  reader = xmlReaderForIO(
+    inf_text_filesystem_format_read_read_func,
+    inf_text_filesystem_format_read_close_func,
+    stream,
+    uri,
+    "UTF-8",
+    XML_PARSE_NOWARNING | XML_PARSE_NOERROR
+  );
+
+  g_free(uri);
+
+  if(reader == NULL)
+  {
+    inf_text_filesystem_format_set_parser_error(path, error);
+    return FALSE;
+  }
+
+  result = inf_text_filesystem_format_read_session(
+    user_table,
+    buffer,
+    reader,
+    NULL,
+    path,
+    error
+  );
+
+  /* This closes the stream */
+  xmlFreeTextReader(reader);
+  return result;
+}
+
+/**
+ * inf_text_filesystem_format_read:
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path to retrieve the session from.
+ * @user_table: An empty #InfUserTable to use as the new session's user table.
+ * @buffer: An empty #InfTextBuffer to use as the new session's buffer.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Reads a text session from @path in @storage. The file is expected to have
+ * been saved with inf_text_filesystem_format_write() or
+ * inf_text_filesystem_format_write_mappable() before. The @user_table
+ * parameter should be an empty user table that will be used for the session,
+ * and the @buffer parameter should be an empty #InfTextBuffer, and the
+ * document will be written into this buffer. If the function succeeds, the
+ * user table and buffer can be used to create an #InfTextSession with
+ * inf_text_session_new_with_user_table(). If the function fails, %FALSE is
+ * returned, @error is set and @buffer is left empty.
+ *
+ * The file is parsed incrementally, so apart from the document itself only
+ * a single segment of it is held in memory at a time.
+ *
+ * If the file has been written with
+ * inf_text_filesystem_format_write_mappable() or
+ * inf_text_filesystem_format_write_binary(), then it is mapped into memory
+ * instead of being read. If @buffer is a #InfTextPieceBuffer, the text is
+ * not copied, but the buffer refers to the mapped file directly.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_text_filesystem_format_read(InfdFilesystemStorage* storage,
+                                const gchar* path,
+                                InfUserTable* user_table,
+                                InfTextBuffer* buffer,
+                                GError** error)
+{
+  gboolean result;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
+  g_return_val_if_fail(path != NULL, FALSE);
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+  g_return_val_if_fail(inf_text_buffer_get_length(buffer) == 0, FALSE);
+
+  result = inf_text_filesystem_format_read_file(
+    storage,
+    path,
+    user_table,
+    buffer,
+    error
+  );
+
+  /* Do not leave a partially read document behind */
+  if(result == FALSE)
+    inf_text_buffer_clear(buffer);
+
+  return result;
+}
+
+static void
+inf_text_filesystem_format_system_error(int code,
+                                        GError** error)
+{
+  g_set_error_literal(
+    error,
+    G_FILE_ERROR,
+    g_file_error_from_errno(code),
+    g_strerror(code)
+  );
+}
+
+/* Opens a temporary file next to the file for path. The session is written
+ * into the temporary file, which then replaces the old file. This way, the
+ * old file is never truncated while a buffer still refers to its mapping,
+ * and a failed write leaves the old file intact. The temporary file gets
+ * the permissions of the old file, if there is one. */
+static FILE*
+inf_text_filesystem_format_open_temporary(InfdFilesystemStorage* storage,
+                                          const gchar* path,
+                                          gchar** full_path,
+                                          gchar** temp_path,
+                                          GError** error)
+{
+  FILE* stream;
+  GStatBuf buf;
+  gboolean exists;
+  int mode;
+  int save_errno;
+  int fd;
+
+  *full_path = infd_filesystem_storage_get_path(
+    storage,
+    "InfText",
+    path,
+    error
+  );
+
+  if(*full_path == NULL)
+    return NULL;
+
+  /* The suffix does not start with "Inf", so the temporary file does not
+   * show up as a note in the storage. */
+  *temp_path = g_strconcat(*full_path, ".XXXXXX", NULL);
+  exists = g_stat(*full_path, &buf) == 0;
+
+  /* New files get the same permissions as ones created with fopen() */
+  if(exists)
+    mode = buf.st_mode & 0777;
+  else
+    mode = 0666;
+
+  fd = g_mkstemp_full(*temp_path, O_WRONLY | O_BINARY, mode);
+
+  stream = NULL;
+  save_errno = errno;
+
+#ifndef G_OS_WIN32
+  /* The mode passed to g_mkstemp_full() is subject to the umask, which
+   * might be different from when the old file was created. */
+  if(fd != -1 && exists && fchmod(fd, mode) != 0)
+  {
+    save_errno = errno;
+    g_close(fd, NULL);
+    g_unlink(*temp_path);
+    fd = -1;
+  }
+#endif
+
+  if(fd != -1)
+  {
+    stream = fdopen(fd, "wb");
+    save_errno = errno;
+
+    if(stream == NULL)
+    {
+      g_close(fd, NULL);
+      g_unlink(*temp_path);
+    }
+  }
+
+  if(stream == NULL)
+  {
+    inf_text_filesystem_format_system_error(save_errno, error);
+    g_free(*full_path);
+    g_free(*temp_path);
+  }
+
+  return stream;
+}
+
+/* Closes a stream opened with inf_text_filesystem_format_open_temporary(),
+ * and replaces the old file with it if result is TRUE. Otherwise, the
+ * temporary file is removed. Frees full_path and temp_path. */
+static gboolean
+inf_text_filesystem_format_close_temporary(FILE* stream,
+                                           gchar* full_path,
+                                           gchar* temp_path,
+                                           gboolean result,
+                                           GError** error)
+{
+  if(fclose(stream) != 0 && result == TRUE)
+  {
+    inf_text_filesystem_format_system_error(errno, error);
+    result = FALSE;
+  }
+
+  if(result == TRUE && g_rename(temp_path, full_path) != 0)
+  {
+    inf_text_filesystem_format_system_error(errno, error);
+    result = FALSE;
+  }
+
+  if(result == FALSE)
+    g_unlink(temp_path);
+
+  g_free(full_path);
+  g_free(temp_path);
+  return result;
+}
+
+/* Returns the text of the segment at iter in UTF-8 */
+static gchar*
+inf_text_filesystem_format_get_utf8_text(InfTextBuffer* buffer,
+                                         InfTextBufferIter* iter,
+                                         gsize* bytes,
+                                         GError** error)
+{
+  gchar* content;
+  gchar* converted;
+
+  content = inf_text_buffer_iter_get_text(buffer, iter);
+  *bytes = inf_text_buffer_iter_get_bytes(buffer, iter);
+
+  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") == 0)
+    return content;
+
+  converted = g_convert(
+    content,
+    *bytes,
+    "UTF-8",
+    inf_text_buffer_get_encoding(buffer),
+    NULL,
+    bytes,
+    error
+  );
+
+  g_free(content);
+  return converted;
+}
+
+static int
+inf_text_filesystem_format_write_write_func(void* context,
+                                            const char* buffer,
+                                            int len)
+{
+  gsize res;
+  res = infd_filesystem_storage_stream_write((FILE*)context, buffer, len);
+
+  if(res != (gsize)len)
+    return -1;
+
+  return (int)res;
+}
+
+static void
+inf_text_filesystem_format_set_writer_error(GError** error)
+{
+  xmlErrorPtr xmlerror;
+  xmlerror = xmlGetLastError();
+
+  g_set_error_literal(
+    error,
+    g_quark_from_static_string("LIBXML2_OUTPUT_ERROR"),
+    xmlerror->code,
+    xmlerror->message
+  );
+}
+
+static gboolean
+inf_text_filesystem_format_valid_xml_char(gunichar codepoint)
+{
+  /* cf. http://www.w3.org/TR/REC-xml/#dt-text */
+  return
+    (codepoint >= 0x00020 && codepoint <= 0x00d7ff)
+    || codepoint == 0xd
+    || codepoint == 0xa
+    || codepoint == 0x9
+    || (codepoint >= 0x0e000 && codepoint <= 0x00fffd)
+    || (codepoint >= 0x10000 && codepoint <= 0x10ffff);
+}
+
+/* Writes a run of valid XML characters as text */
+static int
+inf_text_filesystem_format_write_run(xmlTextWriterPtr writer,
+                                     const gchar* text,
+                                     gsize bytes)
+{
+  gchar run[INF_TEXT_FILESYSTEM_FORMAT_RUN_SIZE + 1];
+
+  g_assert(bytes <= INF_TEXT_FILESYSTEM_FORMAT_RUN_SIZE);
+  if(bytes == 0)
+    return 0;
+
+  memcpy(run, text, bytes);
+  run[bytes] = '\0';
+
+  return xmlTextWriterWriteString(writer, (const xmlChar*)run);
+}
+
+/* Writes text in the same way as inf_xml_util_add_child_text() adds it to
+ * a node, but without a copy of the whole text. */
+static int
+inf_text_filesystem_format_write_text(xmlTextWriterPtr writer,
+                                      const gchar* text,
+                                      gsize bytes)
+{
+  const gchar* end;
+  const gchar* run;
+  const gchar* p;
+  const gchar* next;
+  gboolean valid;
+  gunichar ch;
+  int result;
+
+  result = 0;
+  end = text + bytes;
+  run = text;
+
+  for(p = text; p < end && result >= 0; p = next)
+  {
+    next = g_utf8_next_char(p);
+    ch = g_utf8_get_char(p);
+    valid = inf_text_filesystem_format_valid_xml_char(ch);
+
+    if(!valid || next - run > INF_TEXT_FILESYSTEM_FORMAT_RUN_SIZE)
+    {
+      result = inf_text_filesystem_format_write_run(writer, run, p - run);
+      run = p;
+
+      if(!valid)
+      {
+        if(result >= 0)
+          result = xmlTextWriterStartElement(writer, BAD_CAST "uchar");
+        if(result >= 0)
+        {
+          result = xmlTextWriterWriteFormatAttribute(
+            writer,
+            BAD_CAST "codepoint",
+            "%" G_GUINT32_FORMAT,
+            ch
+          );
+        }
+        if(result >= 0)
+          result = xmlTextWriterEndElement(writer);
+
+        run = next;
+      }
+    }
+  }
+
+  if(result >= 0)
+    result = inf_text_filesystem_format_write_run(writer, run, end - run);
+
+  return result;
+}
+
+static void
+inf_text_filesystem_format_write_foreach_user_func(InfUser* user,
+                                                   gpointer user_data)
 {
   InfTextFilesystemFormatWriteData* data;
   gpointer user_id;
-  xmlNodePtr node;
+  gchar hue[G_ASCII_DTOSTR_BUF_SIZE];
+  int result;
 
   data = (InfTextFilesystemFormatWriteData*)user_data;
   user_id = GUINT_TO_POINTER(inf_user_get_id(user));
 
+  if(data->result < 0)
+    return;
+
   /* TODO: Use g_hash_table_contains when we can use glib 2.32 */
   if(g_hash_table_lookup(data->encountered_authors, user_id) != NULL)
   {
-    node = xmlNewChild(data->root, NULL, (const xmlChar*)"user", NULL);
-
-    inf_xml_util_set_attribute_uint(node, "id", inf_user_get_id(user));
-    inf_xml_util_set_attribute(node, "name", inf_user_get_name(user));
-    inf_xml_util_set_attribute_double(
-      node,
-      "hue",
+    g_ascii_dtostr(
+      hue,
+      G_ASCII_DTOSTR_BUF_SIZE,
       inf_text_user_get_hue(INF_TEXT_USER(user))
     );
+
+    result = xmlTextWriterWriteString(data->writer, BAD_CAST "\n  ");
+    if(result >= 0)
+      result = xmlTextWriterStartElement(data->writer, BAD_CAST "user");
+    if(result >= 0)
+    {
+      result = xmlTextWriterWriteFormatAttribute(
+        data->writer,
+        BAD_CAST "id",
+        "%u",
+        inf_user_get_id(user)
+      );
+    }
+    if(result >= 0)
+    {
+      result = xmlTextWriterWriteAttribute(
+        data->writer,
+        BAD_CAST "name",
+        BAD_CAST inf_user_get_name(user)
+      );
+    }
+    if(result >= 0)
+    {
+      result = xmlTextWriterWriteAttribute(
+        data->writer,
+        BAD_CAST "hue",
+        BAD_CAST hue
+      );
+    }
+    if(result >= 0)
+      result = xmlTextWriterEndElement(data->writer);
+
+    data->result = result;
+  }
+}
+
+/* Only users that have contributed to the document are written, the others
+ * we drop to avoid cluttering the user table too much. Since the users are
+ * written before the buffer, find the authors first. Returns the number of
+ * segments in buffer. */
+static guint
+inf_text_filesystem_format_collect_authors(InfTextBuffer* buffer,
+                                           GHashTable* authors)
+{
+  InfTextBufferIter* iter;
+  guint author;
+  guint n_segments;
+
+  n_segments = 0;
+  iter = inf_text_buffer_create_begin_iter(buffer);
+  if(iter != NULL)
+  {
+    do
+    {
+      author = inf_text_buffer_iter_get_author(buffer, iter);
+
+      /* TODO: Use g_hash_table_add with glib 2.32 */
+      g_hash_table_insert(
+        authors,
+        GUINT_TO_POINTER(author),
+        GUINT_TO_POINTER(author)
+      );
+
+      ++n_segments;
+    } while(inf_text_buffer_iter_next(buffer, iter));
+
+    inf_text_buffer_destroy_iter(buffer, iter);
+  }
+
+  return n_segments;
+}
+
+static void
+inf_text_filesystem_format_collect_user_func(InfUser* user,
+                                             gpointer user_data)
+{
+  InfTextFilesystemFormatWriteData* data;
+  gpointer user_id;
+
+  data = (InfTextFilesystemFormatWriteData*)user_data;
+  user_id = GUINT_TO_POINTER(inf_user_get_id(user));
+
+  if(g_hash_table_lookup(data->encountered_authors, user_id) != NULL)
+    data->users = g_slist_prepend(data->users, user);
+}
+
+/* Writes the session into writer, one segment at a time, so that apart from
+ * the output buffer of the writer only the text of a single segment needs
+ * to be held in memory. If mappable is TRUE, only the size of the
+ * segments is written instead of their text. */
+static gboolean
+inf_text_filesystem_format_write_session(xmlTextWriterPtr writer,
+                                         InfUserTable* user_table,
+                                         InfTextBuffer* buffer,
+                                         gboolean mappable,
+                                         GError** error)
+{
+  InfTextFilesystemFormatWriteData data;
+  InfTextBufferIter* iter;
+  gboolean is_utf8;
+  gchar* content;
+  gsize bytes;
+  int result;
+
+  is_utf8 = TRUE;
+  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") != 0)
+    is_utf8 = FALSE;
+
+  data.writer = writer;
+  data.encountered_authors = g_hash_table_new(NULL, NULL);
+  data.users = NULL;
+  data.result = 0;
+
+  inf_text_filesystem_format_collect_authors(
+    buffer,
+    data.encountered_authors
+  );
+
+  result = xmlTextWriterStartDocument(writer, NULL, NULL, NULL);
+  if(result >= 0)
+  {
+    result = xmlTextWriterStartElement(
+      writer,
+      BAD_CAST "inf-text-session"
+    );
+  }
+
+  if(result >= 0)
+  {
+    inf_user_table_foreach_user(
+      user_table,
+      inf_text_filesystem_format_write_foreach_user_func,
+      &data
+    );
+
+    result = data.result;
+  }
+
+  g_hash_table_destroy(data.encountered_authors);
+
+  if(result >= 0)
+    result = xmlTextWriterWriteString(writer, BAD_CAST "\n  ");
+  if(result >= 0)
+    result = xmlTextWriterStartElement(writer, BAD_CAST "buffer");
+
+  iter = NULL;
+  if(result >= 0)
+    iter = inf_text_buffer_create_begin_iter(buffer);
+
+  if(iter != NULL)
+  {
+    do
+    {
+      content = NULL;
+      bytes = inf_text_buffer_iter_get_bytes(buffer, iter);
+
+      /* The text is only needed to find its size in UTF-8 when writing a
+       * mappable file. */
+      if(mappable == FALSE || is_utf8 == FALSE)
+      {
+        content = inf_text_filesystem_format_get_utf8_text(
+          buffer,
+          iter,
+          &bytes,
+          error
+        );
+
+        if(content == NULL)
+        {
+          inf_text_buffer_destroy_iter(buffer, iter);
+          return FALSE;
+        }
+      }
+
+      result = xmlTextWriterWriteString(writer, BAD_CAST "\n    ");
+      if(result >= 0)
+        result = xmlTextWriterStartElement(writer, BAD_CAST "segment");
+      if(result >= 0)
+      {
+        result = xmlTextWriterWriteFormatAttribute(
+          writer,
+          BAD_CAST "author",
+          "%u",
+          inf_text_buffer_iter_get_author(buffer, iter)
+        );
+      }
+
+      if(mappable == TRUE)
+      {
+        if(result >= 0)
+        {
+          result = xmlTextWriterWriteFormatAttribute(
+            writer,
+            BAD_CAST "bytes",
+            "%" G_GSIZE_FORMAT,
+            bytes
+          );
+        }
+        if(result >= 0)
+        {
+          result = xmlTextWriterWriteFormatAttribute(
+            writer,
+            BAD_CAST "chars",
+            "%u",
+            inf_text_buffer_iter_get_length(buffer, iter)
+          );
+        }
+      }
+      else
+      {
+        if(result >= 0)
+        {
+          result = inf_text_filesystem_format_write_text(
+            writer,
+            content,
+            bytes
+          );
+        }
+      }
+
+      if(result >= 0)
+        result = xmlTextWriterEndElement(writer);
+
+      g_free(content);
+    } while(result >= 0 && inf_text_buffer_iter_next(buffer, iter));
+
+    inf_text_buffer_destroy_iter(buffer, iter);
+  }
+
+  if(result >= 0)
+    result = xmlTextWriterWriteString(writer, BAD_CAST "\n  ");
+  if(result >= 0)
+    result = xmlTextWriterEndElement(writer);
+  if(result >= 0)
+    result = xmlTextWriterWriteString(writer, BAD_CAST "\n");
+  if(result >= 0)
+    result = xmlTextWriterEndDocument(writer);
+
+  if(result < 0)
+  {
+    inf_text_filesystem_format_set_writer_error(error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * inf_text_filesystem_format_write:
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path where to write the session to.
+ * @user_table: The #InfUserTable to write.
+ * @buffer: The #InfTextBuffer to write.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Writes the given user table and buffer into the filesystem storage at
+ * @path. If successful, the session can then be read back with
+ * inf_text_filesystem_format_read(). If the function fails, %FALSE is
+ * returned and @error is set.
+ *
+ * The document is written incrementally, so apart from the document itself
+ * only a single segment of it is held in memory at a time.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
+                                 const gchar* path,
+                                 InfUserTable* user_table,
+                                 InfTextBuffer* buffer,
+                                 GError** error)
+{
+  FILE* stream;
+  gchar* full_path;
+  gchar* temp_path;
+  xmlOutputBufferPtr output;
+  xmlTextWriterPtr writer;
+  gboolean result;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
+  g_return_val_if_fail(path != NULL, FALSE);
+  g_return_val_if_fail(INF_IS_USER_TABLE(user_table), FALSE);
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  stream = inf_text_filesystem_format_open_temporary(
+    storage,
+    path,
+    &full_path,
+    &temp_path,
+    error
+  );
+
+  if(stream == NULL)
+    return FALSE;
+
+  /* The stream is closed by close_temporary, not by libxml2 */
+  output = xmlOutputBufferCreateIO(
+    inf_text_filesystem_format_write_write_func,
+    NULL,
+    stream,
+    NULL
+  );
+
+  writer = NULL;
+  if(output != NULL)
+  {
+    writer = xmlNewTextWriter(output);
+    if(writer == NULL)
+      xmlOutputBufferClose(output);
+  }
+
+  if(writer == NULL)
+  {
+    inf_text_filesystem_format_set_writer_error(error);
+    result = FALSE;
+  }
+  else
+  {
+    result = inf_text_filesystem_format_write_session(
+      writer,
+      user_table,
+      buffer,
+      FALSE,
+      error
+    );
+
+    xmlFreeTextWriter(writer);
   }
+
+  return inf_text_filesystem_format_close_temporary(
+    stream,
+    full_path,
+    temp_path,
+    result,
+    error
+  );
 }
 
 /**
- * inf_text_filesystem_format_read:
+ * inf_text_filesystem_format_write_mappable:
  * @storage: A #InfdFilesystemStorage.
- * @path: Storage path to retrieve the session from.
- * @user_table: An empty #InfUserTable to use as the new session's user table.
- * @buffer: An empty #InfTextBuffer to use as the new session's buffer.
+ * @path: Storage path where to write the session to.
+ * @user_table: The #InfUserTable to write.
+ * @buffer: The #InfTextBuffer to write.
  * @error: Location to store error information, if any, or %NULL.
  *
- * Reads a text session from @path in @storage. The file is expected to have
- * been saved with inf_text_filesystem_format_write() before. The @user_table
- * parameter should be an empty user table that will be used for the session,
- * and the @buffer parameter should be an empty #InfTextBuffer, and the
- * document will be written into this buffer. If the function succeeds, the
- * user table and buffer can be used to create an #InfTextSession with
- * inf_text_session_new_with_user_table(). If the function fails, %FALSE is
- * returned and @error is set.
+ * Writes the given user table and buffer into the filesystem storage at
+ * @path, like inf_text_filesystem_format_write(). However, the text of the
+ * document is not escaped into the XML, but stored verbatim after it. When
+ * the session is read back with inf_text_filesystem_format_read() into a
+ * #InfTextPieceBuffer, the text does not need to be parsed or copied. It is
+ * only checked to be valid UTF-8, and the buffer refers to the mapped file
+ * afterwards. This allows to open large documents quickly.
  *
  * Returns: %TRUE on success or %FALSE on error.
  */
 gboolean
-inf_text_filesystem_format_read(InfdFilesystemStorage* storage,
-                                const gchar* path,
-                                InfUserTable* user_table,
-                                InfTextBuffer* buffer,
-                                GError** error)
+inf_text_filesystem_format_write_mappable(InfdFilesystemStorage* storage,
+                                          const gchar* path,
+                                          InfUserTable* user_table,
+                                          InfTextBuffer* buffer,
+                                          GError** error)
 {
+  InfTextBufferIter* iter;
+  gchar* content;
+  gsize bytes;
+
   FILE* stream;
   gchar* full_path;
-  gchar* uri;
-
-  xmlDocPtr doc;
-  xmlErrorPtr xmlerror;
-  xmlNodePtr root;
-  xmlNodePtr child;
+  gchar* temp_path;
+  xmlBufferPtr xml;
+  xmlTextWriterPtr writer;
+  gchar* header;
   gboolean result;
 
   g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
   g_return_val_if_fail(path != NULL, FALSE);
+  g_return_val_if_fail(INF_IS_USER_TABLE(user_table), FALSE);
   g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), FALSE);
   g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
-  g_return_val_if_fail(inf_text_buffer_get_length(buffer) == 0, FALSE);
 
-  /* TODO: Use a SAX parser for better performance */
-  full_path = NULL;
-  stream = infd_filesystem_storage_open(
-    INFD_FILESYSTEM_STORAGE(storage),
-    "InfText",
-    path,
-    "r",
-    &full_path,
+  /* Write the XML into memory first, so that we know where the text of the
+   * document starts. */
+  xml = xmlBufferCreate();
+  writer = xmlNewTextWriterMemory(xml, 0);
+  if(writer == NULL)
+  {
+    inf_text_filesystem_format_set_writer_error(error);
+    xmlBufferFree(xml);
+    return FALSE;
+  }
+
+  result = inf_text_filesystem_format_write_session(
+    writer,
+    user_table,
+    buffer,
+    TRUE,
     error
   );
 
-  if(stream == NULL)
+  xmlFreeTextWriter(writer);
+
+  if(result == FALSE)
   {
-    g_free(full_path);
+    xmlBufferFree(xml);
     return FALSE;
   }
 
-  uri = g_filename_to_uri(full_path, NULL, error);
-  g_free(full_path);
+  stream = inf_text_filesystem_format_open_temporary(
+    storage,
+    path,
+    &full_path,
+    &temp_path,
+    error
+  );
 
-  if(uri == NULL)
+  if(stream == NULL)
+  {
+    xmlBufferFree(xml);
     return FALSE;
+  }
 
-  doc = xmlReadIO(
-    inf_text_filesystem_format_read_read_func,
-    inf_text_filesystem_format_read_close_func,
-    stream,
-    uri,
-    "UTF-8",
-    XML_PARSE_NOWARNING | XML_PARSE_NOERROR
+  header = g_strdup_printf(
+    "%s%d\n",
+    INF_TEXT_FILESYSTEM_FORMAT_MAPPABLE_MAGIC,
+    xmlBufferLength(xml)
   );
 
-  g_free(uri);
-
-  if(doc == NULL)
+  bytes = strlen(header);
+  if(infd_filesystem_storage_stream_write(stream, header, bytes) != bytes ||
+     infd_filesystem_storage_stream_write(stream, xmlBufferContent(xml),
+                                          xmlBufferLength(xml)) !=
+       (gsize)xmlBufferLength(xml))
   {
-    xmlerror = xmlGetLastError();
-
-    g_set_error(
-      error,
-      g_quark_from_static_string("LIBXML2_PARSER_ERROR"),
-      xmlerror->code,
-      _("Error parsing XML in file \"%s\": [%d]: %s"),
-      path,
-      xmlerror->line,
-      xmlerror->message
-    );
-
+    inf_text_filesystem_format_system_error(errno, error);
     result = FALSE;
   }
-  else
+
+  g_free(header);
+  xmlBufferFree(xml);
+
+  /* Then write the text of the segments */
+  iter = NULL;
+  if(result == TRUE)
+    iter = inf_text_buffer_create_begin_iter(buffer);
+
+  if(iter != NULL)
   {
-    root = xmlDocGetRootElement(doc);
-    if(strcmp((const char*)root->name, "inf-text-session") != 0)
+    do
     {
-      g_set_error(
-        error,
-        inf_text_filesystem_format_error_quark(),
-        INF_TEXT_FILESYSTEM_FORMAT_ERROR_NOT_A_TEXT_SESSION,
-        _("Error processing file \"%s\": %s"),
-        path,
-        _("The document is not a text session")
+      content = inf_text_filesystem_format_get_utf8_text(
+        buffer,
+        iter,
+        &bytes,
+        error
       );
 
-      result = FALSE;
-    }
-    else
-    {
-      for(child = root->children; child != NULL; child = child->next)
+      if(content == NULL)
       {
-        if(child->type != XML_ELEMENT_NODE)
-          continue;
-
-        if(strcmp((const char*)child->name, "user") == 0)
-        {
-          if(!inf_text_filesystem_format_read_user(user_table, child, error))
-          {
-            g_prefix_error(error, _("Error processing file \"%s\": "), path);
-            result = FALSE;
-            break;
-          }
-        }
-        else if(strcmp((const char*)child->name, "buffer") == 0)
+        result = FALSE;
+      }
+      else
+      {
+        if(infd_filesystem_storage_stream_write(stream, content, bytes) !=
+           bytes)
         {
-          if(!inf_text_filesystem_format_read_buffer(buffer, user_table,
-                                                     child, error))
-          {
-            g_prefix_error(error, _("Error processing file \"%s\": "), path);
-            result = FALSE;
-            break;
-          }
+          inf_text_filesystem_format_system_error(errno, error);
+          result = FALSE;
         }
+
+        g_free(content);
       }
+    } while(result == TRUE && inf_text_buffer_iter_next(buffer, iter));
 
-      if(child == NULL)
-        result = TRUE;
-    }
+    inf_text_buffer_destroy_iter(buffer, iter);
+  }
+
+  return inf_text_filesystem_format_close_temporary(
+    stream,
+    full_path,
+    temp_path,
+    result,
+    error
+  );
+}
 
-    xmlFreeDoc(doc);
+static gboolean
+inf_text_filesystem_format_write_data(FILE* stream,
+                                      GChecksum* checksum,
+                                      gconstpointer data,
+                                      gsize len,
+                                      GError** error)
+{
+  if(checksum != NULL)
+    g_checksum_update(checksum, data, len);
+
+  if(infd_filesystem_storage_stream_write(stream, data, len) != len)
+  {
+    inf_text_filesystem_format_system_error(errno, error);
+    return FALSE;
   }
 
-  return result;
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_format_write_uint32(FILE* stream,
+                                        GChecksum* checksum,
+                                        guint32 value,
+                                        GError** error)
+{
+  value = GUINT32_TO_LE(value);
+
+  return inf_text_filesystem_format_write_data(
+    stream,
+    checksum,
+    &value,
+    4,
+    error
+  );
+}
+
+static gboolean
+inf_text_filesystem_format_write_uint64(FILE* stream,
+                                        GChecksum* checksum,
+                                        guint64 value,
+                                        GError** error)
+{
+  value = GUINT64_TO_LE(value);
+
+  return inf_text_filesystem_format_write_data(
+    stream,
+    checksum,
+    &value,
+    8,
+    error
+  );
+}
+
+static gboolean
+inf_text_filesystem_format_write_binary_user(FILE* stream,
+                                             GChecksum* checksum,
+                                             InfUser* user,
+                                             GError** error)
+{
+  const gchar* name;
+  gdouble hue_value;
+  guint64 hue;
+
+  name = inf_user_get_name(user);
+  hue_value = inf_text_user_get_hue(INF_TEXT_USER(user));
+  memcpy(&hue, &hue_value, sizeof(hue));
+
+  if(!inf_text_filesystem_format_write_uint32(stream, checksum,
+                                              inf_user_get_id(user), error))
+    return FALSE;
+  if(!inf_text_filesystem_format_write_uint64(stream, checksum, hue, error))
+    return FALSE;
+  if(!inf_text_filesystem_format_write_uint32(stream, checksum,
+                                              strlen(name), error))
+    return FALSE;
+
+  return inf_text_filesystem_format_write_data(
+    stream,
+    checksum,
+    name,
+    strlen(name),
+    error
+  );
+}
+
+static gboolean
+inf_text_filesystem_format_write_binary_segment(FILE* stream,
+                                                GChecksum* checksum,
+                                                guint author,
+                                                guint chars,
+                                                const gchar* text,
+                                                gsize bytes,
+                                                GError** error)
+{
+  if(!inf_text_filesystem_format_write_uint32(stream, checksum, author, error))
+    return FALSE;
+  if(!inf_text_filesystem_format_write_uint32(stream, checksum, chars, error))
+    return FALSE;
+  if(!inf_text_filesystem_format_write_uint64(stream, checksum, bytes, error))
+    return FALSE;
+
+  return inf_text_filesystem_format_write_data(
+    stream,
+    checksum,
+    text,
+    bytes,
+    error
+  );
 }
 
 /**
- * inf_text_filesystem_format_write:
+ * inf_text_filesystem_format_write_binary:
  * @storage: A #InfdFilesystemStorage.
  * @path: Storage path where to write the session to.
  * @user_table: The #InfUserTable to write.
  * @buffer: The #InfTextBuffer to write.
+ * @checksum: Whether to append a checksum of the content to the file.
  * @error: Location to store error information, if any, or %NULL.
  *
  * Writes the given user table and buffer into the filesystem storage at
- * @path. If successful, the session can then be read back with
- * inf_text_filesystem_format_read(). If the function fails, %FALSE is
- * returned and @error is set.
+ * @path, like inf_text_filesystem_format_write(), but in a compact binary
+ * format instead of XML. The file consists of a header line, a flags word,
+ * the users that have contributed to the document, and then the author,
+ * length and text of each segment. All numbers are stored as little endian
+ * integers of 32 bit, or 64 bit for hue and byte length of the segments.
+ * The text is stored verbatim in UTF-8, so that reading the file back with
+ * inf_text_filesystem_format_read() does not need to parse or unescape it.
+ *
+ * If @checksum is %TRUE, a SHA-256 checksum of the file content is
+ * appended, which is verified when the file is read back.
  *
  * Returns: %TRUE on success or %FALSE on error.
  */
 gboolean
-inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
-                                 const gchar* path,
-                                 InfUserTable* user_table,
-                                 InfTextBuffer* buffer,
-                                 GError** error)
+inf_text_filesystem_format_write_binary(InfdFilesystemStorage* storage,
+                                        const gchar* path,
+                                        InfUserTable* user_table,
+                                        InfTextBuffer* buffer,
+                                        gboolean checksum,
+                                        GError** error)
 {
+  InfTextFilesystemFormatWriteData data;
   InfTextBufferIter* iter;
-  xmlNodePtr buffer_node;
-  xmlNodePtr segment_node;
-
-  guint author;
+  guint n_segments;
+  GSList* item;
   gchar* content;
   gsize bytes;
-  gchar* converted;
-  gsize converted_bytes;
+  guint8 digest[64];
+  gsize digest_len;
 
   FILE* stream;
-  xmlDocPtr doc;
-  xmlErrorPtr xmlerror;
-  gboolean is_utf8;
-
-  InfTextFilesystemFormatWriteData data;
+  gchar* full_path;
+  gchar* temp_path;
+  GChecksum* sum;
+  gboolean result;
 
   g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
   g_return_val_if_fail(path != NULL, FALSE);
@@ -472,130 +2086,153 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
   g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), FALSE);
   g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
 
-  is_utf8 = TRUE;
-  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") != 0)
-    is_utf8 = FALSE;
-
-  /* Open stream before exporting buffer to XML so possible errors are
-   * catched earlier. */
-  stream = infd_filesystem_storage_open(
-    INFD_FILESYSTEM_STORAGE(storage),
-    "InfText",
+  stream = inf_text_filesystem_format_open_temporary(
+    storage,
     path,
-    "w",
-    NULL,
+    &full_path,
+    &temp_path,
     error
   );
 
   if(stream == NULL)
     return FALSE;
 
-  data.root = xmlNewNode(NULL, (const xmlChar*)"inf-text-session");
+  data.writer = NULL;
   data.encountered_authors = g_hash_table_new(NULL, NULL);
+  data.users = NULL;
+  data.result = 0;
+
+  n_segments = inf_text_filesystem_format_collect_authors(
+    buffer,
+    data.encountered_authors
+  );
+
+  inf_user_table_foreach_user(
+    user_table,
+    inf_text_filesystem_format_collect_user_func,
+    &data
+  );
+
+  g_hash_table_destroy(data.encountered_authors);
+
+  sum = NULL;
+  if(checksum == TRUE)
+    sum = g_checksum_new(INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM_TYPE);
+
+  result = inf_text_filesystem_format_write_data(
+    stream,
+    sum,
+    INF_TEXT_FILESYSTEM_FORMAT_BINARY_MAGIC,
+    strlen(INF_TEXT_FILESYSTEM_FORMAT_BINARY_MAGIC),
+    error
+  );
+
+  if(result == TRUE)
+  {
+    result = inf_text_filesystem_format_write_uint32(
+      stream,
+      sum,
+      checksum ? INF_TEXT_FILESYSTEM_FORMAT_BINARY_CHECKSUM : 0,
+      error
+    );
+  }
+
+  if(result == TRUE)
+  {
+    result = inf_text_filesystem_format_write_uint32(
+      stream,
+      sum,
+      g_slist_length(data.users),
+      error
+    );
+  }
+
+  for(item = data.users; item != NULL && result == TRUE; item = item->next)
+  {
+    result = inf_text_filesystem_format_write_binary_user(
+      stream,
+      sum,
+      INF_USER(item->data),
+      error
+    );
+  }
+
+  g_slist_free(data.users);
+
+  if(result == TRUE)
+  {
+    result = inf_text_filesystem_format_write_uint32(
+      stream,
+      sum,
+      n_segments,
+      error
+    );
+  }
+
+  iter = NULL;
+  if(result == TRUE)
+    iter = inf_text_buffer_create_begin_iter(buffer);
 
-  buffer_node = xmlNewNode(NULL, (const xmlChar*)"buffer");
-  iter = inf_text_buffer_create_begin_iter(buffer);
   if(iter != NULL)
   {
     do
     {
-      author = inf_text_buffer_iter_get_author(buffer, iter);
-      content = inf_text_buffer_iter_get_text(buffer, iter);
-      bytes = inf_text_buffer_iter_get_bytes(buffer, iter);
-
-      /* TODO: Use g_hash_table_add with glib 2.32 */
-      g_hash_table_insert(
-        data.encountered_authors,
-        GUINT_TO_POINTER(author),
-        GUINT_TO_POINTER(author)
-      );
-
-      segment_node = xmlNewChild(
-        buffer_node,
-        NULL,
-        (const xmlChar*)"segment",
-        NULL
+      content = inf_text_filesystem_format_get_utf8_text(
+        buffer,
+        iter,
+        &bytes,
+        error
       );
 
-      inf_xml_util_set_attribute_uint(segment_node, "author", author);
-
-      if(is_utf8)
+      if(content == NULL)
       {
-        /* Buffer is UTF-8, no conversion necessary */
-        inf_xml_util_add_child_text(segment_node, content, bytes);
-        g_free(content);
+        result = FALSE;
       }
       else
       {
-        /* Convert from buffer encoding to UTF-8 for storage */
-        converted = g_convert(
+        result = inf_text_filesystem_format_write_binary_segment(
+          stream,
+          sum,
+          inf_text_buffer_iter_get_author(buffer, iter),
+          inf_text_buffer_iter_get_length(buffer, iter),
           content,
           bytes,
-          "UTF-8",
-          inf_text_buffer_get_encoding(buffer),
-          NULL,
-          &converted_bytes,
           error
         );
 
         g_free(content);
-
-        if(converted == NULL)
-        {
-          xmlFreeNode(buffer_node);
-          xmlFreeNode(data.root);
-          g_hash_table_destroy(data.encountered_authors);
-          infd_filesystem_storage_stream_close(stream);
-          return FALSE;
-        }
-
-        inf_xml_util_add_child_text(segment_node, converted, converted_bytes);
-        g_free(converted);
       }
-    } while(inf_text_buffer_iter_next(buffer, iter));
+    } while(result == TRUE && inf_text_buffer_iter_next(buffer, iter));
 
     inf_text_buffer_destroy_iter(buffer, iter);
   }
 
-  /* After we wrote the buffer, now write the user table, but only for those
-   * users that have contributed to the document. The others we drop, to
-   * avoid cluttering the user table too much. */
-  inf_user_table_foreach_user(
-    user_table,
-    inf_text_filesystem_format_write_foreach_user_func,
-    &data
-  );
-
-  g_hash_table_destroy(data.encountered_authors);
-
-  /* Write the buffer after the users */
-  xmlAddChild(data.root, buffer_node);
-
-  doc = xmlNewDoc((const xmlChar*)"1.0");
-  xmlDocSetRootElement(doc, data.root);
-
-  /* TODO: At this point, we should tell libxml2 to use
-   * infd_filesystem_storage_stream_write() instead of fwrite(),
-   * to prevent C runtime mixups. */
-  if(xmlDocFormatDump(stream, doc, 1) == -1)
+  if(sum != NULL)
   {
-    xmlerror = xmlGetLastError();
-    infd_filesystem_storage_stream_close(stream);
-    xmlFreeDoc(doc);
+    if(result == TRUE)
+    {
+      digest_len = sizeof(digest);
+      g_checksum_get_digest(sum, digest, &digest_len);
 
-    g_set_error_literal(
-      error,
-      g_quark_from_static_string("LIBXML2_OUTPUT_ERROR"),
-      xmlerror->code,
-      xmlerror->message
-    );
+      result = inf_text_filesystem_format_write_data(
+        stream,
+        NULL,
+        digest,
+        digest_len,
+        error
+      );
+    }
 
-    return FALSE;
+    g_checksum_free(sum);
   }
 
-  infd_filesystem_storage_stream_close(stream);
-  xmlFreeDoc(doc);
-  return TRUE;
+  return inf_text_filesystem_format_close_temporary(
+    stream,
+    full_path,
+    temp_path,
+    result,
+    error
+  );
 }
 
 /* vim:set et sw=2 ts=2: */
@@ -35,6 +35,12 @@ G_BEGIN_DECLS
  * session contains users with duplicate ID or duplicate name.
  * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER: A segment of the text
  * document is written by a user which does not exist.
+ * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD: The header or the
+ * text of a file written by inf_text_filesystem_format_write_mappable() or
+ * inf_text_filesystem_format_write_binary() is invalid or truncated.
+ * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_CHECKSUM_MISMATCH: The checksum of a
+ * file written by inf_text_filesystem_format_write_binary() does not match
+ * its content.
  *
  * Errors that can occur when reading a #InfTextSession from a
  * #InfdFilesystemStorage.
@@ -42,7 +48,9 @@ G_BEGIN_DECLS
 typedef enum _InfTextFilesystemFormatError {
   INF_TEXT_FILESYSTEM_FORMAT_ERROR_NOT_A_TEXT_SESSION,
   INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
-  INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER,
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD,
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_CHECKSUM_MISMATCH
 } InfTextFilesystemFormatError;
 
 gboolean
@@ -59,6 +67,21 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
                                  InfTextBuffer* buffer,
                                  GError** error);
 
+gboolean
+inf_text_filesystem_format_write_mappable(InfdFilesystemStorage* storage,
+                                          const gchar* path,
+                                          InfUserTable* user_table,
+                                          InfTextBuffer* buffer,
+                                          GError** error);
+
+gboolean
+inf_text_filesystem_format_write_binary(InfdFilesystemStorage* storage,
+                                        const gchar* path,
+                                        InfUserTable* user_table,
+                                        InfTextBuffer* buffer,
+                                        gboolean checksum,
+                                        GError** error);
+
 G_END_DECLS
 
 #endif /* __INF_TEXT_FILESYSTEM_FORMAT_H__ */
@@ -34,6 +34,7 @@
  */
 
 #include <libinftext/inf-text-fixline-buffer.h>
+#include <libinftext/inf-text-line-index.h>
 #include <libinftext/inf-text-user.h>
 #include <libinftext/inf-text-move-operation.h>
 #include <libinfinity/common/inf-buffer.h>
@@ -52,6 +53,7 @@ typedef struct _InfTextFixlineBufferPrivate InfTextFixlineBufferPrivate;
 struct _InfTextFixlineBufferPrivate {
   InfIo* io;
   InfTextBuffer* buffer;
+  InfTextLineIndex* line_index;
   guint lines;
 
   /* base + n_keep == buffer */
@@ -138,61 +140,33 @@ inf_text_fixline_buffer_newlines_to_chunk(InfTextChunk* chunk,
 /* Count the number of trailing newlines in the buffer, but only check
  * up to the given position. Set min_check to 0 to check the whole buffer. */
 static guint
-inf_text_fixline_buffer_buffer_count_trailing_newlines(InfTextBuffer* buffer,
+inf_text_fixline_buffer_buffer_count_trailing_newlines(InfTextLineIndex* index,
                                                        guint min_check)
 {
-  InfTextBufferIter* iter;
-  guint cur_pos;
-
-  gchar* text;
-  gchar* text_pos;
-  gunichar c;
-
-  /* TODO: Implement this properly with iconv */
-  g_assert(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") == 0);
-
-  iter = inf_text_buffer_create_end_iter(buffer);
-  if(iter == NULL) return 0;
-
-  cur_pos = inf_text_buffer_get_length(buffer);
-  text = inf_text_buffer_iter_get_text(buffer, iter);
-  text_pos = text + inf_text_buffer_iter_get_bytes(buffer, iter);
-
-  for(cur_pos = inf_text_buffer_get_length(buffer);
-      cur_pos > min_check;
-      --cur_pos)
-  {
-    if(text_pos == text)
-    {
-      g_free(text);
-      inf_text_buffer_iter_prev(buffer, iter);
-      text = inf_text_buffer_iter_get_text(buffer, iter);
-      text_pos = text + inf_text_buffer_iter_get_bytes(buffer, iter);
-    }
-
-    g_assert(text_pos > text);
-
-    text_pos = g_utf8_prev_char(text_pos);
-    c = g_utf8_get_char(text_pos);
-    if(c != '\n') break;
-  }
+  InfTextBuffer* buffer;
+  guint length;
+  guint count;
 
-  g_free(text);
-  inf_text_buffer_destroy_iter(buffer, iter);
+  buffer = inf_text_line_index_get_buffer(index);
+  length = inf_text_buffer_get_length(buffer);
+  g_assert(min_check <= length);
 
-  return inf_text_buffer_get_length(buffer) - cur_pos;
+  count = inf_text_line_index_get_trailing_newlines(index);
+  return MIN(count, length - min_check);
 }
 
 /* Checks whether the given buffer contains only newline characters
  * after the given position */
 static gboolean
-inf_text_fixline_buffer_buffer_only_newlines_after(InfTextBuffer* buffer,
+inf_text_fixline_buffer_buffer_only_newlines_after(InfTextLineIndex* index,
                                                    guint pos)
 {
+  InfTextBuffer* buffer;
   guint new_lines;
 
+  buffer = inf_text_line_index_get_buffer(index);
   new_lines = inf_text_fixline_buffer_buffer_count_trailing_newlines(
-    buffer,
+    index,
     pos
   );
 
@@ -533,19 +507,15 @@ inf_text_fixline_buffer_base_to_keep(InfTextFixlineBuffer* fixline_buffer,
   );
 }
 
+/* Makes the number of trailing newlines in the base buffer match the
+ * configured number of lines, given that it currently is count. */
 static void
-inf_text_fixline_buffer_fix_lines(InfTextFixlineBuffer* fixline_buffer)
+inf_text_fixline_buffer_fix_lines_from(InfTextFixlineBuffer* fixline_buffer,
+                                       guint count)
 {
   InfTextFixlineBufferPrivate* priv;
-  guint count;
-
   priv = INF_TEXT_FIXLINE_BUFFER_PRIVATE(fixline_buffer);
 
-  count = inf_text_fixline_buffer_buffer_count_trailing_newlines(
-    priv->buffer,
-    0
-  );
-
   if(count < priv->lines)
   {
     inf_text_fixline_buffer_keep_to_base(fixline_buffer, priv->lines - count);
@@ -556,6 +526,22 @@ inf_text_fixline_buffer_fix_lines(InfTextFixlineBuffer* fixline_buffer)
   }
 }
 
+static void
+inf_text_fixline_buffer_fix_lines(InfTextFixlineBuffer* fixline_buffer)
+{
+  InfTextFixlineBufferPrivate* priv;
+  guint count;
+
+  priv = INF_TEXT_FIXLINE_BUFFER_PRIVATE(fixline_buffer);
+
+  count = inf_text_fixline_buffer_buffer_count_trailing_newlines(
+    priv->line_index,
+    0
+  );
+
+  inf_text_fixline_buffer_fix_lines_from(fixline_buffer, count);
+}
+
 static void
 inf_text_fixline_buffer_dispatch_func(gpointer user_data)
 {
@@ -601,7 +587,9 @@ inf_text_fixline_buffer_text_inserted_cb(InfTextBuffer* buffer,
   end = buffer_length + priv->n_keep;
 
   if(inf_text_fixline_buffer_chunk_only_newlines(chunk) &&
-     inf_text_fixline_buffer_buffer_only_newlines_after(buffer, pos + chunk_length))
+     inf_text_fixline_buffer_buffer_only_newlines_after(
+       priv->line_index,
+       pos + chunk_length))
   {
     /* Newlines were inserted at the end of the buffer. Don't propagate.
      * Note that this step is optional, we could also propagate it to the
@@ -746,7 +734,7 @@ inf_text_fixline_buffer_text_erased_cb(InfTextBuffer* buffer,
    * end: length of buffer before the operation */
 
   if(inf_text_fixline_buffer_chunk_only_newlines(chunk) &&
-     inf_text_fixline_buffer_buffer_only_newlines_after(buffer, pos))
+     inf_text_fixline_buffer_buffer_only_newlines_after(priv->line_index, pos))
   {
     /* Newlines were removed from the end of the buffer. Don't propagate.
      * Note that this step is optional, we could also propagate it to the
@@ -886,6 +874,7 @@ inf_text_fixline_buffer_init(InfTextFixlineBuffer* fixline_buffer)
 
   priv->io = NULL;
   priv->buffer = NULL;
+  priv->line_index = NULL;
   priv->lines = 0;
   priv->keep = NULL;
   priv->n_keep = 0;
@@ -928,6 +917,9 @@ inf_text_fixline_buffer_dispose(GObject* object)
       fixline_buffer
     );
 
+    g_object_unref(priv->line_index);
+    priv->line_index = NULL;
+
     g_object_unref(priv->buffer);
     priv->buffer = NULL;
   }
@@ -986,6 +978,10 @@ inf_text_fixline_buffer_set_property(GObject* object,
     g_assert(priv->buffer == NULL);
     priv->buffer = INF_TEXT_BUFFER(g_value_dup_object(value));
 
+    /* Create the line index before connecting to the buffer signals, so
+     * that it is already up to date when our own handlers run. */
+    priv->line_index = inf_text_line_index_new(priv->buffer);
+
     g_signal_connect(
       G_OBJECT(priv->buffer),
       "text-inserted",
@@ -1353,6 +1349,126 @@ inf_text_fixline_buffer_buffer_erase_text(InfTextBuffer* buffer,
   inf_text_fixline_buffer_fix_lines(fixline_buffer);
 }
 
+static void
+inf_text_fixline_buffer_buffer_append_text(InfTextBuffer* buffer,
+                                           gconstpointer text,
+                                           gsize bytes,
+                                           guint len,
+                                           InfUser* user)
+{
+  InfTextFixlineBuffer* fixline_buffer;
+  InfTextFixlineBufferPrivate* priv;
+  const gchar* text_end;
+  guint trailing;
+  guint buf_len;
+  guint author;
+  guint i;
+
+  fixline_buffer = INF_TEXT_FIXLINE_BUFFER(buffer);
+  priv = INF_TEXT_FIXLINE_BUFFER_PRIVATE(fixline_buffer);
+  buf_len = inf_text_buffer_get_length(priv->buffer);
+
+  /* TODO: Implement this properly with iconv */
+  g_assert(strcmp(inf_text_buffer_get_encoding(priv->buffer), "UTF-8") == 0);
+
+  /* A newline byte cannot be part of a multibyte character in UTF-8 */
+  text_end = (const gchar*)text + bytes;
+  for(trailing = 0; trailing < len && text_end[-1] == '\n'; ++trailing)
+    --text_end;
+
+  if(trailing == len && priv->n_keep >= 0)
+  {
+    /* Add the added newlines only to the keep */
+    author = (user == NULL) ? 0 : inf_user_get_id(user);
+    priv->keep = g_realloc(priv->keep, (priv->n_keep + len) * sizeof(guint));
+
+    for(i = 0; i < len; ++i)
+      priv->keep[priv->n_keep + i] = author;
+
+    priv->n_keep += len;
+    return;
+  }
+
+  inf_signal_handlers_block_by_func(
+    priv->buffer,
+    G_CALLBACK(inf_text_fixline_buffer_text_inserted_cb),
+    fixline_buffer
+  );
+
+  if(priv->n_keep >= 0)
+  {
+    if(priv->n_keep > 0)
+      inf_text_fixline_buffer_keep_to_base(fixline_buffer, priv->n_keep);
+
+    inf_text_buffer_append_text(priv->buffer, text, bytes, len, user);
+  }
+  else
+  {
+    /* Insert before the newlines that are added to the base buffer */
+    g_assert(buf_len >= (guint)(-priv->n_keep));
+
+    inf_text_buffer_insert_text(
+      priv->buffer,
+      buf_len - (guint)(-priv->n_keep),
+      text,
+      bytes,
+      len,
+      user
+    );
+  }
+
+  inf_signal_handlers_unblock_by_func(
+    priv->buffer,
+    G_CALLBACK(inf_text_fixline_buffer_text_inserted_cb),
+    fixline_buffer
+  );
+
+  /* Unless the text consists of newlines only, the trailing newlines of the
+   * base buffer are known without scanning it: The ones of the appended
+   * text, followed by the ones that were added to the base buffer. */
+  if(trailing == len)
+  {
+    inf_text_fixline_buffer_fix_lines(fixline_buffer);
+  }
+  else
+  {
+    inf_text_fixline_buffer_fix_lines_from(
+      fixline_buffer,
+      trailing + (priv->n_keep < 0 ? (guint)(-priv->n_keep) : 0)
+    );
+  }
+}
+
+static void
+inf_text_fixline_buffer_buffer_clear(InfTextBuffer* buffer)
+{
+  InfTextFixlineBuffer* fixline_buffer;
+  InfTextFixlineBufferPrivate* priv;
+
+  fixline_buffer = INF_TEXT_FIXLINE_BUFFER(buffer);
+  priv = INF_TEXT_FIXLINE_BUFFER_PRIVATE(fixline_buffer);
+
+  inf_signal_handlers_block_by_func(
+    priv->buffer,
+    G_CALLBACK(inf_text_fixline_buffer_text_erased_cb),
+    fixline_buffer
+  );
+
+  inf_text_buffer_clear(priv->buffer);
+
+  inf_signal_handlers_unblock_by_func(
+    priv->buffer,
+    G_CALLBACK(inf_text_fixline_buffer_text_erased_cb),
+    fixline_buffer
+  );
+
+  g_free(priv->keep);
+  priv->keep = NULL;
+  priv->n_keep = 0;
+
+  inf_text_fixline_buffer_fix_lines_from(fixline_buffer, 0);
+}
+
 static InfTextBufferIter*
 inf_text_fixline_buffer_buffer_create_begin_iter(InfTextBuffer* buffer)
 {
@@ -1797,6 +1913,8 @@ inf_text_fixline_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_fixline_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_fixline_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_fixline_buffer_buffer_iter_get_author;
+  iface->append_text = inf_text_fixline_buffer_buffer_append_text;
+  iface->clear = inf_text_fixline_buffer_buffer_clear;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
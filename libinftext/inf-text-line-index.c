@@ -0,0 +1,870 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-text-line-index
+ * @title: InfTextLineIndex
+ * @short_description: Line and column lookups for a text buffer
+ * @include: libinftext/inf-text-line-index.h
+ * @see_also: #InfTextBuffer
+ * @stability: Unstable
+ *
+ * #InfTextLineIndex keeps track of the line structure of a #InfTextBuffer.
+ * It is built once from the buffer content when it is created and from
+ * then on updated incrementally from the #InfTextBuffer::text-inserted and
+ * #InfTextBuffer::text-erased signals, so that only the inserted text needs
+ * to be scanned for line breaks.
+ *
+ * The lines are stored in a balanced tree which keeps the number of
+ * characters of each subtree, so that converting between a character
+ * offset and a line and column, as well as counting the empty lines at the
+ * end of the buffer, takes logarithmic time in the number of lines.
+ *
+ * Only the newline character separates lines. The buffer needs to use the
+ * UTF-8 encoding.
+ */
+
+#include <libinftext/inf-text-line-index.h>
+#include <libinfinity/common/inf-utf8-util.h>
+#include <libinfinity/inf-signals.h>
+
+#include <string.h>
+
+typedef struct _InfTextLineIndexLine InfTextLineIndexLine;
+struct _InfTextLineIndexLine {
+  InfTextLineIndexLine* parent;
+  InfTextLineIndexLine* left;
+  InfTextLineIndexLine* right;
+  guint32 priority;
+
+  /* Number of characters in this line, not counting the newline */
+  guint length;
+
+  /* Number of characters in this subtree, counting one newline per line */
+  guint sum;
+  /* Number of lines in this subtree */
+  guint count;
+  /* Number of non-empty lines in this subtree */
+  guint filled;
+};
+
+typedef struct _InfTextLineIndexPrivate InfTextLineIndexPrivate;
+struct _InfTextLineIndexPrivate {
+  InfTextBuffer* buffer;
+
+  /* There is always at least one line, so that the total number of
+   * characters in the buffer is root->sum - 1. */
+  InfTextLineIndexLine* root;
+  guint32 seed;
+};
+
+enum {
+  PROP_0,
+
+  PROP_BUFFER
+};
+
+#define INF_TEXT_LINE_INDEX_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TEXT_TYPE_LINE_INDEX, InfTextLineIndexPrivate))
+
+G_DEFINE_TYPE_WITH_CODE(InfTextLineIndex, inf_text_line_index, G_TYPE_OBJECT,
+  G_ADD_PRIVATE(InfTextLineIndex))
+
+static guint32
+inf_text_line_index_next_priority(InfTextLineIndexPrivate* priv)
+{
+  /* xorshift32, as for the segments of InfTextChunk */
+  priv->seed ^= priv->seed << 13;
+  priv->seed ^= priv->seed >> 17;
+  priv->seed ^= priv->seed << 5;
+  return priv->seed;
+}
+
+static InfTextLineIndexLine*
+inf_text_line_index_line_new(InfTextLineIndexPrivate* priv,
+                             guint length)
+{
+  InfTextLineIndexLine* line;
+
+  line = g_slice_new(InfTextLineIndexLine);
+  line->parent = NULL;
+  line->left = NULL;
+  line->right = NULL;
+  line->priority = inf_text_line_index_next_priority(priv);
+  line->length = length;
+  line->sum = length + 1;
+  line->count = 1;
+  line->filled = (length > 0) ? 1 : 0;
+
+  return line;
+}
+
+static void
+inf_text_line_index_line_free_tree(InfTextLineIndexLine* line)
+{
+  if(line->left != NULL)
+    inf_text_line_index_line_free_tree(line->left);
+  if(line->right != NULL)
+    inf_text_line_index_line_free_tree(line->right);
+
+  g_slice_free(InfTextLineIndexLine, line);
+}
+
+/* Recomputes the aggregate values of line from its children */
+static void
+inf_text_line_index_line_update(InfTextLineIndexLine* line)
+{
+  line->sum = line->length + 1;
+  line->count = 1;
+  line->filled = (line->length > 0) ? 1 : 0;
+
+  if(line->left != NULL)
+  {
+    line->sum += line->left->sum;
+    line->count += line->left->count;
+    line->filled += line->left->filled;
+  }
+
+  if(line->right != NULL)
+  {
+    line->sum += line->right->sum;
+    line->count += line->right->count;
+    line->filled += line->right->filled;
+  }
+}
+
+static void
+inf_text_line_index_line_update_path(InfTextLineIndexLine* line)
+{
+  for(; line != NULL; line = line->parent)
+    inf_text_line_index_line_update(line);
+}
+
+static void
+inf_text_line_index_line_set_length(InfTextLineIndexLine* line,
+                                    guint length)
+{
+  if(line->length != length)
+  {
+    line->length = length;
+    inf_text_line_index_line_update_path(line);
+  }
+}
+
+static InfTextLineIndexLine*
+inf_text_line_index_line_next(InfTextLineIndexLine* line)
+{
+  if(line->right != NULL)
+  {
+    line = line->right;
+    while(line->left != NULL)
+      line = line->left;
+    return line;
+  }
+
+  while(line->parent != NULL && line->parent->right == line)
+    line = line->parent;
+
+  return line->parent;
+}
+
+static void
+inf_text_line_index_line_rotate_up(InfTextLineIndexPrivate* priv,
+                                   InfTextLineIndexLine* line)
+{
+  InfTextLineIndexLine* parent;
+  InfTextLineIndexLine* grandparent;
+
+  parent = line->parent;
+  grandparent = parent->parent;
+
+  if(parent->left == line)
+  {
+    parent->left = line->right;
+    if(parent->left != NULL)
+      parent->left->parent = parent;
+    line->right = parent;
+  }
+  else
+  {
+    parent->right = line->left;
+    if(parent->right != NULL)
+      parent->right->parent = parent;
+    line->left = parent;
+  }
+
+  parent->parent = line;
+  line->parent = grandparent;
+
+  if(grandparent == NULL)
+    priv->root = line;
+  else if(grandparent->left == parent)
+    grandparent->left = line;
+  else
+    grandparent->right = line;
+
+  inf_text_line_index_line_update(parent);
+  inf_text_line_index_line_update(line);
+}
+
+/* Inserts line into the tree, right after position */
+static void
+inf_text_line_index_line_insert_after(InfTextLineIndexPrivate* priv,
+                                      InfTextLineIndexLine* position,
+                                      InfTextLineIndexLine* line)
+{
+  InfTextLineIndexLine* node;
+
+  if(position->right == NULL)
+  {
+    position->right = line;
+    line->parent = position;
+  }
+  else
+  {
+    node = position->right;
+    while(node->left != NULL)
+      node = node->left;
+
+    node->left = line;
+    line->parent = node;
+  }
+
+  inf_text_line_index_line_update_path(line->parent);
+
+  while(line->parent != NULL && line->parent->priority < line->priority)
+    inf_text_line_index_line_rotate_up(priv, line);
+}
+
+/* Removes line from the tree and frees it */
+static void
+inf_text_line_index_line_remove(InfTextLineIndexPrivate* priv,
+                                InfTextLineIndexLine* line)
+{
+  InfTextLineIndexLine* child;
+
+  g_assert(line != priv->root || line->left != NULL || line->right != NULL);
+
+  while(line->left != NULL || line->right != NULL)
+  {
+    if(line->left == NULL)
+      child = line->right;
+    else if(line->right == NULL)
+      child = line->left;
+    else if(line->left->priority > line->right->priority)
+      child = line->left;
+    else
+      child = line->right;
+
+    inf_text_line_index_line_rotate_up(priv, child);
+  }
+
+  if(line->parent->left == line)
+    line->parent->left = NULL;
+  else
+    line->parent->right = NULL;
+
+  inf_text_line_index_line_update_path(line->parent);
+  g_slice_free(InfTextLineIndexLine, line);
+}
+
+/* Returns the line containing the character offset pos. A position right
+ * in front of a newline character belongs to the line which the newline
+ * terminates. column is set to the offset of pos within the line, and
+ * number, if non-NULL, to the index of the line. */
+static InfTextLineIndexLine*
+inf_text_line_index_get_line(InfTextLineIndexPrivate* priv,
+                             guint pos,
+                             guint* column,
+                             guint* number)
+{
+  InfTextLineIndexLine* line;
+  guint index;
+
+  g_assert(pos < priv->root->sum);
+
+  line = priv->root;
+  index = 0;
+
+  for(;;)
+  {
+    if(line->left != NULL && pos < line->left->sum)
+    {
+      line = line->left;
+    }
+    else
+    {
+      if(line->left != NULL)
+      {
+        pos -= line->left->sum;
+        index += line->left->count;
+      }
+
+      if(pos <= line->length)
+        break;
+
+      pos -= line->length + 1;
+      index += 1;
+      line = line->right;
+      g_assert(line != NULL);
+    }
+  }
+
+  *column = pos;
+  if(number != NULL) *number = index;
+  return line;
+}
+
+/* Returns the line with the given index */
+static InfTextLineIndexLine*
+inf_text_line_index_get_nth_line(InfTextLineIndexPrivate* priv,
+                                 guint number,
+                                 guint* offset)
+{
+  InfTextLineIndexLine* line;
+  guint left_count;
+  guint pos;
+
+  g_assert(number < priv->root->count);
+
+  line = priv->root;
+  pos = 0;
+
+  for(;;)
+  {
+    left_count = (line->left != NULL) ? line->left->count : 0;
+
+    if(number < left_count)
+    {
+      line = line->left;
+    }
+    else
+    {
+      if(line->left != NULL)
+        pos += line->left->sum;
+
+      if(number == left_count)
+        break;
+
+      number -= left_count + 1;
+      pos += line->length + 1;
+      line = line->right;
+    }
+  }
+
+  if(offset != NULL) *offset = pos;
+  return line;
+}
+
+/* Splits text inserted at column of line into lines */
+static InfTextLineIndexLine*
+inf_text_line_index_insert_text(InfTextLineIndexPrivate* priv,
+                                InfTextLineIndexLine* line,
+                                guint column,
+                                const gchar* text,
+                                gsize bytes)
+{
+  InfTextLineIndexLine* new_line;
+  const gchar* end;
+  const gchar* newline;
+  guint tail;
+
+  end = text + bytes;
+  tail = line->length - column;
+
+  while((newline = memchr(text, '\n', end - text)) != NULL)
+  {
+    inf_text_line_index_line_set_length(
+      line,
+      column + inf_utf8_util_strlen(text, newline - text)
+    );
+
+    new_line = inf_text_line_index_line_new(priv, 0);
+    inf_text_line_index_line_insert_after(priv, line, new_line);
+
+    line = new_line;
+    column = 0;
+    text = newline + 1;
+  }
+
+  inf_text_line_index_line_set_length(
+    line,
+    column + inf_utf8_util_strlen(text, end - text) + tail
+  );
+
+  return line;
+}
+
+static void
+inf_text_line_index_text_inserted_cb(InfTextBuffer* buffer,
+                                     guint pos,
+                                     InfTextChunk* chunk,
+                                     InfUser* user,
+                                     gpointer user_data)
+{
+  InfTextLineIndexPrivate* priv;
+  InfTextChunkIter iter;
+  InfTextLineIndexLine* line;
+  guint column;
+  gboolean result;
+
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(user_data);
+
+  /* TODO: Implement this properly with iconv */
+  g_assert(strcmp(inf_text_chunk_get_encoding(chunk), "UTF-8") == 0);
+
+  result = inf_text_chunk_iter_init_begin(chunk, &iter);
+  while(result == TRUE)
+  {
+    line = inf_text_line_index_get_line(priv, pos, &column, NULL);
+
+    inf_text_line_index_insert_text(
+      priv,
+      line,
+      column,
+      inf_text_chunk_iter_get_text(&iter),
+      inf_text_chunk_iter_get_bytes(&iter)
+    );
+
+    pos += inf_text_chunk_iter_get_length(&iter);
+    result = inf_text_chunk_iter_next(&iter);
+  }
+}
+
+static void
+inf_text_line_index_text_erased_cb(InfTextBuffer* buffer,
+                                   guint pos,
+                                   InfTextChunk* chunk,
+                                   InfUser* user,
+                                   gpointer user_data)
+{
+  InfTextLineIndexPrivate* priv;
+  InfTextLineIndexLine* first;
+  InfTextLineIndexLine* last;
+  InfTextLineIndexLine* line;
+  guint first_column;
+  guint last_column;
+  guint len;
+
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(user_data);
+  len = inf_text_chunk_get_length(chunk);
+
+  /* The index still reflects the buffer before the erasure */
+  first = inf_text_line_index_get_line(priv, pos, &first_column, NULL);
+  last = inf_text_line_index_get_line(priv, pos + len, &last_column, NULL);
+
+  if(first == last)
+  {
+    inf_text_line_index_line_set_length(first, first->length - len);
+  }
+  else
+  {
+    inf_text_line_index_line_set_length(
+      first,
+      first_column + last->length - last_column
+    );
+
+    do
+    {
+      line = inf_text_line_index_line_next(first);
+      g_assert(line != NULL);
+
+      inf_text_line_index_line_remove(priv, line);
+    } while(line != last);
+  }
+}
+
+static void
+inf_text_line_index_init(InfTextLineIndex* index)
+{
+  InfTextLineIndexPrivate* priv;
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+
+  priv->buffer = NULL;
+  priv->seed = 0x9e3779b9;
+  priv->root = inf_text_line_index_line_new(priv, 0);
+}
+
+static void
+inf_text_line_index_constructed(GObject* object)
+{
+  InfTextLineIndex* index;
+  InfTextLineIndexPrivate* priv;
+  InfTextBufferIter* iter;
+  InfTextLineIndexLine* line;
+  gchar* text;
+  gboolean result;
+
+  index = INF_TEXT_LINE_INDEX(object);
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+
+  G_OBJECT_CLASS(inf_text_line_index_parent_class)->constructed(object);
+
+  g_assert(priv->buffer != NULL);
+
+  /* TODO: Implement this properly with iconv */
+  g_assert(strcmp(inf_text_buffer_get_encoding(priv->buffer), "UTF-8") == 0);
+
+  iter = inf_text_buffer_create_begin_iter(priv->buffer);
+  if(iter != NULL)
+  {
+    line = priv->root;
+
+    do
+    {
+      text = inf_text_buffer_iter_get_text(priv->buffer, iter);
+
+      line = inf_text_line_index_insert_text(
+        priv,
+        line,
+        line->length,
+        text,
+        inf_text_buffer_iter_get_bytes(priv->buffer, iter)
+      );
+
+      g_free(text);
+      result = inf_text_buffer_iter_next(priv->buffer, iter);
+    } while(result == TRUE);
+
+    inf_text_buffer_destroy_iter(priv->buffer, iter);
+  }
+
+  g_assert(priv->root->sum == inf_text_buffer_get_length(priv->buffer) + 1);
+
+  g_signal_connect(
+    G_OBJECT(priv->buffer),
+    "text-inserted",
+    G_CALLBACK(inf_text_line_index_text_inserted_cb),
+    index
+  );
+
+  g_signal_connect(
+    G_OBJECT(priv->buffer),
+    "text-erased",
+    G_CALLBACK(inf_text_line_index_text_erased_cb),
+    index
+  );
+}
+
+static void
+inf_text_line_index_dispose(GObject* object)
+{
+  InfTextLineIndex* index;
+  InfTextLineIndexPrivate* priv;
+
+  index = INF_TEXT_LINE_INDEX(object);
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+
+  if(priv->buffer != NULL)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_text_line_index_text_inserted_cb),
+      index
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_text_line_index_text_erased_cb),
+      index
+    );
+
+    g_object_unref(priv->buffer);
+    priv->buffer = NULL;
+  }
+
+  G_OBJECT_CLASS(inf_text_line_index_parent_class)->dispose(object);
+}
+
+static void
+inf_text_line_index_finalize(GObject* object)
+{
+  InfTextLineIndex* index;
+  InfTextLineIndexPrivate* priv;
+
+  index = INF_TEXT_LINE_INDEX(object);
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+
+  inf_text_line_index_line_free_tree(priv->root);
+
+  G_OBJECT_CLASS(inf_text_line_index_parent_class)->finalize(object);
+}
+
+static void
+inf_text_line_index_set_property(GObject* object,
+                                 guint prop_id,
+                                 const GValue* value,
+                                 GParamSpec* pspec)
+{
+  InfTextLineIndex* index;
+  InfTextLineIndexPrivate* priv;
+
+  index = INF_TEXT_LINE_INDEX(object);
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+
+  switch(prop_id)
+  {
+  case PROP_BUFFER:
+    /* construct only */
+    g_assert(priv->buffer == NULL);
+    priv->buffer = INF_TEXT_BUFFER(g_value_dup_object(value));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_text_line_index_get_property(GObject* object,
+                                 guint prop_id,
+                                 GValue* value,
+                                 GParamSpec* pspec)
+{
+  InfTextLineIndex* index;
+  InfTextLineIndexPrivate* priv;
+
+  index = INF_TEXT_LINE_INDEX(object);
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+
+  switch(prop_id)
+  {
+  case PROP_BUFFER:
+    g_value_set_object(value, priv->buffer);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_text_line_index_class_init(InfTextLineIndexClass* line_index_class)
+{
+  GObjectClass* object_class;
+  object_class = G_OBJECT_CLASS(line_index_class);
+
+  object_class->constructed = inf_text_line_index_constructed;
+  object_class->dispose = inf_text_line_index_dispose;
+  object_class->finalize = inf_text_line_index_finalize;
+  object_class->set_property = inf_text_line_index_set_property;
+  object_class->get_property = inf_text_line_index_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_BUFFER,
+    g_param_spec_object(
+      "buffer",
+      "Buffer",
+      "The buffer whose lines to keep track of",
+      INF_TEXT_TYPE_BUFFER,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+    )
+  );
+}
+
+/**
+ * inf_text_line_index_new: (constructor)
+ * @buffer: The #InfTextBuffer to index.
+ *
+ * Creates a new #InfTextLineIndex for @buffer. The index scans the current
+ * content of @buffer once, and updates itself whenever text is inserted
+ * into or erased from @buffer afterwards. @buffer must use the UTF-8
+ * encoding.
+ *
+ * Returns: (transfer full): A new #InfTextLineIndex.
+ **/
+InfTextLineIndex*
+inf_text_line_index_new(InfTextBuffer* buffer)
+{
+  GObject* object;
+
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), NULL);
+
+  g_return_val_if_fail(
+    strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") == 0,
+    NULL
+  );
+
+  object = g_object_new(INF_TEXT_TYPE_LINE_INDEX, "buffer", buffer, NULL);
+  return INF_TEXT_LINE_INDEX(object);
+}
+
+/**
+ * inf_text_line_index_get_buffer:
+ * @index: A #InfTextLineIndex.
+ *
+ * Returns the buffer that @index keeps track of.
+ *
+ * Returns: (transfer none): The indexed #InfTextBuffer.
+ **/
+InfTextBuffer*
+inf_text_line_index_get_buffer(InfTextLineIndex* index)
+{
+  g_return_val_if_fail(INF_TEXT_IS_LINE_INDEX(index), NULL);
+  return INF_TEXT_LINE_INDEX_PRIVATE(index)->buffer;
+}
+
+/**
+ * inf_text_line_index_get_n_lines:
+ * @index: A #InfTextLineIndex.
+ *
+ * Returns the number of lines in the indexed buffer. This is one more than
+ * the number of newline characters, so an empty buffer has one line.
+ *
+ * Returns: The number of lines in the buffer.
+ **/
+guint
+inf_text_line_index_get_n_lines(InfTextLineIndex* index)
+{
+  g_return_val_if_fail(INF_TEXT_IS_LINE_INDEX(index), 0);
+  return INF_TEXT_LINE_INDEX_PRIVATE(index)->root->count;
+}
+
+/**
+ * inf_text_line_index_get_line_offset:
+ * @index: A #InfTextLineIndex.
+ * @line: The index of a line in the buffer, starting from 0.
+ *
+ * Returns the character offset at which @line starts.
+ *
+ * Returns: The offset of the first character of @line.
+ **/
+guint
+inf_text_line_index_get_line_offset(InfTextLineIndex* index,
+                                    guint line)
+{
+  InfTextLineIndexPrivate* priv;
+  guint offset;
+
+  g_return_val_if_fail(INF_TEXT_IS_LINE_INDEX(index), 0);
+
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+  g_return_val_if_fail(line < priv->root->count, 0);
+
+  inf_text_line_index_get_nth_line(priv, line, &offset);
+  return offset;
+}
+
+/**
+ * inf_text_line_index_get_line_length:
+ * @index: A #InfTextLineIndex.
+ * @line: The index of a line in the buffer, starting from 0.
+ *
+ * Returns the number of characters in @line, not counting the newline
+ * character terminating it.
+ *
+ * Returns: The length of @line.
+ **/
+guint
+inf_text_line_index_get_line_length(InfTextLineIndex* index,
+                                    guint line)
+{
+  InfTextLineIndexPrivate* priv;
+
+  g_return_val_if_fail(INF_TEXT_IS_LINE_INDEX(index), 0);
+
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+  g_return_val_if_fail(line < priv->root->count, 0);
+
+  return inf_text_line_index_get_nth_line(priv, line, NULL)->length;
+}
+
+/**
+ * inf_text_line_index_get_line_at_offset:
+ * @index: A #InfTextLineIndex.
+ * @offset: A character offset in the buffer.
+ * @column: (out) (allow-none): Location to store the column of @offset, or
+ * %NULL.
+ *
+ * Returns the line which contains the character at @offset. An offset
+ * pointing to a newline character belongs to the line that the newline
+ * terminates. If @column is non-%NULL, the offset of @offset relative to
+ * the beginning of that line is stored in it.
+ *
+ * Returns: The index of the line containing @offset.
+ **/
+guint
+inf_text_line_index_get_line_at_offset(InfTextLineIndex* index,
+                                       guint offset,
+                                       guint* column)
+{
+  InfTextLineIndexPrivate* priv;
+  guint line_column;
+  guint number;
+
+  g_return_val_if_fail(INF_TEXT_IS_LINE_INDEX(index), 0);
+
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+  g_return_val_if_fail(offset < priv->root->sum, 0);
+
+  inf_text_line_index_get_line(priv, offset, &line_column, &number);
+  if(column != NULL) *column = line_column;
+  return number;
+}
+
+/**
+ * inf_text_line_index_get_trailing_newlines:
+ * @index: A #InfTextLineIndex.
+ *
+ * Returns the number of newline characters at the end of the buffer, that
+ * is the number of lines following the last non-empty line.
+ *
+ * Returns: The number of trailing newline characters.
+ **/
+guint
+inf_text_line_index_get_trailing_newlines(InfTextLineIndex* index)
+{
+  InfTextLineIndexPrivate* priv;
+  InfTextLineIndexLine* line;
+  guint number;
+
+  g_return_val_if_fail(INF_TEXT_IS_LINE_INDEX(index), 0);
+
+  priv = INF_TEXT_LINE_INDEX_PRIVATE(index);
+  if(priv->root->filled == 0)
+    return priv->root->count - 1;
+
+  /* Find the last non-empty line */
+  line = priv->root;
+  number = 0;
+
+  for(;;)
+  {
+    if(line->right != NULL && line->right->filled > 0)
+    {
+      number += line->count - line->right->count;
+      line = line->right;
+    }
+    else if(line->length > 0)
+    {
+      if(line->left != NULL)
+        number += line->left->count;
+      break;
+    }
+    else
+    {
+      line = line->left;
+      g_assert(line != NULL);
+    }
+  }
+
+  return priv->root->count - 1 - number;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,92 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_TEXT_LINE_INDEX_H__
+#define __INF_TEXT_LINE_INDEX_H__
+
+#include <libinftext/inf-text-buffer.h>
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INF_TEXT_TYPE_LINE_INDEX                 (inf_text_line_index_get_type())
+#define INF_TEXT_LINE_INDEX(obj)                 (G_TYPE_CHECK_INSTANCE_CAST((obj), INF_TEXT_TYPE_LINE_INDEX, InfTextLineIndex))
+#define INF_TEXT_LINE_INDEX_CLASS(klass)         (G_TYPE_CHECK_CLASS_CAST((klass), INF_TEXT_TYPE_LINE_INDEX, InfTextLineIndexClass))
+#define INF_TEXT_IS_LINE_INDEX(obj)              (G_TYPE_CHECK_INSTANCE_TYPE((obj), INF_TEXT_TYPE_LINE_INDEX))
+#define INF_TEXT_IS_LINE_INDEX_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE((klass), INF_TEXT_TYPE_LINE_INDEX))
+#define INF_TEXT_LINE_INDEX_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS((obj), INF_TEXT_TYPE_LINE_INDEX, InfTextLineIndexClass))
+
+typedef struct _InfTextLineIndex InfTextLineIndex;
+typedef struct _InfTextLineIndexClass InfTextLineIndexClass;
+
+/**
+ * InfTextLineIndexClass:
+ *
+ * This structure does not contain any public fields.
+ */
+struct _InfTextLineIndexClass {
+  /*< private >*/
+  GObjectClass parent_class;
+};
+
+/**
+ * InfTextLineIndex:
+ *
+ * #InfTextLineIndex is an opaque data type. You should only access it
+ * via the public API functions.
+ */
+struct _InfTextLineIndex {
+  /*< private >*/
+  GObject parent;
+};
+
+GType
+inf_text_line_index_get_type(void) G_GNUC_CONST;
+
+InfTextLineIndex*
+inf_text_line_index_new(InfTextBuffer* buffer);
+
+InfTextBuffer*
+inf_text_line_index_get_buffer(InfTextLineIndex* index);
+
+guint
+inf_text_line_index_get_n_lines(InfTextLineIndex* index);
+
+guint
+inf_text_line_index_get_line_offset(InfTextLineIndex* index,
+                                    guint line);
+
+guint
+inf_text_line_index_get_line_length(InfTextLineIndex* index,
+                                    guint line);
+
+guint
+inf_text_line_index_get_line_at_offset(InfTextLineIndex* index,
+                                       guint offset,
+                                       guint* column);
+
+guint
+inf_text_line_index_get_trailing_newlines(InfTextLineIndex* index);
+
+G_END_DECLS
+
+#endif /* __INF_TEXT_LINE_INDEX_H__ */
+
+/* vim:set et sw=2 ts=2: */
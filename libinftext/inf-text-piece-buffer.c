@@ -0,0 +1,1146 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-text-piece-buffer
+ * @title: InfTextPieceBuffer
+ * @short_description: Piece table text buffer for large documents
+ * @include: libinftext/inf-text-piece-buffer.h
+ * @see_also: #InfTextBuffer, #InfTextDefaultBuffer
+ * @stability: Unstable
+ *
+ * #InfTextPieceBuffer is an implementation of #InfTextBuffer which is
+ * suited for very large documents. Text is never moved once it has been
+ * stored in the buffer. Inserted text is appended to an append-only add
+ * buffer, and the document is described by a sequence of pieces, each
+ * referring to a range of text in the add buffer or in an original buffer
+ * provided with inf_text_piece_buffer_insert_original(). The pieces are
+ * kept in a balanced tree, so that inserting and erasing text takes
+ * logarithmic time in the number of pieces, independent of the size of the
+ * document.
+ *
+ * Since erased text stays in the add buffer, memory usage grows with the
+ * amount of text ever inserted, not with the size of the document. The
+ * buffer always uses the UTF-8 encoding.
+ */
+
+#include <libinftext/inf-text-piece-buffer.h>
+#include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-chunk.h>
+#include <libinfinity/common/inf-buffer.h>
+#include <libinfinity/common/inf-utf8-util.h>
+
+#include <string.h>
+
+/* Maximum size of a piece, in bytes. Text inserted in one go is split into
+ * several pieces if it is larger than this, so that finding a position
+ * inside a piece never needs to scan more than this number of bytes. */
+#define INF_TEXT_PIECE_BUFFER_MAX_PIECE 8192
+
+/* Size of the blocks making up the add buffer */
+#define INF_TEXT_PIECE_BUFFER_BLOCK_SIZE 65536
+
+/* The pieces are stored in a treap, in the same way as the segments of an
+ * InfTextChunk. Each piece caches the number of characters in its
+ * subtree, and its offset is derived from these sums when needed. */
+typedef struct _InfTextPieceBufferPiece InfTextPieceBufferPiece;
+struct _InfTextPieceBufferPiece {
+  InfTextPieceBufferPiece* parent;
+  InfTextPieceBufferPiece* left;
+  InfTextPieceBufferPiece* right;
+  guint32 priority;
+  guint sum; /* characters in the subtree rooted at this piece */
+
+  guint author;
+  const gchar* text; /* into the add buffer or an original buffer */
+  gsize bytes;
+  guint chars;
+};
+
+/* A block of the add buffer. Blocks are never reallocated, so that pieces
+ * can point into them directly. The text follows the structure. */
+typedef struct _InfTextPieceBufferBlock InfTextPieceBufferBlock;
+struct _InfTextPieceBufferBlock {
+  InfTextPieceBufferBlock* next; /* the block filled before this one */
+  gsize size;
+  gsize used;
+};
+
+#define INF_TEXT_PIECE_BUFFER_BLOCK_DATA(block) ((gchar*)((block) + 1))
+
+/* An iterator points to a run of adjacent pieces written by the same
+ * author, so that it is visited as a single segment. */
+struct _InfTextBufferIter {
+  InfTextPieceBufferPiece* first;
+  InfTextPieceBufferPiece* last;
+  guint offset;
+  guint length;
+  gsize bytes;
+};
+
+typedef struct _InfTextPieceBufferPrivate InfTextPieceBufferPrivate;
+struct _InfTextPieceBufferPrivate {
+  InfTextPieceBufferPiece* root;
+  /* Sentinel without text that is always the last node of the tree */
+  InfTextPieceBufferPiece end;
+  guint32 seed; /* generates piece priorities */
+
+  InfTextPieceBufferBlock* block; /* the block currently being filled */
+  GPtrArray* originals; /* GBytes referenced by pieces */
+
+  gboolean modified;
+};
+
+enum {
+  PROP_0,
+
+  /* overwritten */
+  PROP_MODIFIED
+};
+
+#define INF_TEXT_PIECE_BUFFER_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TEXT_TYPE_PIECE_BUFFER, InfTextPieceBufferPrivate))
+
+static void inf_text_piece_buffer_buffer_iface_init(InfBufferInterface* iface);
+static void inf_text_piece_buffer_text_buffer_iface_init(InfTextBufferInterface* iface);
+G_DEFINE_TYPE_WITH_CODE(InfTextPieceBuffer, inf_text_piece_buffer, G_TYPE_OBJECT,
+  G_ADD_PRIVATE(InfTextPieceBuffer)
+  G_IMPLEMENT_INTERFACE(INF_TYPE_BUFFER, inf_text_piece_buffer_buffer_iface_init)
+  G_IMPLEMENT_INTERFACE(INF_TEXT_TYPE_BUFFER, inf_text_piece_buffer_text_buffer_iface_init))
+
+static guint32
+inf_text_piece_buffer_next_priority(InfTextPieceBufferPrivate* priv)
+{
+  /* xorshift32, as for the segments of InfTextChunk */
+  priv->seed ^= priv->seed << 13;
+  priv->seed ^= priv->seed >> 17;
+  priv->seed ^= priv->seed << 5;
+  return priv->seed;
+}
+
+static InfTextPieceBufferPiece*
+inf_text_piece_buffer_piece_new(InfTextPieceBufferPrivate* priv,
+                                guint author,
+                                const gchar* text,
+                                gsize bytes,
+                                guint chars)
+{
+  InfTextPieceBufferPiece* piece;
+
+  piece = g_slice_new(InfTextPieceBufferPiece);
+  piece->parent = NULL;
+  piece->left = NULL;
+  piece->right = NULL;
+  piece->priority = inf_text_piece_buffer_next_priority(priv);
+  piece->sum = chars;
+
+  piece->author = author;
+  piece->text = text;
+  piece->bytes = bytes;
+  piece->chars = chars;
+
+  return piece;
+}
+
+static void
+inf_text_piece_buffer_piece_free_tree(InfTextPieceBufferPrivate* priv,
+                                      InfTextPieceBufferPiece* piece)
+{
+  if(piece->left != NULL)
+    inf_text_piece_buffer_piece_free_tree(priv, piece->left);
+  if(piece->right != NULL)
+    inf_text_piece_buffer_piece_free_tree(priv, piece->right);
+
+  if(piece != &priv->end)
+    g_slice_free(InfTextPieceBufferPiece, piece);
+}
+
+static guint
+inf_text_piece_buffer_piece_sum(InfTextPieceBufferPiece* piece)
+{
+  if(piece == NULL)
+    return 0;
+  return piece->sum;
+}
+
+static InfTextPieceBufferPiece*
+inf_text_piece_buffer_piece_next(InfTextPieceBufferPiece* piece)
+{
+  if(piece->right != NULL)
+  {
+    piece = piece->right;
+    while(piece->left != NULL)
+      piece = piece->left;
+    return piece;
+  }
+
+  while(piece->parent != NULL && piece->parent->right == piece)
+    piece = piece->parent;
+
+  return piece->parent;
+}
+
+static InfTextPieceBufferPiece*
+inf_text_piece_buffer_piece_prev(InfTextPieceBufferPiece* piece)
+{
+  if(piece->left != NULL)
+  {
+    piece = piece->left;
+    while(piece->right != NULL)
+      piece = piece->right;
+    return piece;
+  }
+
+  while(piece->parent != NULL && piece->parent->left == piece)
+    piece = piece->parent;
+
+  return piece->parent;
+}
+
+static void
+inf_text_piece_buffer_piece_set_chars(InfTextPieceBufferPiece* piece,
+                                      guint chars)
+{
+  InfTextPieceBufferPiece* node;
+  guint old_chars;
+
+  old_chars = piece->chars;
+  piece->chars = chars;
+
+  for(node = piece; node != NULL; node = node->parent)
+    node->sum = node->sum - old_chars + chars;
+}
+
+static void
+inf_text_piece_buffer_piece_rotate_up(InfTextPieceBufferPrivate* priv,
+                                      InfTextPieceBufferPiece* piece)
+{
+  InfTextPieceBufferPiece* parent;
+  InfTextPieceBufferPiece* grandparent;
+
+  parent = piece->parent;
+  grandparent = parent->parent;
+
+  if(parent->left == piece)
+  {
+    parent->left = piece->right;
+    if(parent->left != NULL)
+      parent->left->parent = parent;
+    piece->right = parent;
+  }
+  else
+  {
+    parent->right = piece->left;
+    if(parent->right != NULL)
+      parent->right->parent = parent;
+    piece->left = parent;
+  }
+
+  parent->parent = piece;
+  piece->parent = grandparent;
+
+  if(grandparent == NULL)
+    priv->root = piece;
+  else if(grandparent->left == parent)
+    grandparent->left = piece;
+  else
+    grandparent->right = piece;
+
+  piece->sum = parent->sum;
+  parent->sum = inf_text_piece_buffer_piece_sum(parent->left) +
+    inf_text_piece_buffer_piece_sum(parent->right) + parent->chars;
+}
+
+/* Inserts piece into the tree, in front of position */
+static void
+inf_text_piece_buffer_piece_insert_before(InfTextPieceBufferPrivate* priv,
+                                          InfTextPieceBufferPiece* position,
+                                          InfTextPieceBufferPiece* piece)
+{
+  InfTextPieceBufferPiece* node;
+
+  if(position->left == NULL)
+  {
+    position->left = piece;
+    piece->parent = position;
+  }
+  else
+  {
+    node = position->left;
+    while(node->right != NULL)
+      node = node->right;
+
+    node->right = piece;
+    piece->parent = node;
+  }
+
+  for(node = piece->parent; node != NULL; node = node->parent)
+    node->sum += piece->chars;
+
+  while(piece->parent != NULL && piece->parent->priority < piece->priority)
+    inf_text_piece_buffer_piece_rotate_up(priv, piece);
+}
+
+/* Removes piece from the tree, without freeing it */
+static void
+inf_text_piece_buffer_piece_remove(InfTextPieceBufferPrivate* priv,
+                                   InfTextPieceBufferPiece* piece)
+{
+  InfTextPieceBufferPiece* child;
+  InfTextPieceBufferPiece* node;
+
+  g_assert(piece != &priv->end);
+
+  while(piece->left != NULL || piece->right != NULL)
+  {
+    if(piece->left == NULL)
+      child = piece->right;
+    else if(piece->right == NULL)
+      child = piece->left;
+    else if(piece->left->priority > piece->right->priority)
+      child = piece->left;
+    else
+      child = piece->right;
+
+    inf_text_piece_buffer_piece_rotate_up(priv, child);
+  }
+
+  for(node = piece->parent; node != NULL; node = node->parent)
+    node->sum -= piece->chars;
+
+  if(piece->parent->left == piece)
+    piece->parent->left = NULL;
+  else
+    piece->parent->right = NULL;
+
+  piece->parent = NULL;
+}
+
+/* Returns the piece containing the character at pos, or the end sentinel
+ * if pos is the end of the buffer. begin is set to the character offset
+ * of the returned piece. */
+static InfTextPieceBufferPiece*
+inf_text_piece_buffer_get_piece(InfTextPieceBufferPrivate* priv,
+                                guint pos,
+                                guint* begin)
+{
+  InfTextPieceBufferPiece* piece;
+  guint offset;
+  guint left;
+
+  g_assert(pos <= priv->root->sum);
+
+  piece = priv->root;
+  offset = 0;
+
+  for(;;)
+  {
+    left = inf_text_piece_buffer_piece_sum(piece->left);
+
+    if(pos < offset + left)
+    {
+      piece = piece->left;
+    }
+    else if(pos < offset + left + piece->chars || piece == &priv->end)
+    {
+      /* The end sentinel is the only piece without characters, and it is
+       * reached for pos being the length of the buffer. */
+      offset += left;
+      break;
+    }
+    else
+    {
+      offset += left + piece->chars;
+      piece = piece->right;
+    }
+  }
+
+  *begin = offset;
+  return piece;
+}
+
+/* Makes sure that a piece starts at pos, splitting the piece containing
+ * pos if necessary, and returns that piece. */
+static InfTextPieceBufferPiece*
+inf_text_piece_buffer_split(InfTextPieceBufferPrivate* priv,
+                            guint pos)
+{
+  InfTextPieceBufferPiece* piece;
+  InfTextPieceBufferPiece* tail;
+  guint begin;
+  gsize index;
+
+  piece = inf_text_piece_buffer_get_piece(priv, pos, &begin);
+  if(begin == pos)
+    return piece;
+
+  index = inf_utf8_util_offset_to_index(piece->text, piece->bytes, pos - begin);
+
+  tail = inf_text_piece_buffer_piece_new(
+    priv,
+    piece->author,
+    piece->text + index,
+    piece->bytes - index,
+    piece->chars - (pos - begin)
+  );
+
+  piece->bytes = index;
+  inf_text_piece_buffer_piece_set_chars(piece, pos - begin);
+
+  inf_text_piece_buffer_piece_insert_before(
+    priv,
+    inf_text_piece_buffer_piece_next(piece),
+    tail
+  );
+
+  return tail;
+}
+
+/* Copies text to the end of the add buffer, and returns the copy */
+static const gchar*
+inf_text_piece_buffer_append(InfTextPieceBufferPrivate* priv,
+                             gconstpointer text,
+                             gsize bytes)
+{
+  InfTextPieceBufferBlock* block;
+  gchar* copy;
+
+  block = priv->block;
+  if(block == NULL || block->size - block->used < bytes)
+  {
+    /* The rest of the current block is left unused. */
+    block = g_malloc(
+      sizeof(InfTextPieceBufferBlock) +
+      MAX(bytes, INF_TEXT_PIECE_BUFFER_BLOCK_SIZE)
+    );
+
+    block->next = priv->block;
+    block->size = MAX(bytes, INF_TEXT_PIECE_BUFFER_BLOCK_SIZE);
+    block->used = 0;
+    priv->block = block;
+  }
+
+  copy = INF_TEXT_PIECE_BUFFER_BLOCK_DATA(block) + block->used;
+  memcpy(copy, text, bytes);
+  block->used += bytes;
+
+  return copy;
+}
+
+/* Inserts pieces for text at pos. The text must stay valid for the
+ * lifetime of the buffer. */
+static void
+inf_text_piece_buffer_insert_pieces(InfTextPieceBufferPrivate* priv,
+                                    guint pos,
+                                    const gchar* text,
+                                    gsize bytes,
+                                    guint chars,
+                                    guint author)
+{
+  InfTextPieceBufferPiece* position;
+  InfTextPieceBufferPiece* prev;
+  InfTextPieceBufferPiece* piece;
+  gsize piece_bytes;
+  guint piece_chars;
+
+  position = inf_text_piece_buffer_split(priv, pos);
+  prev = inf_text_piece_buffer_piece_prev(position);
+
+  /* When typing, each insertion continues the text of the previous one in
+   * the add buffer, so just extend the previous piece in that case. */
+  if(prev != NULL && prev->author == author &&
+     prev->text + prev->bytes == text &&
+     prev->bytes + bytes <= INF_TEXT_PIECE_BUFFER_MAX_PIECE)
+  {
+    prev->bytes += bytes;
+    inf_text_piece_buffer_piece_set_chars(prev, prev->chars + chars);
+    return;
+  }
+
+  while(bytes > 0)
+  {
+    if(bytes > INF_TEXT_PIECE_BUFFER_MAX_PIECE)
+    {
+      /* Do not cut through a multibyte character */
+      piece_bytes = INF_TEXT_PIECE_BUFFER_MAX_PIECE;
+      while((text[piece_bytes] & 0xc0) == 0x80)
+        --piece_bytes;
+
+      piece_chars = inf_utf8_util_strlen(text, piece_bytes);
+    }
+    else
+    {
+      piece_bytes = bytes;
+      piece_chars = chars;
+    }
+
+    piece = inf_text_piece_buffer_piece_new(
+      priv,
+      author,
+      text,
+      piece_bytes,
+      piece_chars
+    );
+
+    inf_text_piece_buffer_piece_insert_before(priv, position, piece);
+
+    text += piece_bytes;
+    bytes -= piece_bytes;
+    chars -= piece_chars;
+  }
+}
+
+static void
+inf_text_piece_buffer_set_modified(InfTextPieceBuffer* buffer)
+{
+  InfTextPieceBufferPrivate* priv;
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+
+  if(priv->modified == FALSE)
+  {
+    priv->modified = TRUE;
+    g_object_notify(G_OBJECT(buffer), "modified");
+  }
+}
+
+/* Sets iter to the run of pieces of the same author starting at first */
+static void
+inf_text_piece_buffer_iter_set_forward(InfTextPieceBufferPrivate* priv,
+                                       InfTextBufferIter* iter,
+                                       InfTextPieceBufferPiece* first,
+                                       guint offset)
+{
+  InfTextPieceBufferPiece* piece;
+
+  iter->first = first;
+  iter->last = first;
+  iter->offset = offset;
+  iter->length = first->chars;
+  iter->bytes = first->bytes;
+
+  for(piece = inf_text_piece_buffer_piece_next(first);
+      piece != &priv->end && piece->author == first->author;
+      piece = inf_text_piece_buffer_piece_next(piece))
+  {
+    iter->last = piece;
+    iter->length += piece->chars;
+    iter->bytes += piece->bytes;
+  }
+}
+
+/* Sets iter to the run of pieces of the same author ending at last, whose
+ * end is at character offset end. */
+static void
+inf_text_piece_buffer_iter_set_backward(InfTextPieceBufferPrivate* priv,
+                                        InfTextBufferIter* iter,
+                                        InfTextPieceBufferPiece* last,
+                                        guint end)
+{
+  InfTextPieceBufferPiece* piece;
+
+  iter->first = last;
+  iter->last = last;
+  iter->length = last->chars;
+  iter->bytes = last->bytes;
+
+  for(piece = inf_text_piece_buffer_piece_prev(last);
+      piece != NULL && piece->author == last->author;
+      piece = inf_text_piece_buffer_piece_prev(piece))
+  {
+    iter->first = piece;
+    iter->length += piece->chars;
+    iter->bytes += piece->bytes;
+  }
+
+  iter->offset = end - iter->length;
+}
+
+static void
+inf_text_piece_buffer_init(InfTextPieceBuffer* buffer)
+{
+  InfTextPieceBufferPrivate* priv;
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+
+  priv->seed = 0x9e3779b9;
+
+  priv->end.parent = NULL;
+  priv->end.left = NULL;
+  priv->end.right = NULL;
+  priv->end.priority = inf_text_piece_buffer_next_priority(priv);
+  priv->end.sum = 0;
+  priv->end.author = 0;
+  priv->end.text = NULL;
+  priv->end.bytes = 0;
+  priv->end.chars = 0;
+  priv->root = &priv->end;
+
+  priv->block = NULL;
+  priv->originals = g_ptr_array_new_with_free_func(
+    (GDestroyNotify)g_bytes_unref
+  );
+
+  priv->modified = FALSE;
+}
+
+static void
+inf_text_piece_buffer_finalize(GObject* object)
+{
+  InfTextPieceBuffer* piece_buffer;
+  InfTextPieceBufferPrivate* priv;
+  InfTextPieceBufferBlock* block;
+
+  piece_buffer = INF_TEXT_PIECE_BUFFER(object);
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(piece_buffer);
+
+  inf_text_piece_buffer_piece_free_tree(priv, priv->root);
+
+  while(priv->block != NULL)
+  {
+    block = priv->block;
+    priv->block = block->next;
+    g_free(block);
+  }
+
+  g_ptr_array_free(priv->originals, TRUE);
+
+  G_OBJECT_CLASS(inf_text_piece_buffer_parent_class)->finalize(object);
+}
+
+static void
+inf_text_piece_buffer_set_property(GObject* object,
+                                   guint prop_id,
+                                   const GValue* value,
+                                   GParamSpec* pspec)
+{
+  InfTextPieceBuffer* piece_buffer;
+  InfTextPieceBufferPrivate* priv;
+
+  piece_buffer = INF_TEXT_PIECE_BUFFER(object);
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(piece_buffer);
+
+  switch(prop_id)
+  {
+  case PROP_MODIFIED:
+    priv->modified = g_value_get_boolean(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_text_piece_buffer_get_property(GObject* object,
+                                   guint prop_id,
+                                   GValue* value,
+                                   GParamSpec* pspec)
+{
+  InfTextPieceBuffer* piece_buffer;
+  InfTextPieceBufferPrivate* priv;
+
+  piece_buffer = INF_TEXT_PIECE_BUFFER(object);
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(piece_buffer);
+
+  switch(prop_id)
+  {
+  case PROP_MODIFIED:
+    g_value_set_boolean(value, priv->modified);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static gboolean
+inf_text_piece_buffer_buffer_get_modified(InfBuffer* buffer)
+{
+  return INF_TEXT_PIECE_BUFFER_PRIVATE(buffer)->modified;
+}
+
+static void
+inf_text_piece_buffer_buffer_set_modified(InfBuffer* buffer,
+                                          gboolean modified)
+{
+  InfTextPieceBuffer* piece_buffer;
+  InfTextPieceBufferPrivate* priv;
+
+  piece_buffer = INF_TEXT_PIECE_BUFFER(buffer);
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(piece_buffer);
+
+  if(priv->modified != modified)
+  {
+    priv->modified = modified;
+    g_object_notify(G_OBJECT(buffer), "modified");
+  }
+}
+
+static const gchar*
+inf_text_piece_buffer_buffer_get_encoding(InfTextBuffer* buffer)
+{
+  return "UTF-8";
+}
+
+static guint
+inf_text_piece_buffer_buffer_get_length(InfTextBuffer* buffer)
+{
+  return INF_TEXT_PIECE_BUFFER_PRIVATE(buffer)->root->sum;
+}
+
+static InfTextChunk*
+inf_text_piece_buffer_buffer_get_slice(InfTextBuffer* buffer,
+                                       guint pos,
+                                       guint len)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextPieceBufferPiece* piece;
+  InfTextChunk* chunk;
+  guint begin;
+  guint skip;
+  guint written;
+  guint chars;
+  gsize start;
+  gsize end;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  g_return_val_if_fail(pos + len <= priv->root->sum, NULL);
+
+  chunk = inf_text_chunk_new("UTF-8");
+  if(len == 0)
+    return chunk;
+
+  piece = inf_text_piece_buffer_get_piece(priv, pos, &begin);
+  skip = pos - begin;
+  written = 0;
+
+  while(written < len)
+  {
+    start = 0;
+    if(skip > 0)
+      start = inf_utf8_util_offset_to_index(piece->text, piece->bytes, skip);
+
+    if(piece->chars - skip <= len - written)
+    {
+      chars = piece->chars - skip;
+      end = piece->bytes;
+    }
+    else
+    {
+      chars = len - written;
+      end = start + inf_utf8_util_offset_to_index(
+        piece->text + start,
+        piece->bytes - start,
+        chars
+      );
+    }
+
+    inf_text_chunk_insert_text(
+      chunk,
+      written,
+      piece->text + start,
+      end - start,
+      chars,
+      piece->author
+    );
+
+    written += chars;
+    skip = 0;
+    piece = inf_text_piece_buffer_piece_next(piece);
+  }
+
+  return chunk;
+}
+
+static void
+inf_text_piece_buffer_buffer_insert_text(InfTextBuffer* buffer,
+                                         guint pos,
+                                         InfTextChunk* chunk,
+                                         InfUser* user)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextChunkIter iter;
+  const gchar* text;
+  guint offset;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  g_return_if_fail(pos <= priv->root->sum);
+
+  offset = pos;
+  if(inf_text_chunk_iter_init_begin(chunk, &iter))
+  {
+    do
+    {
+      text = inf_text_piece_buffer_append(
+        priv,
+        inf_text_chunk_iter_get_text(&iter),
+        inf_text_chunk_iter_get_bytes(&iter)
+      );
+
+      inf_text_piece_buffer_insert_pieces(
+        priv,
+        offset,
+        text,
+        inf_text_chunk_iter_get_bytes(&iter),
+        inf_text_chunk_iter_get_length(&iter),
+        inf_text_chunk_iter_get_author(&iter)
+      );
+
+      offset += inf_text_chunk_iter_get_length(&iter);
+    } while(inf_text_chunk_iter_next(&iter));
+  }
+
+  inf_text_buffer_text_inserted(buffer, pos, chunk, user);
+  inf_text_piece_buffer_set_modified(INF_TEXT_PIECE_BUFFER(buffer));
+}
+
+static void
+inf_text_piece_buffer_buffer_append_text(InfTextBuffer* buffer,
+                                         gconstpointer text,
+                                         gsize bytes,
+                                         guint len,
+                                         InfUser* user)
+{
+  InfTextPieceBufferPrivate* priv;
+  const gchar* added;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  added = inf_text_piece_buffer_append(priv, text, bytes);
+
+  inf_text_piece_buffer_insert_pieces(
+    priv,
+    priv->root->sum,
+    added,
+    bytes,
+    len,
+    user == NULL ? 0 : inf_user_get_id(user)
+  );
+
+  inf_text_piece_buffer_set_modified(INF_TEXT_PIECE_BUFFER(buffer));
+}
+
+static void
+inf_text_piece_buffer_buffer_erase_text(InfTextBuffer* buffer,
+                                        guint pos,
+                                        guint len,
+                                        InfUser* user)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextPieceBufferPiece* first;
+  InfTextPieceBufferPiece* last;
+  InfTextPieceBufferPiece* next;
+  InfTextChunk* chunk;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  g_return_if_fail(pos + len <= priv->root->sum);
+
+  chunk = inf_text_piece_buffer_buffer_get_slice(buffer, pos, len);
+
+  /* Splitting at the end does not invalidate first, since first still
+   * starts at pos if it is the piece being split. */
+  first = inf_text_piece_buffer_split(priv, pos);
+  last = inf_text_piece_buffer_split(priv, pos + len);
+
+  while(first != last)
+  {
+    next = inf_text_piece_buffer_piece_next(first);
+    inf_text_piece_buffer_piece_remove(priv, first);
+    g_slice_free(InfTextPieceBufferPiece, first);
+    first = next;
+  }
+
+  inf_text_buffer_text_erased(buffer, pos, chunk, user);
+  inf_text_chunk_free(chunk);
+
+  inf_text_piece_buffer_set_modified(INF_TEXT_PIECE_BUFFER(buffer));
+}
+
+static InfTextBufferIter*
+inf_text_piece_buffer_buffer_create_begin_iter(InfTextBuffer* buffer)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextPieceBufferPiece* first;
+  InfTextBufferIter* iter;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  if(priv->root->sum == 0)
+    return NULL;
+
+  first = priv->root;
+  while(first->left != NULL)
+    first = first->left;
+
+  iter = g_slice_new(InfTextBufferIter);
+  inf_text_piece_buffer_iter_set_forward(priv, iter, first, 0);
+  return iter;
+}
+
+static InfTextBufferIter*
+inf_text_piece_buffer_buffer_create_end_iter(InfTextBuffer* buffer)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextBufferIter* iter;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  if(priv->root->sum == 0)
+    return NULL;
+
+  iter = g_slice_new(InfTextBufferIter);
+
+  inf_text_piece_buffer_iter_set_backward(
+    priv,
+    iter,
+    inf_text_piece_buffer_piece_prev(&priv->end),
+    priv->root->sum
+  );
+
+  return iter;
+}
+
+static void
+inf_text_piece_buffer_buffer_destroy_iter(InfTextBuffer* buffer,
+                                          InfTextBufferIter* iter)
+{
+  g_slice_free(InfTextBufferIter, iter);
+}
+
+static gboolean
+inf_text_piece_buffer_buffer_iter_next(InfTextBuffer* buffer,
+                                       InfTextBufferIter* iter)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextPieceBufferPiece* next;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  next = inf_text_piece_buffer_piece_next(iter->last);
+  if(next == &priv->end)
+    return FALSE;
+
+  inf_text_piece_buffer_iter_set_forward(
+    priv,
+    iter,
+    next,
+    iter->offset + iter->length
+  );
+
+  return TRUE;
+}
+
+static gboolean
+inf_text_piece_buffer_buffer_iter_prev(InfTextBuffer* buffer,
+                                       InfTextBufferIter* iter)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextPieceBufferPiece* prev;
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  prev = inf_text_piece_buffer_piece_prev(iter->first);
+  if(prev == NULL)
+    return FALSE;
+
+  inf_text_piece_buffer_iter_set_backward(priv, iter, prev, iter->offset);
+  return TRUE;
+}
+
+static gpointer
+inf_text_piece_buffer_buffer_iter_get_text(InfTextBuffer* buffer,
+                                           InfTextBufferIter* iter)
+{
+  InfTextPieceBufferPiece* piece;
+  gchar* text;
+  gsize written;
+
+  text = g_malloc(iter->bytes);
+  written = 0;
+
+  for(piece = iter->first; ; piece = inf_text_piece_buffer_piece_next(piece))
+  {
+    memcpy(text + written, piece->text, piece->bytes);
+    written += piece->bytes;
+
+    if(piece == iter->last)
+      break;
+  }
+
+  return text;
+}
+
+static guint
+inf_text_piece_buffer_buffer_iter_get_offset(InfTextBuffer* buffer,
+                                             InfTextBufferIter* iter)
+{
+  return iter->offset;
+}
+
+static guint
+inf_text_piece_buffer_buffer_iter_get_length(InfTextBuffer* buffer,
+                                             InfTextBufferIter* iter)
+{
+  return iter->length;
+}
+
+static gsize
+inf_text_piece_buffer_buffer_iter_get_bytes(InfTextBuffer* buffer,
+                                            InfTextBufferIter* iter)
+{
+  return iter->bytes;
+}
+
+static guint
+inf_text_piece_buffer_buffer_iter_get_author(InfTextBuffer* buffer,
+                                             InfTextBufferIter* iter)
+{
+  return iter->first->author;
+}
+
+static void
+inf_text_piece_buffer_class_init(
+  InfTextPieceBufferClass* piece_buffer_class)
+{
+  GObjectClass* object_class;
+  object_class = G_OBJECT_CLASS(piece_buffer_class);
+
+  object_class->finalize = inf_text_piece_buffer_finalize;
+  object_class->set_property = inf_text_piece_buffer_set_property;
+  object_class->get_property = inf_text_piece_buffer_get_property;
+
+  g_object_class_override_property(object_class, PROP_MODIFIED, "modified");
+}
+
+static void
+inf_text_piece_buffer_buffer_iface_init(InfBufferInterface* iface)
+{
+  iface->get_modified = inf_text_piece_buffer_buffer_get_modified;
+  iface->set_modified = inf_text_piece_buffer_buffer_set_modified;
+}
+
+static void
+inf_text_piece_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
+{
+  iface->get_encoding = inf_text_piece_buffer_buffer_get_encoding;
+  iface->get_length = inf_text_piece_buffer_buffer_get_length;
+  iface->get_slice = inf_text_piece_buffer_buffer_get_slice;
+  iface->insert_text = inf_text_piece_buffer_buffer_insert_text;
+  iface->erase_text = inf_text_piece_buffer_buffer_erase_text;
+  iface->create_begin_iter = inf_text_piece_buffer_buffer_create_begin_iter;
+  iface->create_end_iter = inf_text_piece_buffer_buffer_create_end_iter;
+  iface->destroy_iter = inf_text_piece_buffer_buffer_destroy_iter;
+  iface->iter_next = inf_text_piece_buffer_buffer_iter_next;
+  iface->iter_prev = inf_text_piece_buffer_buffer_iter_prev;
+  iface->iter_get_text = inf_text_piece_buffer_buffer_iter_get_text;
+  iface->iter_get_offset = inf_text_piece_buffer_buffer_iter_get_offset;
+  iface->iter_get_length = inf_text_piece_buffer_buffer_iter_get_length;
+  iface->iter_get_bytes = inf_text_piece_buffer_buffer_iter_get_bytes;
+  iface->iter_get_author = inf_text_piece_buffer_buffer_iter_get_author;
+  iface->append_text = inf_text_piece_buffer_buffer_append_text;
+  iface->clear = NULL;
+  iface->text_inserted = NULL;
+  iface->text_erased = NULL;
+}
+
+/**
+ * inf_text_piece_buffer_new: (constructor)
+ *
+ * Creates a new, empty #InfTextPieceBuffer. The buffer uses the UTF-8
+ * encoding.
+ *
+ * Returns: (transfer full): A #InfTextPieceBuffer.
+ **/
+InfTextPieceBuffer*
+inf_text_piece_buffer_new(void)
+{
+  GObject* object;
+  object = g_object_new(INF_TEXT_TYPE_PIECE_BUFFER, NULL);
+  return INF_TEXT_PIECE_BUFFER(object);
+}
+
+/**
+ * inf_text_piece_buffer_insert_original:
+ * @buffer: A #InfTextPieceBuffer.
+ * @pos: A character offset into @buffer.
+ * @original: A #GBytes containing UTF-8 encoded text.
+ * @offset: The byte offset of the text to insert within @original.
+ * @bytes: The number of bytes to insert.
+ * @len: The number of characters contained in @bytes.
+ * @user: (allow-none): A #InfUser inserting the text, or %NULL.
+ *
+ * Inserts text from @original into @buffer, in the same way as
+ * inf_text_buffer_insert_text(). Instead of copying the text into the add
+ * buffer, @buffer refers to the text in @original directly, and keeps a
+ * reference on @original for as long as it exists. This is meant for
+ * loading documents: a whole file can be read into a single #GBytes, and
+ * its segments can then be inserted without copying them.
+ *
+ * The #InfTextBuffer::text-inserted signal is only emitted with a copy of
+ * the inserted text if a handler is connected to it.
+ **/
+void
+inf_text_piece_buffer_insert_original(InfTextPieceBuffer* buffer,
+                                      guint pos,
+                                      GBytes* original,
+                                      gsize offset,
+                                      gsize bytes,
+                                      guint len,
+                                      InfUser* user)
+{
+  InfTextPieceBufferPrivate* priv;
+  InfTextChunk* chunk;
+  guint signal_id;
+
+  g_return_if_fail(INF_TEXT_IS_PIECE_BUFFER(buffer));
+  g_return_if_fail(original != NULL);
+  g_return_if_fail(offset + bytes <= g_bytes_get_size(original));
+  g_return_if_fail(user == NULL || INF_IS_USER(user));
+
+  priv = INF_TEXT_PIECE_BUFFER_PRIVATE(buffer);
+  g_return_if_fail(pos <= priv->root->sum);
+
+  if(bytes == 0)
+    return;
+
+  if(priv->originals->len == 0 ||
+     g_ptr_array_index(priv->originals, priv->originals->len - 1) != original)
+  {
+    g_ptr_array_add(priv->originals, g_bytes_ref(original));
+  }
+
+  inf_text_piece_buffer_insert_pieces(
+    priv,
+    pos,
+    (const gchar*)g_bytes_get_data(original, NULL) + offset,
+    bytes,
+    len,
+    user == NULL ? 0 : inf_user_get_id(user)
+  );
+
+  signal_id = g_signal_lookup("text-inserted", INF_TEXT_TYPE_BUFFER);
+  if(g_signal_has_handler_pending(buffer, signal_id, 0, FALSE))
+  {
+    chunk = inf_text_piece_buffer_buffer_get_slice(
+      INF_TEXT_BUFFER(buffer),
+      pos,
+      len
+    );
+
+    inf_text_buffer_text_inserted(INF_TEXT_BUFFER(buffer), pos, chunk, user);
+    inf_text_chunk_free(chunk);
+  }
+
+  inf_text_piece_buffer_set_modified(buffer);
+}
+
+/* vim:set et sw=2 ts=2: */
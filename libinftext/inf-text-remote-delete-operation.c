@@ -52,6 +52,9 @@ struct _InfTextRemoteDeleteOperationPrivate {
   /* TODO: We don't actually need recon_offset, it is just used in an
    * assertion. Perhaps keep in debug code. */
   guint recon_offset;
+  /* Properties can only be set during construction, since operations
+   * are shared between requests and must not change afterwards. */
+  gboolean constructed;
 };
 
 enum {
@@ -212,6 +215,41 @@ inf_text_remote_delete_operation_init(InfTextRemoteDeleteOperation* operation)
 
   priv->recon = NULL;
   priv->recon_offset = 0;
+  priv->constructed = FALSE;
+}
+
+static void
+inf_text_remote_delete_operation_constructed(GObject* object)
+{
+  InfTextRemoteDeleteOperationPrivate* priv;
+  priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(object);
+
+  G_OBJECT_CLASS(inf_text_remote_delete_operation_parent_class)->constructed(object);
+
+  priv->constructed = TRUE;
+}
+
+/* Bypasses property dispatch, which is slow for objects that are created
+ * as often as operations during transformation. Takes ownership of
+ * recon. */
+static InfTextRemoteDeleteOperation*
+inf_text_remote_delete_operation_new_internal(guint position,
+                                              guint length,
+                                              GSList* recon,
+                                              guint recon_offset)
+{
+  GObject* object;
+  InfTextRemoteDeleteOperationPrivate* priv;
+
+  object = g_object_new(INF_TEXT_TYPE_REMOTE_DELETE_OPERATION, NULL);
+  priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(object);
+
+  priv->position = position;
+  priv->length = length;
+  priv->recon = recon;
+  priv->recon_offset = recon_offset;
+
+  return INF_TEXT_REMOTE_DELETE_OPERATION(object);
 }
 
 static void
@@ -240,6 +278,17 @@ inf_text_remote_delete_operation_set_property(GObject* object,
   operation = INF_TEXT_REMOTE_DELETE_OPERATION(object);
   priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(operation);
 
+  if(priv->constructed)
+  {
+    g_warning(
+      "Property \"%s\" of %s can only be set at construction time",
+      pspec->name,
+      G_OBJECT_TYPE_NAME(object)
+    );
+
+    return;
+  }
+
   switch(prop_id)
   {
   case PROP_POSITION:
@@ -327,26 +376,16 @@ static InfAdoptedOperation*
 inf_text_remote_delete_operation_copy(InfAdoptedOperation* operation)
 {
   InfTextRemoteDeleteOperationPrivate* priv;
-  GObject* result;
-  InfTextRemoteDeleteOperationPrivate* result_priv;
-
   priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(operation);
 
-  result = g_object_new(
-    INF_TEXT_TYPE_REMOTE_DELETE_OPERATION,
-    "position", priv->position,
-    "length", priv->length,
-    NULL
-  );
-
-  result_priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(result);
-
-  result_priv->recon = inf_text_remote_delete_operation_recon_copy(
-    priv->recon
+  return INF_ADOPTED_OPERATION(
+    inf_text_remote_delete_operation_new_internal(
+      priv->position,
+      priv->length,
+      inf_text_remote_delete_operation_recon_copy(priv->recon),
+      priv->recon_offset
+    )
   );
-
-  result_priv->recon_offset = priv->recon_offset;
-  return INF_ADOPTED_OPERATION(result);
 }
 
 static InfAdoptedOperationFlags
@@ -518,23 +557,16 @@ inf_text_remote_delete_operation_transform_position(
   guint position)
 {
   InfTextRemoteDeleteOperationPrivate* priv;
-  GObject* result;
-  InfTextRemoteDeleteOperationPrivate* result_priv;
-
   priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(operation);
-  result = g_object_new(
-    INF_TEXT_TYPE_REMOTE_DELETE_OPERATION,
-    "position", position,
-    "length", priv->length,
-    NULL
-  );
-  result_priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(result);
 
-  result_priv->recon = inf_text_remote_delete_operation_recon_copy(
-    priv->recon
+  return INF_TEXT_DELETE_OPERATION(
+    inf_text_remote_delete_operation_new_internal(
+      position,
+      priv->length,
+      inf_text_remote_delete_operation_recon_copy(priv->recon),
+      priv->recon_offset
+    )
   );
-  result_priv->recon_offset = priv->recon_offset;
-  return INF_TEXT_DELETE_OPERATION(result);
 }
 
 static InfTextDeleteOperation*
@@ -548,8 +580,7 @@ inf_text_remote_delete_operation_transform_overlap(
 {
   InfTextRemoteDeleteOperationPrivate* priv;
   InfTextChunk* chunk;
-  GObject* result;
-  InfTextRemoteDeleteOperationPrivate* result_priv;
+  InfTextRemoteDeleteOperation* result;
 
   /* It is actually possible that two remote delete operations are
    * transformed against each other (actually the parts of a splitted
@@ -566,24 +597,14 @@ inf_text_remote_delete_operation_transform_overlap(
     length
   );
 
-  result = g_object_new(
-    INF_TEXT_TYPE_REMOTE_DELETE_OPERATION,
-    "position", position,
-    "length", priv->length - length,
-    NULL
-  );
-
-  result_priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(result);
-
-  result_priv->recon = inf_text_remote_delete_operation_recon_feed(
-    priv->recon,
-    begin,
-    chunk
+  result = inf_text_remote_delete_operation_new_internal(
+    position,
+    priv->length - length,
+    inf_text_remote_delete_operation_recon_feed(priv->recon, begin, chunk),
+    priv->recon_offset
   );
 
   inf_text_chunk_free(chunk);
-
-  result_priv->recon_offset = priv->recon_offset;
   return INF_TEXT_DELETE_OPERATION(result);
 }
 
@@ -596,9 +617,8 @@ inf_text_remote_delete_operation_transform_split(
   /* Need to split the delete operation and the recon list */
   InfTextRemoteDeleteOperationPrivate* priv;
   InfAdoptedSplitOperation* result;
-  GObject* first_operation;
-  GObject* second_operation;
-  InfTextRemoteDeleteOperationPrivate* result_priv;
+  InfTextRemoteDeleteOperation* first_operation;
+  InfTextRemoteDeleteOperation* second_operation;
   InfTextRemoteDeleteOperationRecon* recon;
   InfTextRemoteDeleteOperationRecon* new_recon;
   GSList* first_recon;
@@ -635,27 +655,19 @@ inf_text_remote_delete_operation_transform_split(
     }
   }
 
-  first_operation = g_object_new(
-    INF_TEXT_TYPE_REMOTE_DELETE_OPERATION,
-    "position", priv->position,
-    "length", split_pos,
-    NULL
-  );
-  
-  second_operation = g_object_new(
-    INF_TEXT_TYPE_REMOTE_DELETE_OPERATION,
-    "position", priv->position + split_len,
-    "length", priv->length - split_pos,
-    NULL
+  first_operation = inf_text_remote_delete_operation_new_internal(
+    priv->position,
+    split_pos,
+    g_slist_reverse(first_recon),
+    priv->recon_offset
   );
 
-  result_priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(first_operation);
-  result_priv->recon = g_slist_reverse(first_recon);
-  result_priv->recon_offset = priv->recon_offset;
-
-  result_priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(second_operation);
-  result_priv->recon = g_slist_reverse(second_recon);
-  result_priv->recon_offset = priv->recon_offset + split_pos + recon_cur_len;
+  second_operation = inf_text_remote_delete_operation_new_internal(
+    priv->position + split_len,
+    priv->length - split_pos,
+    g_slist_reverse(second_recon),
+    priv->recon_offset + split_pos + recon_cur_len
+  );
 
   result = inf_adopted_split_operation_new(
     INF_ADOPTED_OPERATION(first_operation),
@@ -674,6 +686,7 @@ inf_text_remote_delete_operation_class_init(
   GObjectClass* object_class;
   object_class = G_OBJECT_CLASS(remote_delete_operation_class);
 
+  object_class->constructed = inf_text_remote_delete_operation_constructed;
   object_class->finalize = inf_text_remote_delete_operation_finalize;
   object_class->set_property = inf_text_remote_delete_operation_set_property;
   object_class->get_property = inf_text_remote_delete_operation_get_property;
@@ -688,7 +701,7 @@ inf_text_remote_delete_operation_class_init(
       0,
       G_MAXUINT,
       0,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 
@@ -702,7 +715,7 @@ inf_text_remote_delete_operation_class_init(
       0,
       G_MAXUINT,
       0,
-      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+      G_PARAM_READWRITE
     )
   );
 }
@@ -757,16 +770,12 @@ InfTextRemoteDeleteOperation*
 inf_text_remote_delete_operation_new(guint position,
                                      guint length)
 {
-  GObject* object;
-
-  object = g_object_new(
-    INF_TEXT_TYPE_REMOTE_DELETE_OPERATION,
-    "position", position,
-    "length", length,
-    NULL
+  return inf_text_remote_delete_operation_new_internal(
+    position,
+    length,
+    NULL,
+    0
   );
-
-  return INF_TEXT_REMOTE_DELETE_OPERATION(object);
 }
 
 /* vim:set et sw=2 ts=2: */
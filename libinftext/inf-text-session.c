@@ -28,6 +28,7 @@
 #include <libinftext/inf-text-user.h>
 #include <libinfinity/adopted/inf-adopted-no-operation.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-utf8-util.h>
 #include <libinfinity/common/inf-error.h>
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
@@ -101,9 +102,41 @@ inf_text_session_timeval_diff(GTimeVal* first,
          (first->tv_usec+500)/1000 - (second->tv_usec+500)/1000;
 }
 
+/* Text in this encoding is written to and read from XML as it is, so
+ * that it does not need to go through iconv. */
+static gboolean
+inf_text_session_encoding_is_utf8(const gchar* encoding)
+{
+  return strcmp(encoding, "UTF-8") == 0;
+}
+
+/* Text read from XML is valid UTF-8 except for characters given by
+ * <uchar> elements, so it is validated before it is used without
+ * conversion. */
+static gboolean
+inf_text_session_validate_utf8(const gchar* text,
+                               gsize bytes,
+                               GError** error)
+{
+  if(!inf_utf8_util_validate(text, bytes))
+  {
+    g_set_error_literal(
+      error,
+      G_CONVERT_ERROR,
+      G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+      _("Invalid byte sequence in conversion input")
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 /* Converts at most *bytes bytes with cd and writes the result, which are
  * at most 1024 bytes, into xml, setting the given author. *bytes will be
- * set to the number of bytes not yet processed. */
+ * set to the number of bytes not yet processed. If cd is NULL, text is in
+ * UTF-8 already and is added to xml directly. */
 static void
 inf_text_session_segment_to_xml(GIConv* cd,
                                 xmlNodePtr xml,
@@ -119,6 +152,23 @@ inf_text_session_segment_to_xml(GIConv* cd,
   gchar* inbuf;
   gchar* outbuf;
 
+  if(cd == NULL)
+  {
+    /* Don't split a character across two nodes */
+    bytes_left = MIN(*bytes, sizeof(utf8_text));
+    if(bytes_left < *bytes)
+    {
+      while((((const guchar*)text)[bytes_left] & 0xc0) == 0x80)
+        --bytes_left;
+    }
+
+    inf_xml_util_add_child_text(xml, text, bytes_left);
+    inf_xml_util_set_attribute_uint(xml, "author", author);
+
+    *bytes -= bytes_left;
+    return;
+  }
+
   bytes_left = 1024;
 
   inbuf = *(gchar**)(gpointer)&text; /* cast const away without warning */
@@ -158,6 +208,18 @@ inf_text_session_segment_from_xml(GIConv* cd,
   if(!utf8_text)
     return NULL;
 
+  if(cd == NULL)
+  {
+    if(!inf_text_session_validate_utf8(utf8_text, bytes_read, error))
+    {
+      g_free(utf8_text);
+      return NULL;
+    }
+
+    *bytes = bytes_read;
+    return utf8_text;
+  }
+
   text = g_convert_with_iconv(
     utf8_text,
     bytes_read,
@@ -988,6 +1050,7 @@ inf_text_session_to_xml_sync(InfSession* session,
   gsize total_bytes;
   gsize bytes_left;
   GIConv cd;
+  GIConv* cd_ptr;
 
   INF_SESSION_CLASS(inf_text_session_parent_class)->to_xml_sync(
     session,
@@ -995,7 +1058,13 @@ inf_text_session_to_xml_sync(InfSession* session,
   );
 
   buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
-  cd = g_iconv_open("UTF-8", inf_text_buffer_get_encoding(buffer));
+
+  cd_ptr = NULL;
+  if(!inf_text_session_encoding_is_utf8(inf_text_buffer_get_encoding(buffer)))
+  {
+    cd = g_iconv_open("UTF-8", inf_text_buffer_get_encoding(buffer));
+    cd_ptr = &cd;
+  }
 
   iter = inf_text_buffer_create_begin_iter(buffer);
   if(iter != NULL)
@@ -1012,7 +1081,7 @@ inf_text_session_to_xml_sync(InfSession* session,
       {
         xml = xmlNewChild(parent, NULL, (const xmlChar*)"sync-segment", NULL);
         inf_text_session_segment_to_xml(
-          &cd,
+          cd_ptr,
           xml,
           text + total_bytes - bytes_left,
           &bytes_left,
@@ -1027,7 +1096,8 @@ inf_text_session_to_xml_sync(InfSession* session,
     inf_text_buffer_destroy_iter(buffer, iter);
   }
 
-  g_iconv_close(cd);
+  if(cd_ptr != NULL)
+    g_iconv_close(cd);
 }
 
 static gboolean
@@ -1048,18 +1118,34 @@ inf_text_session_process_xml_sync(InfSession* session,
   if(strcmp((const char*)xml->name, "sync-segment") == 0)
   {
     buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
-    cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
 
-    text = inf_text_session_segment_from_xml(
-      &cd,
-      xml,
-      &length,
-      &bytes,
-      &author,
-      error
-    );
+    if(inf_text_session_encoding_is_utf8(inf_text_buffer_get_encoding(buffer)))
+    {
+      text = inf_text_session_segment_from_xml(
+        NULL,
+        xml,
+        &length,
+        &bytes,
+        &author,
+        error
+      );
+    }
+    else
+    {
+      cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
+
+      text = inf_text_session_segment_from_xml(
+        &cd,
+        xml,
+        &length,
+        &bytes,
+        &author,
+        error
+      );
+
+      g_iconv_close(cd);
+    }
 
-    g_iconv_close(cd);
     if(text == NULL) return FALSE;
 
     if(author != 0)
@@ -1090,14 +1176,7 @@ inf_text_session_process_xml_sync(InfSession* session,
       user = NULL;
     }
 
-    inf_text_buffer_insert_text(
-      buffer,
-      inf_text_buffer_get_length(buffer),
-      text,
-      bytes,
-      length,
-      user
-    );
+    inf_text_buffer_append_text(buffer, text, bytes, length, user);
 
     g_free(text);
     return TRUE;
@@ -1336,6 +1415,7 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
   gsize bytes_written;
 
   GIConv cd;
+  GIConv* cd_ptr;
   xmlNodePtr child;
   const gchar* text;
   gsize total_bytes;
@@ -1369,22 +1449,33 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
       result = inf_text_chunk_iter_init_begin(chunk, &iter);
       g_assert(result == TRUE);
 
-      utf8_text = g_convert(
-        inf_text_chunk_iter_get_text(&iter),
-        inf_text_chunk_iter_get_bytes(&iter),
-        "UTF-8",
-        inf_text_chunk_get_encoding(chunk),
-        &bytes_read,
-        &bytes_written,
-        NULL
-      );
+      if(inf_text_session_encoding_is_utf8(inf_text_chunk_get_encoding(chunk)))
+      {
+        inf_xml_util_add_child_text(
+          op_xml,
+          inf_text_chunk_iter_get_text(&iter),
+          inf_text_chunk_iter_get_bytes(&iter)
+        );
+      }
+      else
+      {
+        utf8_text = g_convert(
+          inf_text_chunk_iter_get_text(&iter),
+          inf_text_chunk_iter_get_bytes(&iter),
+          "UTF-8",
+          inf_text_chunk_get_encoding(chunk),
+          &bytes_read,
+          &bytes_written,
+          NULL
+        );
 
-      /* Conversion to UTF-8 should always succeed */
-      g_assert(utf8_text != NULL);
-      g_assert(bytes_read == inf_text_chunk_iter_get_bytes(&iter));
+        /* Conversion to UTF-8 should always succeed */
+        g_assert(utf8_text != NULL);
+        g_assert(bytes_read == inf_text_chunk_iter_get_bytes(&iter));
 
-      inf_xml_util_add_child_text(op_xml, utf8_text, bytes_written);
-      g_free(utf8_text);
+        inf_xml_util_add_child_text(op_xml, utf8_text, bytes_written);
+        g_free(utf8_text);
+      }
 
       /* We only allow a single segment because the whole inserted text must
        * be written by a single user. */
@@ -1412,7 +1503,14 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
         );
 
         /* Need to transmit all deleted data */
-        cd = g_iconv_open("UTF-8", inf_text_chunk_get_encoding(chunk));
+        cd_ptr = NULL;
+        if(!inf_text_session_encoding_is_utf8(
+             inf_text_chunk_get_encoding(chunk)))
+        {
+          cd = g_iconv_open("UTF-8", inf_text_chunk_get_encoding(chunk));
+          cd_ptr = &cd;
+        }
+
         result = inf_text_chunk_iter_init_begin(chunk, &iter);
 
         while(result == TRUE)
@@ -1425,7 +1523,7 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
           while(bytes_left > 0)
           {
             inf_text_session_segment_to_xml(
-              &cd,
+              cd_ptr,
               child,
               text + total_bytes - bytes_left,
               &bytes_left,
@@ -1436,7 +1534,8 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
           result = inf_text_chunk_iter_next(&iter);
         }
 
-        g_iconv_close(cd);
+        if(cd_ptr != NULL)
+          g_iconv_close(cd);
       }
       else
       {
@@ -1529,6 +1628,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
 
   xmlNodePtr child;
   GIConv cd;
+  GIConv* cd_ptr;
   guint author;
   gboolean cmp;
 
@@ -1561,18 +1661,32 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
     if(!utf8_text)
       goto fail;
 
-    text = g_convert(
-      utf8_text,
-      in_bytes,
-      inf_text_buffer_get_encoding(buffer),
-      "UTF-8",
-      NULL,
-      &bytes,
-      error
-    );
+    if(inf_text_session_encoding_is_utf8(inf_text_buffer_get_encoding(buffer)))
+    {
+      if(!inf_text_session_validate_utf8(utf8_text, in_bytes, error))
+      {
+        g_free(utf8_text);
+        goto fail;
+      }
 
-    g_free(utf8_text);
-    if(text == NULL) goto fail;
+      text = utf8_text;
+      bytes = in_bytes;
+    }
+    else
+    {
+      text = g_convert(
+        utf8_text,
+        in_bytes,
+        inf_text_buffer_get_encoding(buffer),
+        "UTF-8",
+        NULL,
+        &bytes,
+        error
+      );
+
+      g_free(utf8_text);
+      if(text == NULL) goto fail;
+    }
 
     chunk = inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
     inf_text_chunk_insert_text(chunk, 0, text, bytes, length, user_id);
@@ -1595,15 +1709,22 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
     if(for_sync == TRUE)
     {
       chunk = inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
-      cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
-      g_assert(cd != (GIConv)(-1));
+
+      cd_ptr = NULL;
+      if(!inf_text_session_encoding_is_utf8(
+           inf_text_buffer_get_encoding(buffer)))
+      {
+        cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
+        g_assert(cd != (GIConv)(-1));
+        cd_ptr = &cd;
+      }
 
       for(child = op_xml->children; child != NULL; child = child->next)
       {
         if(strcmp((const char*)child->name, "segment") == 0)
         {
           text = inf_text_session_segment_from_xml(
-            &cd,
+            cd_ptr,
             child,
             &length,
             &bytes,
@@ -1614,7 +1735,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
           if(text == NULL)
           {
             inf_text_chunk_free(chunk);
-            g_iconv_close(cd);
+            if(cd_ptr != NULL) g_iconv_close(cd);
             goto fail;
           }
           else
@@ -1637,7 +1758,8 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
         }
       }
 
-      g_iconv_close(cd);
+      if(cd_ptr != NULL)
+        g_iconv_close(cd);
 
       operation = INF_ADOPTED_OPERATION(
         inf_text_default_delete_operation_new(pos, chunk)
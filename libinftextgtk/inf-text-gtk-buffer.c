@@ -1584,6 +1584,81 @@ inf_text_gtk_buffer_buffer_get_slice(InfTextBuffer* buffer,
   return result;
 }
 
+/* Moves the insertion mark and the selection bound back to the beginning of
+ * text of the given length that has just been inserted by a user other than
+ * the active user and ends at end_iter, so that they keep left gravity. */
+static void
+inf_text_gtk_buffer_fix_insert_gravity(InfTextGtkBuffer* buffer,
+                                       GtkTextIter* end_iter,
+                                       guint len,
+                                       InfUser* user)
+{
+  InfTextGtkBufferPrivate* priv;
+  GtkTextMark* mark;
+  GtkTextIter insert_iter;
+  gboolean insert_at_cursor;
+  gboolean insert_at_selection_bound;
+
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+
+  /* TODO: We could also do this by simply resyncing the text buffer marks
+   * to the active user's caret and selection properties. But then we
+   * wouldn't have left gravtiy if no active user was present. */
+  if(user != INF_USER(priv->active_user) || user == NULL)
+  {
+    mark = gtk_text_buffer_get_insert(priv->buffer);
+    gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
+
+    if(gtk_text_iter_equal(&insert_iter, end_iter))
+      insert_at_cursor = TRUE;
+    else
+      insert_at_cursor = FALSE;
+
+    mark = gtk_text_buffer_get_selection_bound(priv->buffer);
+    gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
+
+    if(gtk_text_iter_equal(&insert_iter, end_iter))
+      insert_at_selection_bound = TRUE;
+    else
+      insert_at_selection_bound = FALSE;
+
+    if(insert_at_cursor || insert_at_selection_bound)
+    {
+      inf_signal_handlers_block_by_func(
+        G_OBJECT(priv->buffer),
+        G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
+        buffer
+      );
+
+      gtk_text_iter_backward_chars(end_iter, len);
+
+      if(insert_at_cursor)
+      {
+        gtk_text_buffer_move_mark(
+          priv->buffer,
+          gtk_text_buffer_get_insert(priv->buffer),
+          end_iter
+        );
+      }
+
+      if(insert_at_selection_bound)
+      {
+        gtk_text_buffer_move_mark(
+          priv->buffer,
+          gtk_text_buffer_get_selection_bound(priv->buffer),
+          end_iter
+        );
+      }
+
+      inf_signal_handlers_unblock_by_func(
+        G_OBJECT(priv->buffer),
+        G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
+        buffer
+      );
+    }
+  }
+}
+
 static void
 inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
                                        guint pos,
@@ -1595,11 +1670,6 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
   InfTextGtkBufferTagRemove tag_remove;
   GtkTextTag* tag;
 
-  GtkTextMark* mark;
-  GtkTextIter insert_iter;
-  gboolean insert_at_cursor;
-  gboolean insert_at_selection_bound;
-
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
   tag_remove.buffer = priv->buffer;
 
@@ -1684,66 +1754,12 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
     } while(inf_text_chunk_iter_next(&chunk_iter));
 
     /* Fix left gravity of own cursor on remote insert */
-
-    /* TODO: We could also do this by simply resyncing the text buffer marks
-     * to the active user's caret and selection properties. But then we
-     * wouldn't have left gravtiy if no active user was present. */
-    if(user != INF_USER(priv->active_user) || user == NULL)
-    {
-      mark = gtk_text_buffer_get_insert(priv->buffer);
-      gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
-
-      if(gtk_text_iter_equal(&insert_iter, &tag_remove.end_iter))
-        insert_at_cursor = TRUE;
-      else
-        insert_at_cursor = FALSE;
-
-      mark = gtk_text_buffer_get_selection_bound(priv->buffer);
-      gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
-
-      if(gtk_text_iter_equal(&insert_iter, &tag_remove.end_iter))
-        insert_at_selection_bound = TRUE;
-      else
-        insert_at_selection_bound = FALSE;
-
-      if(insert_at_cursor || insert_at_selection_bound)
-      {
-        inf_signal_handlers_block_by_func(
-          G_OBJECT(priv->buffer),
-          G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
-          buffer
-        );
-
-        gtk_text_iter_backward_chars(
-          &tag_remove.end_iter,
-          inf_text_chunk_get_length(chunk)
-        );
-
-        if(insert_at_cursor)
-        {
-          gtk_text_buffer_move_mark(
-            priv->buffer,
-            gtk_text_buffer_get_insert(priv->buffer),
-            &tag_remove.end_iter
-          );
-        }
-
-        if(insert_at_selection_bound)
-        {
-          gtk_text_buffer_move_mark(
-            priv->buffer,
-            gtk_text_buffer_get_selection_bound(priv->buffer),
-            &tag_remove.end_iter
-          );
-        }
-
-        inf_signal_handlers_unblock_by_func(
-          G_OBJECT(priv->buffer),
-          G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
-          buffer
-        );
-      }
-    }
+    inf_text_gtk_buffer_fix_insert_gravity(
+      INF_TEXT_GTK_BUFFER(buffer),
+      &tag_remove.end_iter,
+      inf_text_chunk_get_length(chunk),
+      user
+    );
   }
 
   inf_signal_handlers_unblock_by_func(
@@ -1821,6 +1837,150 @@ inf_text_gtk_buffer_buffer_erase_text(InfTextBuffer* buffer,
   inf_text_chunk_free(chunk);
 }
 
+static void
+inf_text_gtk_buffer_buffer_append_text(InfTextBuffer* buffer,
+                                       gconstpointer text,
+                                       gsize bytes,
+                                       guint len,
+                                       InfUser* user)
+{
+  InfTextGtkBufferPrivate* priv;
+  InfTextGtkBufferTagRemove tag_remove;
+  GtkTextTag* tag;
+
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+  tag_remove.buffer = priv->buffer;
+
+  /* See inf_text_gtk_buffer_buffer_insert_text() */
+  g_assert(priv->record == NULL);
+
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_apply_tag_cb),
+    buffer
+  );
+
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_before),
+    buffer
+  );
+
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_after),
+    buffer
+  );
+
+  /* The end iterator is cheaper to obtain than one at an arbitrary offset,
+   * and the text is inserted without building a chunk for it first. */
+  gtk_text_buffer_get_end_iter(priv->buffer, &tag_remove.end_iter);
+
+  tag_remove.ignore_tags = inf_text_gtk_buffer_get_user_tags(
+    INF_TEXT_GTK_BUFFER(buffer),
+    user == NULL ? 0 : inf_user_get_id(user)
+  );
+
+  if(tag_remove.ignore_tags)
+  {
+    tag = inf_text_gtk_buffer_get_user_tag(
+      INF_TEXT_GTK_BUFFER(buffer),
+      tag_remove.ignore_tags,
+      priv->show_user_colors
+    );
+  }
+  else
+  {
+    tag = NULL;
+  }
+
+  gtk_text_buffer_insert_with_tags(
+    tag_remove.buffer,
+    &tag_remove.end_iter,
+    text,
+    bytes,
+    tag,
+    NULL
+  );
+
+  /* Remove the tag of the author of the preceding text, which
+   * GtkTextBuffer applies to the new text as well. */
+  tag_remove.begin_iter = tag_remove.end_iter;
+  gtk_text_iter_backward_chars(&tag_remove.begin_iter, len);
+
+  gtk_text_tag_table_foreach(
+    gtk_text_buffer_get_tag_table(tag_remove.buffer),
+    inf_text_gtk_buffer_buffer_insert_text_tag_table_foreach_func,
+    &tag_remove
+  );
+
+  inf_text_gtk_buffer_fix_insert_gravity(
+    INF_TEXT_GTK_BUFFER(buffer),
+    &tag_remove.end_iter,
+    len,
+    user
+  );
+
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_apply_tag_cb),
+    buffer
+  );
+
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_before),
+    buffer
+  );
+
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_after),
+    buffer
+  );
+}
+
+static void
+inf_text_gtk_buffer_buffer_clear(InfTextBuffer* buffer)
+{
+  InfTextGtkBufferPrivate* priv;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+
+  /* See inf_text_gtk_buffer_buffer_erase_text() */
+  g_assert(priv->record == NULL);
+
+  gtk_text_buffer_get_bounds(priv->buffer, &begin, &end);
+
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_before),
+    buffer
+  );
+
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_after),
+    buffer
+  );
+
+  gtk_text_buffer_delete(priv->buffer, &begin, &end);
+
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_before),
+    buffer
+  );
+
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_after),
+    buffer
+  );
+}
+
 static InfTextBufferIter*
 inf_text_gtk_buffer_buffer_create_begin_iter(InfTextBuffer* buffer)
 {
@@ -2148,6 +2308,8 @@ inf_text_gtk_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_gtk_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_gtk_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_gtk_buffer_buffer_iter_get_author;
+  iface->append_text = inf_text_gtk_buffer_buffer_append_text;
+  iface->clear = inf_text_gtk_buffer_buffer_clear;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
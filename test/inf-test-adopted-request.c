@@ -0,0 +1,826 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Creates InfAdoptedRequests with the constructor functions and with
+ * g_object_new(), and verifies that both report the values they were
+ * created with, and that neither they nor their operations can be changed
+ * after construction. Then executes a few requests of two users with an
+ * InfAdoptedAlgorithm, including concurrent ones and an undo and redo, so
+ * that the requests created during transformation, mirroring and folding
+ * are used as well, and verifies the resulting buffer content. Finally,
+ * executes the same set of requests, including an invalid one, once one by
+ * one and once with inf_adopted_algorithm_execute_requests(), and verifies
+ * that both lead to the same result. */
+
+#include <libinftext/inf-text-default-insert-operation.h>
+#include <libinftext/inf-text-default-delete-operation.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/adopted/inf-adopted-request.h>
+#include <libinfinity/common/inf-user-table.h>
+
+#include <string.h>
+#include <stdio.h>
+
+static const gchar INITIAL_TEXT[] = "0123456789";
+
+/* Number of requests used for the batch test, and the index of the one
+ * that is expected to fail. */
+#define N_BATCH_REQUESTS 7
+#define INVALID_BATCH_REQUEST 3
+
+static gboolean
+check_request(InfAdoptedRequest* request,
+              InfAdoptedRequestType type,
+              InfAdoptedStateVector* vector,
+              guint user_id,
+              InfAdoptedOperation* operation,
+              gint64 received)
+{
+  InfAdoptedRequestType prop_type;
+  InfAdoptedStateVector* prop_vector;
+  guint prop_user_id;
+  InfAdoptedOperation* prop_operation;
+  gint64 prop_received;
+  gboolean result;
+
+  g_object_get(
+    G_OBJECT(request),
+    "type", &prop_type,
+    "vector", &prop_vector,
+    "user-id", &prop_user_id,
+    "operation", &prop_operation,
+    "received", &prop_received,
+    NULL
+  );
+
+  result = TRUE;
+  if(inf_adopted_request_get_request_type(request) != type ||
+     prop_type != type)
+  {
+    printf("Request has wrong type\n");
+    result = FALSE;
+  }
+
+  if(inf_adopted_state_vector_compare(
+       inf_adopted_request_get_vector(request), vector) != 0 ||
+     inf_adopted_state_vector_compare(prop_vector, vector) != 0)
+  {
+    printf("Request has wrong vector\n");
+    result = FALSE;
+  }
+
+  if(inf_adopted_request_get_user_id(request) != user_id ||
+     prop_user_id != user_id)
+  {
+    printf("Request has wrong user ID\n");
+    result = FALSE;
+  }
+
+  if(inf_adopted_request_get_index(request) !=
+     inf_adopted_state_vector_get(vector, user_id))
+  {
+    printf("Request has wrong index\n");
+    result = FALSE;
+  }
+
+  if(inf_adopted_request_get_operation(request) != operation ||
+     prop_operation != operation)
+  {
+    printf("Request has wrong operation\n");
+    result = FALSE;
+  }
+
+  if(inf_adopted_request_get_receive_time(request) != received ||
+     prop_received != received)
+  {
+    printf("Request has wrong receive time\n");
+    result = FALSE;
+  }
+
+  inf_adopted_state_vector_free(prop_vector);
+  if(prop_operation != NULL)
+    g_object_unref(prop_operation);
+
+  return result;
+}
+
+static gboolean
+test_construct(void)
+{
+  InfAdoptedStateVector* vector;
+  InfTextChunk* chunk;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+  gboolean result;
+
+  vector = inf_adopted_state_vector_new();
+  inf_adopted_state_vector_set(vector, 1, 3);
+  inf_adopted_state_vector_set(vector, 2, 5);
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, "abc", 3, 3, 1);
+  operation = INF_ADOPTED_OPERATION(
+    inf_text_default_insert_operation_new(0, chunk)
+  );
+  inf_text_chunk_free(chunk);
+
+  result = TRUE;
+
+  request = inf_adopted_request_new_do(vector, 2, operation, 42);
+  if(!check_request(request, INF_ADOPTED_REQUEST_DO, vector, 2, operation, 42))
+    result = FALSE;
+  g_object_unref(request);
+
+  request = inf_adopted_request_new_undo(vector, 1, 7);
+  if(!check_request(request, INF_ADOPTED_REQUEST_UNDO, vector, 1, NULL, 7))
+    result = FALSE;
+  g_object_unref(request);
+
+  request = inf_adopted_request_new_redo(vector, 1, 0);
+  if(!check_request(request, INF_ADOPTED_REQUEST_REDO, vector, 1, NULL, 0))
+    result = FALSE;
+  g_object_unref(request);
+
+  /* The properties can still be given to g_object_new(), in any order */
+  request = INF_ADOPTED_REQUEST(
+    g_object_new(
+      INF_ADOPTED_TYPE_REQUEST,
+      "user-id", 2,
+      "operation", operation,
+      "vector", vector,
+      "received", G_GINT64_CONSTANT(13),
+      NULL
+    )
+  );
+
+  if(!check_request(request, INF_ADOPTED_REQUEST_DO, vector, 2, operation, 13))
+    result = FALSE;
+  g_object_unref(request);
+
+  g_object_unref(operation);
+  inf_adopted_state_vector_free(vector);
+  return result;
+}
+
+static void
+count_warnings_log_func(const gchar* log_domain,
+                        GLogLevelFlags log_level,
+                        const gchar* message,
+                        gpointer user_data)
+{
+  ++*(guint*)user_data;
+}
+
+static gboolean
+test_immutable(void)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedStateVector* other;
+  InfTextChunk* chunk;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+  guint n_warnings;
+  guint handler;
+  gboolean result;
+
+  vector = inf_adopted_state_vector_new();
+  inf_adopted_state_vector_set(vector, 1, 3);
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, "abc", 3, 3, 1);
+  operation = INF_ADOPTED_OPERATION(
+    inf_text_default_insert_operation_new(0, chunk)
+  );
+  inf_text_chunk_free(chunk);
+
+  other = inf_adopted_state_vector_new();
+  inf_adopted_state_vector_set(other, 2, 8);
+
+  request = inf_adopted_request_new_do(vector, 1, operation, 42);
+
+  n_warnings = 0;
+  handler = g_log_set_handler(
+    NULL,
+    G_LOG_LEVEL_WARNING,
+    count_warnings_log_func,
+    &n_warnings
+  );
+
+  /* Setting any of the properties describing the request after
+   * construction is rejected with a warning, and leaves the request as it
+   * is. Only the execution time can be changed. */
+  g_object_set(G_OBJECT(request), "type", INF_ADOPTED_REQUEST_UNDO, NULL);
+  g_object_set(G_OBJECT(request), "vector", other, NULL);
+  g_object_set(G_OBJECT(request), "user-id", 2, NULL);
+  g_object_set(G_OBJECT(request), "operation", NULL, NULL);
+  g_object_set(G_OBJECT(request), "received", G_GINT64_CONSTANT(7), NULL);
+  g_object_set(G_OBJECT(request), "executed", G_GINT64_CONSTANT(9), NULL);
+
+  /* The same holds for the operation the request refers to */
+  g_object_set(G_OBJECT(operation), "position", 2, NULL);
+
+  g_log_remove_handler(NULL, handler);
+
+  result = TRUE;
+  if(n_warnings != 6)
+  {
+    printf("Expected 6 warnings, got %u\n", n_warnings);
+    result = FALSE;
+  }
+
+  if(inf_text_insert_operation_get_position(
+       INF_TEXT_INSERT_OPERATION(operation)) != 0)
+  {
+    printf("Operation has wrong position\n");
+    result = FALSE;
+  }
+
+  if(!check_request(request, INF_ADOPTED_REQUEST_DO, vector, 1, operation, 42))
+    result = FALSE;
+
+  if(inf_adopted_request_get_execute_time(request) != 9)
+  {
+    printf("Request has wrong execution time\n");
+    result = FALSE;
+  }
+
+  g_object_unref(request);
+  g_object_unref(operation);
+  inf_adopted_state_vector_free(other);
+  inf_adopted_state_vector_free(vector);
+  return result;
+}
+
+static gboolean
+execute(InfAdoptedAlgorithm* algorithm,
+        InfAdoptedRequest* request)
+{
+  GError* error;
+
+  error = NULL;
+  inf_adopted_algorithm_execute_request(algorithm, request, TRUE, &error);
+  g_object_unref(request);
+
+  if(error != NULL)
+  {
+    printf("Failed to execute request: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+check_buffer(InfTextBuffer* buffer,
+             const gchar* expected)
+{
+  InfTextChunk* chunk;
+  gchar* text;
+  gsize bytes;
+  gboolean result;
+
+  chunk = inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  inf_text_chunk_free(chunk);
+
+  result = TRUE;
+  if(bytes != strlen(expected) || strncmp(text, expected, bytes) != 0)
+  {
+    printf(
+      "Buffer has \"%.*s\", expected \"%s\"\n",
+      (int)bytes,
+      text,
+      expected
+    );
+    result = FALSE;
+  }
+
+  g_free(text);
+  return result;
+}
+
+static gboolean
+test_algorithm(void)
+{
+  InfTextBuffer* buffer;
+  InfUserTable* user_table;
+  InfTextUser* user;
+  InfAdoptedAlgorithm* algorithm;
+  InfAdoptedStateVector* initial;
+  InfAdoptedStateVector* vector;
+  InfTextChunk* chunk;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+  gboolean result;
+  guint i;
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  inf_text_buffer_insert_text(
+    buffer,
+    0,
+    INITIAL_TEXT,
+    strlen(INITIAL_TEXT),
+    strlen(INITIAL_TEXT),
+    NULL
+  );
+
+  user_table = inf_user_table_new();
+  for(i = 1; i <= 2; ++i)
+  {
+    user = INF_TEXT_USER(
+      g_object_new(
+        INF_TEXT_TYPE_USER,
+        "id", i,
+        "name", i == 1 ? "User_1" : "User_2",
+        "status", INF_USER_ACTIVE,
+        "flags", 0,
+        NULL
+      )
+    );
+
+    inf_user_table_add_user(user_table, INF_USER(user));
+    g_object_unref(user);
+  }
+
+  algorithm = inf_adopted_algorithm_new(user_table, INF_BUFFER(buffer));
+  initial = inf_adopted_state_vector_new();
+  result = TRUE;
+
+  /* User 1 inserts "ab" at position 2 */
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, "ab", 2, 2, 1);
+  operation = INF_ADOPTED_OPERATION(
+    inf_text_default_insert_operation_new(2, chunk)
+  );
+  inf_text_chunk_free(chunk);
+
+  request = inf_adopted_request_new_do(initial, 1, operation, 0);
+  g_object_unref(operation);
+
+  if(!execute(algorithm, request) || !check_buffer(buffer, "01ab23456789"))
+    result = FALSE;
+
+  /* Concurrently, user 2 erases "56", which needs to be transformed against
+   * the insertion of user 1. */
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, "56", 2, 2, 0);
+  operation = INF_ADOPTED_OPERATION(
+    inf_text_default_delete_operation_new(5, chunk)
+  );
+  inf_text_chunk_free(chunk);
+
+  request = inf_adopted_request_new_do(initial, 2, operation, 0);
+  g_object_unref(operation);
+
+  if(!execute(algorithm, request) || !check_buffer(buffer, "01ab234789"))
+    result = FALSE;
+
+  /* User 1 undoes and redoes the insertion, which requires mirroring and
+   * folding the requests in the log. */
+  request = inf_adopted_request_new_undo(
+    inf_adopted_algorithm_get_current(algorithm),
+    1,
+    0
+  );
+
+  if(!execute(algorithm, request) || !check_buffer(buffer, "01234789"))
+    result = FALSE;
+
+  request = inf_adopted_request_new_redo(
+    inf_adopted_algorithm_get_current(algorithm),
+    1,
+    0
+  );
+
+  if(!execute(algorithm, request) || !check_buffer(buffer, "01ab234789"))
+    result = FALSE;
+
+  /* User 2 undoes the erasure, at a state where it has not yet seen the
+   * undo and redo of user 1. */
+  vector = inf_adopted_state_vector_copy(
+    inf_adopted_algorithm_get_current(algorithm)
+  );
+
+  inf_adopted_state_vector_set(vector, 1, 1);
+  request = inf_adopted_request_new_undo(vector, 2, 0);
+  inf_adopted_state_vector_free(vector);
+
+  if(!execute(algorithm, request) || !check_buffer(buffer, "01ab23456789"))
+    result = FALSE;
+
+  inf_adopted_state_vector_free(initial);
+  g_object_unref(algorithm);
+  g_object_unref(user_table);
+  g_object_unref(buffer);
+  return result;
+}
+
+static InfAdoptedStateVector*
+make_vector(guint user1,
+            guint user2)
+{
+  InfAdoptedStateVector* vector;
+
+  vector = inf_adopted_state_vector_new();
+  inf_adopted_state_vector_set(vector, 1, user1);
+  inf_adopted_state_vector_set(vector, 2, user2);
+
+  return vector;
+}
+
+static InfAdoptedRequest*
+make_text_request(guint user1,
+                  guint user2,
+                  guint user_id,
+                  gboolean insert,
+                  guint position,
+                  const gchar* text)
+{
+  InfAdoptedStateVector* vector;
+  InfTextChunk* chunk;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(
+    chunk,
+    0,
+    text,
+    strlen(text),
+    strlen(text),
+    user_id
+  );
+
+  if(insert)
+  {
+    operation = INF_ADOPTED_OPERATION(
+      inf_text_default_insert_operation_new(position, chunk)
+    );
+  }
+  else
+  {
+    operation = INF_ADOPTED_OPERATION(
+      inf_text_default_delete_operation_new(position, chunk)
+    );
+  }
+
+  inf_text_chunk_free(chunk);
+
+  vector = make_vector(user1, user2);
+  request = inf_adopted_request_new_do(vector, user_id, operation, 0);
+  inf_adopted_state_vector_free(vector);
+  g_object_unref(operation);
+
+  return request;
+}
+
+static InfAdoptedRequest*
+make_undo_redo_request(guint user1,
+                       guint user2,
+                       guint user_id,
+                       gboolean undo)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedRequest* request;
+
+  vector = make_vector(user1, user2);
+  if(undo)
+    request = inf_adopted_request_new_undo(vector, user_id, 0);
+  else
+    request = inf_adopted_request_new_redo(vector, user_id, 0);
+  inf_adopted_state_vector_free(vector);
+
+  return request;
+}
+
+/* Creates the requests for the batch test. Users 1 and 2 make concurrent
+ * changes, and undo and redo them. The REDO request of user 2 at
+ * INVALID_BATCH_REQUEST is invalid since there is nothing to redo. */
+static void
+make_batch_requests(InfAdoptedRequest** requests)
+{
+  requests[0] = make_text_request(0, 0, 1, TRUE, 2, "ab");
+  requests[1] = make_text_request(0, 0, 2, FALSE, 5, "56");
+  requests[2] = make_undo_redo_request(1, 1, 1, TRUE);
+  requests[3] = make_undo_redo_request(1, 1, 2, FALSE);
+  requests[4] = make_text_request(1, 1, 2, TRUE, 0, "xy");
+  requests[5] = make_undo_redo_request(2, 2, 1, FALSE);
+  requests[6] = make_undo_redo_request(3, 2, 2, TRUE);
+}
+
+/* Creates a buffer with INITIAL_TEXT and an algorithm for it, with the
+ * local user 1 and the remote user 2. */
+static InfAdoptedAlgorithm*
+create_batch_algorithm(InfTextBuffer** buffer,
+                       InfUserTable** user_table)
+{
+  InfTextUser* user;
+  guint i;
+
+  *buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  inf_text_buffer_insert_text(
+    *buffer,
+    0,
+    INITIAL_TEXT,
+    strlen(INITIAL_TEXT),
+    strlen(INITIAL_TEXT),
+    NULL
+  );
+
+  inf_buffer_set_modified(INF_BUFFER(*buffer), FALSE);
+
+  *user_table = inf_user_table_new();
+  for(i = 1; i <= 2; ++i)
+  {
+    user = INF_TEXT_USER(
+      g_object_new(
+        INF_TEXT_TYPE_USER,
+        "id", i,
+        "name", i == 1 ? "User_1" : "User_2",
+        "status", INF_USER_ACTIVE,
+        "flags", i == 1 ? INF_USER_LOCAL : 0,
+        NULL
+      )
+    );
+
+    inf_user_table_add_user(*user_table, INF_USER(user));
+    g_object_unref(user);
+  }
+
+  return inf_adopted_algorithm_new(*user_table, INF_BUFFER(*buffer));
+}
+
+static gboolean
+compare_batch_algorithms(InfAdoptedAlgorithm* sequential,
+                         InfTextBuffer* sequential_buffer,
+                         InfUserTable* sequential_user_table,
+                         InfAdoptedAlgorithm* batch,
+                         InfTextBuffer* batch_buffer,
+                         InfUserTable* batch_user_table)
+{
+  InfTextChunk* chunk;
+  gchar* text;
+  gsize bytes;
+  gchar* expected;
+  InfUser* sequential_user;
+  InfUser* batch_user;
+  gboolean result;
+  guint i;
+
+  result = TRUE;
+
+  chunk = inf_text_buffer_get_slice(
+    sequential_buffer,
+    0,
+    inf_text_buffer_get_length(sequential_buffer)
+  );
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  inf_text_chunk_free(chunk);
+
+  expected = g_strndup(text, bytes);
+  g_free(text);
+
+  if(!check_buffer(batch_buffer, expected))
+    result = FALSE;
+  g_free(expected);
+
+  if(inf_buffer_get_modified(INF_BUFFER(sequential_buffer)) !=
+     inf_buffer_get_modified(INF_BUFFER(batch_buffer)))
+  {
+    printf("Buffers differ in modified flag\n");
+    result = FALSE;
+  }
+
+  if(inf_adopted_state_vector_compare(
+       inf_adopted_algorithm_get_current(sequential),
+       inf_adopted_algorithm_get_current(batch)) != 0)
+  {
+    printf("Algorithms differ in current state\n");
+    result = FALSE;
+  }
+
+  for(i = 1; i <= 2; ++i)
+  {
+    sequential_user =
+      inf_user_table_lookup_user_by_id(sequential_user_table, i);
+    batch_user = inf_user_table_lookup_user_by_id(batch_user_table, i);
+
+    if(inf_adopted_state_vector_compare(
+         inf_adopted_user_get_vector(INF_ADOPTED_USER(sequential_user)),
+         inf_adopted_user_get_vector(INF_ADOPTED_USER(batch_user))) != 0)
+    {
+      printf("User %u differs in vector\n", i);
+      result = FALSE;
+    }
+
+    if(inf_adopted_algorithm_can_undo(
+         sequential,
+         INF_ADOPTED_USER(sequential_user)) !=
+       inf_adopted_algorithm_can_undo(batch, INF_ADOPTED_USER(batch_user)))
+    {
+      printf("User %u differs in can-undo\n", i);
+      result = FALSE;
+    }
+
+    if(inf_adopted_algorithm_can_redo(
+         sequential,
+         INF_ADOPTED_USER(sequential_user)) !=
+       inf_adopted_algorithm_can_redo(batch, INF_ADOPTED_USER(batch_user)))
+    {
+      printf("User %u differs in can-redo\n", i);
+      result = FALSE;
+    }
+  }
+
+  return result;
+}
+
+static gboolean
+test_batch(void)
+{
+  InfTextBuffer* sequential_buffer;
+  InfUserTable* sequential_user_table;
+  InfAdoptedAlgorithm* sequential;
+  InfTextBuffer* batch_buffer;
+  InfUserTable* batch_user_table;
+  InfAdoptedAlgorithm* batch;
+  InfAdoptedRequest* requests[N_BATCH_REQUESTS];
+  GError* error;
+  gboolean result;
+  gboolean executed;
+  guint i;
+  guint n;
+
+  result = TRUE;
+
+  /* Execute the requests one by one */
+  sequential = create_batch_algorithm(
+    &sequential_buffer,
+    &sequential_user_table
+  );
+
+  make_batch_requests(requests);
+  for(i = 0; i < N_BATCH_REQUESTS; ++i)
+  {
+    error = NULL;
+    executed = inf_adopted_algorithm_execute_request(
+      sequential,
+      requests[i],
+      TRUE,
+      &error
+    );
+
+    if(executed != (i != INVALID_BATCH_REQUEST) ||
+       executed != (error == NULL))
+    {
+      printf("Sequential execution of request %u: unexpected result\n", i);
+      result = FALSE;
+    }
+
+    if(error != NULL)
+      g_error_free(error);
+    g_object_unref(requests[i]);
+  }
+
+  if(!check_buffer(sequential_buffer, "01ab234789"))
+    result = FALSE;
+
+  /* Execute the same requests as a batch. The batch stops at the invalid
+   * request; the rest is executed with a second batch. */
+  batch = create_batch_algorithm(&batch_buffer, &batch_user_table);
+
+  make_batch_requests(requests);
+  error = NULL;
+  n = inf_adopted_algorithm_execute_requests(
+    batch,
+    requests,
+    N_BATCH_REQUESTS,
+    TRUE,
+    &error
+  );
+
+  if(n != INVALID_BATCH_REQUEST)
+  {
+    printf(
+      "Batch stopped after %u requests, expected %u\n",
+      n,
+      INVALID_BATCH_REQUEST
+    );
+
+    result = FALSE;
+  }
+
+  if(error == NULL)
+  {
+    printf("Batch failed without setting an error\n");
+    result = FALSE;
+  }
+  else
+  {
+    if(error->code != INF_ADOPTED_ALGORITHM_ERROR_NO_REDO)
+    {
+      printf("Batch failed with unexpected error: %s\n", error->message);
+      result = FALSE;
+    }
+
+    g_error_free(error);
+  }
+
+  if(n < N_BATCH_REQUESTS)
+  {
+    error = NULL;
+    n += 1 + inf_adopted_algorithm_execute_requests(
+      batch,
+      requests + n + 1,
+      N_BATCH_REQUESTS - n - 1,
+      TRUE,
+      &error
+    );
+
+    if(n != N_BATCH_REQUESTS || error != NULL)
+    {
+      printf("Remaining batch failed\n");
+      result = FALSE;
+    }
+
+    if(error != NULL)
+      g_error_free(error);
+  }
+
+  for(i = 0; i < N_BATCH_REQUESTS; ++i)
+    g_object_unref(requests[i]);
+
+  if(!compare_batch_algorithms(sequential,
+                               sequential_buffer,
+                               sequential_user_table,
+                               batch,
+                               batch_buffer,
+                               batch_user_table))
+  {
+    result = FALSE;
+  }
+
+  g_object_unref(batch);
+  g_object_unref(batch_user_table);
+  g_object_unref(batch_buffer);
+  g_object_unref(sequential);
+  g_object_unref(sequential_user_table);
+  g_object_unref(sequential_buffer);
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  int result;
+
+  result = 0;
+
+  if(test_construct())
+    printf("Request construction: PASSED\n");
+  else
+    result = -1;
+
+  if(test_immutable())
+    printf("Request immutability: PASSED\n");
+  else
+    result = -1;
+
+  if(test_algorithm())
+    printf("Request execution: PASSED\n");
+  else
+    result = -1;
+
+  if(test_batch())
+    printf("Batch execution: PASSED\n");
+  else
+    result = -1;
+
+  return result;
+}
+
+/* vim:set et sw=2 ts=2: */
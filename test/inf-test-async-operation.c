@@ -0,0 +1,195 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Starts a large number of InfAsyncOperations at once (5000 by default, or
+ * the number given as first argument), each of which blocks for a short
+ * time in its worker thread, like a name lookup does. Every tenth operation
+ * is cancelled right after it was started. Prints the average and maximum
+ * time until the result of an operation arrives in the main thread, and
+ * the peak number of worker threads and queued operations of the default
+ * InfThreadPool, whose size can be given as second argument. Verifies that
+ * cancelled operations never report a result and that the pool stays
+ * within its limit. */
+
+#include <libinfinity/common/inf-async-operation.h>
+#include <libinfinity/common/inf-thread-pool.h>
+#include <libinfinity/common/inf-standalone-io.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define DEFAULT_OPERATIONS 5000
+#define RUN_USECS 1000
+#define CANCEL_EVERY 10
+
+typedef struct _InfTestAsyncOperation InfTestAsyncOperation;
+struct _InfTestAsyncOperation {
+  InfAsyncOperation* op;
+  gint64 start_time;
+  gboolean cancelled;
+};
+
+static InfStandaloneIo* io;
+static guint n_pending;
+static gint64 total_latency;
+static gint64 max_latency;
+static gboolean result;
+
+static void
+run_func(gpointer* run_data,
+         GDestroyNotify* run_notify,
+         gpointer user_data)
+{
+  g_usleep(RUN_USECS);
+
+  *run_data = NULL;
+  *run_notify = NULL;
+}
+
+static void
+done_func(gpointer run_data,
+          gpointer user_data)
+{
+  InfTestAsyncOperation* test;
+  gint64 latency;
+
+  test = (InfTestAsyncOperation*)user_data;
+
+  if(test->cancelled == TRUE)
+  {
+    printf("Cancelled operation reported a result\n");
+    result = FALSE;
+  }
+
+  latency = g_get_monotonic_time() - test->start_time;
+  total_latency += latency;
+  if(latency > max_latency)
+    max_latency = latency;
+
+  test->op = NULL;
+
+  --n_pending;
+  if(n_pending == 0)
+    inf_standalone_io_loop_quit(io);
+}
+
+int main(int argc, char* argv[])
+{
+  InfThreadPool* pool;
+  InfTestAsyncOperation* tests;
+  GTimer* timer;
+  GError* error;
+  guint n_operations;
+  guint n_completed;
+  guint i;
+
+  n_operations = DEFAULT_OPERATIONS;
+  if(argc > 1)
+    n_operations = atoi(argv[1]);
+
+  pool = inf_thread_pool_get_default();
+  if(argc > 2 && atoi(argv[2]) > 0)
+    inf_thread_pool_set_max_threads(pool, atoi(argv[2]));
+
+  io = inf_standalone_io_new();
+  tests = g_new(InfTestAsyncOperation, n_operations);
+  timer = g_timer_new();
+  result = TRUE;
+  n_pending = 0;
+  total_latency = 0;
+  max_latency = 0;
+
+  for(i = 0; i < n_operations; ++i)
+  {
+    tests[i].cancelled = FALSE;
+    tests[i].start_time = g_get_monotonic_time();
+    tests[i].op = inf_async_operation_new(
+      INF_IO(io),
+      run_func,
+      done_func,
+      &tests[i]
+    );
+
+    error = NULL;
+    if(!inf_async_operation_start(tests[i].op, &error))
+    {
+      fprintf(stderr, "Failed to start operation: %s\n", error->message);
+      g_error_free(error);
+      tests[i].op = NULL;
+      result = FALSE;
+      break;
+    }
+
+    if(i % CANCEL_EVERY == 0)
+    {
+      inf_async_operation_free(tests[i].op);
+      tests[i].op = NULL;
+      tests[i].cancelled = TRUE;
+    }
+    else
+    {
+      ++n_pending;
+    }
+  }
+
+  n_completed = n_pending;
+  if(n_pending > 0)
+    inf_standalone_io_loop(io);
+
+  if(n_completed > 0)
+  {
+    printf(
+      "%u operations in %.3f secs: latency avg %.3f msecs, "
+      "max %.3f msecs\n",
+      n_completed,
+      g_timer_elapsed(timer, NULL),
+      (gdouble)total_latency / n_completed / 1000.0,
+      (gdouble)max_latency / 1000.0
+    );
+  }
+
+  printf(
+    "peak %u of at most %u threads, peak queue length %u\n",
+    inf_thread_pool_get_peak_threads(pool),
+    inf_thread_pool_get_max_threads(pool),
+    inf_thread_pool_get_peak_queue_length(pool)
+  );
+
+  if(inf_thread_pool_get_peak_threads(pool) >
+     inf_thread_pool_get_max_threads(pool))
+  {
+    printf("Thread pool exceeded its limit\n");
+    result = FALSE;
+  }
+
+  /* Cancelled operations that were already running finish in the
+   * background; give them a chance to wrongly dispatch their result. */
+  inf_standalone_io_iteration_timeout(io, 10 * RUN_USECS / 1000);
+
+  g_timer_destroy(timer);
+  g_free(tests);
+  g_object_unref(io);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
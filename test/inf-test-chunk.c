@@ -19,10 +19,334 @@
 
 #include <libinftext/inf-text-chunk.h>
 
-int main()
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Number of single-character insertions that make up the large document.
+ * They are written by different authors at random positions, so that the
+ * document ends up with a huge number of segments. */
+#define NUM_INSERTIONS 100000
+#define NUM_AUTHORS 8
+#define NUM_ERASURES 20000
+#define NUM_COPIES 5000
+
+/* Number of characters in a single large segment, as if pasted at once,
+ * and the number of edits made to it afterwards. */
+#define NUM_SEGMENT_CHARS 500000
+#define NUM_SEGMENT_EDITS 2000
+
+/* Plain text that the chunk is compared with */
+typedef struct {
+  gchar* text;
+  guint length;
+} test_reference;
+
+static void
+reference_insert(test_reference* ref,
+                 guint pos,
+                 const gchar* text,
+                 guint length)
+{
+  memmove(ref->text + pos + length, ref->text + pos, ref->length - pos);
+  memcpy(ref->text + pos, text, length);
+  ref->length += length;
+}
+
+static void
+reference_erase(test_reference* ref,
+                guint pos,
+                guint length)
+{
+  memmove(
+    ref->text + pos,
+    ref->text + pos + length,
+    ref->length - pos - length
+  );
+
+  ref->length -= length;
+}
+
+static gboolean
+check_chunk(InfTextChunk* chunk,
+            test_reference* ref)
+{
+  InfTextChunkIter iter;
+  gchar* text;
+  gsize bytes;
+  guint offset;
+  gboolean result;
+
+  if(inf_text_chunk_get_length(chunk) != ref->length)
+    return FALSE;
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  result = bytes == ref->length && memcmp(text, ref->text, bytes) == 0;
+  g_free(text);
+
+  /* Segment offsets need to be consistent with segment lengths */
+  offset = 0;
+  if(result && inf_text_chunk_iter_init_begin(chunk, &iter))
+  {
+    do
+    {
+      if(inf_text_chunk_iter_get_offset(&iter) != offset)
+        result = FALSE;
+      offset += inf_text_chunk_iter_get_length(&iter);
+    } while(result && inf_text_chunk_iter_next(&iter));
+  }
+
+  if(result && offset != ref->length)
+    result = FALSE;
+
+  return result;
+}
+
+static guint
+count_segments(InfTextChunk* chunk)
+{
+  InfTextChunkIter iter;
+  guint count;
+
+  count = 0;
+  if(inf_text_chunk_iter_init_begin(chunk, &iter))
+  {
+    do
+    {
+      ++count;
+    } while(inf_text_chunk_iter_next(&iter));
+  }
+
+  return count;
+}
+
+/* Performs many small edits on a large document with many segments, and
+ * prints the time needed for them. */
+static gboolean
+test_large_document(GRand* rand)
+{
+  InfTextChunk* chunk;
+  InfTextChunk* substring;
+  test_reference ref;
+  GTimer* timer;
+  gchar* copy;
+  gchar c;
+  guint pos;
+  guint length;
+  guint i;
+  gboolean result;
+
+  chunk = inf_text_chunk_new("UTF-8");
+  ref.text = g_malloc(NUM_INSERTIONS * 2);
+  ref.length = 0;
+
+  timer = g_timer_new();
+  for(i = 0; i < NUM_INSERTIONS; ++i)
+  {
+    c = 'a' + g_rand_int_range(rand, 0, 26);
+    pos = g_rand_int_range(rand, 0, ref.length + 1);
+
+    inf_text_chunk_insert_text(
+      chunk,
+      pos,
+      &c,
+      1,
+      1,
+      g_rand_int_range(rand, 0, NUM_AUTHORS) + 1
+    );
+
+    reference_insert(&ref, pos, &c, 1);
+  }
+
+  printf(
+    "%u insertions: %g secs (%u segments)\n",
+    NUM_INSERTIONS,
+    g_timer_elapsed(timer, NULL),
+    count_segments(chunk)
+  );
+
+  g_timer_start(timer);
+  for(i = 0; i < NUM_ERASURES; ++i)
+  {
+    pos = g_rand_int_range(rand, 0, ref.length);
+    length = MIN(ref.length - pos, (guint)g_rand_int_range(rand, 1, 4));
+
+    inf_text_chunk_erase(chunk, pos, length);
+    reference_erase(&ref, pos, length);
+  }
+
+  printf(
+    "%u erasures: %g secs\n",
+    NUM_ERASURES,
+    g_timer_elapsed(timer, NULL)
+  );
+
+  g_timer_start(timer);
+  for(i = 0; i < NUM_COPIES; ++i)
+  {
+    pos = g_rand_int_range(rand, 0, ref.length);
+    length = MIN(ref.length - pos, (guint)g_rand_int_range(rand, 1, 32));
+
+    substring = inf_text_chunk_substring(chunk, pos, length);
+    copy = g_memdup(ref.text + pos, length);
+
+    pos = g_rand_int_range(rand, 0, ref.length + 1);
+    inf_text_chunk_insert_chunk(chunk, pos, substring);
+    reference_insert(&ref, pos, copy, length);
+
+    inf_text_chunk_free(substring);
+    g_free(copy);
+  }
+
+  printf(
+    "%u substring copies: %g secs\n",
+    NUM_COPIES,
+    g_timer_elapsed(timer, NULL)
+  );
+
+  result = check_chunk(chunk, &ref);
+  if(result == FALSE)
+    printf("Chunk content does not match reference\n");
+
+  g_timer_destroy(timer);
+  g_free(ref.text);
+  inf_text_chunk_free(chunk);
+  return result;
+}
+
+/* Characters of different UTF-8 lengths that make up the large segment */
+static const gchar* const segment_chars[] = { "a", "\xc3\xbc", "\xe2\x82\xac" };
+
+static gchar*
+build_segment_text(const guchar* chars,
+                   guint n_chars,
+                   gsize* bytes)
+{
+  GString* str;
+  guint i;
+
+  str = g_string_sized_new(n_chars * 2);
+  for(i = 0; i < n_chars; ++i)
+    g_string_append(str, segment_chars[chars[i]]);
+
+  *bytes = str->len;
+  return g_string_free(str, FALSE);
+}
+
+/* Edits a single large segment containing multibyte characters, mostly
+ * close to its end, and prints the time needed for the edits. */
+static gboolean
+test_large_segment(GRand* rand)
+{
+  InfTextChunk* chunk;
+  guchar* chars;
+  guint n_chars;
+  GTimer* timer;
+  gchar* text;
+  gchar* expected;
+  gsize bytes;
+  gsize expected_bytes;
+  guint pos;
+  guint c;
+  guint i;
+  gboolean insert;
+  gboolean result;
+
+  chunk = inf_text_chunk_new("UTF-8");
+  chars = g_malloc(NUM_SEGMENT_CHARS + NUM_SEGMENT_EDITS);
+  n_chars = NUM_SEGMENT_CHARS;
+
+  for(i = 0; i < n_chars; ++i)
+    chars[i] = g_rand_int_range(rand, 0, G_N_ELEMENTS(segment_chars));
+
+  text = build_segment_text(chars, n_chars, &bytes);
+  inf_text_chunk_insert_text(chunk, 0, text, bytes, n_chars, 1);
+  g_free(text);
+
+  timer = g_timer_new();
+  g_timer_stop(timer);
+
+  for(i = 0; i < NUM_SEGMENT_EDITS; ++i)
+  {
+    /* Three quarters of the edits happen at the end of the segment */
+    if(g_rand_int_range(rand, 0, 4) > 0)
+      pos = n_chars - g_rand_int_range(rand, 0, MIN(n_chars, 100) + 1);
+    else
+      pos = g_rand_int_range(rand, 0, n_chars + 1);
+
+    insert = i % 2 == 0 || pos == n_chars;
+    c = g_rand_int_range(rand, 0, G_N_ELEMENTS(segment_chars));
+
+    g_timer_continue(timer);
+    if(insert)
+    {
+      inf_text_chunk_insert_text(
+        chunk,
+        pos,
+        segment_chars[c],
+        strlen(segment_chars[c]),
+        1,
+        1
+      );
+    }
+    else
+    {
+      inf_text_chunk_erase(chunk, pos, 1);
+    }
+    g_timer_stop(timer);
+
+    if(insert)
+    {
+      memmove(chars + pos + 1, chars + pos, n_chars - pos);
+      chars[pos] = c;
+      ++n_chars;
+    }
+    else
+    {
+      memmove(chars + pos, chars + pos + 1, n_chars - pos - 1);
+      --n_chars;
+    }
+  }
+
+  printf(
+    "%u edits in a segment of %u characters: %g secs\n",
+    NUM_SEGMENT_EDITS,
+    NUM_SEGMENT_CHARS,
+    g_timer_elapsed(timer, NULL)
+  );
+
+  expected = build_segment_text(chars, n_chars, &expected_bytes);
+  text = inf_text_chunk_get_text(chunk, &bytes);
+
+  result = inf_text_chunk_get_length(chunk) == n_chars &&
+    bytes == expected_bytes && memcmp(text, expected, bytes) == 0;
+
+  if(result == FALSE)
+    printf("Segment content does not match reference\n");
+
+  g_free(text);
+  g_free(expected);
+  g_free(chars);
+  g_timer_destroy(timer);
+  inf_text_chunk_free(chunk);
+  return result;
+}
+
+int main(int argc, char* argv[])
 {
   InfTextChunk* chunk;
   InfTextChunk* chunk2;
+  GRand* rand;
+  unsigned int rseed;
+  gboolean result;
+
+  if(argc > 1)
+    rseed = atoi(argv[1]);
+  else
+    rseed = time(NULL);
+
+  printf("Using random seed %u\n", rseed);
 
   chunk2 = inf_text_chunk_new("UTF-8");
 
@@ -35,5 +359,16 @@ int main()
   inf_text_chunk_free(chunk);
   inf_text_chunk_free(chunk2);
 
+  rand = g_rand_new_with_seed(rseed);
+  result = test_large_document(rand);
+  if(result == TRUE)
+    result = test_large_segment(rand);
+  g_rand_free(rand);
+
+  if(result == FALSE)
+    return -1;
+
   return 0;
 }
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,195 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Schedules a large number of long timeouts (100000 by default, or the
+ * number given as argument) on an InfStandaloneIo, then repeatedly removes
+ * a random one and schedules a new one instead, the way save and noop
+ * timers are rescheduled on a busy server. Prints the time needed per
+ * operation. Finally runs a number of short timeouts next to the long ones
+ * and verifies that they fire in order and not before they elapse. */
+
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-io.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define DEFAULT_TIMEOUTS 100000
+#define NUM_CHURN 1000000
+#define NUM_SHORT_TIMEOUTS 1000
+#define MAX_SHORT_MSECS 200
+
+typedef struct _InfTestStandaloneIoTimeoutsShort
+  InfTestStandaloneIoTimeoutsShort;
+struct _InfTestStandaloneIoTimeoutsShort {
+  gint64 deadline;
+};
+
+static gint64 last_deadline;
+static guint n_fired;
+static gboolean result;
+
+static void
+long_timeout_func(gpointer user_data)
+{
+  /* None of the long timeouts elapses during the test */
+  printf("Long timeout fired\n");
+  result = FALSE;
+}
+
+static void
+short_timeout_func(gpointer user_data)
+{
+  InfTestStandaloneIoTimeoutsShort* timeout;
+  timeout = (InfTestStandaloneIoTimeoutsShort*)user_data;
+
+  if(g_get_monotonic_time() < timeout->deadline)
+  {
+    printf("Timeout fired before it elapsed\n");
+    result = FALSE;
+  }
+
+  /* Each timeout was scheduled slightly after its deadline was taken here,
+   * so allow timeouts with almost the same deadline to swap places. */
+  if(timeout->deadline + 1000 < last_deadline)
+  {
+    printf("Timeout fired after one with a later deadline\n");
+    result = FALSE;
+  }
+
+  last_deadline = timeout->deadline;
+  ++n_fired;
+}
+
+static InfIoTimeout*
+add_long_timeout(InfIo* io,
+                 GRand* rand)
+{
+  /* Between one and two minutes */
+  return inf_io_add_timeout(
+    io,
+    g_rand_int_range(rand, 60000, 120000),
+    long_timeout_func,
+    NULL,
+    NULL
+  );
+}
+
+int main(int argc, char* argv[])
+{
+  InfStandaloneIo* io;
+  InfIoTimeout** timeouts;
+  InfTestStandaloneIoTimeoutsShort* shorts;
+  GRand* rand;
+  GTimer* timer;
+  guint n_timeouts;
+  guint msecs;
+  guint i;
+  guint j;
+
+  n_timeouts = DEFAULT_TIMEOUTS;
+  if(argc > 1)
+    n_timeouts = atoi(argv[1]);
+  if(n_timeouts == 0)
+    n_timeouts = 1;
+
+  io = inf_standalone_io_new();
+  rand = g_rand_new_with_seed(0);
+  timer = g_timer_new();
+  timeouts = g_new(InfIoTimeout*, n_timeouts);
+  result = TRUE;
+
+  for(i = 0; i < n_timeouts; ++i)
+    timeouts[i] = add_long_timeout(INF_IO(io), rand);
+
+  printf(
+    "add    %8.3f usecs per timeout, %u timeouts\n",
+    g_timer_elapsed(timer, NULL) * 1e6 / n_timeouts,
+    n_timeouts
+  );
+
+  g_timer_start(timer);
+  for(i = 0; i < NUM_CHURN; ++i)
+  {
+    j = g_rand_int_range(rand, 0, n_timeouts);
+    inf_io_remove_timeout(INF_IO(io), timeouts[j]);
+    timeouts[j] = add_long_timeout(INF_IO(io), rand);
+  }
+
+  printf(
+    "churn  %8.3f usecs per removal and addition\n",
+    g_timer_elapsed(timer, NULL) * 1e6 / NUM_CHURN
+  );
+
+  shorts = g_new(InfTestStandaloneIoTimeoutsShort, NUM_SHORT_TIMEOUTS);
+  for(i = 0; i < NUM_SHORT_TIMEOUTS; ++i)
+  {
+    msecs = g_rand_int_range(rand, 0, MAX_SHORT_MSECS);
+    shorts[i].deadline = g_get_monotonic_time() + (gint64)msecs * 1000;
+
+    inf_io_add_timeout(
+      INF_IO(io),
+      msecs,
+      short_timeout_func,
+      &shorts[i],
+      NULL
+    );
+  }
+
+  last_deadline = 0;
+  n_fired = 0;
+
+  g_timer_start(timer);
+  while(result == TRUE && n_fired < NUM_SHORT_TIMEOUTS &&
+        g_timer_elapsed(timer, NULL) < 10.0)
+  {
+    inf_standalone_io_iteration_timeout(io, 1000);
+  }
+
+  if(result == TRUE && n_fired < NUM_SHORT_TIMEOUTS)
+  {
+    printf("Only %u of %u timeouts fired\n", n_fired, NUM_SHORT_TIMEOUTS);
+    result = FALSE;
+  }
+
+  if(result == TRUE)
+    printf("%u short timeouts fired in order\n", n_fired);
+
+  g_timer_start(timer);
+  for(i = 0; i < n_timeouts; ++i)
+    inf_io_remove_timeout(INF_IO(io), timeouts[i]);
+
+  printf(
+    "remove %8.3f usecs per timeout\n",
+    g_timer_elapsed(timer, NULL) * 1e6 / n_timeouts
+  );
+
+  g_free(shorts);
+  g_free(timeouts);
+  g_timer_destroy(timer);
+  g_rand_free(rand);
+  g_object_unref(io);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,305 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Opens a number of loopback TCP connections (1000 by default, or the
+ * number given as argument) and watches one end of each of them with an
+ * InfStandaloneIo, once using poll() and once using epoll. Then sends a
+ * single byte over randomly chosen connections, one at a time, and prints
+ * the average time until the watch callback runs and the CPU time used per
+ * event. Verifies that each byte is reported to the right watch. */
+
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-io.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#define DEFAULT_CONNECTIONS 1000
+#define NUM_EVENTS 20000
+
+typedef struct _InfTestStandaloneIo InfTestStandaloneIo;
+struct _InfTestStandaloneIo {
+  guint n_connections;
+  InfNativeSocket* server_sockets;
+  InfNativeSocket* client_sockets;
+
+  guint expected;
+  gboolean received;
+  gboolean wrong;
+  gint64 received_time;
+};
+
+static InfTestStandaloneIo test;
+
+static void
+watch_func(InfNativeSocket* socket,
+           InfIoEvent event,
+           gpointer user_data)
+{
+  char buf[1];
+
+  if(GPOINTER_TO_UINT(user_data) != test.expected ||
+     (~event & INF_IO_INCOMING) ||
+     read(*socket, buf, 1) != 1)
+  {
+    test.wrong = TRUE;
+  }
+
+  test.received = TRUE;
+  test.received_time = g_get_monotonic_time();
+}
+
+static gboolean
+open_connections(guint n_connections)
+{
+  struct sockaddr_in addr;
+  socklen_t len;
+  InfNativeSocket listen_socket;
+  guint i;
+  int one;
+
+  listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+  if(listen_socket == -1)
+  {
+    fprintf(stderr, "socket() failed: %s\n", strerror(errno));
+    return FALSE;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  len = sizeof(addr);
+
+  if(bind(listen_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+     listen(listen_socket, 16) == -1 ||
+     getsockname(listen_socket, (struct sockaddr*)&addr, &len) == -1)
+  {
+    fprintf(stderr, "Failed to listen: %s\n", strerror(errno));
+    close(listen_socket);
+    return FALSE;
+  }
+
+  test.n_connections = n_connections;
+  test.server_sockets = g_new(InfNativeSocket, n_connections);
+  test.client_sockets = g_new(InfNativeSocket, n_connections);
+
+  one = 1;
+  for(i = 0; i < n_connections; ++i)
+  {
+    test.client_sockets[i] = socket(AF_INET, SOCK_STREAM, 0);
+    if(test.client_sockets[i] == -1 ||
+       connect(test.client_sockets[i], (struct sockaddr*)&addr, len) == -1)
+    {
+      fprintf(stderr, "Failed to connect: %s\n", strerror(errno));
+      break;
+    }
+
+    /* Send each byte right away, instead of waiting for the previous one
+     * to be acknowledged. */
+    setsockopt(
+      test.client_sockets[i],
+      IPPROTO_TCP,
+      TCP_NODELAY,
+      &one,
+      sizeof(one)
+    );
+
+    test.server_sockets[i] = accept(listen_socket, NULL, NULL);
+    if(test.server_sockets[i] == -1)
+    {
+      fprintf(stderr, "accept() failed: %s\n", strerror(errno));
+      close(test.client_sockets[i]);
+      break;
+    }
+  }
+
+  close(listen_socket);
+  if(i < n_connections)
+  {
+    test.n_connections = i;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+close_connections(void)
+{
+  guint i;
+
+  for(i = 0; i < test.n_connections; ++i)
+  {
+    close(test.server_sockets[i]);
+    close(test.client_sockets[i]);
+  }
+
+  g_free(test.server_sockets);
+  g_free(test.client_sockets);
+}
+
+static gdouble
+cpu_time(void)
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec +
+         usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+}
+
+static gboolean
+run(const gchar* backend,
+    GRand* rand)
+{
+  InfStandaloneIo* io;
+  InfIoWatch** watches;
+  gint64 sent_time;
+  gint64 latency;
+  gdouble cpu;
+  guint i;
+  gboolean result;
+
+  /* The backend is chosen when the InfStandaloneIo is created */
+  g_setenv("LIBINFINITY_STANDALONE_IO_BACKEND", backend, TRUE);
+  io = inf_standalone_io_new();
+
+  watches = g_new(InfIoWatch*, test.n_connections);
+  for(i = 0; i < test.n_connections; ++i)
+  {
+    watches[i] = inf_io_add_watch(
+      INF_IO(io),
+      &test.server_sockets[i],
+      INF_IO_INCOMING | INF_IO_ERROR,
+      watch_func,
+      GUINT_TO_POINTER(i),
+      NULL
+    );
+  }
+
+  result = TRUE;
+  latency = 0;
+  cpu = cpu_time();
+
+  for(i = 0; i < NUM_EVENTS && result == TRUE; ++i)
+  {
+    test.expected = g_rand_int_range(rand, 0, test.n_connections);
+    test.received = FALSE;
+    test.wrong = FALSE;
+
+    sent_time = g_get_monotonic_time();
+    if(write(test.client_sockets[test.expected], "c", 1) != 1)
+    {
+      fprintf(stderr, "write() failed: %s\n", strerror(errno));
+      result = FALSE;
+    }
+    else
+    {
+      inf_standalone_io_iteration_timeout(io, 1000);
+
+      if(test.received == FALSE)
+      {
+        fprintf(stderr, "%s: Event %u was not reported\n", backend, i);
+        result = FALSE;
+      }
+      else if(test.wrong == TRUE)
+      {
+        fprintf(stderr, "%s: Event %u was reported wrongly\n", backend, i);
+        result = FALSE;
+      }
+      else
+      {
+        latency += test.received_time - sent_time;
+      }
+    }
+  }
+
+  cpu = cpu_time() - cpu;
+
+  if(result == TRUE)
+  {
+    printf(
+      "%-6s %6u connections: latency %8.2f usecs, "
+      "CPU %8.2f usecs per event\n",
+      backend,
+      test.n_connections,
+      (gdouble)latency / NUM_EVENTS,
+      cpu / NUM_EVENTS
+    );
+  }
+
+  for(i = 0; i < test.n_connections; ++i)
+    inf_io_remove_watch(INF_IO(io), watches[i]);
+  g_free(watches);
+
+  g_object_unref(io);
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  struct rlimit limit;
+  guint n_connections;
+  GRand* rand;
+  gboolean result;
+
+  n_connections = DEFAULT_CONNECTIONS;
+  if(argc > 1)
+    n_connections = atoi(argv[1]);
+
+  /* Each connection needs two file descriptors */
+  if(getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+     limit.rlim_cur < 2 * n_connections + 32)
+  {
+    limit.rlim_cur = MIN(limit.rlim_max, 2 * n_connections + 32);
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  if(!open_connections(n_connections))
+  {
+    close_connections();
+    return -1;
+  }
+
+  rand = g_rand_new_with_seed(0);
+  result = run("poll", rand);
+  if(result == TRUE)
+    result = run("epoll", rand);
+
+  g_rand_free(rand);
+  close_connections();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
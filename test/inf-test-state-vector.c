@@ -36,7 +36,9 @@ static void cmp(const char* should_be, InfAdoptedStateVector* vec) {
   should_be_vec = inf_adopted_state_vector_from_string(should_be, NULL);
   if (!should_be_vec
       || inf_adopted_state_vector_compare(vec, should_be_vec) != 0
-      || inf_adopted_state_vector_compare(should_be_vec, vec) != 0) {
+      || inf_adopted_state_vector_compare(should_be_vec, vec) != 0
+      || inf_adopted_state_vector_hash(vec)
+         != inf_adopted_state_vector_hash(should_be_vec)) {
     printf("should be: %s\n"
            "is:        %s\n"
            "compare failed\n", should_be, is);
@@ -122,11 +124,80 @@ static void l_test() {
   vec  = apply(from_string, ("1:0;5:0", NULL));
   vec_ = apply(new, ());
   g_assert(apply(compare, (vec, vec_)) == 0);
+  g_assert(apply(hash, (vec)) == apply(hash, (vec_)));
 
   apply(free, (vec));
   apply(free, (vec_));
 }
 
+#define BENCH_USERS 32
+#define BENCH_ITERATIONS 200000
+
+typedef struct {
+  gint64 time;
+  guint result;
+} bench_result;
+
+static bench_result bench_run(InfAdoptedStateVector* first,
+                              InfAdoptedStateVector* second) {
+  bench_result res;
+  gint64 begin;
+  int i;
+
+  res.result = 0;
+  begin = g_get_monotonic_time();
+
+  for (i = 0; i < BENCH_ITERATIONS; ++i) {
+    res.result += apply(compare, (first, second)) + 1;
+    res.result += apply(causally_before, (first, second));
+    res.result += apply(causally_before_inc, (first, second, 1 + i % BENCH_USERS));
+    res.result += apply(vdiff, (first, second));
+  }
+
+  res.time = g_get_monotonic_time() - begin;
+  return res;
+}
+
+/* Compares the timing of the comparison functions for two vectors that
+ * contain exactly the same set of users, which allows component-wise
+ * comparison, with the timing for vectors that differ in one (zero-valued)
+ * component, which requires the general merge algorithm. The results have
+ * to be identical. */
+static void bench_test() {
+  InfAdoptedStateVector* vec, * vec_;
+  InfAdoptedStateVector* merge_vec, * merge_vec_;
+  bench_result same;
+  bench_result merge;
+  int i;
+
+  vec = apply(new, ());
+  vec_ = apply(new, ());
+
+  for (i = 1; i <= BENCH_USERS; ++i) {
+    apply(set, (vec, i, 100 + i));
+    apply(set, (vec_, i, 100 + i + (i % 3)));
+  }
+
+  merge_vec = apply(copy, (vec));
+  merge_vec_ = apply(copy, (vec_));
+  apply(set, (merge_vec, BENCH_USERS + 1, 0));
+
+  same = bench_run(vec, vec_);
+  merge = bench_run(merge_vec, merge_vec_);
+  g_assert(same.result == merge.result);
+
+  printf("%d users, %d iterations: same layout %.3fs, merge %.3fs "
+         "(speedup %.2fx)\n",
+         BENCH_USERS, BENCH_ITERATIONS,
+         same.time / 1e6, merge.time / 1e6,
+         same.time > 0 ? (double)merge.time / same.time : 0.0);
+
+  apply(free, (vec));
+  apply(free, (vec_));
+  apply(free, (merge_vec));
+  apply(free, (merge_vec_));
+}
+
 int main(int argc, char* argv[])
 {
   guint users[2];
@@ -158,6 +229,7 @@ int main(int argc, char* argv[])
 
   inf_adopted_state_vector_free(vec);
   l_test();
+  bench_test();
   return 0;
 }
 
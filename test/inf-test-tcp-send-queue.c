@@ -0,0 +1,607 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Opens a loopback TCP connection and sends data over it without running
+ * the event loop until the socket buffers are full and data is queued.
+ * Verifies that the regions reported by the "sent" signal exactly cover the
+ * data passed to the connection, in order, that the send queue size and
+ * length are consistent while the queue is flushed, and that large GBytes
+ * are sent from their own memory instead of being copied. Finally closes
+ * the connection from within a "sent" signal handler while data is still
+ * queued. */
+
+#include <libinfinity/server/infd-tcp-server.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-ip-address.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdio.h>
+
+/* Size of the pieces used to fill the socket buffers */
+#define FILL_SIZE 65536
+/* Give up if this much data can be sent without anything being queued */
+#define MAX_FILL_SIZE (256 * 1024 * 1024)
+/* Small enough to be copied into the send queue */
+#define SMALL_SIZE 100
+/* Give up if a test does not finish within this many seconds */
+#define TIMEOUT 30
+
+typedef struct _InfTestTcpSendQueue InfTestTcpSendQueue;
+struct _InfTestTcpSendQueue {
+  InfStandaloneIo* io;
+  InfdTcpServer* server;
+  InfTcpConnection* client;
+  InfTcpConnection* accepted;
+  GRand* rand;
+
+  /* Everything passed to the client connection, in order */
+  GByteArray* stream;
+  /* Amount of data reported with the "sent" signal and received by the
+   * accepted connection, respectively */
+  gsize sent;
+  gsize received;
+
+  /* Data sent with inf_tcp_connection_send_bytes() which should not be
+   * copied, and its position in the stream */
+  GBytes* bytes;
+  gsize bytes_offset;
+
+  gboolean close_in_sent;
+  guint sent_after_close;
+  gboolean failed;
+};
+
+static InfTcpConnectionStatus
+get_status(InfTcpConnection* connection)
+{
+  InfTcpConnectionStatus status;
+  g_object_get(G_OBJECT(connection), "status", &status, NULL);
+  return status;
+}
+
+static void
+fail(InfTestTcpSendQueue* test,
+     const gchar* message)
+{
+  if(!test->failed)
+    printf("%s\n", message);
+  test->failed = TRUE;
+}
+
+/* Checks that the send queue properties agree with the getters, and that
+ * every byte passed to the connection has either been reported as sent or
+ * is still queued. Only valid outside of a "sent" emission. */
+static void
+check_queue(InfTestTcpSendQueue* test)
+{
+  guint length;
+  guint64 size;
+
+  g_object_get(
+    G_OBJECT(test->client),
+    "send-queue-length", &length,
+    "send-queue-size", &size,
+    NULL
+  );
+
+  if(length != inf_tcp_connection_get_send_queue_length(test->client) ||
+     size != inf_tcp_connection_get_send_queue_size(test->client))
+  {
+    fail(test, "Send queue properties do not match the getters");
+  }
+
+  if(test->sent + size != test->stream->len)
+    fail(test, "Send queue size does not match the unsent data");
+
+  if((length == 0) != (size == 0))
+    fail(test, "Send queue length does not match its size");
+}
+
+static gboolean
+iterate(InfTestTcpSendQueue* test,
+        gint64 end_time)
+{
+  inf_standalone_io_iteration_timeout(test->io, 100);
+
+  if(g_get_monotonic_time() > end_time)
+    fail(test, "Timeout");
+
+  return !test->failed;
+}
+
+static guint8*
+append_data(InfTestTcpSendQueue* test,
+            gsize len)
+{
+  guint8* data;
+  gsize i;
+
+  data = g_malloc(len);
+  for(i = 0; i < len; ++i)
+    data[i] = g_rand_int_range(test->rand, 0, 256);
+
+  g_byte_array_append(test->stream, data, len);
+  return data;
+}
+
+static void
+send_data(InfTestTcpSendQueue* test,
+          gsize len)
+{
+  guint8* data;
+
+  data = append_data(test, len);
+  inf_tcp_connection_send(test->client, data, len);
+  g_free(data);
+}
+
+static void
+send_bytes(InfTestTcpSendQueue* test,
+           gsize len)
+{
+  GBytes* bytes;
+
+  bytes = g_bytes_new_take(append_data(test, len), len);
+  inf_tcp_connection_send_bytes(test->client, bytes);
+  g_bytes_unref(bytes);
+}
+
+/* Sends data until not all of it can be handed to the kernel anymore */
+static void
+fill(InfTestTcpSendQueue* test)
+{
+  gsize sent_before;
+  gsize len_before;
+
+  do
+  {
+    sent_before = test->sent;
+    len_before = test->stream->len;
+    send_data(test, FILL_SIZE);
+
+    if(test->stream->len > MAX_FILL_SIZE)
+    {
+      fail(test, "Sent data is never queued");
+      return;
+    }
+  } while(inf_tcp_connection_get_send_queue_size(test->client) == 0);
+
+  /* The last send was partial or was not sent at all, and nothing of it may
+   * have been reported before it was actually sent. */
+  if(test->sent - sent_before >= test->stream->len - len_before)
+    fail(test, "Queued data has been reported as sent");
+
+  check_queue(test);
+}
+
+static void
+client_sent_cb(InfTcpConnection* connection,
+               gconstpointer data,
+               guint len,
+               gpointer user_data)
+{
+  InfTestTcpSendQueue* test;
+  const guint8* bytes_data;
+  gsize bytes_len;
+
+  test = (InfTestTcpSendQueue*)user_data;
+
+  if(test->close_in_sent)
+  {
+    if(get_status(connection) == INF_TCP_CONNECTION_CLOSED)
+    {
+      ++test->sent_after_close;
+    }
+    else
+    {
+      inf_tcp_connection_close(connection);
+    }
+
+    return;
+  }
+
+  if(len == 0 || test->sent + len > test->stream->len)
+  {
+    fail(test, "Sent region exceeds the data passed to the connection");
+    return;
+  }
+
+  if(memcmp(data, test->stream->data + test->sent, len) != 0)
+  {
+    fail(test, "Sent region does not match the next data in the stream");
+    return;
+  }
+
+  /* Everything reported so far plus everything still queued must not
+   * exceed what was passed to the connection. The queue is already
+   * updated for the rest of the current emission. */
+  if(test->sent + len +
+     inf_tcp_connection_get_send_queue_size(connection) > test->stream->len)
+  {
+    fail(test, "Sent region is still counted in the send queue");
+  }
+
+  if(test->bytes != NULL)
+  {
+    bytes_data = g_bytes_get_data(test->bytes, &bytes_len);
+    if(test->sent < test->bytes_offset + bytes_len &&
+       test->sent + len > test->bytes_offset)
+    {
+      /* Regions are reported per queued chunk, so the whole region must
+       * lie inside the GBytes, at the position we expect. */
+      if(test->sent < test->bytes_offset ||
+         test->sent + len > test->bytes_offset + bytes_len ||
+         (const guint8*)data !=
+           bytes_data + (test->sent - test->bytes_offset))
+      {
+        fail(test, "Data sent with send_bytes() has been copied");
+      }
+    }
+  }
+
+  test->sent += len;
+}
+
+static void
+accepted_received_cb(InfTcpConnection* connection,
+                     gconstpointer data,
+                     guint len,
+                     gpointer user_data)
+{
+  InfTestTcpSendQueue* test;
+  test = (InfTestTcpSendQueue*)user_data;
+
+  if(test->received + len > test->stream->len ||
+     memcmp(data, test->stream->data + test->received, len) != 0)
+  {
+    fail(test, "Received data does not match the sent data");
+    return;
+  }
+
+  test->received += len;
+}
+
+static void
+error_cb(GObject* object,
+         GError* error,
+         gpointer user_data)
+{
+  InfTestTcpSendQueue* test;
+  test = (InfTestTcpSendQueue*)user_data;
+
+  printf("Error: %s\n", error->message);
+  test->failed = TRUE;
+}
+
+static void
+new_connection_cb(InfdTcpServer* server,
+                  InfTcpConnection* connection,
+                  gpointer user_data)
+{
+  InfTestTcpSendQueue* test;
+  test = (InfTestTcpSendQueue*)user_data;
+
+  if(test->accepted != NULL)
+  {
+    fail(test, "Unexpected second connection");
+    return;
+  }
+
+  test->accepted = connection;
+  g_object_ref(connection);
+
+  g_signal_connect(
+    G_OBJECT(connection),
+    "received",
+    G_CALLBACK(accepted_received_cb),
+    test
+  );
+
+  g_signal_connect(
+    G_OBJECT(connection),
+    "error",
+    G_CALLBACK(error_cb),
+    test
+  );
+}
+
+static gboolean
+test_connect(InfTestTcpSendQueue* test)
+{
+  InfIpAddress* address;
+  guint port;
+  gint64 end_time;
+  GError* error;
+
+  address = inf_ip_address_new_loopback4();
+
+  test->server = g_object_new(
+    INFD_TYPE_TCP_SERVER,
+    "io", test->io,
+    "local-address", address,
+    "local-port", 0,
+    NULL
+  );
+
+  g_signal_connect(
+    G_OBJECT(test->server),
+    "new-connection",
+    G_CALLBACK(new_connection_cb),
+    test
+  );
+
+  g_signal_connect(
+    G_OBJECT(test->server),
+    "error",
+    G_CALLBACK(error_cb),
+    test
+  );
+
+  error = NULL;
+  if(!infd_tcp_server_open(test->server, &error))
+  {
+    printf("Failed to open server: %s\n", error->message);
+    g_error_free(error);
+    inf_ip_address_free(address);
+    return FALSE;
+  }
+
+  g_object_get(G_OBJECT(test->server), "local-port", &port, NULL);
+
+  test->client = inf_tcp_connection_new_and_open(
+    INF_IO(test->io),
+    address,
+    port,
+    &error
+  );
+
+  inf_ip_address_free(address);
+
+  if(test->client == NULL)
+  {
+    printf("Failed to connect: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  g_signal_connect(
+    G_OBJECT(test->client),
+    "sent",
+    G_CALLBACK(client_sent_cb),
+    test
+  );
+
+  g_signal_connect(
+    G_OBJECT(test->client),
+    "error",
+    G_CALLBACK(error_cb),
+    test
+  );
+
+  end_time = g_get_monotonic_time() + TIMEOUT * G_TIME_SPAN_SECOND;
+  while(test->accepted == NULL ||
+        get_status(test->client) != INF_TCP_CONNECTION_CONNECTED)
+  {
+    if(!iterate(test, end_time))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+test_partial_sends(InfTestTcpSendQueue* test)
+{
+  guint length;
+  guint64 size;
+  gint64 end_time;
+
+  fill(test);
+
+  /* The remainder of the last fill might leave room in its chunk. A full
+   * piece does not fit there and is queued as a chunk without room to
+   * spare, so the next small piece needs a new chunk, and the one after
+   * that can be appended to it. */
+  send_data(test, FILL_SIZE);
+  check_queue(test);
+  if(test->failed) return FALSE;
+
+  length = inf_tcp_connection_get_send_queue_length(test->client);
+  size = inf_tcp_connection_get_send_queue_size(test->client);
+
+  send_data(test, SMALL_SIZE);
+  send_data(test, SMALL_SIZE);
+  check_queue(test);
+
+  if(inf_tcp_connection_get_send_queue_length(test->client) != length + 1 ||
+     inf_tcp_connection_get_send_queue_size(test->client) !=
+     size + 2 * SMALL_SIZE)
+  {
+    fail(test, "Small pieces of data are not merged in the send queue");
+  }
+
+  /* Large GBytes are queued by reference, as a chunk of their own */
+  test->bytes_offset = test->stream->len;
+  test->bytes = g_bytes_new_take(
+    append_data(test, FILL_SIZE),
+    FILL_SIZE
+  );
+
+  inf_tcp_connection_send_bytes(test->client, test->bytes);
+  check_queue(test);
+
+  if(inf_tcp_connection_get_send_queue_length(test->client) != length + 2)
+    fail(test, "GBytes is not queued as a chunk of its own");
+
+  /* Small GBytes are copied, after the large one into a new chunk */
+  send_bytes(test, SMALL_SIZE);
+  send_bytes(test, SMALL_SIZE);
+  check_queue(test);
+
+  if(inf_tcp_connection_get_send_queue_length(test->client) != length + 3)
+    fail(test, "Small GBytes are not merged in the send queue");
+
+  if(test->failed) return FALSE;
+
+  /* Let the receiving end drain the socket, until all data is through */
+  end_time = g_get_monotonic_time() + TIMEOUT * G_TIME_SPAN_SECOND;
+  while(test->received < test->stream->len ||
+        test->sent < test->stream->len)
+  {
+    if(!iterate(test, end_time))
+      return FALSE;
+    check_queue(test);
+  }
+
+  if(inf_tcp_connection_get_send_queue_length(test->client) != 0)
+    fail(test, "Send queue is not empty after all data has been sent");
+
+  g_bytes_unref(test->bytes);
+  test->bytes = NULL;
+
+  return !test->failed;
+}
+
+static gboolean
+test_close_in_sent(InfTestTcpSendQueue* test)
+{
+  gint64 end_time;
+  guint i;
+
+  fill(test);
+  if(test->failed) return FALSE;
+
+  /* Queue several chunks, so that a single send call can cover more than
+   * one of them, and the connection is closed in the middle of reporting
+   * them. */
+  for(i = 0; i < 8; ++i)
+    send_bytes(test, 4 * 1024);
+  check_queue(test);
+  if(test->failed) return FALSE;
+
+  test->close_in_sent = TRUE;
+
+  end_time = g_get_monotonic_time() + TIMEOUT * G_TIME_SPAN_SECOND;
+  while(get_status(test->client) != INF_TCP_CONNECTION_CLOSED)
+  {
+    if(!iterate(test, end_time))
+      return FALSE;
+  }
+
+  if(test->sent_after_close > 0)
+    fail(test, "Sent signal emitted after the connection was closed");
+
+  if(inf_tcp_connection_get_send_queue_length(test->client) != 0 ||
+     inf_tcp_connection_get_send_queue_size(test->client) != 0)
+  {
+    fail(test, "Send queue is not empty after closing the connection");
+  }
+
+  return !test->failed;
+}
+
+int main(int argc, char* argv[])
+{
+  InfTestTcpSendQueue test;
+  GError* error;
+  int result;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  test.io = inf_standalone_io_new();
+  test.server = NULL;
+  test.client = NULL;
+  test.accepted = NULL;
+  test.rand = g_rand_new_with_seed(42);
+  test.stream = g_byte_array_new();
+  test.sent = 0;
+  test.received = 0;
+  test.bytes = NULL;
+  test.bytes_offset = 0;
+  test.close_in_sent = FALSE;
+  test.sent_after_close = 0;
+  test.failed = FALSE;
+
+  result = 0;
+  if(!test_connect(&test))
+  {
+    result = -1;
+  }
+  else
+  {
+    if(test_partial_sends(&test))
+    {
+      printf(
+        "Partial sends: PASSED (%u bytes)\n",
+        (guint)test.stream->len
+      );
+    }
+    else
+    {
+      result = -1;
+    }
+
+    if(result == 0)
+    {
+      if(test_close_in_sent(&test))
+        printf("Close in sent handler: PASSED\n");
+      else
+        result = -1;
+    }
+  }
+
+  if(test.bytes != NULL)
+    g_bytes_unref(test.bytes);
+  if(test.client != NULL)
+  {
+    if(get_status(test.client) != INF_TCP_CONNECTION_CLOSED)
+      inf_tcp_connection_close(test.client);
+
+    g_object_unref(test.client);
+  }
+
+  if(test.accepted != NULL)
+  {
+    if(get_status(test.accepted) != INF_TCP_CONNECTION_CLOSED)
+      inf_tcp_connection_close(test.accepted);
+
+    g_object_unref(test.accepted);
+  }
+
+  if(test.server != NULL)
+  {
+    infd_tcp_server_close(test.server);
+    g_object_unref(test.server);
+  }
+
+  g_byte_array_free(test.stream, TRUE);
+  g_rand_free(test.rand);
+  g_object_unref(test.io);
+  return result;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,336 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Generates a long history of concurrent insertions by several users, and
+ * delivers it to a session in many different orders. Only the order of the
+ * requests of each single user is kept, so most requests arrive before the
+ * requests of other users they depend on, and need to be buffered by the
+ * session until they can be executed. At the end, the buffer must have the
+ * same content as when delivering all requests in causal order. */
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <time.h>
+
+#define NUM_USERS 5
+#define NUM_REQUESTS 4000
+#define NUM_PERMUTATIONS 10
+
+/* Maximum number of requests a user is behind when issuing a request. This
+ * limits the amount of concurrency, and with it the cost of transformation,
+ * but not the amount of buffering. */
+#define MAX_LAG 64
+
+typedef struct {
+  /* Request XML, in causal order */
+  xmlNodePtr requests[NUM_REQUESTS];
+  /* User index of each request */
+  guint users[NUM_REQUESTS];
+} test_history;
+
+static void
+generate_history(test_history* history,
+                 GRand* rand)
+{
+  /* prefix[t * NUM_USERS + v] is the number of requests of user v among
+   * the first t requests. */
+  guint* prefix;
+  /* Each user has seen the first seen[u] requests, plus its own ones */
+  guint seen[NUM_USERS];
+  guint count[NUM_USERS];
+  InfAdoptedStateVector* base[NUM_USERS];
+
+  InfAdoptedStateVector* vector;
+  xmlNodePtr xml;
+  xmlNodePtr child;
+  gchar* time_str;
+  gchar text[2];
+  guint length;
+  guint low;
+  guint n;
+  guint i;
+  guint u;
+  guint v;
+
+  prefix = g_malloc0(sizeof(guint) * (NUM_REQUESTS + 1) * NUM_USERS);
+  for(u = 0; u < NUM_USERS; ++u)
+  {
+    seen[u] = 0;
+    count[u] = 0;
+    base[u] = inf_adopted_state_vector_new();
+  }
+
+  for(i = 0; i < NUM_REQUESTS; ++i)
+  {
+    u = g_rand_int_range(rand, 0, NUM_USERS);
+
+    /* Let the user catch up with some of the requests issued so far. Any
+     * prefix of the history together with the user's own requests is a
+     * state that is causally closed. */
+    low = MAX(seen[u], i > MAX_LAG ? i - MAX_LAG : 0);
+    seen[u] = g_rand_int_range(rand, low, i + 1);
+
+    vector = inf_adopted_state_vector_new();
+    length = 0;
+
+    for(v = 0; v < NUM_USERS; ++v)
+    {
+      if(v == u)
+        n = count[u];
+      else
+        n = prefix[seen[u] * NUM_USERS + v];
+
+      inf_adopted_state_vector_set(vector, v + 1, n);
+      length += n;
+    }
+
+    time_str = inf_adopted_state_vector_to_string_diff(vector, base[u]);
+    text[0] = 'a' + u;
+    text[1] = '\0';
+
+    xml = xmlNewNode(NULL, (const xmlChar*)"request");
+    inf_xml_util_set_attribute(xml, "time", time_str);
+    inf_xml_util_set_attribute_uint(xml, "user", u + 1);
+
+    child = xmlNewChild(xml, NULL, (const xmlChar*)"insert", NULL);
+    inf_xml_util_set_attribute_uint(
+      child,
+      "pos",
+      g_rand_int_range(rand, 0, length + 1)
+    );
+    xmlNodeAddContent(child, (const xmlChar*)text);
+
+    g_free(time_str);
+
+    /* The session sets the user's vector to the vector of the request, plus
+     * the request itself, and sends the next vector as diff to this. */
+    inf_adopted_state_vector_add(vector, u + 1, 1);
+    inf_adopted_state_vector_free(base[u]);
+    base[u] = vector;
+
+    history->requests[i] = xml;
+    history->users[i] = u;
+
+    ++count[u];
+    for(v = 0; v < NUM_USERS; ++v)
+    {
+      prefix[(i + 1) * NUM_USERS + v] =
+        prefix[i * NUM_USERS + v] + (v == u ? 1 : 0);
+    }
+  }
+
+  for(u = 0; u < NUM_USERS; ++u)
+    inf_adopted_state_vector_free(base[u]);
+  g_free(prefix);
+}
+
+/* Delivers the requests in the given order to a new session, and returns
+ * the resulting buffer content. */
+static InfTextChunk*
+deliver(xmlNodePtr* requests,
+        gdouble* time)
+{
+  InfTextBuffer* buffer;
+  InfCommunicationManager* manager;
+  InfIo* io;
+  InfTextSession* session;
+  InfUserTable* user_table;
+  InfTextUser* user;
+  gchar* user_name;
+  InfTextChunk* chunk;
+  GTimer* timer;
+  guint i;
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  manager = inf_communication_manager_new();
+  io = INF_IO(inf_standalone_io_new());
+  user_table = inf_user_table_new();
+
+  for(i = 0; i < NUM_USERS; ++i)
+  {
+    user_name = g_strdup_printf("User_%u", i + 1);
+
+    user = INF_TEXT_USER(
+      g_object_new(
+        INF_TEXT_TYPE_USER,
+        "id", i + 1,
+        "name", user_name,
+        "status", INF_USER_ACTIVE,
+        "flags", 0,
+        NULL
+      )
+    );
+
+    g_free(user_name);
+    inf_user_table_add_user(user_table, INF_USER(user));
+    g_object_unref(user);
+  }
+
+  session = inf_text_session_new_with_user_table(
+    manager,
+    buffer,
+    io,
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(io);
+  g_object_unref(manager);
+  g_object_unref(user_table);
+
+  timer = g_timer_new();
+  for(i = 0; i < NUM_REQUESTS; ++i)
+  {
+    inf_communication_object_received(
+      INF_COMMUNICATION_OBJECT(session),
+      NULL,
+      requests[i]
+    );
+  }
+
+  *time = g_timer_elapsed(timer, NULL);
+  g_timer_destroy(timer);
+
+  chunk = inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+
+  g_object_unref(session);
+  g_object_unref(buffer);
+  return chunk;
+}
+
+int main(int argc, char* argv[])
+{
+  GError* error;
+  GRand* rand;
+  unsigned int rseed;
+  test_history history;
+  xmlNodePtr permutation[NUM_REQUESTS];
+  guint order[NUM_REQUESTS];
+  guint next[NUM_USERS];
+  guint user_requests[NUM_USERS][NUM_REQUESTS];
+  InfTextChunk* reference;
+  InfTextChunk* chunk;
+  gdouble elapsed;
+  gboolean result;
+  guint i;
+  guint j;
+  guint k;
+  guint temp;
+
+  if(argc > 1)
+    rseed = atoi(argv[1]);
+  else
+    rseed = time(NULL);
+
+  printf("Using random seed %u\n", rseed);
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    return 1;
+  }
+
+  rand = g_rand_new_with_seed(rseed);
+  generate_history(&history, rand);
+
+  for(i = 0; i < NUM_USERS; ++i)
+    next[i] = 0;
+  for(i = 0; i < NUM_REQUESTS; ++i)
+    user_requests[history.users[i]][next[history.users[i]]++] = i;
+
+  printf("Causal order... ");
+  fflush(stdout);
+
+  reference = deliver(history.requests, &elapsed);
+  printf("%g secs\n", elapsed);
+
+  result = TRUE;
+  if(inf_text_chunk_get_length(reference) != NUM_REQUESTS)
+  {
+    printf("Not all requests have been executed\n");
+    result = FALSE;
+  }
+
+  for(i = 0; i < NUM_PERMUTATIONS && result == TRUE; ++i)
+  {
+    /* Shuffle the sequence of users, and then deliver the requests of each
+     * user in their original order in the shuffled sequence. */
+    for(j = 0; j < NUM_REQUESTS; ++j)
+      order[j] = history.users[j];
+
+    for(j = NUM_REQUESTS - 1; j > 0; --j)
+    {
+      k = g_rand_int_range(rand, 0, j + 1);
+      temp = order[j];
+      order[j] = order[k];
+      order[k] = temp;
+    }
+
+    for(j = 0; j < NUM_USERS; ++j)
+      next[j] = 0;
+    for(j = 0; j < NUM_REQUESTS; ++j)
+    {
+      permutation[j] =
+        history.requests[user_requests[order[j]][next[order[j]]++]];
+    }
+
+    printf("Permutation %u... ", i + 1);
+    fflush(stdout);
+
+    chunk = deliver(permutation, &elapsed);
+
+    if(inf_text_chunk_equal(chunk, reference))
+    {
+      printf("OK (%g secs)\n", elapsed);
+    }
+    else
+    {
+      printf("FAILED\n");
+      result = FALSE;
+    }
+
+    inf_text_chunk_free(chunk);
+  }
+
+  inf_text_chunk_free(reference);
+  for(i = 0; i < NUM_REQUESTS; ++i)
+    xmlFreeNode(history.requests[i]);
+  g_rand_free(rand);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -416,6 +416,9 @@ int main(int argc, char* argv[])
   const char* dir;
   GError* error;
   test_result result;
+  GTimer* timer;
+  gboolean retval;
+  gdouble elapsed;
 
   if(argc > 1)
     dir = argv[1];
@@ -432,15 +435,24 @@ int main(int argc, char* argv[])
   result.total = 0;
   result.passed = 0;
 
-  if(inf_test_util_dir_foreach(dir, foreach_test_func, &result, &error) ==
-     FALSE)
+  timer = g_timer_new();
+  retval = inf_test_util_dir_foreach(dir, foreach_test_func, &result, &error);
+
+  g_timer_stop(timer);
+  elapsed = g_timer_elapsed(timer, NULL);
+  g_timer_destroy(timer);
+
+  if(retval == FALSE)
   {
     fprintf(stderr, "%s\n", error->message);
     g_error_free(error);
     return -1;
   }
 
-  printf("%u out of %u tests passed\n", result.passed, result.total);
+  printf(
+    "%u out of %u tests passed (real %g secs)\n",
+    result.passed, result.total, elapsed
+  );
   if(result.passed < result.total)
     return -1;
 
@@ -0,0 +1,118 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Converts a stored text document into another storage format. The
+ * document is read in whatever format it has been stored, and written back
+ * to the same path in the requested one. */
+
+#include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-default-buffer.h>
+
+#include <string.h>
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+  InfdFilesystemStorage* storage;
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  GError* error;
+  gboolean checksum;
+  gboolean result;
+
+  if(argc < 4 || argc > 5 ||
+     (argc == 5 && strcmp(argv[4], "checksum") != 0) ||
+     (strcmp(argv[3], "xml") != 0 &&
+      strcmp(argv[3], "mappable") != 0 &&
+      strcmp(argv[3], "binary") != 0))
+  {
+    fprintf(
+      stderr,
+      "Usage: %s <root-directory> <path> <xml|mappable|binary> [checksum]\n",
+      argv[0]
+    );
+
+    return -1;
+  }
+
+  checksum = (argc == 5);
+
+  storage = infd_filesystem_storage_new(argv[1]);
+  user_table = inf_user_table_new();
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  error = NULL;
+  result = inf_text_filesystem_format_read(
+    storage,
+    argv[2],
+    user_table,
+    buffer,
+    &error
+  );
+
+  if(result == TRUE)
+  {
+    if(strcmp(argv[3], "xml") == 0)
+    {
+      result = inf_text_filesystem_format_write(
+        storage,
+        argv[2],
+        user_table,
+        buffer,
+        &error
+      );
+    }
+    else if(strcmp(argv[3], "mappable") == 0)
+    {
+      result = inf_text_filesystem_format_write_mappable(
+        storage,
+        argv[2],
+        user_table,
+        buffer,
+        &error
+      );
+    }
+    else
+    {
+      result = inf_text_filesystem_format_write_binary(
+        storage,
+        argv[2],
+        user_table,
+        buffer,
+        checksum,
+        &error
+      );
+    }
+  }
+
+  g_object_unref(buffer);
+  g_object_unref(user_table);
+  g_object_unref(storage);
+
+  if(result == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
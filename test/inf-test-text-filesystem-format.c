@@ -0,0 +1,491 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Writes a large document to a filesystem storage and reads it back, in
+ * the XML, the mappable and the binary format, and prints the throughput
+ * and the peak memory use of each step. The size of the document in
+ * megabytes can be given on the command line. Finally, verifies that
+ * mappable and binary documents whose text is not valid UTF-8 are
+ * rejected. */
+
+#include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-piece-buffer.h>
+#include <libinftext/inf-text-user.h>
+
+#include <glib/gstdio.h>
+
+#ifndef G_OS_WIN32
+# include <sys/resource.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define NUM_AUTHORS 4
+#define SEGMENT_CHARS 65536
+
+/* Characters of different UTF-8 lengths that make up the text. The form
+ * feed is not valid in XML and needs to be escaped. */
+static const gchar* const test_chars[] = {
+  "a", "b", " ", "\n", "<", "&", "\f", "\xc3\xbc", "\xe2\x82\xac"
+};
+
+/* Returns the peak resident set size of the process in kilobytes */
+static glong
+peak_rss(void)
+{
+#ifndef G_OS_WIN32
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return -1;
+}
+
+static void
+report(const gchar* step,
+       const gchar* full_path,
+       GTimer* timer)
+{
+  GStatBuf buf;
+  gdouble elapsed;
+
+  elapsed = g_timer_elapsed(timer, NULL);
+  if(g_stat(full_path, &buf) != 0)
+    buf.st_size = 0;
+
+  printf(
+    "%-16s %8.3f secs, %8.1f MB/s, peak RSS %ld KB\n",
+    step,
+    elapsed,
+    buf.st_size / elapsed / (1024 * 1024),
+    peak_rss()
+  );
+}
+
+static InfTextBuffer*
+create_document(InfUserTable* user_table,
+                gsize size)
+{
+  InfTextBuffer* buffer;
+  InfUser* users[NUM_AUTHORS];
+  GString* str;
+  gchar* name;
+  gsize bytes;
+  guint chars;
+  guint i;
+
+  for(i = 0; i < NUM_AUTHORS; ++i)
+  {
+    name = g_strdup_printf("User %u", i + 1);
+    users[i] = INF_USER(inf_text_user_new(i + 1, name, NULL, 0.1 * i));
+    inf_user_table_add_user(user_table, users[i]);
+    g_free(name);
+  }
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  str = g_string_sized_new(SEGMENT_CHARS * 2);
+
+  for(i = 0, bytes = 0; bytes < size || i == 0; ++i, bytes += str->len)
+  {
+    g_string_truncate(str, 0);
+    for(chars = 0; chars < SEGMENT_CHARS; ++chars)
+      g_string_append(str, test_chars[rand() % G_N_ELEMENTS(test_chars)]);
+
+    inf_text_buffer_insert_text(
+      buffer,
+      inf_text_buffer_get_length(buffer),
+      str->str,
+      str->len,
+      SEGMENT_CHARS,
+      users[i % NUM_AUTHORS]
+    );
+  }
+
+  g_string_free(str, TRUE);
+  for(i = 0; i < NUM_AUTHORS; ++i)
+    g_object_unref(users[i]);
+
+  return buffer;
+}
+
+static gboolean
+compare_files(const gchar* first,
+              const gchar* second)
+{
+  FILE* first_file;
+  FILE* second_file;
+  gchar first_buf[4096];
+  gchar second_buf[4096];
+  gsize first_len;
+  gsize second_len;
+  gboolean result;
+
+  first_file = fopen(first, "rb");
+  second_file = fopen(second, "rb");
+  result = first_file != NULL && second_file != NULL;
+
+  while(result == TRUE)
+  {
+    first_len = fread(first_buf, 1, sizeof(first_buf), first_file);
+    second_len = fread(second_buf, 1, sizeof(second_buf), second_file);
+
+    if(first_len != second_len ||
+       memcmp(first_buf, second_buf, first_len) != 0)
+    {
+      result = FALSE;
+    }
+
+    if(first_len < sizeof(first_buf))
+      break;
+  }
+
+  if(first_file != NULL) fclose(first_file);
+  if(second_file != NULL) fclose(second_file);
+  return result;
+}
+
+/* Overwrites the last byte of the file at full_path, which belongs to the
+ * text of the document, with a byte that cannot occur in UTF-8, and checks
+ * that reading the document into buffer fails. Takes ownership of
+ * buffer. */
+static gboolean
+check_corrupted(InfdFilesystemStorage* storage,
+                const gchar* path,
+                const gchar* full_path,
+                InfTextBuffer* buffer)
+{
+  FILE* file;
+  InfUserTable* user_table;
+  GError* error;
+  gboolean result;
+
+  file = fopen(full_path, "r+b");
+  if(file == NULL)
+  {
+    fprintf(stderr, "Failed to open %s\n", full_path);
+    g_object_unref(buffer);
+    return FALSE;
+  }
+
+  result = fseek(file, -1, SEEK_END) == 0 && fputc(0xff, file) != EOF;
+  if(fclose(file) != 0 || result == FALSE)
+  {
+    fprintf(stderr, "Failed to modify %s\n", full_path);
+    g_object_unref(buffer);
+    return FALSE;
+  }
+
+  user_table = inf_user_table_new();
+  error = NULL;
+
+  result = inf_text_filesystem_format_read(
+    storage,
+    path,
+    user_table,
+    buffer,
+    &error
+  );
+
+  g_object_unref(user_table);
+  g_object_unref(buffer);
+
+  if(result == TRUE)
+  {
+    fprintf(stderr, "Document with invalid text was read\n");
+    return FALSE;
+  }
+
+  result = g_error_matches(
+    error,
+    g_quark_from_static_string("INF_TEXT_FILESYSTEM_FORMAT_ERROR"),
+    INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_PAYLOAD
+  );
+
+  if(result == FALSE)
+    fprintf(stderr, "Unexpected error: %s\n", error->message);
+
+  g_error_free(error);
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  InfdFilesystemStorage* storage;
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  GTimer* timer;
+  GError* error;
+  gchar* directory;
+  gchar* document;
+  gchar* copy;
+  gchar* mapped;
+  gchar* mapped_copy;
+  gchar* binary;
+  gchar* binary_copy;
+  gchar* binary_plain;
+  gsize size;
+  gboolean result;
+
+  size = 100;
+  if(argc > 1)
+    size = atoi(argv[1]);
+
+  error = NULL;
+  directory = g_dir_make_tmp(
+    "inf-test-text-filesystem-format-XXXXXX",
+    &error
+  );
+
+  if(directory == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  storage = infd_filesystem_storage_new(directory);
+  document = g_build_filename(directory, "document.InfText", NULL);
+  copy = g_build_filename(directory, "copy.InfText", NULL);
+  mapped = g_build_filename(directory, "mapped.InfText", NULL);
+  mapped_copy = g_build_filename(directory, "mapped-copy.InfText", NULL);
+  binary = g_build_filename(directory, "binary.InfText", NULL);
+  binary_copy = g_build_filename(directory, "binary-copy.InfText", NULL);
+  binary_plain = g_build_filename(directory, "binary-plain.InfText", NULL);
+
+  user_table = inf_user_table_new();
+  buffer = create_document(user_table, size * 1024 * 1024);
+  printf(
+    "Document of %u characters, peak RSS %ld KB\n",
+    inf_text_buffer_get_length(buffer),
+    peak_rss()
+  );
+
+  timer = g_timer_new();
+
+  result = inf_text_filesystem_format_write(
+    storage,
+    "/document",
+    user_table,
+    buffer,
+    &error
+  );
+
+  if(result == TRUE) report("write", document, timer);
+
+  g_object_unref(buffer);
+  g_object_unref(user_table);
+
+  if(result == TRUE)
+  {
+    /* Read into a new buffer, and write it out again, which should yield
+     * the very same file. */
+    user_table = inf_user_table_new();
+    buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+    g_timer_start(timer);
+    result = inf_text_filesystem_format_read(
+      storage,
+      "/document",
+      user_table,
+      buffer,
+      &error
+    );
+
+    if(result == TRUE) report("read", document, timer);
+
+    if(result == TRUE)
+    {
+      result = inf_text_filesystem_format_write(
+        storage,
+        "/copy",
+        user_table,
+        buffer,
+        &error
+      );
+    }
+
+    if(result == TRUE)
+    {
+      g_timer_start(timer);
+      result = inf_text_filesystem_format_write_mappable(
+        storage,
+        "/mapped",
+        user_table,
+        buffer,
+        &error
+      );
+
+      if(result == TRUE) report("write mappable", mapped, timer);
+    }
+
+    if(result == TRUE)
+    {
+      g_timer_start(timer);
+      result = inf_text_filesystem_format_write_binary(
+        storage,
+        "/binary",
+        user_table,
+        buffer,
+        TRUE,
+        &error
+      );
+
+      if(result == TRUE) report("write binary", binary, timer);
+    }
+
+    if(result == TRUE)
+    {
+      result = inf_text_filesystem_format_write_binary(
+        storage,
+        "/binary-plain",
+        user_table,
+        buffer,
+        FALSE,
+        &error
+      );
+    }
+
+    g_object_unref(buffer);
+    g_object_unref(user_table);
+  }
+
+  if(result == TRUE)
+  {
+    user_table = inf_user_table_new();
+    buffer = INF_TEXT_BUFFER(inf_text_piece_buffer_new());
+
+    g_timer_start(timer);
+    result = inf_text_filesystem_format_read(
+      storage,
+      "/mapped",
+      user_table,
+      buffer,
+      &error
+    );
+
+    if(result == TRUE) report("read mappable", mapped, timer);
+
+    if(result == TRUE)
+    {
+      result = inf_text_filesystem_format_write(
+        storage,
+        "/mapped-copy",
+        user_table,
+        buffer,
+        &error
+      );
+    }
+
+    g_object_unref(buffer);
+    g_object_unref(user_table);
+  }
+
+  if(result == TRUE)
+  {
+    user_table = inf_user_table_new();
+    buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+    g_timer_start(timer);
+    result = inf_text_filesystem_format_read(
+      storage,
+      "/binary",
+      user_table,
+      buffer,
+      &error
+    );
+
+    if(result == TRUE) report("read binary", binary, timer);
+
+    if(result == TRUE)
+    {
+      result = inf_text_filesystem_format_write(
+        storage,
+        "/binary-copy",
+        user_table,
+        buffer,
+        &error
+      );
+    }
+
+    g_object_unref(buffer);
+    g_object_unref(user_table);
+  }
+
+  if(error != NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+  else if(!compare_files(document, copy) ||
+          !compare_files(document, mapped_copy) ||
+          !compare_files(document, binary_copy))
+  {
+    fprintf(stderr, "Document changed after being written and read\n");
+    result = FALSE;
+  }
+
+  if(result == TRUE)
+  {
+    result = check_corrupted(
+      storage,
+      "/mapped",
+      mapped,
+      INF_TEXT_BUFFER(inf_text_piece_buffer_new())
+    );
+  }
+
+  if(result == TRUE)
+  {
+    result = check_corrupted(
+      storage,
+      "/binary-plain",
+      binary_plain,
+      INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"))
+    );
+  }
+
+  g_unlink(document);
+  g_unlink(copy);
+  g_unlink(mapped);
+  g_unlink(mapped_copy);
+  g_unlink(binary);
+  g_unlink(binary_copy);
+  g_unlink(binary_plain);
+  g_rmdir(directory);
+
+  g_timer_destroy(timer);
+  g_object_unref(storage);
+  g_free(document);
+  g_free(copy);
+  g_free(mapped);
+  g_free(mapped_copy);
+  g_free(binary);
+  g_free(binary_copy);
+  g_free(binary_plain);
+  g_free(directory);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
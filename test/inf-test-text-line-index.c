@@ -0,0 +1,252 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Performs random insertions and deletions on an InfTextDefaultBuffer and
+ * checks after each of them that an InfTextLineIndex on the buffer agrees
+ * with the lines found by scanning the whole buffer. */
+
+#include <libinftext/inf-text-line-index.h>
+#include <libinftext/inf-text-default-buffer.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_OPERATIONS 5000
+#define MAX_INSERT_CHARS 20
+#define MAX_ERASE_CHARS 30
+
+/* Newlines are frequent, so that there are many lines and often several
+ * empty lines at the end of the buffer. */
+static const gchar* const test_chars[] = {
+  "a", "b", "\n", "\n", "\n", "\xc3\xbc", "\xe2\x80\xa8"
+};
+
+static gboolean
+check_index(InfTextLineIndex* index,
+            InfTextBuffer* buffer)
+{
+  InfTextChunk* chunk;
+  gchar* text;
+  gsize bytes;
+  GArray* offsets;
+  guint length;
+  guint n_lines;
+  guint trailing;
+  guint offset;
+  guint line_length;
+  guint line;
+  guint column;
+  guint i;
+  const gchar* pos;
+  gboolean result;
+
+  length = inf_text_buffer_get_length(buffer);
+  chunk = inf_text_buffer_get_slice(buffer, 0, length);
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  inf_text_chunk_free(chunk);
+
+  /* Collect the offset at which each line starts */
+  offsets = g_array_new(FALSE, FALSE, sizeof(guint));
+  offset = 0;
+  g_array_append_val(offsets, offset);
+
+  for(pos = text, i = 0; pos != text + bytes; pos = g_utf8_next_char(pos))
+  {
+    ++i;
+    if(*pos == '\n')
+    {
+      offset = i;
+      g_array_append_val(offsets, offset);
+    }
+  }
+
+  trailing = 0;
+  for(pos = text + bytes; pos != text && pos[-1] == '\n'; --pos)
+    ++trailing;
+
+  result = TRUE;
+  n_lines = offsets->len;
+
+  if(inf_text_line_index_get_n_lines(index) != n_lines)
+  {
+    printf(
+      "Index has %u lines instead of %u\n",
+      inf_text_line_index_get_n_lines(index),
+      n_lines
+    );
+
+    result = FALSE;
+  }
+  else if(inf_text_line_index_get_trailing_newlines(index) != trailing)
+  {
+    printf(
+      "Index has %u trailing newlines instead of %u\n",
+      inf_text_line_index_get_trailing_newlines(index),
+      trailing
+    );
+
+    result = FALSE;
+  }
+
+  for(line = 0; result == TRUE && line < n_lines; ++line)
+  {
+    offset = g_array_index(offsets, guint, line);
+    if(line + 1 < n_lines)
+      line_length = g_array_index(offsets, guint, line + 1) - offset - 1;
+    else
+      line_length = length - offset;
+
+    if(inf_text_line_index_get_line_offset(index, line) != offset ||
+       inf_text_line_index_get_line_length(index, line) != line_length)
+    {
+      printf("Line %u has wrong offset or length\n", line);
+      result = FALSE;
+    }
+
+    for(i = 0; result == TRUE && i <= line_length; ++i)
+    {
+      if(inf_text_line_index_get_line_at_offset(index, offset + i, &column) !=
+         line || column != i)
+      {
+        printf("Offset %u maps to the wrong line or column\n", offset + i);
+        result = FALSE;
+      }
+    }
+  }
+
+  g_array_free(offsets, TRUE);
+  g_free(text);
+  return result;
+}
+
+static void
+random_insert(InfTextBuffer* buffer,
+              GRand* rand)
+{
+  GString* str;
+  guint chars;
+  guint i;
+
+  str = g_string_sized_new(MAX_INSERT_CHARS * 3);
+  chars = g_rand_int_range(rand, 1, MAX_INSERT_CHARS + 1);
+
+  for(i = 0; i < chars; ++i)
+  {
+    g_string_append(
+      str,
+      test_chars[g_rand_int_range(rand, 0, G_N_ELEMENTS(test_chars))]
+    );
+  }
+
+  inf_text_buffer_insert_text(
+    buffer,
+    g_rand_int_range(rand, 0, inf_text_buffer_get_length(buffer) + 1),
+    str->str,
+    str->len,
+    chars,
+    NULL
+  );
+
+  g_string_free(str, TRUE);
+}
+
+static void
+random_erase(InfTextBuffer* buffer,
+             GRand* rand)
+{
+  guint length;
+  guint pos;
+  guint len;
+
+  length = inf_text_buffer_get_length(buffer);
+  if(length == 0) return;
+
+  pos = g_rand_int_range(rand, 0, length);
+  len = g_rand_int_range(rand, 1, MIN(length - pos, MAX_ERASE_CHARS) + 1);
+  inf_text_buffer_erase_text(buffer, pos, len, NULL);
+}
+
+int main(int argc, char* argv[])
+{
+  InfTextBuffer* buffer;
+  InfTextLineIndex* index;
+  InfTextLineIndex* scanned;
+  GRand* rand;
+  unsigned int rseed;
+  gboolean result;
+  guint i;
+
+  if(argc > 1)
+    rseed = atoi(argv[1]);
+  else
+    rseed = time(NULL);
+
+  printf("Using random seed %u\n", rseed);
+
+  rand = g_rand_new_with_seed(rseed);
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  index = inf_text_line_index_new(buffer);
+
+  result = check_index(index, buffer);
+  for(i = 0; result == TRUE && i < NUM_OPERATIONS; ++i)
+  {
+    /* Insert a bit more often than erasing so that the buffer grows */
+    if(g_rand_int_range(rand, 0, 5) < 3)
+      random_insert(buffer, rand);
+    else
+      random_erase(buffer, rand);
+
+    result = check_index(index, buffer);
+  }
+
+  if(result == TRUE)
+  {
+    /* An index created for a non-empty buffer needs to scan it */
+    scanned = inf_text_line_index_new(buffer);
+    result = check_index(scanned, buffer);
+    g_object_unref(scanned);
+  }
+
+  if(result == TRUE && inf_text_buffer_get_length(buffer) > 0)
+  {
+    inf_text_buffer_erase_text(
+      buffer,
+      0,
+      inf_text_buffer_get_length(buffer),
+      NULL
+    );
+
+    result = check_index(index, buffer);
+  }
+
+  if(result == TRUE)
+    printf("%u operations OK\n", NUM_OPERATIONS);
+
+  g_object_unref(index);
+  g_object_unref(buffer);
+  g_rand_free(rand);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
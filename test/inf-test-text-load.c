@@ -0,0 +1,344 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Loads a document consisting of many segments into different kinds of
+ * text buffers, once by inserting each segment at the end of the buffer and
+ * once by appending it, and prints the time needed for both. Verifies that
+ * both ways yield the same buffer content, and that clearing the buffer
+ * leaves it empty. InfTextGtkBuffer is tested as well if libinftextgtk is
+ * built. */
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-fixline-buffer.h>
+#include <libinftext/inf-text-piece-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-standalone-io.h>
+
+#ifdef INF_TEST_TEXT_LOAD_WITH_GTK
+# include <libinftextgtk/inf-text-gtk-buffer.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_AUTHORS 4
+#define NUM_SEGMENTS 100000
+#define MAX_SEGMENT_CHARS 200
+
+/* Characters of different UTF-8 lengths that make up the text */
+static const gchar* const test_chars[] = {
+  "a", "b", " ", "\n", "\xc3\xbc", "\xe2\x82\xac", "\xf0\x9f\x98\x80"
+};
+
+typedef struct _InfTestTextLoadSegment InfTestTextLoadSegment;
+struct _InfTestTextLoadSegment {
+  gchar* text;
+  gsize bytes;
+  guint chars;
+  InfUser* author;
+};
+
+typedef InfTextBuffer*(*InfTestTextLoadCreateFunc)(InfIo*, InfUserTable*);
+
+static InfTextBuffer*
+create_default_buffer(InfIo* io,
+                      InfUserTable* user_table)
+{
+  return INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+}
+
+static InfTextBuffer*
+create_fixline_buffer(InfIo* io,
+                      InfUserTable* user_table)
+{
+  InfTextBuffer* base;
+  InfTextBuffer* buffer;
+
+  base = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  buffer = INF_TEXT_BUFFER(inf_text_fixline_buffer_new(io, base, 1));
+  g_object_unref(base);
+
+  return buffer;
+}
+
+static InfTextBuffer*
+create_piece_buffer(InfIo* io,
+                    InfUserTable* user_table)
+{
+  return INF_TEXT_BUFFER(inf_text_piece_buffer_new());
+}
+
+#ifdef INF_TEST_TEXT_LOAD_WITH_GTK
+static InfTextBuffer*
+create_gtk_buffer(InfIo* io,
+                  InfUserTable* user_table)
+{
+  GtkTextBuffer* text_buffer;
+  InfTextGtkBuffer* buffer;
+
+  text_buffer = gtk_text_buffer_new(NULL);
+  buffer = inf_text_gtk_buffer_new(text_buffer, user_table);
+  g_object_unref(text_buffer);
+
+  return INF_TEXT_BUFFER(buffer);
+}
+#endif
+
+static InfTestTextLoadSegment*
+create_segments(GRand* rand,
+                InfUser** users)
+{
+  InfTestTextLoadSegment* segments;
+  GString* str;
+  guint i;
+  guint j;
+
+  segments = g_new(InfTestTextLoadSegment, NUM_SEGMENTS);
+  str = g_string_sized_new(MAX_SEGMENT_CHARS * 4);
+
+  for(i = 0; i < NUM_SEGMENTS; ++i)
+  {
+    g_string_truncate(str, 0);
+
+    segments[i].chars = g_rand_int_range(rand, 1, MAX_SEGMENT_CHARS + 1);
+    for(j = 0; j < segments[i].chars; ++j)
+    {
+      g_string_append(
+        str,
+        test_chars[g_rand_int_range(rand, 0, G_N_ELEMENTS(test_chars))]
+      );
+    }
+
+    segments[i].text = g_strndup(str->str, str->len);
+    segments[i].bytes = str->len;
+    segments[i].author = users[i % NUM_AUTHORS];
+  }
+
+  g_string_free(str, TRUE);
+  return segments;
+}
+
+static gdouble
+load(InfTextBuffer* buffer,
+     const InfTestTextLoadSegment* segments,
+     gboolean append)
+{
+  GTimer* timer;
+  gdouble elapsed;
+  guint i;
+
+  timer = g_timer_new();
+
+  for(i = 0; i < NUM_SEGMENTS; ++i)
+  {
+    if(append)
+    {
+      inf_text_buffer_append_text(
+        buffer,
+        segments[i].text,
+        segments[i].bytes,
+        segments[i].chars,
+        segments[i].author
+      );
+    }
+    else
+    {
+      inf_text_buffer_insert_text(
+        buffer,
+        inf_text_buffer_get_length(buffer),
+        segments[i].text,
+        segments[i].bytes,
+        segments[i].chars,
+        segments[i].author
+      );
+    }
+  }
+
+  elapsed = g_timer_elapsed(timer, NULL);
+  g_timer_destroy(timer);
+  return elapsed;
+}
+
+static gboolean
+test_buffer(const gchar* name,
+            InfTestTextLoadCreateFunc create_func,
+            InfIo* io,
+            InfUserTable* user_table,
+            const InfTestTextLoadSegment* segments)
+{
+  InfTextBuffer* inserted;
+  InfTextBuffer* appended;
+  InfTextChunk* inserted_chunk;
+  InfTextChunk* appended_chunk;
+  gdouble insert_time;
+  gdouble append_time;
+  gboolean result;
+
+  inserted = create_func(io, user_table);
+  appended = create_func(io, user_table);
+
+  insert_time = load(inserted, segments, FALSE);
+  append_time = load(appended, segments, TRUE);
+
+  printf(
+    "%-16s insert: %8.3f secs, append: %8.3f secs\n",
+    name,
+    insert_time,
+    append_time
+  );
+
+  result = TRUE;
+  if(inf_text_buffer_get_length(inserted) !=
+     inf_text_buffer_get_length(appended))
+  {
+    result = FALSE;
+  }
+  else
+  {
+    inserted_chunk = inf_text_buffer_get_slice(
+      inserted,
+      0,
+      inf_text_buffer_get_length(inserted)
+    );
+
+    appended_chunk = inf_text_buffer_get_slice(
+      appended,
+      0,
+      inf_text_buffer_get_length(appended)
+    );
+
+    result = inf_text_chunk_equal(inserted_chunk, appended_chunk);
+    inf_text_chunk_free(inserted_chunk);
+    inf_text_chunk_free(appended_chunk);
+  }
+
+  if(result == FALSE)
+  {
+    printf("%s: Appended text differs from inserted text\n", name);
+  }
+  else
+  {
+    inf_text_buffer_clear(appended);
+    if(inf_text_buffer_get_length(appended) != 0)
+    {
+      printf("%s: Buffer is not empty after clearing\n", name);
+      result = FALSE;
+    }
+  }
+
+  g_object_unref(inserted);
+  g_object_unref(appended);
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  InfStandaloneIo* io;
+  InfUserTable* user_table;
+  InfUser* users[NUM_AUTHORS];
+  InfTestTextLoadSegment* segments;
+  GRand* rand;
+  unsigned int rseed;
+  gchar* name;
+  gboolean result;
+  guint i;
+
+  if(argc > 1)
+    rseed = atoi(argv[1]);
+  else
+    rseed = time(NULL);
+
+  printf("Using random seed %u\n", rseed);
+
+  /* InfTextGtkBuffer looks up the authors of the text in the user table */
+  user_table = inf_user_table_new();
+  for(i = 0; i < NUM_AUTHORS; ++i)
+  {
+    name = g_strdup_printf("User %u", i + 1);
+    users[i] = INF_USER(inf_text_user_new(i + 1, name, NULL, 0.1 * i));
+    inf_user_table_add_user(user_table, users[i]);
+    g_free(name);
+  }
+
+  rand = g_rand_new_with_seed(rseed);
+  segments = create_segments(rand, users);
+  io = inf_standalone_io_new();
+
+  result = test_buffer(
+    "default buffer",
+    create_default_buffer,
+    INF_IO(io),
+    user_table,
+    segments
+  );
+
+  if(result == TRUE)
+  {
+    result = test_buffer(
+      "fixline buffer",
+      create_fixline_buffer,
+      INF_IO(io),
+      user_table,
+      segments
+    );
+  }
+
+  if(result == TRUE)
+  {
+    result = test_buffer(
+      "piece buffer",
+      create_piece_buffer,
+      INF_IO(io),
+      user_table,
+      segments
+    );
+  }
+
+#ifdef INF_TEST_TEXT_LOAD_WITH_GTK
+  if(result == TRUE)
+  {
+    result = test_buffer(
+      "gtk buffer",
+      create_gtk_buffer,
+      INF_IO(io),
+      user_table,
+      segments
+    );
+  }
+#endif
+
+  for(i = 0; i < NUM_SEGMENTS; ++i)
+    g_free(segments[i].text);
+  g_free(segments);
+
+  g_object_unref(io);
+  g_rand_free(rand);
+  for(i = 0; i < NUM_AUTHORS; ++i)
+    g_object_unref(users[i]);
+  g_object_unref(user_table);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
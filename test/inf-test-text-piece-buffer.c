@@ -0,0 +1,343 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Loads a large document into an InfTextPieceBuffer and an
+ * InfTextDefaultBuffer, applies the same random edits to both, and checks
+ * that both buffers keep the same content and the same segments. */
+
+#include <libinftext/inf-text-piece-buffer.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-buffer.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_AUTHORS 4
+#define NUM_DOCUMENT_SEGMENTS 64
+#define NUM_DOCUMENT_CHARS 200000
+#define NUM_EDITS 20000
+#define CHECK_INTERVAL 500
+
+/* Characters of different UTF-8 lengths that make up the text */
+static const gchar* const test_chars[] = {
+  "a", "b", " ", "\n", "\xc3\xbc", "\xe2\x82\xac", "\xf0\x9f\x98\x80"
+};
+
+static gchar*
+random_text(GRand* rand,
+            guint n_chars,
+            gsize* bytes)
+{
+  GString* str;
+  guint i;
+
+  str = g_string_sized_new(n_chars * 2);
+  for(i = 0; i < n_chars; ++i)
+  {
+    g_string_append(
+      str,
+      test_chars[g_rand_int_range(rand, 0, G_N_ELEMENTS(test_chars))]
+    );
+  }
+
+  *bytes = str->len;
+  return g_string_free(str, FALSE);
+}
+
+static gboolean
+check_buffers(InfTextBuffer* buffer,
+              InfTextBuffer* reference,
+              GRand* rand)
+{
+  InfTextBufferIter* iter;
+  InfTextBufferIter* ref_iter;
+  InfTextChunk* chunk;
+  InfTextChunk* ref_chunk;
+  gpointer text;
+  gpointer ref_text;
+  gboolean result;
+  gboolean more;
+  guint length;
+  guint pos;
+  guint len;
+
+  length = inf_text_buffer_get_length(reference);
+  if(inf_text_buffer_get_length(buffer) != length)
+    return FALSE;
+
+  pos = g_rand_int_range(rand, 0, length + 1);
+  len = g_rand_int_range(rand, 0, length - pos + 1);
+
+  chunk = inf_text_buffer_get_slice(buffer, pos, len);
+  ref_chunk = inf_text_buffer_get_slice(reference, pos, len);
+  result = inf_text_chunk_equal(chunk, ref_chunk);
+  inf_text_chunk_free(chunk);
+  inf_text_chunk_free(ref_chunk);
+
+  if(result == FALSE)
+    return FALSE;
+
+  /* Both buffers merge adjacent text of the same author, so they need to
+   * present the very same segments. */
+  iter = inf_text_buffer_create_begin_iter(buffer);
+  ref_iter = inf_text_buffer_create_begin_iter(reference);
+  if((iter == NULL) != (ref_iter == NULL))
+    result = FALSE;
+
+  more = iter != NULL && ref_iter != NULL;
+  while(result == TRUE && more == TRUE)
+  {
+    if(inf_text_buffer_iter_get_offset(buffer, iter) !=
+         inf_text_buffer_iter_get_offset(reference, ref_iter) ||
+       inf_text_buffer_iter_get_length(buffer, iter) !=
+         inf_text_buffer_iter_get_length(reference, ref_iter) ||
+       inf_text_buffer_iter_get_bytes(buffer, iter) !=
+         inf_text_buffer_iter_get_bytes(reference, ref_iter) ||
+       inf_text_buffer_iter_get_author(buffer, iter) !=
+         inf_text_buffer_iter_get_author(reference, ref_iter))
+    {
+      result = FALSE;
+      break;
+    }
+
+    text = inf_text_buffer_iter_get_text(buffer, iter);
+    ref_text = inf_text_buffer_iter_get_text(reference, ref_iter);
+
+    if(memcmp(text, ref_text, inf_text_buffer_iter_get_bytes(buffer, iter)))
+      result = FALSE;
+
+    g_free(text);
+    g_free(ref_text);
+
+    more = inf_text_buffer_iter_next(buffer, iter);
+    if(inf_text_buffer_iter_next(reference, ref_iter) != more)
+      result = FALSE;
+  }
+
+  if(iter != NULL)
+    inf_text_buffer_destroy_iter(buffer, iter);
+  if(ref_iter != NULL)
+    inf_text_buffer_destroy_iter(reference, ref_iter);
+
+  return result;
+}
+
+static void
+load_document(InfTextPieceBuffer* buffer,
+              InfTextBuffer* reference,
+              InfUser** users,
+              GRand* rand)
+{
+  GBytes* original;
+  gchar* text;
+  gsize bytes;
+  gsize offset;
+  gsize end;
+  guint chars;
+  guint pos;
+  guint i;
+  InfUser* user;
+
+  text = random_text(rand, NUM_DOCUMENT_CHARS, &bytes);
+  original = g_bytes_new_take(text, bytes);
+
+  offset = 0;
+  pos = 0;
+  for(i = 0; i < NUM_DOCUMENT_SEGMENTS; ++i)
+  {
+    if(i == NUM_DOCUMENT_SEGMENTS - 1)
+    {
+      end = bytes;
+    }
+    else
+    {
+      end = offset +
+        g_rand_int_range(rand, 0, 2 * bytes / NUM_DOCUMENT_SEGMENTS);
+      end = MIN(end, bytes);
+      while(end < bytes && (text[end] & 0xc0) == 0x80)
+        ++end;
+    }
+
+    chars = g_utf8_strlen(text + offset, end - offset);
+    user = users[g_rand_int_range(rand, 0, NUM_AUTHORS)];
+
+    inf_text_piece_buffer_insert_original(
+      buffer,
+      pos,
+      original,
+      offset,
+      end - offset,
+      chars,
+      user
+    );
+
+    inf_text_buffer_insert_text(
+      reference,
+      pos,
+      text + offset,
+      end - offset,
+      chars,
+      user
+    );
+
+    offset = end;
+    pos += chars;
+  }
+
+  g_bytes_unref(original);
+}
+
+int main(int argc, char* argv[])
+{
+  InfTextPieceBuffer* buffer;
+  InfTextBuffer* reference;
+  InfUser* users[NUM_AUTHORS];
+  GRand* rand;
+  GTimer* timer;
+  gdouble buffer_time;
+  gdouble reference_time;
+  unsigned int rseed;
+  InfUser* user;
+  gchar* text;
+  gsize bytes;
+  guint length;
+  guint typing;
+  guint pos;
+  guint len;
+  guint i;
+  gboolean result;
+
+  if(argc > 1)
+    rseed = atoi(argv[1]);
+  else
+    rseed = time(NULL);
+
+  printf("Using random seed %u\n", rseed);
+
+  for(i = 0; i < NUM_AUTHORS; ++i)
+  {
+    users[i] = INF_USER(
+      g_object_new(INF_TYPE_USER, "id", i + 1, "name", "User", NULL)
+    );
+  }
+
+  rand = g_rand_new_with_seed(rseed);
+  buffer = inf_text_piece_buffer_new();
+  reference = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  load_document(buffer, reference, users, rand);
+  result = check_buffers(INF_TEXT_BUFFER(buffer), reference, rand);
+
+  timer = g_timer_new();
+  buffer_time = 0.0;
+  reference_time = 0.0;
+  typing = 0;
+
+  for(i = 0; i < NUM_EDITS && result == TRUE; ++i)
+  {
+    length = inf_text_buffer_get_length(reference);
+    user = users[g_rand_int_range(rand, 0, NUM_AUTHORS)];
+
+    if(length == 0 || g_rand_int_range(rand, 0, 3) > 0)
+    {
+      /* Most insertions continue at the position of the previous one, as
+       * when a user is typing. */
+      if(typing <= length && g_rand_int_range(rand, 0, 4) > 0)
+        pos = typing;
+      else
+        pos = g_rand_int_range(rand, 0, length + 1);
+
+      if(g_rand_int_range(rand, 0, 50) == 0)
+        len = g_rand_int_range(rand, 1, 20000);
+      else
+        len = g_rand_int_range(rand, 1, 4);
+
+      text = random_text(rand, len, &bytes);
+
+      g_timer_start(timer);
+      inf_text_buffer_insert_text(
+        INF_TEXT_BUFFER(buffer),
+        pos,
+        text,
+        bytes,
+        len,
+        user
+      );
+      buffer_time += g_timer_elapsed(timer, NULL);
+
+      g_timer_start(timer);
+      inf_text_buffer_insert_text(reference, pos, text, bytes, len, user);
+      reference_time += g_timer_elapsed(timer, NULL);
+
+      g_free(text);
+      typing = pos + len;
+    }
+    else
+    {
+      pos = g_rand_int_range(rand, 0, length);
+      len = MIN(length - pos, (guint)g_rand_int_range(rand, 1, 50));
+
+      g_timer_start(timer);
+      inf_text_buffer_erase_text(INF_TEXT_BUFFER(buffer), pos, len, user);
+      buffer_time += g_timer_elapsed(timer, NULL);
+
+      g_timer_start(timer);
+      inf_text_buffer_erase_text(reference, pos, len, user);
+      reference_time += g_timer_elapsed(timer, NULL);
+
+      typing = pos;
+    }
+
+    if(i % CHECK_INTERVAL == 0)
+      result = check_buffers(INF_TEXT_BUFFER(buffer), reference, rand);
+  }
+
+  if(result == TRUE)
+    result = check_buffers(INF_TEXT_BUFFER(buffer), reference, rand);
+
+  if(result == TRUE)
+  {
+    printf(
+      "%u edits: %g secs (piece buffer), %g secs (default buffer)\n",
+      NUM_EDITS,
+      buffer_time,
+      reference_time
+    );
+  }
+  else
+  {
+    printf("Piece buffer does not match default buffer\n");
+  }
+
+  g_timer_destroy(timer);
+  g_object_unref(buffer);
+  g_object_unref(reference);
+  for(i = 0; i < NUM_AUTHORS; ++i)
+    g_object_unref(users[i]);
+  g_rand_free(rand);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -189,6 +189,8 @@ inf_test_text_replay_request_typestring(InfAdoptedRequest* request)
 }
 
 static gint64 test;
+static guint n_executed;
+static gint64 execute_time;
 
 static void
 inf_test_text_replay_begin_execute_request_cb(InfAdoptedAlgorithm* algorithm,
@@ -250,6 +252,9 @@ inf_test_text_replay_end_execute_request_cb(InfAdoptedAlgorithm* algorithm,
 
   if(error == NULL)
   {
+    ++n_executed;
+    execute_time += time - test;
+
     if(time - test > 10000.)
     {
       current_str = inf_adopted_state_vector_to_string(
@@ -373,6 +378,9 @@ int main(int argc, char* argv[])
     fprintf(stderr, "%s... ", argv[i]);
     fflush(stderr);
 
+    n_executed = 0;
+    execute_time = 0;
+
     replay = inf_adopted_session_replay_new();
     inf_adopted_session_replay_set_record(
       replay,
@@ -453,6 +461,17 @@ int main(int argc, char* argv[])
       {
         fprintf(stderr, "\n");
         inf_test_util_print_buffer(INF_TEXT_BUFFER(buffer));
+
+        if(n_executed > 0)
+        {
+          fprintf(
+            stderr,
+            "Executed %u requests in %.3g ms, %.3g us per request\n",
+            n_executed,
+            execute_time / 1000.,
+            (double)execute_time / n_executed
+          );
+        }
       }
 
       g_string_free(content, TRUE);
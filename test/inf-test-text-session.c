@@ -39,14 +39,54 @@ typedef struct {
   guint total;
   guint passed;
   gdouble time;
+  guint64 evictions;
 } test_result;
 
+typedef struct {
+  guint n_cached_requests;
+  guint64 evictions;
+} cache_stats;
+
+static void
+count_cache_foreach_func(InfUser* user,
+                         gpointer user_data)
+{
+  cache_stats* stats;
+  InfAdoptedRequestLog* log;
+  guint64 evictions;
+
+  stats = (cache_stats*)user_data;
+  log = inf_adopted_user_get_request_log(INF_ADOPTED_USER(user));
+
+  g_object_get(G_OBJECT(log), "cache-evictions", &evictions, NULL);
+
+  stats->n_cached_requests +=
+    inf_adopted_request_log_get_n_cached_requests(log);
+  stats->evictions += evictions;
+}
+
+static void
+count_cache(InfSession* session,
+            cache_stats* stats)
+{
+  stats->n_cached_requests = 0;
+  stats->evictions = 0;
+
+  inf_user_table_foreach_user(
+    inf_session_get_user_table(session),
+    count_cache_foreach_func,
+    stats
+  );
+}
+
 static gboolean
 perform_single_test(InfTextChunk* initial,
                     InfTextChunk* final,
                     GSList* users,
                     GSList* requests,
-                    gdouble* time)
+                    guint max_cache_size,
+                    gdouble* time,
+                    guint64* evictions)
 {
   InfTextBuffer* buffer;
   InfCommunicationManager* manager;
@@ -68,6 +108,7 @@ perform_single_test(InfTextChunk* initial,
   gsize second_bytes;
 
   GTimer* timer;
+  cache_stats stats;
 
   buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
   inf_text_buffer_insert_chunk(buffer, 0, initial, NULL);
@@ -106,10 +147,17 @@ perform_single_test(InfTextChunk* initial,
     NULL
   );
 
+  g_object_set(
+    G_OBJECT(inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session))),
+    "max-cache-size", max_cache_size,
+    NULL
+  );
+
   g_object_unref(G_OBJECT(io));
   g_object_unref(G_OBJECT(manager));
   g_object_unref(G_OBJECT(user_table));
 
+  result = TRUE;
   timer = g_timer_new();
   for(item = requests; item != NULL; item = item->next)
   {
@@ -120,11 +168,29 @@ perform_single_test(InfTextChunk* initial,
       NULL,
       request
     );
+
+    if(max_cache_size != G_MAXUINT)
+    {
+      count_cache(INF_SESSION(session), &stats);
+      if(stats.n_cached_requests > max_cache_size)
+      {
+        printf(
+          "(%u cached requests, limit %u) ",
+          stats.n_cached_requests,
+          max_cache_size
+        );
+
+        result = FALSE;
+      }
+    }
   }
 
   *time = g_timer_elapsed(timer, NULL);
   g_timer_destroy(timer);
 
+  count_cache(INF_SESSION(session), &stats);
+  *evictions += stats.evictions;
+
   test_chunk = inf_text_buffer_get_slice(
     buffer,
     0,
@@ -133,10 +199,10 @@ perform_single_test(InfTextChunk* initial,
 
   g_object_unref(G_OBJECT(session));
 
-  result = inf_text_chunk_equal(test_chunk, final);
-
-  if(result == FALSE)
+  if(!inf_text_chunk_equal(test_chunk, final))
   {
+    result = FALSE;
+
     first = inf_text_chunk_get_text(final, &first_bytes);
     second = inf_text_chunk_get_text(test_chunk, &second_bytes);
     printf("(%.*s vs. %.*s) ", (int)second_bytes, second, (int)first_bytes, first);
@@ -155,7 +221,8 @@ perform_test(InfTextChunk* initial,
              GSList* users,
              GSList* requests,
              GRand* rand,
-             gdouble* time)
+             gdouble* time,
+             guint64* evictions)
 {
   GSList* permutation;
   GSList* item;
@@ -249,12 +316,16 @@ perform_test(InfTextChunk* initial,
       fflush(stdout);
     }
 
+    /* Run every other permutation with a tiny translation cache, so that
+     * cached requests are evicted and need to be translated again. */
     retval = perform_single_test(
       initial,
       final,
       users,
       permutation,
-      &local_time
+      (i % 2 == 0) ? G_MAXUINT : 2,
+      &local_time,
+      evictions
     );
 
     if(!retval) break;
@@ -368,7 +439,8 @@ foreach_test_func(const gchar* testfile,
         users,
         requests,
         result->rand,
-        &local_time
+        &local_time,
+        &result->evictions
       );
       
       if(retval == TRUE)
@@ -433,6 +505,7 @@ int main(int argc, char* argv[])
   result.total = 0;
   result.passed = 0;
   result.time = 0.0;
+  result.evictions = 0;
 
   timer = g_timer_new();
   retval = inf_test_util_dir_foreach(
@@ -462,6 +535,12 @@ int main(int argc, char* argv[])
   if(result.passed < result.total)
     return -1;
 
+  /* Make sure that the tiny translation cache has actually been exceeded,
+   * otherwise the eviction code paths have not been tested. */
+  printf("%" G_GUINT64_FORMAT " cached requests evicted\n", result.evictions);
+  if(result.evictions == 0)
+    return -1;
+
   return 0;
 }
 
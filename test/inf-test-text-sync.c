@@ -0,0 +1,230 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Synchronizes a large document from one text session into another one,
+ * without a connection in between, and prints the time needed to write the
+ * document into XML and to read it back. The size of the document in
+ * megabytes can be given on the command line. */
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/common/inf-standalone-io.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define NUM_AUTHORS 4
+#define SEGMENT_CHARS 65536
+
+/* Characters of different UTF-8 lengths that make up the text. The form
+ * feed is not valid in XML and needs to be escaped. */
+static const gchar* const test_chars[] = {
+  "a", "b", " ", "\n", "<", "&", "\f", "\xc3\xbc", "\xe2\x82\xac"
+};
+
+static InfTextBuffer*
+create_document(InfUserTable* user_table,
+                gsize size)
+{
+  InfTextBuffer* buffer;
+  InfUser* users[NUM_AUTHORS];
+  GString* str;
+  gchar* name;
+  gsize bytes;
+  guint chars;
+  guint i;
+
+  for(i = 0; i < NUM_AUTHORS; ++i)
+  {
+    name = g_strdup_printf("User %u", i + 1);
+    users[i] = INF_USER(inf_text_user_new(i + 1, name, NULL, 0.1 * i));
+    inf_user_table_add_user(user_table, users[i]);
+    g_free(name);
+  }
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  str = g_string_sized_new(SEGMENT_CHARS * 2);
+
+  for(i = 0, bytes = 0; bytes < size || i == 0; ++i, bytes += str->len)
+  {
+    g_string_truncate(str, 0);
+    for(chars = 0; chars < SEGMENT_CHARS; ++chars)
+      g_string_append(str, test_chars[rand() % G_N_ELEMENTS(test_chars)]);
+
+    inf_text_buffer_insert_text(
+      buffer,
+      inf_text_buffer_get_length(buffer),
+      str->str,
+      str->len,
+      SEGMENT_CHARS,
+      users[i % NUM_AUTHORS]
+    );
+  }
+
+  g_string_free(str, TRUE);
+  for(i = 0; i < NUM_AUTHORS; ++i)
+    g_object_unref(users[i]);
+
+  return buffer;
+}
+
+static gboolean
+compare_buffers(InfTextBuffer* first,
+                InfTextBuffer* second)
+{
+  InfTextChunk* first_chunk;
+  InfTextChunk* second_chunk;
+  gboolean result;
+
+  if(inf_text_buffer_get_length(first) != inf_text_buffer_get_length(second))
+    return FALSE;
+
+  first_chunk =
+    inf_text_buffer_get_slice(first, 0, inf_text_buffer_get_length(first));
+  second_chunk =
+    inf_text_buffer_get_slice(second, 0, inf_text_buffer_get_length(second));
+
+  result = inf_text_chunk_equal(first_chunk, second_chunk);
+  inf_text_chunk_free(first_chunk);
+  inf_text_chunk_free(second_chunk);
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  InfStandaloneIo* io;
+  InfCommunicationManager* manager;
+  InfUserTable* user_table;
+  InfTextBuffer* source_buffer;
+  InfTextBuffer* target_buffer;
+  InfTextSession* source;
+  InfTextSession* target;
+  xmlNodePtr root;
+  xmlNodePtr child;
+  GTimer* timer;
+  GError* error;
+  gsize size;
+  guint n_segments;
+  gboolean result;
+
+  size = 20;
+  if(argc > 1)
+    size = atoi(argv[1]);
+
+  io = inf_standalone_io_new();
+  manager = inf_communication_manager_new();
+  user_table = inf_user_table_new();
+
+  source_buffer = create_document(user_table, size * 1024 * 1024);
+  target_buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  source = inf_text_session_new_with_user_table(
+    manager,
+    source_buffer,
+    INF_IO(io),
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  target = inf_text_session_new_with_user_table(
+    manager,
+    target_buffer,
+    INF_IO(io),
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  printf(
+    "Document of %u characters\n",
+    inf_text_buffer_get_length(source_buffer)
+  );
+
+  root = xmlNewNode(NULL, (const xmlChar*)"sync");
+  timer = g_timer_new();
+
+  INF_SESSION_GET_CLASS(source)->to_xml_sync(INF_SESSION(source), root);
+  printf("to XML      %8.3f secs\n", g_timer_elapsed(timer, NULL));
+
+  /* Only the document content is read back, the users are shared between
+   * both sessions already. */
+  error = NULL;
+  result = TRUE;
+  n_segments = 0;
+  g_timer_start(timer);
+
+  for(child = root->children; child != NULL && result; child = child->next)
+  {
+    if(strcmp((const char*)child->name, "sync-segment") == 0)
+    {
+      result = INF_SESSION_GET_CLASS(target)->process_xml_sync(
+        INF_SESSION(target),
+        NULL,
+        child,
+        &error
+      );
+
+      ++n_segments;
+    }
+  }
+
+  if(result == TRUE)
+  {
+    printf(
+      "from XML    %8.3f secs, %u segments\n",
+      g_timer_elapsed(timer, NULL),
+      n_segments
+    );
+
+    if(!compare_buffers(source_buffer, target_buffer))
+    {
+      fprintf(stderr, "Document changed after being synchronized\n");
+      result = FALSE;
+    }
+  }
+  else
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+
+  g_timer_destroy(timer);
+  xmlFreeNode(root);
+
+  g_object_unref(source);
+  g_object_unref(target);
+  g_object_unref(source_buffer);
+  g_object_unref(target_buffer);
+  g_object_unref(user_table);
+  g_object_unref(manager);
+  g_object_unref(io);
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
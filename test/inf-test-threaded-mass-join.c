@@ -0,0 +1,537 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Like inf-test-mass-join, but spreads the joiners over the event loops of
+ * an InfThreadedIo. Each joiner has its own connection, browser and
+ * session, all of which are pinned to one loop and only accessed from the
+ * thread running it. Once joined, each joiner makes a number of insertions.
+ *
+ * This is a smoke test for running many clients on InfThreadedIo only. The
+ * server it connects to is an external infinoted, which processes all
+ * connections and sessions in a single thread, so the time it prints does
+ * not tell how a server would scale with more threads.
+ *
+ * Usage: inf-test-threaded-mass-join [loops] [joiners] [document] */
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-session.h>
+#include <libinfinity/client/infc-browser.h>
+#include <libinfinity/client/infc-session-proxy.h>
+#include <libinfinity/adopted/inf-adopted-session.h>
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/adopted/inf-adopted-state-vector.h>
+#include <libinfinity/common/inf-request-result.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-ip-address.h>
+#include <libinfinity/common/inf-threaded-io.h>
+#include <libinfinity/common/inf-error.h>
+#include <libinfinity/common/inf-protocol.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define DEFAULT_JOINERS 128
+#define NUM_INSERTIONS 20
+#define MAX_SECONDS 60
+
+typedef struct _InfTestThreadedMassJoin InfTestThreadedMassJoin;
+struct _InfTestThreadedMassJoin {
+  InfThreadedIo* io;
+  const gchar* document;
+
+  GMutex mutex;
+  GCond cond;
+  guint n_finished;
+  guint n_joined;
+};
+
+typedef struct _InfTestThreadedMassJoiner InfTestThreadedMassJoiner;
+struct _InfTestThreadedMassJoiner {
+  InfTestThreadedMassJoin* massjoin;
+  InfIo* io;
+
+  InfCommunicationManager* communication_manager;
+  InfcBrowser* browser;
+  InfcSessionProxy* session;
+
+  gchar* username;
+  gboolean finished;
+};
+
+static InfSession*
+inf_test_threaded_mass_join_session_new(InfIo* io,
+                                        InfCommunicationManager* manager,
+                                        InfSessionStatus status,
+                                        InfCommunicationGroup* sync_group,
+                                        InfXmlConnection* sync_connection,
+                                        const gchar* path,
+                                        gpointer user_data)
+{
+  InfTextDefaultBuffer* buffer;
+  InfTextSession* session;
+
+  buffer = inf_text_default_buffer_new("UTF-8");
+  session = inf_text_session_new(
+    manager,
+    INF_TEXT_BUFFER(buffer),
+    io,
+    status,
+    sync_group,
+    sync_connection
+  );
+  g_object_unref(buffer);
+
+  return INF_SESSION(session);
+}
+
+static const InfcNotePlugin INF_TEST_THREADED_MASS_JOIN_TEXT_PLUGIN = {
+  NULL, "InfText", inf_test_threaded_mass_join_session_new
+};
+
+/* Called from the joiner's thread when it is done, either successfully or
+ * not. Wakes up the main thread. */
+static void
+inf_test_threaded_mass_join_finish(InfTestThreadedMassJoiner* joiner,
+                                   gboolean joined)
+{
+  InfTestThreadedMassJoin* massjoin;
+  massjoin = joiner->massjoin;
+
+  if(joiner->finished == TRUE)
+    return;
+
+  joiner->finished = TRUE;
+
+  g_mutex_lock(&massjoin->mutex);
+  ++massjoin->n_finished;
+  if(joined) ++massjoin->n_joined;
+  g_cond_signal(&massjoin->cond);
+  g_mutex_unlock(&massjoin->mutex);
+}
+
+static void
+inf_test_threaded_mass_join_fail(InfTestThreadedMassJoiner* joiner,
+                                 const gchar* message)
+{
+  fprintf(stderr, "Joiner %s: %s\n", joiner->username, message);
+  inf_test_threaded_mass_join_finish(joiner, FALSE);
+}
+
+static void
+inf_test_threaded_mass_join_user_join_finished_cb(InfRequest* request,
+                                                  const InfRequestResult* res,
+                                                  const GError* error,
+                                                  gpointer user_data)
+{
+  InfTestThreadedMassJoiner* joiner;
+  InfSession* session;
+  InfTextBuffer* buffer;
+  InfUser* user;
+  guint i;
+
+  joiner = (InfTestThreadedMassJoiner*)user_data;
+
+  if(error != NULL)
+  {
+    inf_test_threaded_mass_join_fail(joiner, error->message);
+    return;
+  }
+
+  inf_request_result_get_join_user(res, NULL, &user);
+
+  g_object_get(G_OBJECT(joiner->session), "session", &session, NULL);
+  buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
+
+  /* Local insertions are turned into requests by the session and sent to
+   * the server. */
+  for(i = 0; i < NUM_INSERTIONS; ++i)
+    inf_text_buffer_insert_text(buffer, 0, "a", 1, 1, user);
+
+  g_object_unref(session);
+  inf_test_threaded_mass_join_finish(joiner, TRUE);
+}
+
+static void
+inf_test_threaded_mass_join_join_user(InfTestThreadedMassJoiner* joiner)
+{
+  InfSession* session;
+  InfAdoptedStateVector* v;
+  GParameter params[3] = {
+    { "name", { 0 } },
+    { "vector", { 0 } },
+    { "caret-position", { 0 } }
+  };
+
+  g_value_init(&params[0].value, G_TYPE_STRING);
+  g_value_init(&params[1].value, INF_ADOPTED_TYPE_STATE_VECTOR);
+  g_value_init(&params[2].value, G_TYPE_UINT);
+
+  g_value_set_static_string(&params[0].value, joiner->username);
+
+  g_object_get(G_OBJECT(joiner->session), "session", &session, NULL);
+  v = inf_adopted_algorithm_get_current(
+    inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session))
+  );
+  g_object_unref(session);
+
+  g_value_set_boxed(&params[1].value, v);
+  g_value_set_uint(&params[2].value, 0u);
+
+  inf_session_proxy_join_user(
+    INF_SESSION_PROXY(joiner->session),
+    3,
+    params,
+    inf_test_threaded_mass_join_user_join_finished_cb,
+    joiner
+  );
+
+  g_value_unset(&params[2].value);
+  g_value_unset(&params[1].value);
+  g_value_unset(&params[0].value);
+}
+
+static void
+inf_test_threaded_mass_join_synchronization_failed_cb(InfSession* session,
+                                                      InfXmlConnection* conn,
+                                                      const GError* error,
+                                                      gpointer user_data)
+{
+  inf_test_threaded_mass_join_fail(
+    (InfTestThreadedMassJoiner*)user_data,
+    error->message
+  );
+}
+
+static void
+inf_test_threaded_mass_join_synchronization_complete_cb(InfSession* session,
+                                                        InfXmlConnection* c,
+                                                        gpointer user_data)
+{
+  inf_test_threaded_mass_join_join_user(
+    (InfTestThreadedMassJoiner*)user_data
+  );
+}
+
+static void
+inf_test_threaded_mass_join_subscribe_finished_cb(InfRequest* request,
+                                                  const InfRequestResult* res,
+                                                  const GError* error,
+                                                  gpointer user_data)
+{
+  InfTestThreadedMassJoiner* joiner;
+  const InfBrowserIter* iter;
+  InfSession* session;
+
+  joiner = (InfTestThreadedMassJoiner*)user_data;
+
+  if(error != NULL)
+  {
+    inf_test_threaded_mass_join_fail(joiner, error->message);
+    return;
+  }
+
+  inf_request_result_get_subscribe_session(res, NULL, &iter, NULL);
+
+  joiner->session = INFC_SESSION_PROXY(
+    inf_browser_get_session(INF_BROWSER(joiner->browser), iter)
+  );
+
+  g_object_get(G_OBJECT(joiner->session), "session", &session, NULL);
+  switch(inf_session_get_status(session))
+  {
+  case INF_SESSION_PRESYNC:
+  case INF_SESSION_SYNCHRONIZING:
+    g_signal_connect_after(
+      G_OBJECT(session),
+      "synchronization-failed",
+      G_CALLBACK(inf_test_threaded_mass_join_synchronization_failed_cb),
+      joiner
+    );
+
+    g_signal_connect_after(
+      G_OBJECT(session),
+      "synchronization-complete",
+      G_CALLBACK(inf_test_threaded_mass_join_synchronization_complete_cb),
+      joiner
+    );
+
+    break;
+  case INF_SESSION_RUNNING:
+    inf_test_threaded_mass_join_join_user(joiner);
+    break;
+  case INF_SESSION_CLOSED:
+    inf_test_threaded_mass_join_fail(joiner, "Session closed");
+    break;
+  }
+
+  g_object_unref(session);
+}
+
+static void
+inf_test_threaded_mass_join_explore_finished_cb(InfRequest* request,
+                                                const InfRequestResult* res,
+                                                const GError* error,
+                                                gpointer user_data)
+{
+  InfTestThreadedMassJoiner* joiner;
+  InfBrowser* browser;
+  InfBrowserIter iter;
+  gboolean has_child;
+
+  joiner = (InfTestThreadedMassJoiner*)user_data;
+  browser = INF_BROWSER(joiner->browser);
+
+  inf_browser_get_root(browser, &iter);
+  for(has_child = inf_browser_get_child(browser, &iter);
+      has_child == TRUE;
+      has_child = inf_browser_get_next(browser, &iter))
+  {
+    if(strcmp(inf_browser_get_node_name(browser, &iter),
+              joiner->massjoin->document) == 0)
+    {
+      inf_browser_subscribe(
+        browser,
+        &iter,
+        inf_test_threaded_mass_join_subscribe_finished_cb,
+        joiner
+      );
+
+      return;
+    }
+  }
+
+  inf_test_threaded_mass_join_fail(joiner, "Document does not exist");
+}
+
+static void
+inf_test_threaded_mass_join_browser_notify_status_cb(GObject* object,
+                                                     const GParamSpec* pspec,
+                                                     gpointer user_data)
+{
+  InfTestThreadedMassJoiner* joiner;
+  InfBrowser* browser;
+  InfBrowserIter iter;
+
+  joiner = (InfTestThreadedMassJoiner*)user_data;
+  browser = INF_BROWSER(object);
+
+  switch(inf_browser_get_status(browser))
+  {
+  case INF_BROWSER_OPENING:
+    /* nothing to do */
+    break;
+  case INF_BROWSER_OPEN:
+    inf_browser_get_root(browser, &iter);
+
+    inf_browser_explore(
+      browser,
+      &iter,
+      inf_test_threaded_mass_join_explore_finished_cb,
+      joiner
+    );
+
+    break;
+  case INF_BROWSER_CLOSED:
+    inf_test_threaded_mass_join_fail(joiner, "Disconnected");
+    break;
+  default:
+    g_assert_not_reached();
+    break;
+  }
+}
+
+/* Runs in the thread of the joiner's loop, so that all of its objects are
+ * created and used from that thread only. */
+static void
+inf_test_threaded_mass_join_connect_func(gpointer user_data)
+{
+  InfTestThreadedMassJoiner* joiner;
+  InfIpAddress* addr;
+  InfTcpConnection* tcp;
+  InfXmppConnection* xmpp;
+  InfXmlConnection* xml;
+  GError* error;
+
+  joiner = (InfTestThreadedMassJoiner*)user_data;
+
+  addr = inf_ip_address_new_loopback4();
+  tcp = inf_tcp_connection_new(
+    joiner->io,
+    addr,
+    inf_protocol_get_default_port()
+  );
+
+  xmpp = inf_xmpp_connection_new(
+    tcp,
+    INF_XMPP_CONNECTION_CLIENT,
+    g_get_host_name(),
+    "127.0.0.1",
+    INF_XMPP_CONNECTION_SECURITY_BOTH_PREFER_TLS,
+    NULL,
+    NULL,
+    NULL
+  );
+
+  joiner->communication_manager = inf_communication_manager_new();
+  joiner->browser = infc_browser_new(
+    joiner->io,
+    joiner->communication_manager,
+    INF_XML_CONNECTION(xmpp)
+  );
+
+  g_object_unref(xmpp);
+  g_object_unref(tcp);
+  inf_ip_address_free(addr);
+
+  infc_browser_add_plugin(
+    joiner->browser,
+    &INF_TEST_THREADED_MASS_JOIN_TEXT_PLUGIN
+  );
+
+  g_signal_connect(
+    G_OBJECT(joiner->browser),
+    "notify::status",
+    G_CALLBACK(inf_test_threaded_mass_join_browser_notify_status_cb),
+    joiner
+  );
+
+  error = NULL;
+  xml = infc_browser_get_connection(joiner->browser);
+  if(inf_xml_connection_open(xml, &error) == FALSE)
+  {
+    inf_test_threaded_mass_join_fail(joiner, error->message);
+    g_error_free(error);
+  }
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+  InfTestThreadedMassJoin massjoin;
+  InfTestThreadedMassJoiner* joiners;
+  guint n_loops;
+  guint n_joiners;
+  GTimer* timer;
+  gint64 end_time;
+  GError* error;
+  guint i;
+
+  n_loops = 0;
+  n_joiners = DEFAULT_JOINERS;
+  massjoin.document = "Test";
+
+  if(argc > 1)
+    n_loops = atoi(argv[1]);
+  if(argc > 2)
+    n_joiners = atoi(argv[2]);
+  if(argc > 3)
+    massjoin.document = argv[3];
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  massjoin.io = inf_threaded_io_new(n_loops);
+  massjoin.n_finished = 0;
+  massjoin.n_joined = 0;
+  g_mutex_init(&massjoin.mutex);
+  g_cond_init(&massjoin.cond);
+
+  if(!inf_threaded_io_start(massjoin.io, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  timer = g_timer_new();
+  joiners = g_new(InfTestThreadedMassJoiner, n_joiners);
+  for(i = 0; i < n_joiners; ++i)
+  {
+    joiners[i].massjoin = &massjoin;
+    joiners[i].io = inf_threaded_io_acquire_loop(massjoin.io);
+    joiners[i].communication_manager = NULL;
+    joiners[i].browser = NULL;
+    joiners[i].session = NULL;
+    joiners[i].username = g_strdup_printf("MassJoin%03u", i);
+    joiners[i].finished = FALSE;
+
+    /* Hand the joiner over to its loop */
+    inf_io_add_dispatch(
+      joiners[i].io,
+      inf_test_threaded_mass_join_connect_func,
+      &joiners[i],
+      NULL
+    );
+  }
+
+  end_time = g_get_monotonic_time() + MAX_SECONDS * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock(&massjoin.mutex);
+  while(massjoin.n_finished < n_joiners)
+    if(!g_cond_wait_until(&massjoin.cond, &massjoin.mutex, end_time))
+      break;
+
+  printf(
+    "%u of %u users joined and made %u insertions each in %.3f secs, "
+    "using %u client loops\n",
+    massjoin.n_joined,
+    n_joiners,
+    NUM_INSERTIONS,
+    g_timer_elapsed(timer, NULL),
+    inf_threaded_io_get_n_loops(massjoin.io)
+  );
+
+  g_mutex_unlock(&massjoin.mutex);
+
+  /* With the loops stopped, the joiners can be freed from this thread */
+  inf_threaded_io_stop(massjoin.io);
+
+  for(i = 0; i < n_joiners; ++i)
+  {
+    if(joiners[i].browser != NULL)
+      g_object_unref(joiners[i].browser);
+    if(joiners[i].communication_manager != NULL)
+      g_object_unref(joiners[i].communication_manager);
+
+    inf_threaded_io_release_loop(massjoin.io, joiners[i].io);
+    g_free(joiners[i].username);
+  }
+
+  g_free(joiners);
+  g_timer_destroy(timer);
+  g_object_unref(massjoin.io);
+  g_cond_clear(&massjoin.cond);
+  g_mutex_clear(&massjoin.mutex);
+
+  if(massjoin.n_joined < n_joiners)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */